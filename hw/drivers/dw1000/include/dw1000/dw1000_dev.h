@@ -97,6 +97,7 @@ typedef enum _dw1000_extension_id_t{
     DW1000_RTDOA = 0x30,                     //!< RTDoA
     DW1000_RTDOA_BH,                         //!< RTDoA Backhaul
     DW1000_SURVEY = 0x40,
+    DW1000_AOA,                              //!< Angle of arrival
     DW1000_APP0 = 1024, 
     DW1000_APP1, 
     DW1000_APP2
@@ -143,6 +144,7 @@ typedef struct _dw1000_dev_control_t{
     uint32_t sleep_after_tx:1;              //!< Enables to load LDE microcode on wake up
     uint32_t sleep_after_rx:1;              //!< Enables to load LDO tune value on wake up
     uint32_t cir_enable:1;                  //!< Enables reading CIR on this operation
+    uint32_t cir_pending:1;                 //!< CIR read deferred past the rx_complete callbacks, see CIR_DEFERRED_READ
 }dw1000_dev_control_t;
 
 //! DW1000 receiver configuration parameters.
@@ -250,7 +252,7 @@ typedef struct _dw1000_mac_interface_t {
     void *inst_ptr;                   //!< Pointer to instance
     bool (* tx_complete_cb) (struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< Transmit complete callback
     bool (* rx_complete_cb) (struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< Receive complete callback
-    bool (* cir_complete_cb)(struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< CIR complete callback, prior to RXEN
+    bool (* cir_complete_cb)(struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< CIR complete callback, prior to RXEN (after the rx_complete callbacks with CIR_DEFERRED_READ)
     bool (* rx_timeout_cb)  (struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< Receive timeout callback
     bool (* rx_error_cb)    (struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< Receive error callback
     bool (* tx_error_cb)    (struct _dw1000_dev_instance_t *, struct _dw1000_mac_interface_t *);    //!< Transmit error callback  
@@ -80,6 +80,9 @@ int dw1000_cli_register(void);
 static void dw1000_interrupt_task(void *arg);
 static void dw1000_interrupt_ev_cb(struct os_event *ev);
 static void dw1000_irq(void *arg);
+#if MYNEWT_VAL(CIR_ENABLED)
+static void dw1000_mac_cir_complete(dw1000_dev_instance_t * inst);
+#endif
 
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
@@ -548,6 +551,15 @@ struct _dw1000_dev_status_t dw1000_start_tx(struct _dw1000_dev_instance_t * inst
     os_error_t err = os_sem_pend(&inst->tx_sem,  OS_TIMEOUT_NEVER); // Released by a SYS_STATUS_TXFRS event
     assert(err == OS_OK);
 
+#if MYNEWT_VAL(CIR_ENABLED) && MYNEWT_VAL(CIR_DEFERRED_READ)
+    // A rx_complete callback responds to a frame whose CIR is still pending, the accumulator clocks must not
+    // be forced once the transmitter is started so the read falls back to before the TX, on the response path
+    if (inst->control.cir_pending) {
+        dw1000_mac_cir_complete(inst);
+        inst->control.cir_pending = false;
+    }
+#endif
+
     dw1000_dev_control_t control = inst->control;
     dw1000_dev_config_t config = inst->config;
 
@@ -1333,6 +1345,27 @@ dw1000_ic_and_host_ptrs_equal(dw1000_dev_instance_t * inst)
     return (uint8_t)((b & (SYS_STATUS_ICRBP >> 24)) == ((b & (SYS_STATUS_HSRBP >> 24)) << 1));
 }
 
+#if MYNEWT_VAL(CIR_ENABLED)
+/**
+ * Call the CIR complete callbacks. Runs before RXENAB, or after RXENAB and the rx_complete callbacks when
+ * CIR_DEFERRED_READ is set.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return void
+ */
+static void
+dw1000_mac_cir_complete(dw1000_dev_instance_t * inst)
+{
+    dw1000_mac_interface_t * cbs = NULL;
+    if(!(SLIST_EMPTY(&inst->interface_cbs))) {
+        SLIST_FOREACH(cbs, &inst->interface_cbs, next) {
+            if (cbs != NULL && cbs->cir_complete_cb) {
+                if(cbs->cir_complete_cb(inst,cbs)) continue;
+            }
+        }   
+    }  
+}
+#endif
 
 /**
  * This is the DW1000's general Interrupt Service Routine. It will process/report the following events:
@@ -1371,7 +1404,6 @@ dw1000_interrupt_ev_cb(struct os_event *ev)
     // leading edge detection complete
     if((inst->sys_status & SYS_STATUS_RXFCG)){
         MAC_STATS_INC(DFR_cnt);
-
         if (inst->status.overrun_error){
             MAC_STATS_INC(ROV_err);
             /* Overrun flag has been set */
@@ -1462,20 +1494,22 @@ dw1000_interrupt_ev_cb(struct os_event *ev)
             // carrier_integrator only avilable while in single buffer mode.
             inst->carrier_integrator = dw1000_read_carrier_integrator(inst);
 #if MYNEWT_VAL(CIR_ENABLED)
+            bool cir_read = inst->config.cir_enable || inst->control.cir_enable;
+            inst->control.cir_enable = false;
+#if MYNEWT_VAL(CIR_DEFERRED_READ)
+            inst->control.cir_pending = cir_read;
+#else
             // Call CIR complete calbacks if present
-            if(inst->config.cir_enable || inst->control.cir_enable) {
-                dw1000_mac_interface_t * cbs = NULL;
-                if(!(SLIST_EMPTY(&inst->interface_cbs))) {
-                    SLIST_FOREACH(cbs, &inst->interface_cbs, next) {
-                        if (cbs != NULL && cbs->cir_complete_cb) {
-                            if(cbs->cir_complete_cb(inst,cbs)) continue;
-                        }
-                    }   
-                }  
-                inst->control.cir_enable = false;
-            }
+            if (cir_read)
+                dw1000_mac_cir_complete(inst);
+#endif
 #endif
+#if MYNEWT_VAL(CIR_DEFERRED_READ)
+            // RXPRD is cleared so that the deferred CIR read can tell if a new preamble overtook it
+            dw1000_write_reg(inst, SYS_STATUS_ID, 0, (SYS_STATUS_LDEDONE | SYS_STATUS_RXDFR | SYS_STATUS_RXFCG | SYS_STATUS_RXFCE | SYS_STATUS_RXDFR | SYS_STATUS_RXPRD), sizeof(uint16_t)); 
+#else
             dw1000_write_reg(inst, SYS_STATUS_ID, 0, (SYS_STATUS_LDEDONE | SYS_STATUS_RXDFR | SYS_STATUS_RXFCG | SYS_STATUS_RXFCE | SYS_STATUS_RXDFR), sizeof(uint16_t)); 
+#endif
             dw1000_write_reg(inst, SYS_CTRL_ID, SYS_CTRL_OFFSET, SYS_CTRL_RXENAB, sizeof(uint16_t));
         }
         
@@ -1487,6 +1521,14 @@ dw1000_interrupt_ev_cb(struct os_event *ev)
                 if(cbs->rx_complete_cb(inst,cbs)) break;
             }   
         }  
+#if MYNEWT_VAL(CIR_ENABLED) && MYNEWT_VAL(CIR_DEFERRED_READ)
+        // Receiver is back on and the frame handled, the accumulator holds until the next preamble is detected.
+        // Cleared by dw1000_start_tx() when a callback already read it ahead of a response.
+        if (inst->control.cir_pending) {
+            inst->control.cir_pending = false;
+            dw1000_mac_cir_complete(inst);
+        }
+#endif
     }
 
     // Handle TX confirmation event
@@ -0,0 +1,117 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file aoa.h
+ * @brief Angle of arrival
+ *
+ * @details Calibrated angle of arrival for dual receiver boards. The PDoA of every frame received by both
+ * instances is corrected by the board phase offset, averaged on the unit circle and mapped to an angle
+ * through a measured calibration table, falling back to the ideal arcsine when no table is present.
+ */
+
+#ifndef _AOA_H_
+#define _AOA_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/os.h>
+#include <stats/stats.h>
+#include <dw1000/dw1000_dev.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if MYNEWT_VAL(AOA_STATS)
+STATS_SECT_START(aoa_stat_section)
+    STATS_SECT_ENTRY(update)
+    STATS_SECT_ENTRY(mismatch)
+    STATS_SECT_ENTRY(cal_done)
+STATS_SECT_END
+#endif
+
+//! Status parameters
+typedef struct _aoa_status_t{
+    uint16_t selfmalloc:1;              //!< Internal flag for memory garbage collection
+    uint16_t initialized:1;             //!< Instance allocated
+    uint16_t valid:1;                   //!< Angle estimate available
+    uint16_t calibrating:1;             //!< Calibration step in progress
+}aoa_status_t;
+
+//! PDoA to angle calibration table, sorted by pdoa
+typedef struct _aoa_lut_t{
+    uint16_t n;                         //!< Number of points, the ideal arcsine is used below 2
+    float pdoa[MYNEWT_VAL(AOA_LUT_SIZE)];   //!< Offset corrected PDoA in radians
+    float angle[MYNEWT_VAL(AOA_LUT_SIZE)];  //!< Angle in radians
+}aoa_lut_t;
+
+//! Calibration step in progress
+typedef struct _aoa_cal_t{
+    float angle;                        //!< Known angle of the reference tag in radians
+    float sum_cos;                      //!< Unit vector sums of the raw PDoA
+    float sum_sin;
+    uint16_t num;                       //!< Frames collected
+    uint16_t nframes;                   //!< Frames to collect
+    bool offset;                        //!< Step measures the phase offset rather than a table point
+}aoa_cal_t;
+
+//! Angle of arrival instance
+typedef struct _aoa_instance_t{
+    struct _dw1000_dev_instance_t * master; //!< Instance providing the reference phase
+    struct _dw1000_dev_instance_t * slave;  //!< Instance slaving its first path off the master
+#if MYNEWT_VAL(AOA_STATS)
+    STATS_SECT_DECL(aoa_stat_section) stat; //!< Stats instance
+#endif
+    aoa_status_t status;                //!< Status
+    float antenna_separation;           //!< Antenna separation in meters
+    float phase_offset;                 //!< Board phase offset in radians, subtracted from every PDoA
+    aoa_lut_t lut;                      //!< Calibration table
+    aoa_cal_t cal;                      //!< Calibration step
+    float pdoa[MYNEWT_VAL(AOA_AVERAGE_N)];  //!< Offset corrected PDoA history
+    uint16_t idx;                       //!< Next history entry
+    uint16_t nsamples;                  //!< Valid history entries
+    float pdoa_mean;                    //!< Circular mean of the history
+    float resultant;                    //!< Mean resultant length of the history, 1.0 for no spread
+    float angle;                        //!< Angle of arrival in radians
+    float angle_variance;               //!< Variance of angle in radians^2
+}aoa_instance_t;
+
+struct _aoa_instance_t * aoa_init(struct _dw1000_dev_instance_t * master, struct _dw1000_dev_instance_t * slave, struct _aoa_instance_t * aoa);
+void aoa_free(struct _aoa_instance_t * aoa);
+void aoa_reset(struct _aoa_instance_t * aoa);
+float aoa_update(struct _aoa_instance_t * aoa, float pdoa);
+float aoa_pdoa_to_angle(struct _aoa_instance_t * aoa, float pdoa);
+float aoa_wavelength(struct _dw1000_dev_instance_t * inst);
+
+void aoa_cal_start(struct _aoa_instance_t * aoa, bool offset, float angle, uint16_t nframes);
+void aoa_cal_clear(struct _aoa_instance_t * aoa);
+int aoa_lut_insert(struct _aoa_instance_t * aoa, float pdoa, float angle);
+void aoa_lut_get(struct _aoa_instance_t * aoa, aoa_lut_t * lut, float * phase_offset);
+int aoa_config_save(struct _aoa_instance_t * aoa);
+
+struct _aoa_instance_t * aoa_get_instance(void);
+int aoa_cli_register(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AOA_H_ */
@@ -0,0 +1,591 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file aoa.c
+ * @brief Angle of arrival
+ *
+ * @details Runs as a cir_complete_cb on the slave instance, after lib/cir has read both CIRs. The PDoA
+ * of each frame is averaged as unit vectors so that the wrap at +/-pi does not bias the mean, and the
+ * angle variance is the circular phase variance of the mean propagated through the slope of the mapping.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include <stats/stats.h>
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_hal.h>
+#include <dw1000/dw1000_mac.h>
+#include <cir/cir.h>
+#include <aoa/aoa.h>
+
+#if MYNEWT_VAL(AOA_CONFIG)
+#include <stdlib.h>
+#include <config/config.h>
+#endif
+
+#if MYNEWT_VAL(AOA_STATS)
+STATS_NAME_START(aoa_stat_section)
+    STATS_NAME(aoa_stat_section, update)
+    STATS_NAME(aoa_stat_section, mismatch)
+    STATS_NAME(aoa_stat_section, cal_done)
+STATS_NAME_END(aoa_stat_section)
+
+#define AOA_STATS_INC(__X) STATS_INC(aoa->stat, __X)
+#else
+#define AOA_STATS_INC(__X) {}
+#endif
+
+//! Raw timestamps of the same frame on both receivers differ by far less than this (16 accumulator samples)
+#define AOA_MAX_RAW_TS_DIFF (16 * 64)
+
+static aoa_instance_t * g_aoa = NULL;
+
+/**
+ * @fn aoa_wrap(float phase)
+ * @brief Wrap a phase into [-pi, pi).
+ *
+ * @return float
+ */
+static inline float
+aoa_wrap(float phase)
+{
+    return phase - 2.0f * M_PI * floorf((phase + M_PI) / (2.0f * M_PI));
+}
+
+/**
+ * @fn aoa_init(struct _dw1000_dev_instance_t * master, struct _dw1000_dev_instance_t * slave, struct _aoa_instance_t * aoa)
+ * @brief Allocate resources for the aoa instance.
+ *
+ * @param master  Instance providing the reference phase.
+ * @param slave   Instance acting as pdoa slave.
+ * @param aoa     Pointer to aoa_instance_t, NULL to allocate.
+ *
+ * @return aoa_instance_t *
+ */
+aoa_instance_t *
+aoa_init(struct _dw1000_dev_instance_t * master, struct _dw1000_dev_instance_t * slave, struct _aoa_instance_t * aoa)
+{
+    if (aoa == NULL) {
+        aoa = (aoa_instance_t *) malloc(sizeof(aoa_instance_t));
+        assert(aoa);
+        memset(aoa, 0, sizeof(aoa_instance_t));
+        aoa->status.selfmalloc = 1;
+    }
+    aoa->master = master;
+    aoa->slave = slave;
+    aoa->antenna_separation = MYNEWT_VAL(AOA_ANTENNA_SEPARATION);
+    aoa_reset(aoa);
+
+#if MYNEWT_VAL(AOA_STATS)
+    int rc = stats_init(
+                STATS_HDR(aoa->stat),
+                STATS_SIZE_INIT_PARMS(aoa->stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(aoa_stat_section)
+            );
+    rc |= stats_register("aoa", STATS_HDR(aoa->stat));
+    assert(rc == 0);
+#endif
+    aoa->status.initialized = 1;
+    return aoa;
+}
+
+/**
+ * @fn aoa_free(struct _aoa_instance_t * aoa)
+ * @brief Free resources.
+ *
+ * @param aoa  Pointer to aoa_instance_t.
+ * @return void
+ */
+void
+aoa_free(aoa_instance_t * aoa)
+{
+    assert(aoa);
+    if (aoa->status.selfmalloc)
+        free(aoa);
+    else
+        aoa->status.initialized = 0;
+}
+
+/**
+ * @fn aoa_reset(struct _aoa_instance_t * aoa)
+ * @brief Discard the averaging history, e.g. when the tag moves or after calibration.
+ *
+ * @param aoa  Pointer to aoa_instance_t.
+ * @return void
+ */
+void
+aoa_reset(aoa_instance_t * aoa)
+{
+    aoa->idx = aoa->nsamples = 0;
+    aoa->status.valid = 0;
+}
+
+/**
+ * @fn aoa_wavelength(struct _dw1000_dev_instance_t * inst)
+ * @brief Carrier wavelength of the configured channel.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @return wavelength in meters
+ */
+float
+aoa_wavelength(struct _dw1000_dev_instance_t * inst)
+{
+    float fc;
+    switch (inst->config.channel) {
+        case 1: fc = 3494.4e6f; break;
+        case 2: case 4: fc = 3993.6e6f; break;
+        case 3: fc = 4492.8e6f; break;
+        default: fc = 6489.6e6f; break;    // 5, 7
+    }
+    return 299792458.0f / fc;
+}
+
+/**
+ * @fn aoa_pdoa_to_angle(struct _aoa_instance_t * aoa, float pdoa)
+ * @brief Map an offset corrected PDoA to an angle. With a calibration table the mapping is piecewise
+ * linear and clamped to the table ends, otherwise the ideal arcsine of cir_calc_aoa() is used.
+ *
+ * @param aoa   Pointer to aoa_instance_t.
+ * @param pdoa  Offset corrected PDoA in radians.
+ *
+ * @return angle in radians
+ */
+float
+aoa_pdoa_to_angle(aoa_instance_t * aoa, float pdoa)
+{
+    aoa_lut_t * lut = &aoa->lut;
+
+    if (lut->n < 2) {
+        float wavelength = aoa_wavelength(aoa->master);
+        float pdoa_max = 2.0f * M_PI * aoa->antenna_separation / wavelength;
+        pdoa = (pdoa > pdoa_max) ? pdoa_max : (pdoa < -pdoa_max) ? -pdoa_max : pdoa;
+        return cir_calc_aoa(pdoa, wavelength, aoa->antenna_separation);
+    }
+    if (pdoa <= lut->pdoa[0])
+        return lut->angle[0];
+    for (uint16_t i = 1; i < lut->n; i++) {
+        if (pdoa <= lut->pdoa[i]) {
+            float t = (pdoa - lut->pdoa[i - 1]) / (lut->pdoa[i] - lut->pdoa[i - 1]);
+            return lut->angle[i - 1] + t * (lut->angle[i] - lut->angle[i - 1]);
+        }
+    }
+    return lut->angle[lut->n - 1];
+}
+
+/**
+ * @fn aoa_cal_finish(struct _aoa_instance_t * aoa)
+ * @brief Complete a calibration step. The offset step takes the reference at angle cal.angle
+ * (normally boresight) and stores the difference to the ideal PDoA as the board phase offset,
+ * a table step adds the offset corrected mean PDoA as a point of the calibration table.
+ *
+ * @param aoa  Pointer to aoa_instance_t.
+ * @return void
+ */
+static void
+aoa_cal_finish(aoa_instance_t * aoa)
+{
+    aoa_cal_t * cal = &aoa->cal;
+    float mean = atan2f(cal->sum_sin, cal->sum_cos);
+
+    if (cal->offset) {
+        float ideal = 2.0f * M_PI * aoa->antenna_separation * sinf(cal->angle) / aoa_wavelength(aoa->master);
+        aoa->phase_offset = aoa_wrap(mean - ideal);
+    } else {
+        aoa_lut_insert(aoa, aoa_wrap(mean - aoa->phase_offset), cal->angle);
+    }
+    aoa->status.calibrating = 0;
+    AOA_STATS_INC(cal_done);
+    aoa_reset(aoa);
+}
+
+/**
+ * @fn aoa_update(struct _aoa_instance_t * aoa, float pdoa)
+ * @brief Add the PDoA of one frame and update the averaged angle and its variance.
+ *
+ * @param aoa   Pointer to aoa_instance_t.
+ * @param pdoa  Raw PDoA as returned by cir_get_pdoa().
+ *
+ * @return angle in radians
+ */
+float
+aoa_update(aoa_instance_t * aoa, float pdoa)
+{
+    AOA_STATS_INC(update);
+
+    if (aoa->status.calibrating) {
+        aoa_cal_t * cal = &aoa->cal;
+        cal->sum_cos += cosf(pdoa);
+        cal->sum_sin += sinf(pdoa);
+        if (++cal->num >= cal->nframes)
+            aoa_cal_finish(aoa);
+        return aoa->angle;
+    }
+
+    float p = aoa_wrap(pdoa - aoa->phase_offset);
+    aoa->pdoa[aoa->idx] = p;
+    aoa->idx = (aoa->idx + 1) % MYNEWT_VAL(AOA_AVERAGE_N);
+    if (aoa->nsamples < MYNEWT_VAL(AOA_AVERAGE_N))
+        aoa->nsamples++;
+
+    float c = 0, s = 0;
+    for (uint16_t i = 0; i < aoa->nsamples; i++) {
+        c += cosf(aoa->pdoa[i]);
+        s += sinf(aoa->pdoa[i]);
+    }
+    aoa->pdoa_mean = atan2f(s, c);
+    aoa->resultant = sqrtf(c * c + s * s) / aoa->nsamples;
+    aoa->angle = aoa_pdoa_to_angle(aoa, aoa->pdoa_mean);
+
+    // Circular variance of a single frame, then of the mean, mapped through the local slope
+    float r = (aoa->resultant > 1e-6f) ? aoa->resultant : 1e-6f;
+    float var_pdoa = -2.0f * logf(r) / aoa->nsamples;
+    const float h = 0.01f;
+    float slope = (aoa_pdoa_to_angle(aoa, aoa->pdoa_mean + h) - aoa_pdoa_to_angle(aoa, aoa->pdoa_mean - h)) / (2.0f * h);
+    aoa->angle_variance = slope * slope * var_pdoa;
+    aoa->status.valid = 1;
+
+    return aoa->angle;
+}
+
+/**
+ * @fn aoa_cal_start(struct _aoa_instance_t * aoa, bool offset, float angle, uint16_t nframes)
+ * @brief Start a calibration step with a reference tag at a known angle.
+ *
+ * @param aoa      Pointer to aoa_instance_t.
+ * @param offset   true to measure the board phase offset, false to add a table point.
+ * @param angle    Known angle of the reference tag in radians.
+ * @param nframes  Frames to average.
+ *
+ * @return void
+ */
+void
+aoa_cal_start(aoa_instance_t * aoa, bool offset, float angle, uint16_t nframes)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    memset(&aoa->cal, 0, sizeof(aoa->cal));
+    aoa->cal.offset = offset;
+    aoa->cal.angle = angle;
+    aoa->cal.nframes = (nframes) ? nframes : 1;
+    aoa->status.calibrating = 1;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn aoa_cal_clear(struct _aoa_instance_t * aoa)
+ * @brief Remove the phase offset and the calibration table.
+ *
+ * @param aoa  Pointer to aoa_instance_t.
+ * @return void
+ */
+void
+aoa_cal_clear(aoa_instance_t * aoa)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    aoa->phase_offset = 0;
+    aoa->lut.n = 0;
+    aoa_reset(aoa);
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn lut_insert(aoa_lut_t * lut, float pdoa, float angle)
+ * @brief Add a point to a table, see aoa_lut_insert().
+ *
+ * @return OS_OK, OS_ENOMEM when the table is full
+ */
+static int
+lut_insert(aoa_lut_t * lut, float pdoa, float angle)
+{
+    uint16_t i;
+
+    for (i = 0; i < lut->n; i++) {
+        if (fabsf(lut->angle[i] - angle) < 0.1f * M_PI / 180.0f) {
+            memmove(&lut->pdoa[i], &lut->pdoa[i + 1], (lut->n - i - 1) * sizeof(float));
+            memmove(&lut->angle[i], &lut->angle[i + 1], (lut->n - i - 1) * sizeof(float));
+            lut->n--;
+            break;
+        }
+    }
+    if (lut->n >= MYNEWT_VAL(AOA_LUT_SIZE))
+        return OS_ENOMEM;
+
+    for (i = lut->n; i > 0 && lut->pdoa[i - 1] > pdoa; i--) {
+        lut->pdoa[i] = lut->pdoa[i - 1];
+        lut->angle[i] = lut->angle[i - 1];
+    }
+    lut->pdoa[i] = pdoa;
+    lut->angle[i] = angle;
+    lut->n++;
+    return OS_OK;
+}
+
+/**
+ * @fn aoa_lut_insert(struct _aoa_instance_t * aoa, float pdoa, float angle)
+ * @brief Add a calibration point keeping the table sorted by PDoA. A point at the same angle is replaced.
+ * The table is updated in a critical section as aoa_update() reads it from the receive path.
+ *
+ * @param aoa    Pointer to aoa_instance_t.
+ * @param pdoa   Offset corrected PDoA in radians.
+ * @param angle  Angle in radians.
+ *
+ * @return OS_OK, OS_ENOMEM when the table is full
+ */
+int
+aoa_lut_insert(aoa_instance_t * aoa, float pdoa, float angle)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    int rc = lut_insert(&aoa->lut, pdoa, angle);
+    OS_EXIT_CRITICAL(sr);
+    return rc;
+}
+
+/**
+ * @fn aoa_lut_get(struct _aoa_instance_t * aoa, aoa_lut_t * lut, float * phase_offset)
+ * @brief Consistent copy of the calibration, for readers outside the receive path.
+ *
+ * @param aoa           Pointer to aoa_instance_t.
+ * @param lut           Receives the calibration table.
+ * @param phase_offset  Receives the phase offset, may be NULL.
+ *
+ * @return void
+ */
+void
+aoa_lut_get(aoa_instance_t * aoa, aoa_lut_t * lut, float * phase_offset)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    *lut = aoa->lut;
+    if (phase_offset)
+        *phase_offset = aoa->phase_offset;
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn aoa_get_instance(void)
+ * @brief Instance created by aoa_pkg_init, NULL on single receiver boards.
+ *
+ * @return aoa_instance_t *
+ */
+aoa_instance_t *
+aoa_get_instance(void)
+{
+    return g_aoa;
+}
+
+#if MYNEWT_VAL(AOA_CONFIG)
+/*
+ * Flash layout, angles and phases in milliradians:
+ *   aoa/offset  phase offset
+ *   aoa/lut     "pdoa,angle;pdoa,angle;..."
+ */
+static char g_offset_str[12];
+static char g_lut_str[MYNEWT_VAL(AOA_LUT_SIZE) * 14 + 1];
+
+static char *aoa_conf_get(int argc, char **argv, char *val, int val_len_max);
+static int aoa_conf_set(int argc, char **argv, char *val);
+static int aoa_conf_commit(void);
+static int aoa_conf_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt);
+
+static struct conf_handler aoa_handler = {
+    .ch_name = "aoa",
+    .ch_get = aoa_conf_get,
+    .ch_set = aoa_conf_set,
+    .ch_commit = aoa_conf_commit,
+    .ch_export = aoa_conf_export,
+};
+
+/**
+ * @fn aoa_conf_encode(struct _aoa_instance_t * aoa)
+ * @brief Render the calibration into the config strings. Points that do not fit are left out whole.
+ *
+ * @return void
+ */
+static void
+aoa_conf_encode(aoa_instance_t * aoa)
+{
+    aoa_lut_t lut;
+    float phase_offset;
+    size_t len = 0;
+
+    aoa_lut_get(aoa, &lut, &phase_offset);
+    snprintf(g_offset_str, sizeof(g_offset_str), "%ld", (long) lroundf(phase_offset * 1000.0f));
+    g_lut_str[0] = '\0';
+    for (uint16_t i = 0; i < lut.n; i++) {
+        int n = snprintf(g_lut_str + len, sizeof(g_lut_str) - len, "%s%ld,%ld", (i) ? ";" : "",
+                    (long) lroundf(lut.pdoa[i] * 1000.0f), (long) lroundf(lut.angle[i] * 1000.0f));
+        if (n < 0 || (size_t) n >= sizeof(g_lut_str) - len) {
+            g_lut_str[len] = '\0';
+            break;
+        }
+        len += n;
+    }
+}
+
+static char *
+aoa_conf_get(int argc, char **argv, char *val, int val_len_max)
+{
+    if (argc != 1 || g_aoa == NULL)
+        return NULL;
+    aoa_conf_encode(g_aoa);
+    if (!strcmp(argv[0], "offset"))
+        return g_offset_str;
+    if (!strcmp(argv[0], "lut"))
+        return g_lut_str;
+    return NULL;
+}
+
+static int
+aoa_conf_set(int argc, char **argv, char *val)
+{
+    if (argc != 1)
+        return OS_ENOENT;
+    if (!strcmp(argv[0], "offset"))
+        return CONF_VALUE_SET(val, CONF_STRING, g_offset_str);
+    if (!strcmp(argv[0], "lut"))
+        return CONF_VALUE_SET(val, CONF_STRING, g_lut_str);
+    return OS_ENOENT;
+}
+
+static int
+aoa_conf_commit(void)
+{
+    aoa_instance_t * aoa = g_aoa;
+    if (aoa == NULL)
+        return 0;
+
+    aoa_lut_t lut = {.n = 0};
+    char * p = g_lut_str;
+    while (*p) {
+        char * end;
+        long pdoa = strtol(p, &end, 0);
+        if (*end != ',')
+            break;
+        long angle = strtol(end + 1, &end, 0);
+        lut_insert(&lut, pdoa / 1000.0f, angle / 1000.0f);
+        p = (*end == ';') ? end + 1 : end;
+    }
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    aoa->phase_offset = strtol(g_offset_str, NULL, 0) / 1000.0f;
+    aoa->lut = lut;
+    aoa_reset(aoa);
+    OS_EXIT_CRITICAL(sr);
+    return 0;
+}
+
+static int
+aoa_conf_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt)
+{
+    if (g_aoa == NULL)
+        return 0;
+    aoa_conf_encode(g_aoa);
+    export_func("aoa/offset", g_offset_str);
+    export_func("aoa/lut", g_lut_str);
+    return 0;
+}
+#endif // MYNEWT_VAL(AOA_CONFIG)
+
+/**
+ * @fn aoa_config_save(struct _aoa_instance_t * aoa)
+ * @brief Persist the phase offset and calibration table.
+ *
+ * @param aoa  Pointer to aoa_instance_t.
+ * @return OS_OK, OS_ENOENT without AOA_CONFIG
+ */
+int
+aoa_config_save(aoa_instance_t * aoa)
+{
+#if MYNEWT_VAL(AOA_CONFIG)
+    aoa_conf_encode(aoa);
+    int rc = conf_save_one("aoa/offset", g_offset_str);
+    rc |= conf_save_one("aoa/lut", g_lut_str);
+    return rc;
+#else
+    return OS_ENOENT;
+#endif
+}
+
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+/**
+ * @fn cir_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Called on the slave instance after lib/cir has read its CIR. The master CIR is read first
+ * by its own instance, the raw timestamps confirm that both belong to the same frame.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return false, other cir_complete_cb handlers still run
+ */
+static bool
+cir_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+{
+    aoa_instance_t * aoa = (aoa_instance_t *) cbs->inst_ptr;
+    cir_instance_t * master = aoa->master->cir;
+    cir_instance_t * slave = aoa->slave->cir;
+
+    if (master == NULL || slave == NULL || !master->status.valid || !slave->status.valid)
+        return false;
+
+    int64_t diff = ((int64_t)(slave->raw_ts - master->raw_ts) << 24) >> 24;    // 40bit wrap
+    if (diff > AOA_MAX_RAW_TS_DIFF || diff < -AOA_MAX_RAW_TS_DIFF) {
+        AOA_STATS_INC(mismatch);
+        return false;
+    }
+    aoa_update(aoa, cir_get_pdoa(master, slave));
+    return false;
+}
+
+static dw1000_mac_interface_t g_cbs = {
+    .id = DW1000_AOA,
+    .cir_complete_cb = cir_complete_cb
+};
+#endif
+
+/**
+ * @fn aoa_pkg_init(void)
+ * @brief API to initialise the aoa package, needs a second DW1000 instance acting as pdoa slave.
+ *
+ * @return void
+ */
+void
+aoa_pkg_init(void)
+{
+#if MYNEWT_VAL(AOA_ENABLED) && MYNEWT_VAL(DW1000_DEVICE_1)
+    printf("{\"utime\": %lu,\"msg\": \"aoa_pkg_init\"}\n", os_cputime_ticks_to_usecs(os_cputime_get32()));
+
+    g_cbs.inst_ptr = g_aoa = aoa_init(hal_dw1000_inst(0), hal_dw1000_inst(1), NULL);
+    dw1000_mac_append_interface(hal_dw1000_inst(1), &g_cbs);
+#endif
+#if MYNEWT_VAL(AOA_CONFIG)
+    int rc = conf_register(&aoa_handler);
+    assert(rc == 0);
+#endif
+#if MYNEWT_VAL(AOA_CLI)
+    aoa_cli_register();
+#endif
+}
@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/mynewt.h>
+#include <syscfg/syscfg.h>
+
+#if MYNEWT_VAL(AOA_CLI)
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <shell/shell.h>
+#include <console/console.h>
+
+#include "aoa/aoa.h"
+
+static int aoa_cli_cmd(int argc, char **argv);
+
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+const struct shell_param cmd_aoa_param[] = {
+    {"show", "angle, variance and calibration"},
+    {"cal offset [n]", "reference tag at boresight, measure the phase offset"},
+    {"cal point <deg> [n]", "reference tag at <deg>, add a table point"},
+    {"cal clear", "remove offset and table"},
+    {"cal save", "store calibration in flash"},
+    {NULL,NULL},
+};
+
+const struct shell_cmd_help cmd_aoa_help = {
+	"aoa", "<cmd>", cmd_aoa_param
+};
+#endif
+
+static struct shell_cmd shell_aoa_cmd = {
+    .sc_cmd = "aoa",
+    .sc_cmd_func = aoa_cli_cmd,
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+    .help = &cmd_aoa_help
+#endif
+};
+
+/* console_printf has no float support */
+static void
+print_fixed(float v)
+{
+    console_printf("%s%d.%03d", (v < 0) ? "-" : "", (int)fabsf(v), (int)((fabsf(v) - (int)fabsf(v)) * 1000));
+}
+
+static void
+show(aoa_instance_t * aoa)
+{
+    aoa_lut_t lut;
+    float phase_offset;
+
+    aoa_lut_get(aoa, &lut, &phase_offset);
+    console_printf("angle(deg): ");
+    print_fixed(aoa->angle * 180.0f / M_PI);
+    console_printf(", std(deg): ");
+    print_fixed(sqrtf(aoa->angle_variance) * 180.0f / M_PI);
+    console_printf(", pdoa(rad): ");
+    print_fixed(aoa->pdoa_mean);
+    console_printf(", n: %d%s\n", aoa->nsamples, (aoa->status.valid) ? "" : " (no data)");
+
+    console_printf("offset(rad): ");
+    print_fixed(phase_offset);
+    console_printf("%s\n", (aoa->status.calibrating) ? ", calibrating" : "");
+    console_printf("#idx, pdoa(rad), angle(deg)\n");
+    for (uint16_t i = 0; i < lut.n; i++) {
+        console_printf("%4d, ", i);
+        print_fixed(lut.pdoa[i]);
+        console_printf(", ");
+        print_fixed(lut.angle[i] * 180.0f / M_PI);
+        console_printf("\n");
+    }
+}
+
+static int
+aoa_cli_cmd(int argc, char **argv)
+{
+    aoa_instance_t * aoa = aoa_get_instance();
+
+    if (argc < 2) {
+        return 0;
+    }
+    if (aoa == NULL) {
+        console_printf("No aoa instance (needs DW1000_DEVICE_1)\n");
+        return 0;
+    }
+    if (!strcmp(argv[1], "show")) {
+        show(aoa);
+    } else if (!strcmp(argv[1], "cal") && argc > 2) {
+        if (!strcmp(argv[2], "offset")) {
+            uint16_t n = (argc > 3) ? strtol(argv[3], NULL, 0) : MYNEWT_VAL(AOA_CAL_NFRAMES);
+            aoa_cal_start(aoa, true, 0, n);
+            console_printf("Collecting %d frames\n", n);
+        } else if (!strcmp(argv[2], "point") && argc > 3) {
+            float deg = strtof(argv[3], NULL);
+            uint16_t n = (argc > 4) ? strtol(argv[4], NULL, 0) : MYNEWT_VAL(AOA_CAL_NFRAMES);
+            aoa_cal_start(aoa, false, deg * M_PI / 180.0f, n);
+            console_printf("Collecting %d frames\n", n);
+        } else if (!strcmp(argv[2], "clear")) {
+            aoa_cal_clear(aoa);
+        } else if (!strcmp(argv[2], "save")) {
+            console_printf("%s\n", (aoa_config_save(aoa) == 0) ? "Saved" : "Save failed");
+        } else {
+            console_printf("Unknown cmd\n");
+        }
+    } else {
+        console_printf("Unknown cmd\n");
+    }
+    return 0;
+}
+
+int
+aoa_cli_register(void)
+{
+    return shell_cmd_register(&shell_aoa_cmd);
+}
+#endif /* MYNEWT_VAL(AOA_CLI) */
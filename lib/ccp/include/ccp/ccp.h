@@ -58,12 +58,17 @@ STATS_SECT_START(ccp_stat_section)
     STATS_SECT_ENTRY(tx_complete)
     STATS_SECT_ENTRY(rx_complete)
     STATS_SECT_ENTRY(rx_relayed)
+    STATS_SECT_ENTRY(rx_path_ignored)
     STATS_SECT_ENTRY(rx_unsolicited)
     STATS_SECT_ENTRY(txrx_error)
     STATS_SECT_ENTRY(tx_start_error)
     STATS_SECT_ENTRY(tx_relay_error)
     STATS_SECT_ENTRY(tx_relay_ok)
     STATS_SECT_ENTRY(rx_timeout)
+    STATS_SECT_ENTRY(holdover)
+    STATS_SECT_ENTRY(takeover)
+    STATS_SECT_ENTRY(stepdown)
+    STATS_SECT_ENTRY(rejoin)
     STATS_SECT_ENTRY(reset)
 STATS_SECT_END
 #endif
@@ -100,6 +105,8 @@ typedef union {
         ccp_timestamp_t transmission_timestamp; //!< Transmission timestamp
         uint8_t rpt_count;                      //!< Repeat level
         uint8_t rpt_max;                        //!< Repeat max level
+        uint8_t rank;                           //!< 0 from the primary master, backup rank when a backup has taken over
+        uint16_t uncertainty;                   //!< Timing uncertainty accumulated along the relay path in dtu (40bit device time units, ~15.65ps)
     }__attribute__((__packed__, aligned(1)));
     uint8_t array[sizeof(struct _ccp_blink_frame_t)];
 }ccp_blink_frame_t;
@@ -125,6 +132,8 @@ typedef struct _dw1000_ccp_status_t{
     uint16_t start_rx_error:1;        //!< Set for start request error
     uint16_t rx_timeout_error:1;      //!< Receive timeout error 
     uint16_t timer_enabled:1;         //!< Indicates timer is enabled 
+    uint16_t acting_master:1;         //!< Backup master transmitting in place of the primary
+    uint16_t rejoin:1;                //!< Started master listening for a backup acting in its place
 }dw1000_ccp_status_t;
 
 //! Extension ids for services.
@@ -143,6 +152,8 @@ typedef struct _dw1000_ccp_config_t{
     uint16_t fs_xtalt_autotune:1;     //!< Autotune XTALT to Clock Master
     uint16_t role:4;                  //!< dw1000_ccp_role_t
     uint16_t tx_holdoff_dly;          //!< Relay nodes holdoff
+    uint8_t backup_rank;              //!< Slave takes over as master after this many missed beacons, 0 for none
+    uint8_t relay_slot;               //!< Relay transmit slot within its level
 }dw1000_ccp_config_t;
 
 //! ccp instance parameters.
@@ -164,14 +175,19 @@ typedef struct _dw1000_ccp_instance_t{
     struct os_event postprocess_event;              //!< Structure of callout_postprocess
     dw1000_ccp_status_t status;                     //!< DW1000 ccp status parameters
     dw1000_ccp_config_t config;                     //!< DW1000 ccp config parameters
-    ccp_timestamp_t master_epoch;                   //!< ccp event referenced to master systime
-    uint64_t local_epoch;                           //!< ccp event referenced to local systime
-    uint32_t os_epoch;                              //!< ccp event referenced to ostime
+    ccp_timestamp_t master_epoch;                   //!< Last received ccp event referenced to master systime
+    uint64_t local_epoch;                           //!< ccp event referenced to local systime, predicted in holdover
+    uint32_t os_epoch;                              //!< ccp event referenced to ostime, predicted in holdover
     dw1000_ccp_tof_compensation_cb_t tof_comp_cb;   //!< tof compensation callback
     uint32_t period;                                //!< Pulse repetition period
     uint16_t nframes;                               //!< Number of buffers defined to store the data 
     uint16_t idx;                                   //!< Circular buffer index pointer  
-    uint8_t seq_num;                                //!< Clock Master reported sequence number
+    uint8_t seq_num;                                //!< Clock Master reported sequence number, predicted in holdover
+    uint16_t missed;                                //!< Consecutive beacons bridged by holdover
+    uint64_t uncertainty;                           //!< Bound on the error of the predicted local_epoch in dtu (40bit device time units), 0 when locked
+    uint16_t parent;                                //!< Short address of the node the last beacon was taken from
+    uint16_t path_uncertainty;                      //!< Uncertainty the parent reported for its path
+    uint8_t rank;                                   //!< Backup rank of the last beacon taken, 0 from the primary
     struct hal_timer timer;                         //!< Timer structure
     struct os_eventq eventq;                        //!< Event queues
     struct os_event timer_event;                    //!< Event callback
@@ -189,6 +205,9 @@ void dw1000_ccp_set_postprocess(dw1000_ccp_instance_t * inst, os_event_fn * ccp_
 void dw1000_ccp_set_tof_comp_cb(dw1000_ccp_instance_t * inst, dw1000_ccp_tof_compensation_cb_t tof_comp_cb);
 void dw1000_ccp_start(dw1000_ccp_instance_t *ccp, dw1000_ccp_role_t role);
 void dw1000_ccp_stop(dw1000_ccp_instance_t *ccp);
+bool dw1000_ccp_holdover(dw1000_ccp_instance_t *ccp);
+void dw1000_ccp_set_backup(dw1000_ccp_instance_t *ccp, uint8_t rank);
+void dw1000_ccp_set_relay_slot(dw1000_ccp_instance_t *ccp, uint8_t slot);
 
 #ifdef __cplusplus
 }
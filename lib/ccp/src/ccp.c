@@ -47,6 +47,10 @@
 #include <wcs/wcs.h>
 #endif
 
+#if MYNEWT_VAL(DIAGLOG_DIAGMSG)
+#include <diaglog/diaglog.h>
+#define DIAGMSG(s,u) diaglog_msg(s,u)
+#endif
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
 #define DIAGMSG(s,u)
@@ -98,12 +102,17 @@ STATS_NAME_START(ccp_stat_section)
     STATS_NAME(ccp_stat_section, tx_complete)
     STATS_NAME(ccp_stat_section, rx_complete)
     STATS_NAME(ccp_stat_section, rx_relayed)
+    STATS_NAME(ccp_stat_section, rx_path_ignored)
     STATS_NAME(ccp_stat_section, rx_unsolicited)
     STATS_NAME(ccp_stat_section, txrx_error)
     STATS_NAME(ccp_stat_section, tx_start_error)
     STATS_NAME(ccp_stat_section, tx_relay_error)
     STATS_NAME(ccp_stat_section, tx_relay_ok)
     STATS_NAME(ccp_stat_section, rx_timeout)
+    STATS_NAME(ccp_stat_section, holdover)
+    STATS_NAME(ccp_stat_section, takeover)
+    STATS_NAME(ccp_stat_section, stepdown)
+    STATS_NAME(ccp_stat_section, rejoin)
     STATS_NAME(ccp_stat_section, reset)
 STATS_NAME_END(ccp_stat_section)
 
@@ -112,6 +121,10 @@ STATS_NAME_END(ccp_stat_section)
 #define CCP_STATS_INC(__X) {}
 #endif
 
+#if MYNEWT_VAL(CCP_BACKUP_RANK) > MYNEWT_VAL(CCP_HOLDOVER_MAX)
+#error "CCP_BACKUP_RANK must not exceed CCP_HOLDOVER_MAX"
+#endif
+
 static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool ccp_tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool ccp_rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
@@ -125,6 +138,12 @@ static void ccp_tasks_init(struct _dw1000_ccp_instance_t * inst);
 static void ccp_timer_irq(void * arg);
 static void ccp_master_timer_ev_cb(struct os_event *ev);
 static void ccp_slave_timer_ev_cb(struct os_event *ev);
+static void ccp_epoch_advance(dw1000_ccp_instance_t *ccp);
+static bool ccp_beacon_missed(dw1000_ccp_instance_t *ccp);
+static void ccp_master_rejoin(dw1000_ccp_instance_t *ccp);
+#if MYNEWT_VAL(WCS_ENABLED)
+static dw1000_ccp_status_t ccp_backup_tx(dw1000_ccp_instance_t *ccp);
+#endif
 
 #if !MYNEWT_VAL(WCS_ENABLED)
 static void ccp_postprocess(struct os_event * ev);
@@ -188,6 +207,9 @@ ccp_master_timer_ev_cb(struct os_event *ev) {
 
     dw1000_ccp_instance_t * ccp = (dw1000_ccp_instance_t *)ev->ev_arg;
     
+    if (ccp->status.rejoin)
+        ccp_master_rejoin(ccp);
+
     CCP_STATS_INC(master_cnt);
 
     if (dw1000_ccp_send(ccp, DWT_BLOCKING).start_tx_error){
@@ -242,9 +264,26 @@ ccp_slave_timer_ev_cb(struct os_event *ev) {
     uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))
                         + MYNEWT_VAL(XTALT_GUARD);
 
+    /* In holdover open the window early and wide enough to cover the prediction error */
+    if (ccp->uncertainty) {
+        uint64_t widen = ccp->uncertainty + ((uint64_t)ccp->period << 16) * MYNEWT_VAL(CCP_HOLDOVER_SKEW_PPB) / 1000000000UL;
+        dx_time -= widen;
+        uint32_t widen_us = (widen + 0xffff) >> 16;     // dwt usec, rounded up
+        timeout = (timeout + 2 * widen_us > 0xffff) ? 0xffff : timeout + 2 * widen_us;
+    }
+
+    /* Backups transmit rank tx_holdoff_dly after the epoch, see ccp_backup_tx(). Keep listening for the rank
+     * being tracked and, in holdover, for the ranks due to take over. An acting backup listens up to its own slot */
+    uint32_t slots = (ccp->rank > ccp->missed) ? ccp->rank : ccp->missed;
+    if (ccp->status.acting_master)
+        slots = ccp->config.backup_rank - 1;
+    timeout = (timeout + slots * ccp->config.tx_holdoff_dly > 0xffff) ? 0xffff : timeout + slots * ccp->config.tx_holdoff_dly;
+
 #if MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) != 0
     /* Adjust timeout if we're using cascading ccp in anchors */
-    timeout += (ccp->config.tx_holdoff_dly + dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t))) * MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
+    uint32_t cascade = (uint32_t)(ccp->config.tx_holdoff_dly + dw1000_phy_frame_duration(&inst->attrib, sizeof(ccp_blink_frame_t)))
+                * MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) * MYNEWT_VAL(CCP_RELAY_NSLOTS);
+    timeout = (timeout + cascade > 0xffff) ? 0xffff : timeout + cascade;
 #endif
     dw1000_set_rx_timeout(inst, timeout);
     dw1000_set_delay_start(inst, dx_time);
@@ -371,6 +410,8 @@ dw1000_ccp_init(struct _dw1000_dev_instance_t * inst, uint16_t nframes){
     ccp->period = MYNEWT_VAL(CCP_PERIOD);
     ccp->config = (dw1000_ccp_config_t){
         .postprocess = false,
+        .backup_rank = MYNEWT_VAL(CCP_BACKUP_RANK),
+        .relay_slot = MYNEWT_VAL(CCP_RELAY_SLOT),
 #if MYNEWT_VAL(FS_XTALT_AUTOTUNE_ENABLED)
         .fs_xtalt_autotune = true,
 #endif
@@ -555,6 +596,9 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 
     if (inst->fctrl_array[0] != FCNTL_IEEE_BLINK_CCP_64){
         if(os_sem_get_count(&ccp->sem) == 0){
+            /* An acting backup has its slot to keep, anyone else keeps listening */
+            if (ccp->status.acting_master && ccp_beacon_missed(ccp))
+                return true;
             dw1000_set_rx_timeout(inst, (uint16_t) 0xffff);
             return true;
         }
@@ -568,6 +612,20 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     }
 
     if (ccp->config.role == CCP_ROLE_MASTER) {
+        /* A started master listening for a backup acting in its place, recognised by its own euid.
+         * The first beacon takes over the backup's epoch, see ccp_master_rejoin() */
+        ccp_blink_frame_t * rx = (ccp_blink_frame_t *) inst->rxbuf;
+        if (ccp->status.rejoin && inst->frame_len >= sizeof(ccp_blink_frame_t) &&
+            rx->euid == inst->euid && rx->rank != 0 && rx->rpt_count == 0) {
+            ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+            frame->transmission_timestamp.lo = (inst->rxtimestamp
+                - (((uint64_t)rx->rank * ccp->config.tx_holdoff_dly) << 16)) & 0x0FFFFFFFFFFUL;
+            frame->transmission_timestamp.hi = 0;
+            ccp->status.rejoin = 0;
+            dw1000_stop_rx(inst);
+            os_error_t err = os_sem_release(&ccp->sem);
+            assert(err == OS_OK);
+        }
         return true;
     }
     DIAGMSG("{\"utime\": %lu,\"msg\": \"ccp:rx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
@@ -582,6 +640,25 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     if (inst->status.lde_error)
         return false;
 
+    /* An acting backup steps down for the primary or a lower rank, and ignores the others */
+    if (ccp->status.acting_master) {
+        if (frame->rank >= ccp->config.backup_rank)
+            return true;
+        ccp->status.acting_master = 0;
+        CCP_STATS_INC(stepdown);
+    }
+
+    /* Path selection, beacons from a relay other than the preferred one are only taken if their path is
+     * less uncertain. The receiver stays on for the preferred relay, which transmits later in the window */
+    if (frame->rpt_count != 0 && ccp->status.valid && ccp->missed == 0 &&
+        frame->short_address != ccp->parent && frame->uncertainty >= ccp->path_uncertainty) {
+        CCP_STATS_INC(rx_path_ignored);
+        return true;
+    }
+    ccp->parent = frame->short_address;
+    ccp->path_uncertainty = frame->uncertainty;
+    ccp->rank = frame->rank;
+
     /* A good ccp packet has been received, stop the receiver */
     dw1000_stop_rx(inst); //Prevent timeout event
     
@@ -590,6 +667,8 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     ccp->os_epoch = os_cputime_get32();
     CCP_STATS_INC(rx_complete);
     ccp->status.rx_timeout_error = 0;
+    ccp->missed = 0;
+    ccp->uncertainty = 0;
 
     if (frame->transmission_timestamp.timestamp < ccp->master_epoch.timestamp ||
         frame->euid != ccp->master_euid) {
@@ -623,10 +702,15 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
         frame->reception_timestamp = ccp->local_epoch;
     }
 
-    /* Compensate if not receiving the master ccp packet directly */
-    if (frame->rpt_count != 0) {
-        CCP_STATS_INC(rx_relayed);
-        /* Assume ccp intervals are a multiple of 0x10000 dwt usec -> 0x100000000 dwunits */
+    /* Compensate if not receiving the master ccp packet directly. Relays and backups transmit after the epoch,
+     * a backup in the master timebase from its own crystal */
+    if (frame->rpt_count != 0 || frame->rank != 0) {
+        if (frame->rpt_count != 0)
+            CCP_STATS_INC(rx_relayed);
+        /* Assume ccp intervals are a multiple of 0x10000 dwt usec -> 0x100000000 dwunits. Rounding up
+         * recovers the interval only while the delay of the furthest relay or backup stays below that */
+        assert(((uint32_t)(MYNEWT_VAL(CCP_MAX_CASCADE_RPTS) + 1) * MYNEWT_VAL(CCP_RELAY_NSLOTS) + MYNEWT_VAL(CCP_HOLDOVER_MAX))
+                * ccp->config.tx_holdoff_dly < 0x10000);
         uint64_t master_interval = ((frame->transmission_interval/0x100000000UL+1)*0x100000000UL);
         ccp->period = master_interval>>16;
         uint64_t repeat_dly = master_interval - frame->transmission_interval;
@@ -653,8 +737,10 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
         /* Only replace the short id, retain the euid to know which master this originates from */
         tx_frame.short_address = inst->my_short_address;
         tx_frame.rpt_count++;
+        /* Relays of one level transmit in distinct slots after the master epoch, behind the slot of a backup */
         uint64_t tx_timestamp = frame->reception_timestamp;
-        tx_timestamp += tx_frame.rpt_count*((uint64_t)ccp->config.tx_holdoff_dly<<16);
+        tx_timestamp += (uint64_t)(tx_frame.rpt_count * MYNEWT_VAL(CCP_RELAY_NSLOTS) + ccp->config.relay_slot + frame->rank)
+                        * ((uint64_t)ccp->config.tx_holdoff_dly<<16);
         tx_timestamp &= 0x0FFFFFFFE00UL;
         dw1000_set_delay_start(inst, tx_timestamp);
 
@@ -666,11 +752,18 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 #if MYNEWT_VAL(WCS_ENABLED)
         tx_delay *= (1.0l - ccp->wcs->skew);
 #endif
-        tx_frame.transmission_timestamp.timestamp += tx_delay;
+        /* tx_delay counts from the master epoch, so both are taken relative to it rather than to the
+         * frame received, which may come from a relay already */
+        tx_frame.transmission_timestamp.timestamp = ccp->master_epoch.timestamp + tx_delay;
 
         /* Adjust the transmission interval so listening units can calculate the
          * original master's timestamp */
-        tx_frame.transmission_interval = frame->transmission_interval - tx_delay;
+        tx_frame.transmission_interval = ((uint64_t)ccp->period << 16) - tx_delay;
+
+        /* Accumulate path uncertainty, per hop plus the skew error over the relay delay */
+        uint32_t uncertainty = frame->uncertainty + MYNEWT_VAL(CCP_RELAY_HOP_UNCERTAINTY)
+                        + tx_delay * MYNEWT_VAL(CCP_HOLDOVER_SKEW_PPB) / 1000000000UL;
+        tx_frame.uncertainty = (uncertainty > UINT16_MAX) ? UINT16_MAX : uncertainty;
 
         dw1000_write_tx(inst, tx_frame.array, 0, sizeof(ccp_blink_frame_t));
         dw1000_write_tx_fctrl(inst, sizeof(ccp_blink_frame_t), 0);
@@ -729,8 +822,16 @@ ccp_tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t
         return false;
 
     CCP_STATS_INC(tx_complete);
-    if (ccp->config.role != CCP_ROLE_MASTER)
+    if (ccp->config.role != CCP_ROLE_MASTER){
+        if (ccp->status.acting_master && os_sem_get_count(&ccp->sem) == 0){
+            /* Keeps wcs running on the predicted epochs, see ccp_backup_tx() */
+            if (ccp->config.postprocess && ccp->status.valid)
+                os_eventq_put(os_eventq_dflt_get(), &ccp->postprocess_event);
+            os_error_t err = os_sem_release(&ccp->sem);
+            assert(err == OS_OK);
+        }
         return false;
+    }
 
     ccp_frame_t * frame = ccp->frames[(++ccp->idx)%ccp->nframes];
 
@@ -775,6 +876,8 @@ ccp_error_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
         return false;  
 
     CCP_STATS_INC(txrx_error);
+    if (inst->status.rx_error && ccp_beacon_missed(ccp))
+        return true;
     if(os_sem_get_count(&ccp->sem) == 0){
         os_error_t err = os_sem_release(&ccp->sem); 
         assert(err == OS_OK); 
@@ -782,6 +885,70 @@ ccp_error_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
     return true;
 }
 
+/**
+ * @fn ccp_epoch_advance(dw1000_ccp_instance_t *ccp)
+ * @brief Predict the next epoch from the current one, one period of the master clock converted to the
+ * local clock with the current wcs estimate. The first order step in the skew is corrected once through
+ * wcs_local_to_master64(), which takes in the drift since the last beacon received.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ *
+ * @return void
+ */
+static void
+ccp_epoch_advance(dw1000_ccp_instance_t *ccp)
+{
+    uint64_t interval = (uint64_t)ccp->period << 16;
+#if MYNEWT_VAL(WCS_ENABLED)
+    wcs_instance_t * wcs = ccp->wcs;
+    if (wcs->status.valid) {
+        uint64_t master = wcs_local_to_master64(wcs, ccp->local_epoch) + interval;
+        /* Master to local interval, first order in the skew */
+        interval -= ((int64_t)interval * wcs->skew_q32) >> 32;
+        uint64_t local = (ccp->local_epoch + interval) & 0x0FFFFFFFFFFUL;
+        /* Residual of the full mapping at the first order guess, sign extended from 40bit */
+        int64_t residual = (int64_t)(((wcs_local_to_master64(wcs, local) - master) & 0x0FFFFFFFFFFUL) << 24) >> 24;
+        interval -= residual;
+    }
+#endif
+    ccp->local_epoch = (ccp->local_epoch + interval) & 0x0FFFFFFFFFFUL;
+    ccp->os_epoch += os_cputime_usecs_to_ticks((uint32_t)dw1000_dwt_usecs_to_usecs(ccp->period));
+    ccp->seq_num++;
+}
+
+/**
+ * @fn dw1000_ccp_holdover(dw1000_ccp_instance_t *ccp)
+ * @brief Bridge a missed beacon on a slave. The epoch of the missed beacon is predicted from the last one and
+ * the current skew and drift estimates: local_epoch, os_epoch and seq_num advance by one period as if the beacon
+ * had been received, so that tdma keeps scheduling slots and the next listen window opens at the predicted time.
+ * The uncertainty bound grows by CCP_HOLDOVER_SKEW_PPB of the period for every missed beacon. master_epoch
+ * and wcs keep the last received values, wcs extrapolates from there with its drift term and the next beacon
+ * received updates both over the full interval.
+ * After CCP_HOLDOVER_MAX missed beacons in a row the slave falls back to a long listen.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ *
+ * @return true if the missed beacon was bridged
+ */
+bool
+dw1000_ccp_holdover(dw1000_ccp_instance_t *ccp)
+{
+    if (ccp->status.acting_master)
+        return false;
+    if (ccp->config.role == CCP_ROLE_MASTER || !ccp->status.valid
+        || ccp->missed >= MYNEWT_VAL(CCP_HOLDOVER_MAX)) {
+        ccp->uncertainty = 0;
+        return false;
+    }
+
+    ccp->missed++;
+    ccp->uncertainty += ((uint64_t)ccp->period << 16) * MYNEWT_VAL(CCP_HOLDOVER_SKEW_PPB) / 1000000000UL;
+    ccp_epoch_advance(ccp);
+    ccp->status.rx_timeout_error = 0;
+    CCP_STATS_INC(holdover);
+    return true;
+}
+
 /**
  * @fn ccp_rx_timeout_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  * @brief API for rx_timeout_cb of ccp.
@@ -799,11 +966,13 @@ ccp_rx_timeout_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *
         return false;
 
     if (os_sem_get_count(&ccp->sem) == 0){
+        CCP_STATS_INC(rx_timeout);
         ccp->status.rx_timeout_error = 1;
+        if (ccp_beacon_missed(ccp))
+            return true;
         os_error_t err = os_sem_release(&ccp->sem);
         assert(err == OS_OK); 
         DIAGMSG("{\"utime\": %lu,\"msg\": \"ccp:rx_timeout_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
-        CCP_STATS_INC(rx_timeout);
     }
     return true;
 }
@@ -857,6 +1026,8 @@ dw1000_ccp_send(struct _dw1000_ccp_instance_t *ccp, dw1000_dev_modes_t mode)
     ccp_frame_t * frame = ccp->frames[(ccp->idx+1)%ccp->nframes];
     frame->rpt_count = 0;
     frame->rpt_max = MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
+    frame->rank = 0;
+    frame->uncertainty = 0;
 
     uint64_t timestamp = previous_frame->transmission_timestamp.timestamp
                         + ((uint64_t)ccp->period << 16);
@@ -892,6 +1063,161 @@ dw1000_ccp_send(struct _dw1000_ccp_instance_t *ccp, dw1000_dev_modes_t mode)
     return ccp->status;
 }
 
+#if MYNEWT_VAL(WCS_ENABLED)
+/**
+ * @fn ccp_backup_tx(dw1000_ccp_instance_t *ccp)
+ * @brief Backup master beacon, started from the rx_timeout of the listen window at the predicted epoch of
+ * the missing primary beacon. It goes out backup_rank tx_holdoff_dly after the epoch, behind the primary and
+ * any lower rank, with the transmission timestamp converted to the primary's timebase, the interval shortened
+ * by the offset as relays do and the primary's euid. Slaves tracking the primary neither see a master change
+ * nor a jump in time. The predicted epoch also advances wcs, with no skew measurement, so the conversion
+ * stays anchored to the last period rather than to the last beacon received.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ *
+ * @return dw1000_ccp_status_t
+ */
+static dw1000_ccp_status_t
+ccp_backup_tx(dw1000_ccp_instance_t *ccp)
+{
+    struct _dw1000_dev_instance_t * inst = ccp->dev_inst;
+    CCP_STATS_INC(send);
+
+    ccp_epoch_advance(ccp);
+    ccp_frame_t * frame = ccp->frames[(++ccp->idx)%ccp->nframes];
+
+    uint64_t master_epoch = wcs_local_to_master64(ccp->wcs, ccp->local_epoch);
+    uint64_t timestamp = (ccp->local_epoch + (((uint64_t)ccp->config.backup_rank * ccp->config.tx_holdoff_dly) << 16))
+                        & 0x0FFFFFFFE00UL;
+    dw1000_set_delay_start(inst, timestamp);
+    timestamp += inst->tx_antenna_delay;
+
+    frame->fctrl = FCNTL_IEEE_BLINK_CCP_64;
+    frame->transmission_timestamp.timestamp = wcs_local_to_master64(ccp->wcs, timestamp);
+    frame->seq_num = ccp->seq_num;
+    frame->euid = ccp->master_euid;
+    frame->short_address = inst->my_short_address;
+    frame->transmission_interval = ((uint64_t)ccp->period << 16)
+                        - (frame->transmission_timestamp.timestamp - master_epoch);
+    frame->rpt_count = 0;
+    frame->rpt_max = MYNEWT_VAL(CCP_MAX_CASCADE_RPTS);
+    frame->rank = ccp->config.backup_rank;
+    frame->uncertainty = (ccp->uncertainty > UINT16_MAX) ? UINT16_MAX : ccp->uncertainty;
+    frame->reception_timestamp = ccp->local_epoch;
+    frame->carrier_integrator = 0;
+    frame->rxttcko = 0;
+    ccp->master_epoch.timestamp = master_epoch;
+
+    dw1000_write_tx(inst, frame->array, 0, sizeof(ccp_blink_frame_t));
+    dw1000_write_tx_fctrl(inst, sizeof(ccp_blink_frame_t), 0);
+    dw1000_set_wait4resp(inst, false);
+    ccp->status.rx_timeout_error = 0;
+    ccp->status.start_tx_error = dw1000_start_tx(inst).start_tx_error;
+    if (ccp->status.start_tx_error)
+        CCP_STATS_INC(tx_start_error);
+    return ccp->status;
+}
+#endif
+
+/**
+ * @fn ccp_beacon_missed(dw1000_ccp_instance_t *ccp)
+ * @brief No beacon in the listen window of a slave. A backup whose turn it is, backup_rank beacons missing in a
+ * row, or that is acting already transmits in place of the primary, see ccp_backup_tx(). Others bridge the
+ * epoch by holdover.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ *
+ * @return true if a backup beacon is on its way, its tx_complete releases the semaphore
+ */
+static bool
+ccp_beacon_missed(dw1000_ccp_instance_t *ccp)
+{
+#if MYNEWT_VAL(WCS_ENABLED)
+    if (ccp->config.backup_rank && ccp->config.role != CCP_ROLE_MASTER && ccp->status.valid &&
+        (ccp->status.acting_master || (ccp->missed + 1 >= ccp->config.backup_rank
+        && ccp->missed < MYNEWT_VAL(CCP_HOLDOVER_MAX)))) {
+        if (!ccp->status.acting_master)
+            CCP_STATS_INC(takeover);
+        ccp->status.acting_master = 1;
+        if (ccp_backup_tx(ccp).start_tx_error == 0)
+            return true;
+    }
+#endif
+#if MYNEWT_VAL(CCP_HOLDOVER_MAX) > 0
+    dw1000_ccp_holdover(ccp);
+#endif
+    return false;
+}
+
+/**
+ * @fn ccp_master_rejoin(dw1000_ccp_instance_t *ccp)
+ * @brief A started master listens for a period before its first beacon. A backup may have taken over while it
+ * was away, see dw1000_ccp_set_backup(). rx_complete_cb() then aligns the first beacon to the epoch the backup
+ * keeps, where the backups listening before their own slot hear it and step down. Otherwise the master starts
+ * from the current time.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ *
+ * @return void
+ */
+static void
+ccp_master_rejoin(dw1000_ccp_instance_t *ccp)
+{
+    struct _dw1000_dev_instance_t * inst = ccp->dev_inst;
+
+    dw1000_set_rx_timeout(inst, (ccp->period > 0xffff) ? (uint16_t) 0xffff : (uint16_t) ccp->period);
+    dw1000_ccp_listen(ccp, DWT_BLOCKING);
+
+    if (ccp->status.rejoin) {
+        ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
+        uint64_t ts = (dw1000_read_systime(inst) - (((uint64_t)ccp->period)<<16))&0xFFFFFFFFFFULL;
+        ts += ((uint64_t)ccp->config.tx_holdoff_dly)<<16;
+        ccp->local_epoch = frame->transmission_timestamp.lo = ts;
+        frame->transmission_timestamp.hi = 0;
+        ccp->status.rejoin = 0;
+    } else {
+        CCP_STATS_INC(rejoin);
+    }
+    ccp->status.rx_timeout_error = 0;
+}
+
+/**
+ * @fn dw1000_ccp_set_relay_slot(dw1000_ccp_instance_t *ccp, uint8_t slot)
+ * @brief API to set the transmit slot of a relay within its level, relays sharing a level and coverage
+ * need distinct slots. A relay at level n transmits (n * CCP_RELAY_NSLOTS + slot) * tx_holdoff_dly after the master epoch.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ * @param slot  Slot within the level, less than CCP_RELAY_NSLOTS.
+ *
+ * @return void
+ */
+void
+dw1000_ccp_set_relay_slot(dw1000_ccp_instance_t *ccp, uint8_t slot)
+{
+    assert(slot < MYNEWT_VAL(CCP_RELAY_NSLOTS));
+    ccp->config.relay_slot = slot;
+}
+
+/**
+ * @fn dw1000_ccp_set_backup(dw1000_ccp_instance_t *ccp, uint8_t rank)
+ * @brief API to make a slave a backup master. A backup of rank n takes over when n beacons in a row are missed,
+ * transmitting n tx_holdoff_dly after the epoch, so with several backups the lowest rank present takes over first
+ * and the others keep tracking it. An acting backup still listens at every epoch up to its own slot and steps
+ * down on hearing the primary or a lower rank. A restarted primary finds an acting backup by listening before
+ * its first beacon and aligns to it, see ccp_master_rejoin(). Ranks must be unique within the network.
+ *
+ * @param ccp   Pointer to dw1000_ccp_instance_t.
+ * @param rank  Backup rank, 0 for none. At most CCP_HOLDOVER_MAX.
+ *
+ * @return void
+ */
+void
+dw1000_ccp_set_backup(dw1000_ccp_instance_t *ccp, uint8_t rank)
+{
+    assert(rank <= MYNEWT_VAL(CCP_HOLDOVER_MAX));
+    ccp->config.backup_rank = rank;
+}
+
 /*!
  * @fn dw1000_ccp_receive(dw1000_dev_instance_t * inst, dw1000_ccp_modes_t mode)
  *
@@ -916,10 +1242,8 @@ dw1000_ccp_listen(struct _dw1000_ccp_instance_t *ccp, dw1000_dev_modes_t mode)
 
     CCP_STATS_INC(listen);
 
-    ccp->status = (dw1000_ccp_status_t){
-        .rx_timeout_error = 0,
-        .start_rx_error = 0
-    };
+    ccp->status.rx_timeout_error = 0;
+    ccp->status.start_rx_error = 0;
     ccp->status.start_rx_error = dw1000_start_rx(inst).start_rx_error;
     if (ccp->status.start_rx_error){
         err = os_sem_release(&ccp->sem);
@@ -952,6 +1276,11 @@ dw1000_ccp_start(dw1000_ccp_instance_t *ccp, dw1000_ccp_role_t role)
     assert(ccp);
     ccp->idx = 0x0;
     ccp->status.valid = false;
+    ccp->status.acting_master = false;
+    ccp->status.rejoin = (role == CCP_ROLE_MASTER);
+    ccp->missed = 0;
+    ccp->uncertainty = 0;
+    ccp->rank = 0;
     ccp_frame_t * frame = ccp->frames[(ccp->idx)%ccp->nframes];
     ccp->config.role = role;
 
@@ -35,6 +35,10 @@ extern "C" {
 #if MYNEWT_VAL(CIR_STATS)
 STATS_SECT_START(cir_stat_section)
     STATS_SECT_ENTRY(complete)
+    STATS_SECT_ENTRY(fp_refined)
+    STATS_SECT_ENTRY(read_us)
+    STATS_SECT_ENTRY(dead_us)
+    STATS_SECT_ENTRY(overrun)
 STATS_SECT_END
 #endif
 
@@ -54,7 +58,7 @@ typedef union{
 
 typedef struct _cir_t{
     uint8_t dummy;  //Errata
-    struct _cir_complex_t array[MYNEWT_VAL(CIR_SIZE)]; 
+    struct _cir_complex_t array[MYNEWT_VAL(CIR_MAX_SIZE)]; 
 } __attribute__((packed, aligned(1))) cir_t;
 
 
@@ -64,9 +68,15 @@ typedef struct _cir_instance_t{
     STATS_SECT_DECL(cir_stat_section) stat; //!< Stats instance
 #endif
     cir_status_t status;
+    uint16_t offset;        //!< Taps read ahead of the first path index
+    uint16_t length;        //!< Taps read, at most CIR_MAX_SIZE
+    uint32_t read_time;     //!< Duration of the last capture in usec
+    uint32_t dead_time;     //!< Part of read_time the receiver, the rx_complete callbacks or a response TX waited for, usec
     uint16_t fp_amp1;
     float fp_idx;
+    float fp_idx_ref;       //!< First path index re-detected from the CIR window, equals fp_idx when refinement fails
     float fp_power;
+    float los;              //!< Line of sight probability from the CIR classifier, 1.0 when not available
     float rcphase;
     float angle;
     uint64_t raw_ts;
@@ -75,6 +85,7 @@ typedef struct _cir_instance_t{
 
 cir_instance_t * cir_init(struct _dw1000_dev_instance_t * inst, struct _cir_instance_t * cir);
 void cir_enable(struct _cir_instance_t * inst, bool mode);
+void cir_set_window(struct _cir_instance_t * inst, uint16_t offset, uint16_t length);
 void cir_free(struct _cir_instance_t * inst);
 float cir_get_pdoa(struct _cir_instance_t * master, struct _cir_instance_t *slave);
 float cir_calc_aoa(float pdoa, float wavelength, float antenna_separation);
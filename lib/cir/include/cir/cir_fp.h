@@ -0,0 +1,49 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _CIR_FP_H_
+#define _CIR_FP_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <cir/cir.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Leading edge estimate within a CIR window
+typedef struct _cir_fp_t{
+    float fp_idx;               //!< First path index relative to the start of the window, in samples
+    uint32_t peak_mag2;         //!< Squared magnitude of the strongest tap in the window
+    uint32_t thresh_mag2;       //!< Squared magnitude threshold used for detection
+    uint16_t peak_idx;          //!< Index of the strongest tap in the window
+}cir_fp_t;
+
+void cir_fp_init(void);
+void cir_fp_mag2(const struct _cir_complex_t * cir, uint32_t * mag2, uint16_t n);
+void cir_fp_interp_mag2(const struct _cir_complex_t * cir, uint16_t n, uint16_t idx, uint32_t * mag2);
+bool cir_fp_refine(const struct _cir_complex_t * cir, uint16_t n, uint16_t noise_std, cir_fp_t * fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CIR_FP_H_ */
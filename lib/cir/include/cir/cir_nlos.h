@@ -0,0 +1,57 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _CIR_NLOS_H_
+#define _CIR_NLOS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <cir/cir.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Classifier features, all Q8
+typedef enum _cir_nlos_feature_t{
+    CIR_NLOS_RISE_TIME = 0,     //!< Peak index minus first path index, samples
+    CIR_NLOS_KURTOSIS,          //!< Kurtosis of the tap amplitudes
+    CIR_NLOS_MEAN_DELAY,        //!< Power weighted mean excess delay from the first path, samples
+    CIR_NLOS_RMS_DELAY,         //!< RMS delay spread, samples
+    CIR_NLOS_FP_PEAK_RATIO,     //!< First path to peak amplitude ratio
+    CIR_NLOS_NFEATURES
+}cir_nlos_feature_t;
+
+//! Logistic model, z = bias + sum(weight[i] * feature[i]), all Q8
+typedef struct _cir_nlos_model_t{
+    int16_t bias;
+    int16_t weight[CIR_NLOS_NFEATURES];
+}cir_nlos_model_t;
+
+void cir_nlos_features(const struct _cir_complex_t * cir, uint16_t n, float fp_idx, int32_t features[]);
+float cir_nlos_classify(const struct _cir_complex_t * cir, uint16_t n, float fp_idx);
+cir_nlos_model_t * cir_nlos_get_model(void);
+void cir_nlos_set_model(const cir_nlos_model_t * model);
+void cir_nlos_config_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CIR_NLOS_H_ */
@@ -48,14 +48,30 @@
 #include <dw1000/dw1000_stats.h>
 #include <cir/cir.h>
 #include <cir/cir_encode.h>
+#if MYNEWT_VAL(CIR_FP_REFINE)
+#include <cir/cir_fp.h>
+#endif
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+#include <cir/cir_nlos.h>
+#endif
 
 #if MYNEWT_VAL(CIR_STATS)
 STATS_NAME_START(cir_stat_section)
     STATS_NAME(cir_stat_section, complete)
+    STATS_NAME(cir_stat_section, fp_refined)
+    STATS_NAME(cir_stat_section, read_us)
+    STATS_NAME(cir_stat_section, dead_us)
+    STATS_NAME(cir_stat_section, overrun)
 STATS_NAME_END(cir_stat_section)
 #define CIR_STATS_INC(__X) STATS_INC(cir->stat, __X)
+#define CIR_STATS_INCN(__X, __N) STATS_INCN(cir->stat, __X, __N)
 #else
 #define CIR_STATS_INC(__X) {}
+#define CIR_STATS_INCN(__X, __N) {}
+#endif
+
+#if MYNEWT_VAL(CIR_SIZE) > MYNEWT_VAL(CIR_MAX_SIZE) || MYNEWT_VAL(CIR_OFFSET) >= MYNEWT_VAL(CIR_SIZE)
+#error "CIR window must satisfy CIR_OFFSET < CIR_SIZE <= CIR_MAX_SIZE"
 #endif
 
 #if MYNEWT_VAL(CIR_VERBOSE) 
@@ -69,7 +85,7 @@ cir_complete_ev_cb(struct os_event *ev) {
     dw1000_dev_instance_t * inst = (dw1000_dev_instance_t *)ev->ev_arg;
     cir_t * cir  = &inst->cir->cir;
     if(inst->config.rxdiag_enable){
-        for (uint16_t i=0; i < MYNEWT_VAL(CIR_SIZE); i++){
+        for (uint16_t i=0; i < inst->cir->length; i++){
             cir->array[i].real /= inst->rxdiag.pacc_cnt;
             cir->array[i].imag /= inst->rxdiag.pacc_cnt;
         }
@@ -77,12 +93,12 @@ cir_complete_ev_cb(struct os_event *ev) {
     inst->cir->fp_power = dw1000_get_fppl(inst);
 
 #if  MYNEWT_VAL(DW1000_DEVICE_0) && !MYNEWT_VAL(DW1000_DEVICE_1)
-    cir_encode(inst->cir, "cir", MYNEWT_VAL(CIR_SIZE));
+    cir_encode(inst->cir, "cir", inst->cir->length);
 #elif  MYNEWT_VAL(DW1000_DEVICE_0) && MYNEWT_VAL(DW1000_DEVICE_1)
     if (inst->idx == 0)
-        cir_encode(inst->cir, "cir0", MYNEWT_VAL(CIR_SIZE));   
+        cir_encode(inst->cir, "cir0", inst->cir->length);   
     else     
-        cir_encode(inst->cir, "cir1", MYNEWT_VAL(CIR_SIZE)); 
+        cir_encode(inst->cir, "cir1", inst->cir->length); 
 #endif
 }
 
@@ -91,7 +107,7 @@ cir_complete_ev_cb(struct os_event *ev) {
 /*! 
  * @fn cir_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  *
- * @brief Read CIR inadvance of RXENB 
+ * @brief Read CIR inadvance of RXENB, or after RXENB and the rx_complete callbacks with CIR_DEFERRED_READ
  * 
  * input parameters
  * @param inst - dw1000_dev_instance_t * inst
@@ -105,6 +121,9 @@ static bool
 cir_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 {
     cir_instance_t * cir = (cir_instance_t *)cbs->inst_ptr;
+    uint32_t start = os_cputime_get32();
+    uint16_t offset = cir->offset;
+    uint16_t length = cir->length;
 
     cir->status.valid = 0;
     CIR_STATS_INC(complete);
@@ -136,15 +155,51 @@ cir_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
         }
     }
 
-    if(fp_idx < MYNEWT_VAL(CIR_OFFSET) || (fp_idx + MYNEWT_VAL(CIR_SIZE)) > 1023) {
+    if(fp_idx < offset || (fp_idx - offset + length) > 1016) {
         /* Can't extract CIR from required offset, abort */
         return true;
     }
-    dw1000_read_accdata(inst, (uint8_t *)&cir->cir, (fp_idx - MYNEWT_VAL(CIR_OFFSET)) * sizeof(cir_complex_t), sizeof(cir_t));
+    /* Read length taps plus the dummy octet, lengths above DW1000_DEVICE_SPI_RD_MAX_NOBLOCK go through the DMA path */
+    dw1000_read_accdata(inst, (uint8_t *)&cir->cir, (fp_idx - offset) * sizeof(cir_complex_t), 1 + length * sizeof(cir_complex_t));
+
+    cir->fp_idx_ref = cir->fp_idx;
+#if MYNEWT_VAL(CIR_FP_REFINE)
+    cir_fp_t fp;
+    uint16_t noise_std = (inst->config.rxdiag_enable) ? inst->rxdiag.rx_std : 0;
+    if (cir_fp_refine(cir->cir.array, length, noise_std, &fp)) {
+        cir->fp_idx_ref = (float)(fp_idx - offset) + fp.fp_idx;
+        CIR_STATS_INC(fp_refined);
+    }
+#endif
+
+    cir->los = 1.0f;
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+    cir->los = cir_nlos_classify(cir->cir.array, length, cir->fp_idx_ref - (float)(fp_idx - offset));
+#endif
 
     float _rcphase = (float)((uint8_t)dw1000_read_reg(inst, RX_TTCKO_ID, 4, sizeof(uint8_t)) & 0x7F);
     cir->rcphase = _rcphase * (M_PI/64.0f);
-    cir->angle = atan2f((float)cir->cir.array[MYNEWT_VAL(CIR_OFFSET)].imag, (float)cir->cir.array[MYNEWT_VAL(CIR_OFFSET)].real);
+    cir->angle = atan2f((float)cir->cir.array[offset].imag, (float)cir->cir.array[offset].real);
+
+    /* Reported for discarded captures too, the time was spent either way */
+    cir->read_time = os_cputime_ticks_to_usecs(os_cputime_get32() - start);
+    CIR_STATS_INCN(read_us, cir->read_time);
+#if MYNEWT_VAL(CIR_DEFERRED_READ)
+    /* Neither the receiver nor the rx_complete callbacks waited for the read, unless dw1000_start_tx() pulled
+     * it ahead of a response, which waits for it */
+    cir->dead_time = (inst->control.cir_pending) ? cir->read_time : 0;
+
+    /* The receiver was re-enabled and the frame handled before this callback, a preamble detected since
+     * then means the accumulator and the RX_TIME registers may belong to the next frame. The MAC clears
+     * RXPRD with RXENAB. */
+    if (dw1000_read_reg(inst, SYS_STATUS_ID, 0, sizeof(uint16_t)) & SYS_STATUS_RXPRD) {
+        CIR_STATS_INC(overrun);
+        return true;
+    }
+#else
+    cir->dead_time = cir->read_time;
+#endif
+    CIR_STATS_INCN(dead_us, cir->dead_time);
     cir->status.valid = 1;
 
 #if MYNEWT_VAL(CIR_VERBOSE)
@@ -179,6 +234,32 @@ cir_enable(struct _cir_instance_t * cir, bool mode)
 #endif
 }
 
+/*! 
+ * @fn cir_set_window(cir_instance_t * cir, uint16_t offset, uint16_t length)
+ *
+ * @brief Set the CIR window read on the following frames, e.g. a few taps for the
+ * PDoA phase or a wider window for NLOS analysis. Call before cir_enable().
+ * 
+ * @param cir    - cir_instance_t *
+ * @param offset - taps read ahead of the LDE first path index, less than length
+ * @param length - number of taps, at most CIR_MAX_SIZE
+ * 
+ * output parameters
+ *
+ * returns void
+ */
+void
+cir_set_window(struct _cir_instance_t * cir, uint16_t offset, uint16_t length)
+{
+    assert(length <= MYNEWT_VAL(CIR_MAX_SIZE));
+    assert(offset < length);
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    cir->offset = offset;
+    cir->length = length;
+    OS_EXIT_CRITICAL(sr);
+}
+
 /*! 
  * @fn cir_get_pdoa(cir_instance_t * master, cir_instance *slave)
  *
@@ -241,6 +322,11 @@ cir_init(struct _dw1000_dev_instance_t * inst, struct _cir_instance_t * cir)
         cir->status.selfmalloc = 1;
     }
     cir->dev_inst = inst;
+    cir->offset = MYNEWT_VAL(CIR_OFFSET);
+    cir->length = MYNEWT_VAL(CIR_SIZE);
+#if MYNEWT_VAL(CIR_FP_REFINE)
+    cir_fp_init();
+#endif
 
 #if MYNEWT_VAL(CIR_STATS)
     int rc = stats_init(
@@ -314,6 +400,10 @@ void cir_pkg_init(void)
 #if MYNEWT_VAL(CIR_ENABLED)
     printf("{\"utime\": %lu,\"msg\": \"cir_pkg_init\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+    cir_nlos_config_init();
+#endif
+
     dw1000_dev_instance_t * inst = hal_dw1000_inst(0);
     cbs[0].inst_ptr = inst->cir = cir_init(inst, NULL);
     dw1000_mac_append_interface(inst, &cbs[0]);
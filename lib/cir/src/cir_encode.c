@@ -29,6 +29,9 @@
 #if MYNEWT_VAL(WCS_ENABLED)
 #include <wcs/wcs.h>
 #endif
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+#include <diaglog/diaglog.h>
+#endif
 
 #if MYNEWT_VAL(CIR_VERBOSE)
 
@@ -37,17 +40,28 @@ static char _buf[JSON_BUF_SIZE];
 static uint16_t idx=0;
 
 static void
-json_fflush(){
+_json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    diaglog_write(NULL, DIAGLOG_TYPE_TEXT, _buf, idx);
+#else
     _buf[idx] = '\0';
-    printf("%s\n", _buf);
+    printf("%s", _buf);
+#endif
     idx=0;
 }
 
 static void
-_json_fflush(){
+json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    if (idx == JSON_BUF_SIZE)
+        _json_fflush();
+    _buf[idx++] = '\n';
+    _json_fflush();
+#else
     _buf[idx] = '\0';
-    printf("%s", _buf);
+    printf("%s\n", _buf);
     idx=0;
+#endif
 }
 
 static int
@@ -90,9 +104,15 @@ cir_encode(cir_instance_t * cir, char * name, uint16_t nsize){
     JSON_VALUE_UINT(&value, *(uint32_t *)&cir->fp_idx);
     rc |= json_encode_object_entry(&encoder, "idx", &value);
 
+    JSON_VALUE_UINT(&value, *(uint32_t *)&cir->fp_idx_ref);
+    rc |= json_encode_object_entry(&encoder, "idx_ref", &value);
+
     JSON_VALUE_UINT(&value, *(uint32_t *)&cir->fp_power);
     rc |= json_encode_object_entry(&encoder, "power", &value);
 
+    JSON_VALUE_UINT(&value, cir->dead_time);
+    rc |= json_encode_object_entry(&encoder, "dead_us", &value);
+
     rc |= json_encode_array_name(&encoder, "real");
     rc |= json_encode_array_start(&encoder);
     for (uint16_t i=0; i< nsize; i++){
@@ -0,0 +1,231 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file cir_fp.c
+ * @brief Sub-sample first path refinement
+ *
+ * @details The LDE reports the first path as the first accumulator tap crossing its threshold. Here the
+ * leading edge is re-detected on the CIR window read by cir_complete_cb: squared magnitudes are computed
+ * for every tap, the interval holding the threshold crossing is up-sampled CIR_FP_UPSAMPLE times with a
+ * 4-tap cubic (Catmull-Rom) polyphase interpolator on the complex samples, and the crossing is located
+ * by linear interpolation between the two up-sampled points around it.
+ *
+ * All arithmetic is integer. On cores with the DSP extension (Cortex-M4/M7) the magnitude and interpolator
+ * inner loops use the dual 16bit multiply-accumulate instructions, other targets use the scalar code.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <cir/cir.h>
+#include <cir/cir_fp.h>
+
+#if MYNEWT_VAL(CIR_FP_SIMD) && defined(__ARM_FEATURE_DSP)
+#include <arm_acle.h>
+#define CIR_FP_USE_SIMD 1
+#else
+#define CIR_FP_USE_SIMD 0
+#endif
+
+#define CIR_FP_UPSAMPLE MYNEWT_VAL(CIR_FP_UPSAMPLE)
+
+#if CIR_FP_UPSAMPLE < 2 || CIR_FP_UPSAMPLE > 64
+#error "CIR_FP_UPSAMPLE must be within [2, 64]"
+#endif
+
+//! Polyphase coefficients in Q15, packed pairwise for the dual MAC
+static union {
+    int16_t c[4];
+    uint32_t w[2];
+} g_coef[CIR_FP_UPSAMPLE];
+
+/**
+ * @fn cir_fp_init(void)
+ * @brief Build the Catmull-Rom polyphase table, phase k interpolates at idx + k/CIR_FP_UPSAMPLE.
+ *
+ * @return void
+ */
+void
+cir_fp_init(void)
+{
+    for (uint16_t k = 0; k < CIR_FP_UPSAMPLE; k++) {
+        float t = (float) k / CIR_FP_UPSAMPLE;
+        float t2 = t * t, t3 = t2 * t;
+        float w[4] = {
+            0.5f * (-t3 + 2.0f * t2 - t),
+            0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f),
+            0.5f * (-3.0f * t3 + 4.0f * t2 + t),
+            0.5f * (t3 - t2)
+        };
+        for (uint16_t j = 0; j < 4; j++) {
+            int32_t q = (int32_t)(w[j] * 32768.0f + ((w[j] < 0) ? -0.5f : 0.5f));
+            g_coef[k].c[j] = (q > INT16_MAX) ? INT16_MAX : q;
+        }
+    }
+}
+
+/**
+ * @fn cir_fp_load(const struct _cir_complex_t * cir, int16_t i, uint16_t n)
+ * @brief Load one tap as a packed real/imag word, clamping the index to the window.
+ * The taps are not word aligned in cir_t (errata dummy byte), memcpy keeps the access legal.
+ *
+ * @return uint32_t imag << 16 | real
+ */
+static inline uint32_t
+cir_fp_load(const struct _cir_complex_t * cir, int16_t i, uint16_t n)
+{
+    uint32_t w;
+    i = (i < 0) ? 0 : (i >= n) ? n - 1 : i;
+    memcpy(&w, &cir[i], sizeof(w));
+    return w;
+}
+
+/**
+ * @fn cir_fp_mag2(const struct _cir_complex_t * cir, uint32_t * mag2, uint16_t n)
+ * @brief Squared magnitude of n taps.
+ *
+ * @param cir   CIR window.
+ * @param mag2  Output, n entries.
+ * @param n     Number of taps.
+ *
+ * @return void
+ */
+void
+cir_fp_mag2(const struct _cir_complex_t * cir, uint32_t * mag2, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        uint32_t w = cir_fp_load(cir, i, n);
+#if CIR_FP_USE_SIMD
+        // real*real + imag*imag in one instruction, the sum wraps into the unsigned range
+        mag2[i] = (uint32_t) __smuad(w, w);
+#else
+        int32_t re = (int16_t)(w & 0xffff);
+        int32_t im = (int16_t)(w >> 16);
+        mag2[i] = (uint32_t)(re * re) + (uint32_t)(im * im);
+#endif
+    }
+}
+
+/**
+ * @fn cir_fp_interp_mag2(const struct _cir_complex_t * cir, uint16_t n, uint16_t idx, uint32_t * mag2)
+ * @brief Up-sample the interval [idx, idx + 1) and return the squared magnitude at each phase.
+ *
+ * @param cir   CIR window.
+ * @param n     Number of taps in the window.
+ * @param idx   Start of the interval.
+ * @param mag2  Output, CIR_FP_UPSAMPLE entries.
+ *
+ * @return void
+ */
+void
+cir_fp_interp_mag2(const struct _cir_complex_t * cir, uint16_t n, uint16_t idx, uint32_t * mag2)
+{
+    uint32_t s[4];
+    for (int16_t j = 0; j < 4; j++)
+        s[j] = cir_fp_load(cir, (int16_t) idx - 1 + j, n);
+
+#if CIR_FP_USE_SIMD
+    // Regroup as {re0,re1},{re2,re3},{im0,im1},{im2,im3}, compiles to pkhbt/pkhtb
+    uint32_t re01 = (s[0] & 0xffff) | (s[1] << 16);
+    uint32_t re23 = (s[2] & 0xffff) | (s[3] << 16);
+    uint32_t im01 = (s[0] >> 16) | (s[1] & 0xffff0000);
+    uint32_t im23 = (s[2] >> 16) | (s[3] & 0xffff0000);
+#endif
+
+    for (uint16_t k = 0; k < CIR_FP_UPSAMPLE; k++) {
+#if CIR_FP_USE_SIMD
+        int32_t re = __smlad(re01, g_coef[k].w[0], __smuad(re23, g_coef[k].w[1])) >> 15;
+        int32_t im = __smlad(im01, g_coef[k].w[0], __smuad(im23, g_coef[k].w[1])) >> 15;
+#else
+        int32_t re = 0, im = 0;
+        for (uint16_t j = 0; j < 4; j++) {
+            re += (int32_t)(int16_t)(s[j] & 0xffff) * g_coef[k].c[j];
+            im += (int32_t)(int16_t)(s[j] >> 16) * g_coef[k].c[j];
+        }
+        re >>= 15;
+        im >>= 15;
+#endif
+        mag2[k] = (uint32_t)(re * re) + (uint32_t)(im * im);
+    }
+}
+
+/**
+ * @fn cir_fp_refine(const struct _cir_complex_t * cir, uint16_t n, uint16_t noise_std, cir_fp_t * fp)
+ * @brief Threshold based first path re-detection with sub-sample resolution. The threshold is
+ * CIR_FP_THRESHOLD percent of the peak amplitude in the window, raised to CIR_FP_NOISE_MULT
+ * times the noise standard deviation when that is known.
+ *
+ * @param cir        CIR window, as read by cir_complete_cb.
+ * @param n          Number of taps, at most CIR_MAX_SIZE.
+ * @param noise_std  Noise standard deviation in accumulator units, 0 if unknown.
+ * @param fp         Result.
+ *
+ * @return true if a leading edge was found, false if the window holds no crossing or it lies before the first tap
+ */
+bool
+cir_fp_refine(const struct _cir_complex_t * cir, uint16_t n, uint16_t noise_std, cir_fp_t * fp)
+{
+    uint32_t mag2[MYNEWT_VAL(CIR_MAX_SIZE)];
+    uint32_t up[CIR_FP_UPSAMPLE + 1];
+
+    assert(n <= MYNEWT_VAL(CIR_MAX_SIZE));
+    if (n == 0)
+        return false;
+    cir_fp_mag2(cir, mag2, n);
+
+    fp->peak_idx = 0;
+    fp->peak_mag2 = mag2[0];
+    for (uint16_t i = 1; i < n; i++) {
+        if (mag2[i] > fp->peak_mag2) {
+            fp->peak_mag2 = mag2[i];
+            fp->peak_idx = i;
+        }
+    }
+    if (fp->peak_mag2 == 0)
+        return false;
+
+    uint64_t thresh = ((uint64_t) fp->peak_mag2 * MYNEWT_VAL(CIR_FP_THRESHOLD) * MYNEWT_VAL(CIR_FP_THRESHOLD)) / 10000;
+    uint64_t floor2 = (uint64_t) noise_std * noise_std * MYNEWT_VAL(CIR_FP_NOISE_MULT) * MYNEWT_VAL(CIR_FP_NOISE_MULT);
+    if (floor2 > thresh)
+        thresh = floor2;
+    if (thresh > fp->peak_mag2)
+        return false;
+    fp->thresh_mag2 = (uint32_t) thresh;
+
+    uint16_t i = 0;
+    while (mag2[i] < fp->thresh_mag2)
+        i++;
+    if (i == 0)
+        return false;
+
+    // Crossing lies in [i - 1, i), the up-sampled phases cover [i - 1, i) and up[CIR_FP_UPSAMPLE] closes it at tap i
+    cir_fp_interp_mag2(cir, n, i - 1, up);
+    up[CIR_FP_UPSAMPLE] = mag2[i];
+
+    uint16_t k = 1;
+    while (k < CIR_FP_UPSAMPLE && up[k] < fp->thresh_mag2)
+        k++;
+    float frac = 0.0f;
+    if (up[k] > up[k - 1] && up[k - 1] < fp->thresh_mag2)
+        frac = (float)(fp->thresh_mag2 - up[k - 1]) / (float)(up[k] - up[k - 1]);
+
+    fp->fp_idx = (float)(i - 1) + ((float)(k - 1) + frac) / CIR_FP_UPSAMPLE;
+    return true;
+}
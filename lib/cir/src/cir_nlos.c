@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file cir_nlos.c
+ * @brief NLOS classifier from CIR features
+ *
+ * @details dw1000_estimate_los() only looks at the difference between the total and the first path power.
+ * Here five features are taken from the CIR window (rise time, kurtosis, mean excess delay, rms delay
+ * spread and first path to peak ratio), quantised to Q8 and fed to a logistic model with Q8 weights.
+ * The weights default to the CIR_NLOS_W_* syscfg values; with CIR_NLOS_CONFIG they can be overwritten
+ * from flash through the "nlos" config group (nlos/bias, nlos/w0 ... nlos/w4).
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <os/os.h>
+#include <cir/cir.h>
+#include <cir/cir_fp.h>
+#include <cir/cir_nlos.h>
+
+#if MYNEWT_VAL(CIR_NLOS_CONFIG)
+#include <stdio.h>
+#include <config/config.h>
+#endif
+
+static cir_nlos_model_t g_model = {
+    .bias = MYNEWT_VAL(CIR_NLOS_W_BIAS),
+    .weight = {
+        [CIR_NLOS_RISE_TIME] = MYNEWT_VAL(CIR_NLOS_W_RISE_TIME),
+        [CIR_NLOS_KURTOSIS] = MYNEWT_VAL(CIR_NLOS_W_KURTOSIS),
+        [CIR_NLOS_MEAN_DELAY] = MYNEWT_VAL(CIR_NLOS_W_MEAN_DELAY),
+        [CIR_NLOS_RMS_DELAY] = MYNEWT_VAL(CIR_NLOS_W_RMS_DELAY),
+        [CIR_NLOS_FP_PEAK_RATIO] = MYNEWT_VAL(CIR_NLOS_W_FP_PEAK_RATIO)
+    }
+};
+
+//! 1/(1+exp(-z)) in Q15 for z = -8:0.5:8
+static const int16_t g_sigmoid[] = {
+    11, 18, 30, 49, 81, 133, 219, 360, 589, 960, 1554, 2486, 3906, 5978, 8812, 12371, 16384,
+    20396, 23955, 26789, 28861, 30281, 31213, 31807, 32178, 32407, 32548, 32634, 32686, 32718, 32737, 32749, 32756
+};
+
+/**
+ * @fn cir_nlos_sigmoid(int32_t z)
+ * @brief Logistic function by table interpolation.
+ *
+ * @param z  Q8 argument.
+ * @return probability Q15
+ */
+static int32_t
+cir_nlos_sigmoid(int32_t z)
+{
+    z += 8 * 256;               // Table origin
+    if (z <= 0)
+        return g_sigmoid[0];
+    if (z >= 16 * 256)
+        return g_sigmoid[sizeof(g_sigmoid)/sizeof(g_sigmoid[0]) - 1];
+    int32_t i = z >> 7;         // 0.5 steps
+    int32_t frac = z & 0x7f;
+    return g_sigmoid[i] + (((g_sigmoid[i + 1] - g_sigmoid[i]) * frac) >> 7);
+}
+
+/**
+ * @fn cir_nlos_features(const struct _cir_complex_t * cir, uint16_t n, float fp_idx, int32_t features[])
+ * @brief Extract the classifier features from a CIR window.
+ *
+ * @param cir       CIR window.
+ * @param n         Number of taps, at most CIR_MAX_SIZE.
+ * @param fp_idx    First path index relative to the start of the window.
+ * @param features  Output, CIR_NLOS_NFEATURES entries in Q8.
+ *
+ * @return void
+ */
+void
+cir_nlos_features(const struct _cir_complex_t * cir, uint16_t n, float fp_idx, int32_t features[])
+{
+    uint32_t mag2[MYNEWT_VAL(CIR_MAX_SIZE)];
+    float amp[MYNEWT_VAL(CIR_MAX_SIZE)];
+
+    assert(n <= MYNEWT_VAL(CIR_MAX_SIZE));
+    cir_fp_mag2(cir, mag2, n);
+
+    uint16_t peak = 0;
+    float mean = 0, power = 0, tau = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        amp[i] = sqrtf((float) mag2[i]);
+        mean += amp[i];
+        if (mag2[i] > mag2[peak])
+            peak = i;
+        if (i >= fp_idx) {
+            power += (float) mag2[i];
+            tau += (float) mag2[i] * (i - fp_idx);
+        }
+    }
+    mean /= n;
+
+    float m2 = 0, m4 = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        float d = amp[i] - mean;
+        m2 += d * d;
+        m4 += d * d * d * d;
+    }
+    float kurtosis = (m2 > 0) ? (n * m4) / (m2 * m2) : 0;
+
+    float mean_delay = 0, rms_delay = 0;
+    if (power > 0) {
+        mean_delay = tau / power;
+        for (uint16_t i = 0; i < n; i++) {
+            if (i >= fp_idx) {
+                float d = (i - fp_idx) - mean_delay;
+                rms_delay += (float) mag2[i] * d * d;
+            }
+        }
+        rms_delay = sqrtf(rms_delay / power);
+    }
+
+    int16_t fp = (int16_t) floorf(fp_idx + 0.5f);
+    fp = (fp < 0) ? 0 : (fp >= n) ? n - 1 : fp;
+    float ratio = (amp[peak] > 0) ? amp[fp] / amp[peak] : 0;
+
+    features[CIR_NLOS_RISE_TIME] = (int32_t)((peak - fp_idx) * 256.0f);
+    features[CIR_NLOS_KURTOSIS] = (int32_t)(kurtosis * 256.0f);
+    features[CIR_NLOS_MEAN_DELAY] = (int32_t)(mean_delay * 256.0f);
+    features[CIR_NLOS_RMS_DELAY] = (int32_t)(rms_delay * 256.0f);
+    features[CIR_NLOS_FP_PEAK_RATIO] = (int32_t)(ratio * 256.0f);
+}
+
+/**
+ * @fn cir_nlos_classify(const struct _cir_complex_t * cir, uint16_t n, float fp_idx)
+ * @brief Line of sight probability of a CIR window.
+ *
+ * @param cir     CIR window.
+ * @param n       Number of taps, at most CIR_MAX_SIZE.
+ * @param fp_idx  First path index relative to the start of the window.
+ *
+ * @return 1.0 for likely LOS, 0.0 for NLOS, same scale as dw1000_estimate_los()
+ */
+float
+cir_nlos_classify(const struct _cir_complex_t * cir, uint16_t n, float fp_idx)
+{
+    int32_t features[CIR_NLOS_NFEATURES];
+    cir_nlos_features(cir, n, fp_idx, features);
+
+    // Q16 products of Q8 weights and unbounded Q8 features overflow 32 bits
+    int64_t z = (int64_t) g_model.bias << 8;
+    for (uint16_t i = 0; i < CIR_NLOS_NFEATURES; i++)
+        z += (int64_t) g_model.weight[i] * features[i];
+
+    // The sigmoid table saturates beyond +-8
+    z >>= 8;
+    z = (z > 16 * 256) ? 16 * 256 : (z < -16 * 256) ? -16 * 256 : z;
+    return cir_nlos_sigmoid((int32_t) z) / 32768.0f;
+}
+
+/**
+ * @fn cir_nlos_get_model(void)
+ * @brief Active model.
+ *
+ * @return cir_nlos_model_t *
+ */
+cir_nlos_model_t *
+cir_nlos_get_model(void)
+{
+    return &g_model;
+}
+
+/**
+ * @fn cir_nlos_set_model(const cir_nlos_model_t * model)
+ * @brief Replace the model, e.g. with weights trained for a site.
+ *
+ * @param model  New weights.
+ * @return void
+ */
+void
+cir_nlos_set_model(const cir_nlos_model_t * model)
+{
+    assert(model);
+    g_model = *model;
+}
+
+#if MYNEWT_VAL(CIR_NLOS_CONFIG)
+
+static char *cir_nlos_conf_get(int argc, char **argv, char *val, int val_len_max);
+static int cir_nlos_conf_set(int argc, char **argv, char *val);
+static int cir_nlos_conf_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt);
+
+static struct conf_handler cir_nlos_handler = {
+    .ch_name = "nlos",
+    .ch_get = cir_nlos_conf_get,
+    .ch_set = cir_nlos_conf_set,
+    .ch_commit = NULL,
+    .ch_export = cir_nlos_conf_export,
+};
+
+/**
+ * @fn cir_nlos_conf_param(const char * name)
+ * @brief Map a config name (bias, w0 ... w4) to the model entry.
+ *
+ * @return int16_t * or NULL
+ */
+static int16_t *
+cir_nlos_conf_param(const char * name)
+{
+    if (!strcmp(name, "bias"))
+        return &g_model.bias;
+    if (name[0] == 'w' && name[1] >= '0' && name[1] < '0' + CIR_NLOS_NFEATURES && name[2] == '\0')
+        return &g_model.weight[name[1] - '0'];
+    return NULL;
+}
+
+static char *
+cir_nlos_conf_get(int argc, char **argv, char *val, int val_len_max)
+{
+    int16_t * p = (argc == 1) ? cir_nlos_conf_param(argv[0]) : NULL;
+    if (p == NULL)
+        return NULL;
+    return conf_str_from_value(CONF_INT16, p, val, val_len_max);
+}
+
+static int
+cir_nlos_conf_set(int argc, char **argv, char *val)
+{
+    int16_t * p = (argc == 1) ? cir_nlos_conf_param(argv[0]) : NULL;
+    if (p == NULL)
+        return OS_ENOENT;
+    return CONF_VALUE_SET(val, CONF_INT16, *p);
+}
+
+static int
+cir_nlos_conf_export(void (*export_func)(char *name, char *val), enum conf_export_tgt tgt)
+{
+    char name[16], val[8];
+    conf_str_from_value(CONF_INT16, &g_model.bias, val, sizeof(val));
+    export_func("nlos/bias", val);
+    for (uint16_t i = 0; i < CIR_NLOS_NFEATURES; i++) {
+        snprintf(name, sizeof(name), "nlos/w%d", i);
+        conf_str_from_value(CONF_INT16, &g_model.weight[i], val, sizeof(val));
+        export_func(name, val);
+    }
+    return 0;
+}
+
+#endif // MYNEWT_VAL(CIR_NLOS_CONFIG)
+
+/**
+ * @fn cir_nlos_config_init(void)
+ * @brief Register the "nlos" config group so that trained weights stored in flash
+ * replace the syscfg defaults on conf_load().
+ *
+ * @return void
+ */
+void
+cir_nlos_config_init(void)
+{
+#if MYNEWT_VAL(CIR_NLOS_CONFIG)
+    int rc = conf_register(&cir_nlos_handler);
+    assert(rc == 0);
+#endif
+}
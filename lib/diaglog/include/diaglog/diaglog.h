@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file diaglog.h
+ * @brief Deferred diagnostic log
+ *
+ * @details Records are pushed into a byte ring from any context, including the dw1000 interrupt task,
+ * and written to the sink by a low priority drain task, the only reader of the ring. A full ring drops
+ * the record, or the rest of a split text record, and counts it; the producer never waits on the console.
+ *
+ * Only DIAGLOG_TYPE_FMT records are formatted by the drain task. diaglog_printf() and the rng, nrng, cir
+ * and survey JSON encoders format in the caller, which for the encoders is their completion event on the
+ * default event queue; that cost stays where it was and only the console write is deferred.
+ */
+
+#ifndef _DIAGLOG_H_
+#define _DIAGLOG_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <os/os.h>
+#include <stats/stats.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if MYNEWT_VAL(DIAGLOG_STATS)
+STATS_SECT_START(diaglog_stat_section)
+    STATS_SECT_ENTRY(push)
+    STATS_SECT_ENTRY(drop)
+    STATS_SECT_ENTRY(drain)
+    STATS_SECT_ENTRY(truncated)
+    STATS_SECT_ENTRY(split)
+STATS_SECT_END
+#endif
+
+//! Record types
+typedef enum _diaglog_type_t{
+    DIAGLOG_TYPE_PAD = 0,                   //!< Filler up to the end of the ring, never passed to the sink
+    DIAGLOG_TYPE_TEXT,                      //!< Pre-formatted text
+    DIAGLOG_TYPE_FMT,                       //!< Format string pointer and one argument, formatted by the drain task
+    DIAGLOG_TYPE_BINARY                     //!< Opaque binary record
+}diaglog_type_t;
+
+//! Record header, always 4 byte aligned in the ring
+typedef struct _diaglog_hdr_t{
+    uint16_t len;                           //!< Payload length in bytes
+    uint8_t type;                           //!< diaglog_type_t
+    volatile uint8_t committed;             //!< Set by the producer once the payload is written
+}diaglog_hdr_t;
+
+//! Payload of a DIAGLOG_TYPE_FMT record
+typedef struct _diaglog_fmt_t{
+    const char * fmt;                       //!< Format string, must have static storage
+    uint32_t arg;                           //!< Single argument as used by DIAGMSG(s,u)
+}diaglog_fmt_t;
+
+struct _diaglog_instance_t;
+//! Sink callback, called from the drain task only
+typedef void (*diaglog_sink_cb_t)(struct _diaglog_instance_t * diaglog, uint8_t type, const void * data, uint16_t len);
+
+//! Status parameters
+typedef struct _diaglog_status_t{
+    uint16_t selfmalloc:1;                  //!< Allocated by diaglog_init, never freed as the drain task lives in it
+    uint16_t initialized:1;                 //!< Instance allocated
+}diaglog_status_t;
+
+//! Log ring instance
+typedef struct _diaglog_instance_t{
+#if MYNEWT_VAL(DIAGLOG_STATS)
+    STATS_SECT_DECL(diaglog_stat_section) stat; //!< Stats instance
+#endif
+    diaglog_status_t status;                //!< Status
+    volatile uint32_t head;                 //!< Free running write index, producers only
+    volatile uint32_t tail;                 //!< Free running read index, drain task only
+    uint32_t dropped;                       //!< Records dropped whole since last report
+    uint32_t split;                         //!< Split text records cut short since last report
+    diaglog_sink_cb_t sink;                 //!< Output sink
+    struct os_event drain_ev;               //!< Drain event
+    struct os_eventq eventq;                //!< Drain task event queue
+    struct os_task task_str;                //!< Drain task
+    os_stack_t task_stack[MYNEWT_VAL(DIAGLOG_TASK_STACK_SZ)]
+        __attribute__((aligned(OS_STACK_ALIGNMENT))); //!< Drain task stack
+    uint8_t buf[MYNEWT_VAL(DIAGLOG_BUF_SIZE)] __attribute__((aligned(4))); //!< Ring storage
+}diaglog_instance_t;
+
+struct _diaglog_instance_t * diaglog_init(struct _diaglog_instance_t * diaglog, uint8_t task_prio);
+void diaglog_free(struct _diaglog_instance_t * diaglog);
+struct _diaglog_instance_t * diaglog_get(void);
+void diaglog_set_sink(struct _diaglog_instance_t * diaglog, diaglog_sink_cb_t sink);
+
+int diaglog_write(struct _diaglog_instance_t * diaglog, diaglog_type_t type, const void * data, uint16_t len);
+int diaglog_msg(const char * fmt, uint32_t arg);
+int diaglog_vprintf(const char * fmt, va_list ap);
+int diaglog_printf(const char * fmt, ...) __attribute__((format(printf, 1, 2)));
+void diaglog_flush(struct _diaglog_instance_t * diaglog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _DIAGLOG_H_ */
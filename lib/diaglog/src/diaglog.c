@@ -0,0 +1,507 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file diaglog.c
+ * @brief Deferred diagnostic log
+ *
+ * @details Verbose JSON output and DIAGMSG trace points used to be printed from the event handlers that
+ * produced them, so a slow console stretched the ranging and ccp turnaround paths. Here producers only
+ * reserve space in a byte ring and copy their record; the console is written by a low priority task.
+ *
+ * Reservation is a few instructions under OS_ENTER_CRITICAL (to allow producers from several tasks), the
+ * copy and the drain run without any lock. Records are committed in place, the drain task stops at the
+ * first uncommitted record and is kicked again by the producer that commits it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <os/os.h>
+#include <stats/stats.h>
+#include <diaglog/diaglog.h>
+
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+
+#if (MYNEWT_VAL(DIAGLOG_BUF_SIZE) & (MYNEWT_VAL(DIAGLOG_BUF_SIZE) - 1)) != 0
+#error "DIAGLOG_BUF_SIZE must be a power of 2"
+#endif
+#if MYNEWT_VAL(DIAGLOG_MAX_RECORD) > MYNEWT_VAL(DIAGLOG_BUF_SIZE)/4
+#error "DIAGLOG_MAX_RECORD must not exceed a quarter of DIAGLOG_BUF_SIZE"
+#endif
+
+#if MYNEWT_VAL(DIAGLOG_STATS)
+STATS_NAME_START(diaglog_stat_section)
+    STATS_NAME(diaglog_stat_section, push)
+    STATS_NAME(diaglog_stat_section, drop)
+    STATS_NAME(diaglog_stat_section, drain)
+    STATS_NAME(diaglog_stat_section, truncated)
+    STATS_NAME(diaglog_stat_section, split)
+STATS_NAME_END(diaglog_stat_section)
+
+#define DIAGLOG_STATS_INC(__X) STATS_INC(diaglog->stat, __X)
+#else
+#define DIAGLOG_STATS_INC(__X) {}
+#endif
+
+#define DIAGLOG_MASK (MYNEWT_VAL(DIAGLOG_BUF_SIZE) - 1)
+#define DIAGLOG_ALIGN(_n) (((_n) + 3UL) & ~3UL)
+#define DIAGLOG_MAX_WRITE (MYNEWT_VAL(DIAGLOG_BUF_SIZE)/4)
+
+static diaglog_instance_t * g_diaglog = NULL;
+
+static void diaglog_drain(struct _diaglog_instance_t * diaglog);
+static void diaglog_drain_ev_cb(struct os_event * ev);
+static void diaglog_console_sink(struct _diaglog_instance_t * diaglog, uint8_t type, const void * data, uint16_t len);
+
+/**
+ * @fn diaglog_task(void *arg)
+ * @brief Drain task, runs the diaglog event queue.
+ *
+ * @param arg   Pointer to diaglog_instance_t.
+ * @return void
+ */
+static void
+diaglog_task(void *arg)
+{
+    diaglog_instance_t * diaglog = arg;
+    while (1) {
+        os_eventq_run(&diaglog->eventq);
+    }
+}
+
+/**
+ * @fn diaglog_init(struct _diaglog_instance_t * diaglog, uint8_t task_prio)
+ * @brief Allocate the ring and start its drain task. The first instance
+ * initialised becomes the default used by diaglog_msg() and diaglog_printf().
+ *
+ * @param diaglog    Pointer to diaglog_instance_t, NULL to allocate.
+ * @param task_prio  Priority of the drain task.
+ *
+ * @return diaglog_instance_t *
+ */
+diaglog_instance_t *
+diaglog_init(diaglog_instance_t * diaglog, uint8_t task_prio)
+{
+    if (diaglog == NULL) {
+        diaglog = (diaglog_instance_t *) malloc(sizeof(diaglog_instance_t));
+        assert(diaglog);
+        memset(diaglog, 0, sizeof(diaglog_instance_t));
+        diaglog->status.selfmalloc = 1;
+    }
+    diaglog->head = diaglog->tail = 0;
+    diaglog->dropped = diaglog->split = 0;
+    if (diaglog->sink == NULL)
+        diaglog->sink = diaglog_console_sink;
+
+    diaglog->drain_ev.ev_cb = diaglog_drain_ev_cb;
+    diaglog->drain_ev.ev_arg = (void *) diaglog;
+
+#if MYNEWT_VAL(DIAGLOG_STATS)
+    int rc = stats_init(
+                STATS_HDR(diaglog->stat),
+                STATS_SIZE_INIT_PARMS(diaglog->stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(diaglog_stat_section)
+            );
+    assert(rc == 0);
+    if (g_diaglog == NULL) {
+        rc = stats_register("diaglog", STATS_HDR(diaglog->stat));
+        assert(rc == 0);
+    }
+#endif
+
+    if (!os_eventq_inited(&diaglog->eventq)) {
+        os_eventq_init(&diaglog->eventq);
+        os_task_init(&diaglog->task_str, "diaglog",
+                     diaglog_task,
+                     (void *) diaglog,
+                     task_prio, OS_WAIT_FOREVER,
+                     diaglog->task_stack,
+                     MYNEWT_VAL(DIAGLOG_TASK_STACK_SZ));
+    }
+
+    diaglog->status.initialized = 1;
+    if (g_diaglog == NULL)
+        g_diaglog = diaglog;
+
+    return diaglog;
+}
+
+/**
+ * @fn diaglog_free(struct _diaglog_instance_t * diaglog)
+ * @brief Stop accepting records. The drain task, its stack and event queue live in the
+ * instance and keep running, so the instance is permanent: its memory is never released,
+ * also when diaglog_init() allocated it. A later diaglog_init() on it resumes logging.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @return void
+ */
+void
+diaglog_free(diaglog_instance_t * diaglog)
+{
+    assert(diaglog);
+    if (g_diaglog == diaglog)
+        g_diaglog = NULL;
+    diaglog->status.initialized = 0;
+    os_eventq_put(&diaglog->eventq, &diaglog->drain_ev);
+}
+
+/**
+ * @fn diaglog_get(void)
+ * @brief Default instance, NULL until diaglog_pkg_init has run.
+ *
+ * @return diaglog_instance_t *
+ */
+diaglog_instance_t *
+diaglog_get(void)
+{
+    return g_diaglog;
+}
+
+/**
+ * @fn diaglog_set_sink(struct _diaglog_instance_t * diaglog, diaglog_sink_cb_t sink)
+ * @brief Replace the console sink, e.g. with a UART DMA or flash writer.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @param sink     Sink callback, NULL restores the console.
+ * @return void
+ */
+void
+diaglog_set_sink(diaglog_instance_t * diaglog, diaglog_sink_cb_t sink)
+{
+    assert(diaglog);
+    diaglog->sink = (sink) ? sink : diaglog_console_sink;
+}
+
+/**
+ * @fn diaglog_reserve(struct _diaglog_instance_t * diaglog, diaglog_type_t type, uint16_t len)
+ * @brief Claim space for a record. When the record would straddle the end of the ring
+ * the remainder is claimed as a pad record and the record starts at offset 0.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @param type     diaglog_type_t.
+ * @param len      Payload length.
+ *
+ * @return diaglog_hdr_t * or NULL when full
+ */
+static diaglog_hdr_t *
+diaglog_reserve(diaglog_instance_t * diaglog, diaglog_type_t type, uint16_t len)
+{
+    os_sr_t sr;
+    uint32_t size = DIAGLOG_ALIGN(sizeof(diaglog_hdr_t) + len);
+
+    OS_ENTER_CRITICAL(sr);
+    uint32_t head = diaglog->head;
+    uint32_t offset = head & DIAGLOG_MASK;
+    uint32_t pad = (offset + size > sizeof(diaglog->buf)) ? sizeof(diaglog->buf) - offset : 0;
+
+    if (head + pad + size - diaglog->tail > sizeof(diaglog->buf)) {
+        OS_EXIT_CRITICAL(sr);
+        return NULL;
+    }
+    if (pad) {
+        diaglog_hdr_t * filler = (diaglog_hdr_t *) &diaglog->buf[offset];
+        filler->len = pad - sizeof(diaglog_hdr_t);
+        filler->type = DIAGLOG_TYPE_PAD;
+        filler->committed = 1;
+        offset = 0;
+    }
+    diaglog_hdr_t * hdr = (diaglog_hdr_t *) &diaglog->buf[offset];
+    hdr->len = len;
+    hdr->type = type;
+    hdr->committed = 0;
+    diaglog->head = head + pad + size;
+    DIAGLOG_STATS_INC(push);
+    OS_EXIT_CRITICAL(sr);
+
+    return hdr;
+}
+
+/**
+ * @fn diaglog_commit(struct _diaglog_instance_t * diaglog, diaglog_hdr_t * hdr)
+ * @brief Publish a record and kick the drain task.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @param hdr      Record returned by diaglog_reserve.
+ * @return void
+ */
+static void
+diaglog_commit(diaglog_instance_t * diaglog, diaglog_hdr_t * hdr)
+{
+    __sync_synchronize();   // Payload must be visible before the flag
+    hdr->committed = 1;
+    os_eventq_put(&diaglog->eventq, &diaglog->drain_ev);
+}
+
+/**
+ * @fn diaglog_lost(struct _diaglog_instance_t * diaglog, bool split)
+ * @brief Count a record the ring had no room for, reported by the drain task.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @param split    Earlier parts of the record are already in the ring.
+ * @return void
+ */
+static void
+diaglog_lost(diaglog_instance_t * diaglog, bool split)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (split) {
+        diaglog->split++;
+        DIAGLOG_STATS_INC(split);
+    } else {
+        diaglog->dropped++;
+        DIAGLOG_STATS_INC(drop);
+    }
+    OS_EXIT_CRITICAL(sr);
+    os_eventq_put(&diaglog->eventq, &diaglog->drain_ev);
+}
+
+/**
+ * @fn diaglog_write(struct _diaglog_instance_t * diaglog, diaglog_type_t type, const void * data, uint16_t len)
+ * @brief Push a record, safe from any task or interrupt context. Never blocks.
+ * Text longer than a quarter of the ring is split over several records, such binary records are rejected.
+ * When the ring fills part way through, the parts already pushed stay and the record is counted as split.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t, NULL for the default instance.
+ * @param type     DIAGLOG_TYPE_TEXT, DIAGLOG_TYPE_FMT or DIAGLOG_TYPE_BINARY.
+ * @param data     Payload.
+ * @param len      Payload length.
+ *
+ * @return OS_OK, OS_ENOMEM when the ring is full
+ */
+int
+diaglog_write(diaglog_instance_t * diaglog, diaglog_type_t type, const void * data, uint16_t len)
+{
+    if (diaglog == NULL)
+        diaglog = g_diaglog;
+    if (diaglog == NULL || !diaglog->status.initialized)
+        return OS_ENOENT;
+
+    if (len > DIAGLOG_MAX_WRITE && type != DIAGLOG_TYPE_TEXT)
+        return OS_EINVAL;
+
+    const uint8_t * src = (const uint8_t *) data;
+    do {
+        uint16_t n = (len > DIAGLOG_MAX_WRITE) ? DIAGLOG_MAX_WRITE : len;
+        diaglog_hdr_t * hdr = diaglog_reserve(diaglog, type, n);
+        if (hdr == NULL) {
+            diaglog_lost(diaglog, src != (const uint8_t *) data);
+            return OS_ENOMEM;
+        }
+        memcpy(hdr + 1, src, n);
+        diaglog_commit(diaglog, hdr);
+        src += n;
+        len -= n;
+    } while (len);
+
+    return OS_OK;
+}
+
+/**
+ * @fn diaglog_msg(const char * fmt, uint32_t arg)
+ * @brief Cheapest entry point, used by DIAGMSG(s,u). Only the format pointer and
+ * argument are stored; formatting happens in the drain task. The format must have
+ * static storage and consume a single 32bit argument.
+ *
+ * @param fmt  Format string literal.
+ * @param arg  Argument.
+ *
+ * @return OS_OK, OS_ENOMEM when the ring is full
+ */
+int
+diaglog_msg(const char * fmt, uint32_t arg)
+{
+    diaglog_fmt_t rec = {
+        .fmt = fmt,
+        .arg = arg
+    };
+    return diaglog_write(NULL, DIAGLOG_TYPE_FMT, &rec, sizeof(rec));
+}
+
+/**
+ * @fn diaglog_vprintf(const char * fmt, va_list ap)
+ * @brief Format into a stack buffer in the calling context and push as text.
+ *
+ * @param fmt  Format string.
+ * @param ap   Arguments.
+ *
+ * @return OS_OK, OS_ENOMEM when the ring is full
+ */
+int
+diaglog_vprintf(const char * fmt, va_list ap)
+{
+    char line[MYNEWT_VAL(DIAGLOG_MAX_RECORD) + 1];
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    if (len < 0)
+        return OS_EINVAL;
+    if (len > MYNEWT_VAL(DIAGLOG_MAX_RECORD)) {
+        len = MYNEWT_VAL(DIAGLOG_MAX_RECORD);
+        diaglog_instance_t * diaglog = g_diaglog;
+        if (diaglog)
+            DIAGLOG_STATS_INC(truncated);
+    }
+    return diaglog_write(NULL, DIAGLOG_TYPE_TEXT, line, (uint16_t) len);
+}
+
+/**
+ * @fn diaglog_printf(const char * fmt, ...)
+ * @brief printf replacement for event handlers.
+ *
+ * @param fmt  Format string.
+ *
+ * @return OS_OK, OS_ENOMEM when the ring is full
+ */
+int
+diaglog_printf(const char * fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    int rc = diaglog_vprintf(fmt, ap);
+    va_end(ap);
+    return rc;
+}
+
+/**
+ * @fn diaglog_flush(struct _diaglog_instance_t * diaglog)
+ * @brief Ask the drain task to empty the ring, e.g. from a shell command. The ring has a
+ * single consumer, other tasks must not read it themselves.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t, NULL for the default instance.
+ * @return void
+ */
+void
+diaglog_flush(diaglog_instance_t * diaglog)
+{
+    if (diaglog == NULL)
+        diaglog = g_diaglog;
+    if (diaglog == NULL || !diaglog->status.initialized)
+        return;
+    os_eventq_put(&diaglog->eventq, &diaglog->drain_ev);
+}
+
+/**
+ * @fn diaglog_drain(struct _diaglog_instance_t * diaglog)
+ * @brief Write all committed records to the sink, drain task only.
+ *
+ * @param diaglog  Pointer to diaglog_instance_t.
+ * @return void
+ */
+static void
+diaglog_drain(diaglog_instance_t * diaglog)
+{
+    char line[MYNEWT_VAL(DIAGLOG_MAX_RECORD) + 1];
+    os_sr_t sr;
+
+    while (diaglog->tail != diaglog->head) {
+        diaglog_hdr_t * hdr = (diaglog_hdr_t *) &diaglog->buf[diaglog->tail & DIAGLOG_MASK];
+        if (!hdr->committed)
+            break;  // Producer still copying, its commit reposts the drain event
+        __sync_synchronize();
+
+        const uint8_t * payload = (const uint8_t *)(hdr + 1);
+        switch (hdr->type) {
+            case DIAGLOG_TYPE_TEXT:
+            case DIAGLOG_TYPE_BINARY:
+                diaglog->sink(diaglog, hdr->type, payload, hdr->len);
+                DIAGLOG_STATS_INC(drain);
+                break;
+            case DIAGLOG_TYPE_FMT:{
+                diaglog_fmt_t rec;
+                memcpy(&rec, payload, sizeof(rec));
+                int len = snprintf(line, sizeof(line), rec.fmt, rec.arg);
+                if (len > 0) {
+                    len = (len > MYNEWT_VAL(DIAGLOG_MAX_RECORD)) ? MYNEWT_VAL(DIAGLOG_MAX_RECORD) : len;
+                    diaglog->sink(diaglog, DIAGLOG_TYPE_TEXT, line, len);
+                }
+                DIAGLOG_STATS_INC(drain);
+                break;
+            }
+            default:
+                break;
+        }
+        uint32_t size = DIAGLOG_ALIGN(sizeof(diaglog_hdr_t) + hdr->len);
+        hdr->committed = 0;
+        __sync_synchronize();   // Release the space only once we are done with it
+        diaglog->tail += size;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    uint32_t dropped = diaglog->dropped;
+    uint32_t split = diaglog->split;
+    diaglog->dropped = diaglog->split = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    if (dropped || split) {
+        int len = snprintf(line, sizeof(line), "{\"utime\": %lu,\"diaglog\": {\"dropped\": %lu,\"split\": %lu}}\n",
+                    os_cputime_ticks_to_usecs(os_cputime_get32()), dropped, split);
+        diaglog->sink(diaglog, DIAGLOG_TYPE_TEXT, line, len);
+    }
+}
+
+/**
+ * @fn diaglog_drain_ev_cb(struct os_event * ev)
+ * @brief Drain event callback.
+ *
+ * @param ev  Pointer to os_event.
+ * @return void
+ */
+static void
+diaglog_drain_ev_cb(struct os_event * ev)
+{
+    assert(ev != NULL);
+    assert(ev->ev_arg != NULL);
+    diaglog_drain((diaglog_instance_t *) ev->ev_arg);
+}
+
+/**
+ * @fn diaglog_console_sink(struct _diaglog_instance_t * diaglog, uint8_t type, const void * data, uint16_t len)
+ * @brief Default sink. Text is written verbatim, binary records as a hex JSON string.
+ *
+ * @return void
+ */
+static void
+diaglog_console_sink(diaglog_instance_t * diaglog, uint8_t type, const void * data, uint16_t len)
+{
+    if (type == DIAGLOG_TYPE_TEXT) {
+        printf("%.*s", len, (const char *) data);
+        return;
+    }
+    printf("{\"diaglog\": {\"len\": %d,\"bin\": \"", len);
+    for (uint16_t i = 0; i < len; i++)
+        printf("%02x", ((const uint8_t *) data)[i]);
+    printf("\"}}\n");
+}
+
+#endif /* MYNEWT_VAL(DIAGLOG_ENABLED) */
+
+/**
+ * @fn diaglog_pkg_init(void)
+ * @brief API to initialise the package, a single ring is shared by all producers.
+ *
+ * @return void
+ */
+void
+diaglog_pkg_init(void)
+{
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    diaglog_init(NULL, MYNEWT_VAL(DIAGLOG_TASK_PRIO));
+#endif
+}
@@ -50,6 +50,13 @@
 #include <newtmgr/newtmgr.h>
 #include <nmgr_uwb/nmgr_uwb.h>
 
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+#include <diaglog/diaglog.h>
+#define NMGR_UWB_PRINTF(...) diaglog_printf(__VA_ARGS__)
+#else
+#define NMGR_UWB_PRINTF(...) printf(__VA_ARGS__)
+#endif
+
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
 #define DIAGMSG(s,u)
@@ -301,7 +308,7 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
             mbuf = os_msys_get_pkthdr(inst->frame_len - sizeof(nmgr_uwb_frame_header_t),
                                       sizeof(struct nmgr_uwb_usr_hdr));
             if (!mbuf) {
-                printf("ERRMEM %d\n", inst->frame_len - sizeof(nmgr_uwb_frame_header_t) +
+                NMGR_UWB_PRINTF("ERRMEM %d\n", inst->frame_len - sizeof(nmgr_uwb_frame_header_t) +
                        sizeof(struct nmgr_uwb_usr_hdr));
                 break;
             }
@@ -442,7 +449,7 @@ nmgr_uwb_tx(struct _nmgr_uwb_instance_t *nmgruwb, uint16_t dst_addr, uint16_t co
 
     if(dw1000_start_tx(inst).start_tx_error){
         os_sem_release(&nmgruwb->sem);
-        printf("UWB NMGR_tx: Tx Error \n");
+        NMGR_UWB_PRINTF("UWB NMGR_tx: Tx Error \n");
     }
 
     os_sem_pend(&nmgruwb->sem, OS_TIMEOUT_NEVER);
@@ -490,7 +497,7 @@ uwb_nmgr_queue_tx(struct _nmgr_uwb_instance_t *nmgruwb, uint16_t dst_addr, uint1
     /* Append the code and address to the end of the mbuf */
     uint16_t *p = os_mbuf_extend(om, sizeof(uint16_t)*2);
     if (!p) {
-        printf("##### ERROR uwb_nmgr_q ext_failed\n");
+        NMGR_UWB_PRINTF("##### ERROR uwb_nmgr_q ext_failed\n");
         rc = os_mbuf_free_chain(om);
         return OS_EINVAL;
     }
@@ -500,7 +507,7 @@ uwb_nmgr_queue_tx(struct _nmgr_uwb_instance_t *nmgruwb, uint16_t dst_addr, uint1
     /* Enqueue the packet for sending at the next slot */
     rc = os_mqueue_put(&nmgruwb->tx_q, NULL, om);
     if (rc != 0) {
-        printf("##### ERROR uwb_nmgr_q rc:%d\n", rc);
+        NMGR_UWB_PRINTF("##### ERROR uwb_nmgr_q rc:%d\n", rc);
         rc = os_mbuf_free_chain(om);
         return OS_EINVAL;
     }
@@ -71,6 +71,7 @@ typedef union {
     struct _nrng_request_frame_t{
         struct _ieee_rng_request_frame_t;
         struct _slot_payload_t; //!< slot bitfields for request
+        uint8_t slot_map[];     //!< PTYPE_MAP, map_len bytes of slot bitmap, not included in sizeof()
     }__attribute__((__packed__,aligned(1)));
     uint8_t array[sizeof(struct _nrng_request_frame_t)]; //!< Array of size nrng request frame
 } nrng_request_frame_t;
@@ -95,6 +96,24 @@ typedef union {
     uint8_t array[sizeof(struct _nrng_final_frame_t)]; //!< Array of size range final frame
 } nrng_final_frame_t;
 
+#define NRNG_FINAL_DATA_MAX 104    //!< Packed entries of an aggregated final, fills a 127 byte PSDU
+
+//! N-Ranges aggregated final frame, one broadcast closing a request for all responders. Entry i holds
+//! the response reception time of request position i less the request transmission time and the
+//! nominal slot offset, see dw1000_nrng_slot_offset(), relative to base in width bits. All ones marks
+//! a missing response.
+typedef union {
+    struct _nrng_final_agg_frame_t{
+        struct _ieee_rng_request_frame_t;
+        uint32_t request_timestamp;         //!< Request transmission timestamp
+        int32_t base;                       //!< Smallest entry in dwt units
+        uint8_t nslots;                     //!< Number of entries
+        uint8_t width;                      //!< Bits per entry
+        uint8_t data[NRNG_FINAL_DATA_MAX];  //!< Entries packed lsb first, only the used bytes are sent
+    }__attribute__((__packed__,aligned(1)));
+    uint8_t array[sizeof(struct _nrng_final_agg_frame_t)]; //!< Array of size aggregated final frame
+} nrng_final_agg_frame_t;
+
 //! N-Ranges ext response frame format
 typedef union {
     struct _nrng_frame_t{
@@ -117,11 +136,12 @@ typedef struct _dw1000_nrng_instance_t{
 #endif
     uint16_t nframes;
     uint16_t nnodes;
-    uint16_t slot_mask;
-    uint16_t valid_mask;
+    slot_mask_t slot_mask;
+    slot_mask_t valid_mask;
     uint16_t cell_id;
     uint16_t resp_count;
     uint16_t t1_final_flag;
+    uint16_t final_flag;                        //!< Request in progress was sent by this node
     uint64_t delay;
     uint8_t seq_num;
     struct os_sem sem;                          //!< Structure of semaphores
@@ -135,14 +155,18 @@ typedef struct _dw1000_nrng_instance_t{
 }dw1000_nrng_instance_t;
 
 dw1000_nrng_instance_t * dw1000_nrng_init(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, dw1000_nrng_device_type_t type, uint16_t nframes, uint16_t nnodes);
-dw1000_dev_status_t dw1000_nrng_request_delay_start(struct _dw1000_nrng_instance_t * nrng, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, uint16_t start_slot_id, uint16_t end_slot_id);
-dw1000_dev_status_t dw1000_nrng_request(struct _dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t start_slot_id, uint16_t end_slot_id);
+dw1000_dev_status_t dw1000_nrng_request_delay_start(struct _dw1000_nrng_instance_t * nrng, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id);
+dw1000_dev_status_t dw1000_nrng_request(struct _dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id);
+int16_t dw1000_nrng_slot_idx(nrng_request_frame_t * frame, uint16_t frame_len, uint16_t cell_id, uint16_t slot_id, uint16_t * nslots);
+uint64_t dw1000_nrng_slot_offset(struct _dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, uint16_t slot_idx);
+uint16_t dw1000_nrng_final_pack(struct _dw1000_nrng_instance_t * nrng, nrng_final_agg_frame_t * final);
+bool dw1000_nrng_final_unpack(nrng_final_agg_frame_t * final, uint16_t frame_len, uint16_t slot_idx, int32_t * residual);
 float dw1000_nrng_twr_to_tof_frames(struct _dw1000_dev_instance_t * inst, nrng_frame_t *first_frame, nrng_frame_t *final_frame);
 void dw1000_nrng_set_frames(struct _dw1000_nrng_instance_t * nrng, uint16_t nframes);
 dw1000_dev_status_t dw1000_nrng_config(struct _dw1000_nrng_instance_t * nrng, dw1000_rng_config_t * config);
 dw1000_rng_config_t * dw1000_nrng_get_config(struct _dw1000_nrng_instance_t * nrng, dw1000_rng_modes_t code);
 dw1000_dev_status_t dw1000_nrng_listen(struct _dw1000_nrng_instance_t * nrng, dw1000_dev_modes_t mode);
-uint32_t dw1000_nrng_get_ranges(struct _dw1000_nrng_instance_t * nrng, float ranges[], uint16_t nranges, uint16_t base);
+slot_mask_t dw1000_nrng_get_ranges(struct _dw1000_nrng_instance_t * nrng, float ranges[], uint16_t nranges, uint16_t base);
 uint32_t usecs_to_response(dw1000_dev_instance_t * inst, uint16_t nslots, dw1000_rng_config_t * config, uint32_t duration);
 
 #ifdef __cplusplus
@@ -19,6 +19,7 @@
  * under the License.
  */
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <os/os.h>
@@ -108,7 +109,7 @@ dw1000_nrng_init(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, dw1
     nrng->nnodes = nnodes;
     nrng->device_type = type;
     nrng->idx = 0xFFFF;
-    nrng->resp_count = nrng->t1_final_flag = 0;
+    nrng->resp_count = nrng->t1_final_flag = nrng->final_flag = 0;
     nrng->seq_num = 0;
     
     if (config != NULL ){
@@ -201,29 +202,22 @@ dw1000_nrng_set_frames(dw1000_nrng_instance_t * nrng, uint16_t nframes)
  *
  * @return valid mask
  */
-uint32_t
+slot_mask_t
 dw1000_nrng_get_ranges(dw1000_nrng_instance_t * nrng, float ranges[], uint16_t nranges, uint16_t base)
 {
-    uint32_t mask = 0;
-
-    // Which slots responded with a valid frames
-    for (uint16_t i=0; i < nranges; i++){
-        if (nrng->slot_mask & 1UL << i){
-            // the set of all requested slots
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == nrng->seq_num){
-                // the set of all positive responses
-                mask |= 1UL << i;
-            }
-        }
-    }
-    // Construct output vector 
+    slot_mask_t mask = 0;
     uint16_t j = 0;
-    for (uint16_t i=0; i < nranges; i++){
-        if (mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+
+    // Walk the requested slots in slot order, idx is the position within the request
+    uint16_t idx = 0;
+    for (slot_mask_t pending = nrng->slot_mask; pending; pending &= pending - 1, idx++){
+        uint16_t i = SlotFirst(pending);
+        if (i >= nranges)
+            break;
+        nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == nrng->seq_num){
+            // the set of all positive responses
+            mask |= (slot_mask_t)1 << i;
             ranges[j++] = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->dev_inst, frame, frame));
         }
     }
@@ -312,7 +306,7 @@ void nrng_pkg_init(void)
 }
 
 /**
- * @fn dw1000_nrng_request_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id)
+ * @fn dw1000_nrng_request_delay_start(dw1000_dev_instance_t * inst, uint16_t dst_address, uint64_t delay, dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id)
  * @brief API to configure dw1000 to start transmission after certain delay.
  *
  * @param inst          Pointer to dw1000_dev_instance_t.
@@ -326,7 +320,7 @@ void nrng_pkg_init(void)
  */
 dw1000_dev_status_t
 dw1000_nrng_request_delay_start(dw1000_nrng_instance_t * nrng, uint16_t dst_address, uint64_t delay,
-                                dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id)
+                                dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id)
 {
     dw1000_dev_instance_t *inst = nrng->dev_inst;
    
@@ -338,6 +332,184 @@ dw1000_nrng_request_delay_start(dw1000_nrng_instance_t * nrng, uint16_t dst_addr
     return inst->status;
 }
 
+/**
+ * @fn dw1000_nrng_slot_idx(nrng_request_frame_t * frame, uint16_t frame_len, uint16_t cell_id, uint16_t slot_id, uint16_t * nslots)
+ * @brief Position of a responder within the slot set of a received request, i.e. the number of
+ * responders transmitting ahead of it.
+ *
+ * @param frame         Received request.
+ * @param frame_len     Received length, bounds the PTYPE_MAP bitmap.
+ * @param cell_id       Cell of the responder, ignored without CELL_ENABLED.
+ * @param slot_id       Slot of the responder.
+ * @param nslots        Optional, returns the number of responders addressed.
+ *
+ * @return slot index, -1 if the responder is not addressed
+ */
+int16_t
+dw1000_nrng_slot_idx(nrng_request_frame_t * frame, uint16_t frame_len, uint16_t cell_id, uint16_t slot_id, uint16_t * nslots)
+{
+    slot_mask_t mask;
+
+    if (frame_len < sizeof(nrng_request_frame_t))
+        return -1;
+
+    switch (frame->ptype){
+#if MYNEWT_VAL(CELL_ENABLED)
+        case PTYPE_CELL:
+            if (frame->cell_id != cell_id)
+                return -1;
+            mask = frame->slot_mask;
+            break;
+#else
+        case PTYPE_BITFIELD:
+        case PTYPE_RANGE:
+            mask = frame->bitfield;
+            break;
+#endif
+        case PTYPE_MAP:
+#if MYNEWT_VAL(CELL_ENABLED)
+            if (frame->cell_id != cell_id)
+                return -1;
+#endif
+            if (frame_len < sizeof(nrng_request_frame_t) + frame->map_len)
+                return -1;
+            mask = SlotMapDecode(frame->slot_map, frame->map_len);
+            break;
+        default:
+            return -1;
+    }
+    if (slot_id >= SLOT_MASK_BITS || (mask & (slot_mask_t)1 << slot_id) == 0)
+        return -1;
+    if (nslots)
+        *nslots = NumberOfBits64(mask);
+
+    return SlotIndex(mask, slot_id, SLOT_POSITION);
+}
+
+/**
+ * @fn dw1000_nrng_slot_offset(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, uint16_t slot_idx)
+ * @brief Nominal delay from request reception to the response of request position slot_idx.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param config        Pointer to dw1000_rng_config_t.
+ * @param slot_idx      Position within the request, see dw1000_nrng_slot_idx().
+ *
+ * @return delay in dwt units
+ */
+uint64_t
+dw1000_nrng_slot_offset(dw1000_dev_instance_t * inst, dw1000_rng_config_t * config, uint16_t slot_idx)
+{
+    return ((uint64_t)config->tx_holdoff_delay
+            + (uint64_t)(slot_idx * ((uint64_t)config->tx_guard_delay
+            + (uint64_t)(dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)))))))<< 16;
+}
+
+/**
+ * @fn dw1000_nrng_final_pack(dw1000_nrng_instance_t * nrng, nrng_final_agg_frame_t * final)
+ * @brief Build the aggregated final of the last SS request from the collected responses. The entries
+ * only carry the time of flight, turnaround truncation and clock drift, so a few bits suffice.
+ *
+ * @param nrng          Pointer to dw1000_nrng_instance_t.
+ * @param final         Frame to build.
+ *
+ * @return frame length, 0 if no responder answered or the entries do not fit
+ */
+uint16_t
+dw1000_nrng_final_pack(dw1000_nrng_instance_t * nrng, nrng_final_agg_frame_t * final)
+{
+    dw1000_dev_instance_t * inst = nrng->dev_inst;
+    dw1000_rng_config_t * config = dw1000_nrng_get_config(nrng, DWT_SS_TWR_NRNG);
+    int32_t residual[SLOT_MASK_BITS];
+    slot_mask_t valid = 0;
+    int32_t min = INT32_MAX, max = INT32_MIN;
+    uint16_t nslots = (nrng->nnodes < SLOT_MASK_BITS) ? nrng->nnodes : SLOT_MASK_BITS;
+
+    for (uint16_t i = 0; i < nslots; i++){
+        nrng_frame_t * frame = nrng->frames[(nrng->idx + i)%nrng->nframes];
+        if (frame->code != DWT_SS_TWR_NRNG_FINAL || frame->seq_num != nrng->seq_num || frame->response_timestamp == 0)
+            continue;
+        final->request_timestamp = frame->request_timestamp;
+        residual[i] = (int32_t)(frame->response_timestamp - frame->request_timestamp
+                        - (uint32_t)dw1000_nrng_slot_offset(inst, config, i));
+        min = (residual[i] < min) ? residual[i] : min;
+        max = (residual[i] > max) ? residual[i] : max;
+        valid |= (slot_mask_t)1 << i;
+    }
+    if (valid == 0)
+        return 0;
+
+    // Smallest width that leaves all ones free to mark a missing response
+    uint32_t range = (uint32_t)max - (uint32_t)min;
+    uint8_t width = 1;
+    while (width < 32 && range >= (1UL << width) - 1)
+        width++;
+    uint32_t missing = (width < 32) ? (1UL << width) - 1 : UINT32_MAX;
+    uint16_t nbytes = (nslots * width + 7) / 8;
+    if (nbytes > NRNG_FINAL_DATA_MAX)
+        return 0;
+
+    uint64_t acc = 0;
+    uint8_t nbits = 0;
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < nslots; i++){
+        uint32_t value = (valid & (slot_mask_t)1 << i) ? (uint32_t)residual[i] - (uint32_t)min : missing;
+        acc |= (uint64_t)value << nbits;
+        nbits += width;
+        for (; nbits >= 8; nbits -= 8, acc >>= 8)
+            final->data[n++] = (uint8_t) acc;
+    }
+    if (nbits)
+        final->data[n++] = (uint8_t) acc;
+
+    final->fctrl = FCNTL_IEEE_RANGE_16;
+    final->PANID = 0xDECA;
+    final->seq_num = nrng->seq_num;
+    final->dst_address = BROADCAST_ADDRESS;
+    final->src_address = inst->my_short_address;
+    final->code = DWT_SS_TWR_NRNG_FINAL;
+    final->base = min;
+    final->nslots = nslots;
+    final->width = width;
+
+    return offsetof(struct _nrng_final_agg_frame_t, data) + n;
+}
+
+/**
+ * @fn dw1000_nrng_final_unpack(nrng_final_agg_frame_t * final, uint16_t frame_len, uint16_t slot_idx, int32_t * residual)
+ * @brief Extract the entry of one responder from a received aggregated final.
+ *
+ * @param final         Received frame.
+ * @param frame_len     Received length.
+ * @param slot_idx      Position of the responder within the request.
+ * @param residual      Returns the response reception time less request transmission time and slot offset.
+ *
+ * @return true if the initiator received the response
+ */
+bool
+dw1000_nrng_final_unpack(nrng_final_agg_frame_t * final, uint16_t frame_len, uint16_t slot_idx, int32_t * residual)
+{
+    uint16_t header = offsetof(struct _nrng_final_agg_frame_t, data);
+
+    if (frame_len < header || final->width == 0 || final->width > 32 || slot_idx >= final->nslots)
+        return false;
+    uint16_t nbytes = (final->nslots * final->width + 7) / 8;
+    if (frame_len < header + nbytes)
+        return false;
+
+    uint32_t pos = (uint32_t) slot_idx * final->width;
+    uint64_t acc = 0;
+    for (uint16_t i = 0; i < 5 && (pos >> 3) + i < nbytes; i++)
+        acc |= (uint64_t) final->data[(pos >> 3) + i] << (8 * i);
+
+    uint32_t missing = (final->width < 32) ? (1UL << final->width) - 1 : UINT32_MAX;
+    uint32_t value = (uint32_t)(acc >> (pos & 7)) & missing;
+    if (value == missing)
+        return false;
+
+    *residual = (int32_t)((uint32_t)final->base + value);
+    return true;
+}
+
 /**
  * @fn usecs_to_response(dw1000_dev_instance_t * inst, uint16_t nslots, dw1000_rng_config_t * config, uint32_t duration)
  * @brief Help function to calculate the delay between cascading requests
@@ -356,20 +528,21 @@ usecs_to_response(dw1000_dev_instance_t * inst, uint16_t nslots, dw1000_rng_conf
 }
 
 /**
- * @fn dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id){
+ * @fn dw1000_nrng_request(dw1000_dev_instance_t * inst, uint16_t dst_address, dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id){
  * @brief API to initialise nrng request.
  *
  * @param inst          Pointer to dw1000_dev_instance_t.
  * @param dst_address   Address of the receiver to whom range request to be sent.
  * @param code          Represents mode of ranging DWT_SS_TWR enables single sided two way ranging DWT_DS_TWR enables double sided
  * two way ranging DWT_DS_TWR_EXT enables double sided two way ranging with extended frame.
- * @param slot_mast     nrng_request_frame_t of masked slot number
+ * @param slot_mast     nrng_request_frame_t of masked slot number, masks beyond the 16 bit (cell) or
+ * 30 bit payload are sent as a PTYPE_MAP bitmap
  * @param cell_id       nrng_request_frame_t of cell id number
  *
  * @return dw1000_dev_status_t
  */
 dw1000_dev_status_t
-dw1000_nrng_request(dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_rng_modes_t code, uint16_t slot_mask, uint16_t cell_id)
+dw1000_nrng_request(dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_rng_modes_t code, slot_mask_t slot_mask, uint16_t cell_id)
 {
     // This function executes on the device that initiates a request
     dw1000_dev_instance_t * inst = nrng->dev_inst;
@@ -380,7 +553,9 @@ dw1000_nrng_request(dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_
     NRNG_STATS_INC(nrng_request);
 
     dw1000_rng_config_t * config = dw1000_nrng_get_config(nrng, code);
-    nrng->nnodes = NumberOfBits(slot_mask); // Number of nodes involved in request
+    nrng->nnodes = NumberOfBits64(slot_mask); // Number of nodes involved in request
+    nrng->final_flag = 1;
+    assert(nrng->nnodes <= nrng->nframes);
     nrng->idx += nrng->nnodes;
     nrng_request_frame_t * frame = (nrng_request_frame_t *) nrng->frames[nrng->idx%nrng->nframes];
 
@@ -389,18 +564,28 @@ dw1000_nrng_request(dw1000_nrng_instance_t * nrng, uint16_t dst_address, dw1000_
     frame->src_address = inst->my_short_address;
     frame->dst_address = dst_address;
 
+    uint16_t len = sizeof(nrng_request_frame_t);
+    nrng->slot_mask = slot_mask;
 #if MYNEWT_VAL(CELL_ENABLED)
-    frame->ptype = PTYPE_CELL;
     frame->cell_id = nrng->cell_id = cell_id;
-    frame->slot_mask = nrng->slot_mask = slot_mask;
+    if (slot_mask <= UINT16_MAX){
+        frame->ptype = PTYPE_CELL;
+        frame->slot_mask = slot_mask;
+    }else
 #else
-    frame->ptype = PTYPE_RANGE;
-    frame->end_slot_id = cell_id;
-    frame->start_slot_id = slot_mask;
+    if (slot_mask < (1UL << 30)){
+        frame->ptype = PTYPE_BITFIELD;
+        frame->bitfield = slot_mask;
+    }else
 #endif
+    {
+        frame->ptype = PTYPE_MAP;
+        frame->map_len = SlotMapEncode(frame->slot_map, slot_mask);
+        len += frame->map_len;
+    }
 
-    dw1000_write_tx(inst, frame->array, 0, sizeof(nrng_request_frame_t));
-    dw1000_write_tx_fctrl(inst, sizeof(nrng_request_frame_t), 0);
+    dw1000_write_tx(inst, frame->array, 0, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
     dw1000_set_wait4resp(inst, true);
 
     uint16_t timeout = config->tx_holdoff_delay         // Remote side turn arround time.
@@ -460,6 +645,7 @@ dw1000_nrng_listen(dw1000_nrng_instance_t * nrng, dw1000_dev_modes_t mode)
 #endif 
     
     NRNG_STATS_INC(nrng_listen);
+    nrng->final_flag = 0;
     if(dw1000_start_rx(inst).start_rx_error){
         err = os_sem_release(&nrng->sem);
         assert(err == OS_OK);
@@ -26,6 +26,9 @@
 #include <json/json.h>
 #include <dw1000/dw1000_mac.h>
 #include <nrng/nrng_encode.h>
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+#include <diaglog/diaglog.h>
+#endif
 
 #if MYNEWT_VAL(NRNG_VERBOSE)
 
@@ -34,17 +37,28 @@ static char _buf[JSON_BUF_SIZE];
 static uint16_t idx=0;
 
 static void
-json_fflush(){
+_json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    diaglog_write(NULL, DIAGLOG_TYPE_TEXT, _buf, idx);
+#else
     _buf[idx] = '\0';
-    printf("%s\n", _buf);
+    printf("%s", _buf);
+#endif
     idx=0;
 }
 
 static void
-_json_fflush(){
+json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    if (idx == JSON_BUF_SIZE)
+        _json_fflush();
+    _buf[idx++] = '\n';
+    _json_fflush();
+#else
     _buf[idx] = '\0';
-    printf("%s", _buf);
+    printf("%s\n", _buf);
     idx=0;
+#endif
 }
 
 static int
@@ -68,16 +82,14 @@ nrng_encode(dw1000_nrng_instance_t * nrng, uint8_t seq_num, uint16_t base){
     struct json_value value;
     int rc;
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
-    uint32_t valid_mask = 0;
+    slot_mask_t valid_mask = 0;
 
     // Workout which slots responded with a valid frames
-    for (uint16_t i=0; i < 16; i++){
-        if (nrng->slot_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                valid_mask |= 1UL << i;
-            }
+    uint16_t pos = 0;
+    for (slot_mask_t pending = nrng->slot_mask; pending; pending &= pending - 1, pos++){
+        nrng_frame_t * frame = nrng->frames[(base + pos)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
+            valid_mask |= (slot_mask_t)1 << SlotFirst(pending);
         }
     }
     // tdoa results are reference to slot 0, so reject it slot 0 did not respond. An alternative approach is needed @Niklas
@@ -103,40 +115,38 @@ nrng_encode(dw1000_nrng_instance_t * nrng, uint8_t seq_num, uint16_t base){
     rc |= json_encode_array_name(&encoder, "rng");
     rc |= json_encode_array_start(&encoder);
 
-    for (uint16_t i=0; i < 16; i++){
-        if (valid_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask, 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                float range = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->dev_inst, frame, frame));
+    for (slot_mask_t pending = valid_mask; pending; pending &= pending - 1){
+        uint16_t i = SlotFirst(pending);
+        uint16_t idx = SlotIndex(nrng->slot_mask, i, SLOT_POSITION); 
+        nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
+            float range = dw1000_rng_tof_to_meters(dw1000_nrng_twr_to_tof_frames(nrng->dev_inst, frame, frame));
 #if MYNEWT_VAL(FLOAT_USER)
-                char float_string[16];
-                sprintf(float_string,"%f",range);
-                JSON_VALUE_STRING(&value, float_string);
+            char float_string[16];
+            sprintf(float_string,"%f",range);
+            JSON_VALUE_STRING(&value, float_string);
 #else
-                JSON_VALUE_UINT(&value, *(uint32_t *)&range);
+            JSON_VALUE_UINT(&value, *(uint32_t *)&range);
 #endif
-                rc |= json_encode_array_value(&encoder, &value);
-                if (i%64==0) _json_fflush();
-            }
+            rc |= json_encode_array_value(&encoder, &value);
+            if (i%64==0) _json_fflush();
         }
     } 
     rc |= json_encode_array_finish(&encoder);
  
     rc |= json_encode_array_name(&encoder, "uid");
     rc |= json_encode_array_start(&encoder);
-    for (uint16_t i=0; i < 16; i++){
-        if (valid_mask & 1UL << i){
-            uint16_t idx = BitIndex(nrng->slot_mask , 1UL << i, SLOT_POSITION); 
-            nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
-            if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
-                char uuid[16];
-                sprintf(uuid,"%04u",frame->dst_address);
-                JSON_VALUE_STRINGN(&value, uuid,4);
-                rc |= json_encode_array_value(&encoder, &value);
-                if (i%64==0) _json_fflush();
-                frame->code = DWT_SS_TWR_NRNG_EXT_END;
-            }
+    for (slot_mask_t pending = valid_mask; pending; pending &= pending - 1){
+        uint16_t i = SlotFirst(pending);
+        uint16_t idx = SlotIndex(nrng->slot_mask, i, SLOT_POSITION); 
+        nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+        if (frame->code == DWT_SS_TWR_NRNG_FINAL && frame->seq_num == seq_num){
+            char uuid[16];
+            sprintf(uuid,"%04u",frame->dst_address);
+            JSON_VALUE_STRINGN(&value, uuid,4);
+            rc |= json_encode_array_value(&encoder, &value);
+            if (i%64==0) _json_fflush();
+            frame->code = DWT_SS_TWR_NRNG_EXT_END;
         }
     }
 
@@ -67,6 +67,8 @@ typedef enum _dw1000_pan_modes_t{
     DWT_PAN_REQ,                     //!< Pan request
     DWT_PAN_RESP,                    //!< Pan response
     DWT_PAN_RESET,                   //!< Pan reset, in case of master restart
+    DWT_PAN_SLOTMAP,                 //!< Slot assignments changed by the master
+    DWT_PAN_SLOTACK,                 //!< Node applied its slot map entry
 }dw1000_pan_code_t;
 
 //! Union of response frame format
@@ -88,10 +90,35 @@ typedef union{
                 uint16_t slot_id;            //!< Assigned slot_id
             };
         };
+        uint8_t slot_period;                 //!< Requested/assigned slot period in superframes, power of 2, absent from older nodes
+        uint8_t slot_phase;                  //!< Assigned phase, slot used when ccp seq_num % slot_period == slot_phase
     }__attribute__((__packed__, aligned(1)));
     uint8_t array[sizeof(struct _pan_frame_t)];
 }pan_frame_t;
 
+//! Slot assignment as announced by the master
+typedef struct _pan_slot_entry_t{
+    uint16_t short_address;                  //!< Node the assignment applies to
+    uint16_t slot_id;                        //!< Assigned slot_id, 0xffff when revoked
+    uint8_t slot_period;                     //!< Slot period in superframes, power of 2
+    uint8_t slot_phase;                      //!< Phase within the period
+}__attribute__((__packed__, aligned(1))) pan_slot_entry_t;
+
+//! Union of slot map frame format
+typedef union{
+//! Structure containing the slot map broadcast, only entries that changed are sent
+    struct _pan_slotmap_frame_t{
+        //! Structure of IEEE blink frame
+        struct _ieee_blink_frame_t;
+        uint8_t rpt_count:4;                 //!< Repeat level
+        uint8_t rpt_max:4;                   //!< Repeat max level
+        uint16_t code;                       //!< DWT_PAN_SLOTMAP
+        uint8_t nentries;                    //!< Valid entries
+        pan_slot_entry_t entries[MYNEWT_VAL(PAN_SLOTMAP_MAX)];
+    }__attribute__((__packed__, aligned(1)));
+    uint8_t array[sizeof(struct _pan_slotmap_frame_t)];
+}pan_slotmap_frame_t;
+
 //! Pan status parameters
 typedef struct _dw1000_pan_status_t{
     uint16_t selfmalloc:1;                 //!< Internal flag for memory garbage collection
@@ -109,6 +136,7 @@ typedef struct _dw1000_pan_config_t{
     uint32_t role:4;                  //!< dw1000_pan_role_t
     uint16_t lease_time;              //!< Lease time in seconds
     uint16_t network_role;            //!< Network application role (Anchor/Tag...)
+    uint8_t slot_period;              //!< Requested slot period in superframes (demand), power of 2
 }dw1000_pan_config_t;
 
 //! Pan control parameters
@@ -128,6 +156,20 @@ typedef struct _dw1000_pan_instance_t{
     dw1000_pan_config_t * config;                //!< DW1000 pan config parameters
     uint16_t nframes;                            //!< Number of buffers defined to store the data
     uint16_t idx;                                //!< Indicates number of DW1000 instances
+    uint8_t slot_period;                         //!< Assigned slot period in superframes
+    uint8_t slot_phase;                          //!< Assigned slot phase
+    pan_slotmap_frame_t slotmap;                 //!< Master: changed assignments awaiting acknowledgement
+    uint8_t slotmap_tries[MYNEWT_VAL(PAN_SLOTMAP_MAX)]; //!< Master: broadcasts of each entry so far
+    uint8_t slotack_pos;                         //!< Node: position + 1 of the slot map entry to acknowledge, 0 if none
+    uint16_t slotack_slot_id;                    //!< Node: slot_id of the entry to acknowledge
+#if MYNEWT_VAL(TDMA_ENABLED)
+    struct _tdma_instance_t * tdma;              //!< Node: schedule the leased slot is placed in, see dw1000_pan_slot_bind()
+    os_event_fn * slot_cb;                       //!< Node: handler of the leased slot
+    void * slot_arg;                             //!< Node: argument of the leased slot
+    uint16_t slot_first;                         //!< Node: tdma slot of slot_id 0
+    uint16_t slot_bound;                         //!< Node: tdma slot currently assigned, 0xffff if none
+    struct os_event slot_event;                  //!< Node: applies lease changes to the schedule
+#endif
     pan_frame_t * frames[];                      //!< Buffers to pan frames
 }dw1000_pan_instance_t;
 
@@ -139,6 +181,13 @@ dw1000_dev_status_t dw1000_pan_listen(dw1000_pan_instance_t * pan, dw1000_dev_mo
 dw1000_pan_status_t dw1000_pan_blink(dw1000_pan_instance_t * pan, uint16_t role, dw1000_dev_modes_t mode, uint64_t delay);
 dw1000_pan_status_t dw1000_pan_reset(dw1000_pan_instance_t * pan, uint64_t delay);
 uint32_t dw1000_pan_lease_remaining(dw1000_pan_instance_t * pan);
+int dw1000_pan_slotmap_add(dw1000_pan_instance_t * pan, uint16_t short_address, uint16_t slot_id, uint8_t slot_period, uint8_t slot_phase);
+dw1000_pan_status_t dw1000_pan_slotmap_send(dw1000_pan_instance_t * pan, dw1000_dev_modes_t mode, uint64_t delay);
+dw1000_pan_status_t dw1000_pan_slotmap_ack(dw1000_pan_instance_t * pan, uint64_t delay);
+#if MYNEWT_VAL(TDMA_ENABLED)
+void dw1000_pan_slot_bind(dw1000_pan_instance_t * pan, struct _tdma_instance_t * tdma, uint16_t first,
+                          os_event_fn * cb, void * arg);
+#endif
 
 void dw1000_pan_slot_timer_cb(struct os_event * ev);
 
@@ -29,6 +29,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <os/os.h>
@@ -59,6 +60,11 @@
 #if MYNEWT_VAL(PAN_ENABLED)
 #include <pan/pan.h>
 
+/* Slot map entries are acknowledged in subslots 2 onwards of 16, within the 3/4 of the slot the master listens */
+#if MYNEWT_VAL(PAN_SLOTMAP_MAX) > 10
+#error "PAN_SLOTMAP_MAX must not exceed 10"
+#endif
+
 //! Buffers for pan frames
 #if MYNEWT_VAL(DW1000_DEVICE_0)
 static pan_frame_t g_pan_0[] = {
@@ -108,6 +114,12 @@ STATS_SECT_START(pan_stat_section)
     STATS_SECT_ENTRY(tx_error)
     STATS_SECT_ENTRY(rx_timeout)
     STATS_SECT_ENTRY(reset)
+    STATS_SECT_ENTRY(slotmap_tx)
+    STATS_SECT_ENTRY(slotmap_rx)
+    STATS_SECT_ENTRY(slot_revoked)
+    STATS_SECT_ENTRY(slotack_tx)
+    STATS_SECT_ENTRY(slotack_rx)
+    STATS_SECT_ENTRY(slotmap_drop)
 STATS_SECT_END
 
 STATS_NAME_START(pan_stat_section)
@@ -123,6 +135,12 @@ STATS_NAME_START(pan_stat_section)
     STATS_NAME(pan_stat_section, tx_error)
     STATS_NAME(pan_stat_section, rx_timeout)
     STATS_NAME(pan_stat_section, reset)
+    STATS_NAME(pan_stat_section, slotmap_tx)
+    STATS_NAME(pan_stat_section, slotmap_rx)
+    STATS_NAME(pan_stat_section, slot_revoked)
+    STATS_NAME(pan_stat_section, slotack_tx)
+    STATS_NAME(pan_stat_section, slotack_rx)
+    STATS_NAME(pan_stat_section, slotmap_drop)
 STATS_NAME_END(pan_stat_section)
 
 static STATS_SECT_DECL(pan_stat_section) g_stat; //!< Stats instance
@@ -131,7 +149,8 @@ static dw1000_pan_config_t g_config = {
     .tx_holdoff_delay = MYNEWT_VAL(PAN_TX_HOLDOFF),         // Send Time delay in usec.
     .rx_timeout_period = MYNEWT_VAL(PAN_RX_TIMEOUT),        // Receive response timeout in usec.
     .lease_time = MYNEWT_VAL(PAN_LEASE_TIME),               // Lease time in seconds
-    .network_role = MYNEWT_VAL(PAN_NETWORK_ROLE)            // Role in the network (Anchor/Tag/...)
+    .network_role = MYNEWT_VAL(PAN_NETWORK_ROLE),           // Role in the network (Anchor/Tag/...)
+    .slot_period = MYNEWT_VAL(PAN_SLOT_PERIOD)              // Requested slot period in superframes
 };
 
 static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
@@ -198,6 +217,15 @@ dw1000_pan_init(dw1000_dev_instance_t * inst,  dw1000_pan_config_t * config, uin
     pan->control = (dw1000_pan_control_t){
         .postprocess = false,
     };
+    pan->slot_period = 1;
+    pan->slot_phase = 0;
+    pan->slotmap.fctrl = FCNTL_IEEE_BLINK_TAG_64;
+    pan->slotmap.code = DWT_PAN_SLOTMAP;
+    pan->slotmap.nentries = 0;
+    pan->slotack_pos = 0;
+#if MYNEWT_VAL(TDMA_ENABLED)
+    pan->tdma = NULL;
+#endif
 
     os_error_t err = os_sem_init(&pan->sem, 0x1);
     assert(err == OS_OK);
@@ -345,6 +373,52 @@ pan_postprocess(struct os_event * ev){
 #endif
 }
 
+#if MYNEWT_VAL(TDMA_ENABLED)
+/**
+ * @fn pan_slot_update(struct os_event * ev)
+ * @brief Node side, place the leased slot in the bound schedule with its period and phase, or take it
+ * out once the lease ended. Runs on the queue of the slot handlers so no handler of the slot is pending
+ * while it moves.
+ *
+ * @param ev  Pointer to os_event, ev_arg is the pan instance.
+ *
+ * @return void
+ */
+static void
+pan_slot_update(struct os_event * ev)
+{
+    dw1000_pan_instance_t * pan = (dw1000_pan_instance_t *)ev->ev_arg;
+    dw1000_dev_instance_t * inst = pan->dev_inst;
+    tdma_instance_t * tdma = pan->tdma;
+    uint16_t idx = 0xffff;
+
+    if (pan->status.valid && inst->slot_id != 0xffff && (uint32_t)pan->slot_first + inst->slot_id < tdma->nslots)
+        idx = pan->slot_first + inst->slot_id;
+    if (pan->slot_bound != 0xffff && pan->slot_bound != idx)
+        tdma_release_slot(tdma, pan->slot_bound);
+    if (idx != 0xffff)
+        tdma_assign_slot_periodic(tdma, pan->slot_cb, idx, pan->slot_period, pan->slot_phase, pan->slot_arg);
+    pan->slot_bound = idx;
+}
+
+/**
+ * @fn pan_slot_changed(dw1000_pan_instance_t * pan)
+ * @brief Node side, have a lease change applied to the bound schedule, if any.
+ *
+ * @param pan  Pointer to dw1000_pan_instance_t.
+ *
+ * @return void
+ */
+static void
+pan_slot_changed(dw1000_pan_instance_t * pan)
+{
+    if (pan->tdma)
+        os_eventq_put(tdma_eventq(pan->tdma), &pan->slot_event);
+}
+#else
+#define pan_slot_changed(pan)
+#endif
+
 /**
  * @fn lease_expiry_cb(struct os_event * ev)
  * @brief Function called when our lease is about to expire
@@ -364,6 +438,7 @@ lease_expiry_cb(struct os_event * ev)
     pan->status.valid = false;
     pan->status.lease_expired = true;
     inst->slot_id = 0xffff;
+    pan_slot_changed(pan);
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"pan_lease_expired\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
     if (pan->control.postprocess) {
@@ -371,6 +446,57 @@ lease_expiry_cb(struct os_event * ev)
     }
 }
 
+/**
+ * @fn slotmap_rx(dw1000_pan_instance_t * pan, uint8_t * buf, uint16_t len)
+ * @brief Apply the entry of a slot map broadcast addressed to this node, if any, and queue its
+ * acknowledgement. A revoked slot invalidates the lease so that a new assignment is requested in
+ * the next pan slot.
+ *
+ * @param pan   Pointer to dw1000_pan_instance_t.
+ * @param buf   Received frame.
+ * @param len   Frame length.
+ *
+ * @return void
+ */
+static void slotack_rx(dw1000_pan_instance_t * pan, pan_frame_t * ack);
+
+static void
+slotmap_rx(dw1000_pan_instance_t * pan, uint8_t * buf, uint16_t len)
+{
+    dw1000_dev_instance_t * inst = pan->dev_inst;
+    pan_slotmap_frame_t * map = (pan_slotmap_frame_t *) buf;
+
+    STATS_INC(g_stat, slotmap_rx);
+    if (!pan->status.valid || len < offsetof(struct _pan_slotmap_frame_t, entries))
+        return;
+
+    uint16_t n = (len - offsetof(struct _pan_slotmap_frame_t, entries)) / sizeof(pan_slot_entry_t);
+    n = (map->nentries < n) ? map->nentries : n;
+    for (uint16_t i = 0; i < n; i++) {
+        pan_slot_entry_t entry;
+        memcpy(&entry, &map->entries[i], sizeof(entry));
+        if (entry.short_address != inst->my_short_address)
+            continue;
+        if (entry.slot_id == 0xffff) {
+            STATS_INC(g_stat, slot_revoked);
+            pan->status.valid = false;
+            pan->status.lease_expired = true;
+            os_callout_stop(&pan->pan_lease_callout_expiry);
+        } else {
+            pan->slot_period = (entry.slot_period) ? entry.slot_period : 1;
+            pan->slot_phase = entry.slot_phase;
+        }
+        inst->slot_id = entry.slot_id;
+        pan_slot_changed(pan);
+        pan->slotack_pos = i + 1;
+        pan->slotack_slot_id = entry.slot_id;
+        if (pan->control.postprocess) {
+            os_eventq_put(&inst->eventq, &pan->postprocess_event);
+        }
+        break;
+    }
+}
+
 /**
  * @fn rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  * @brief This is an internal static function that executes on both the pan_master Node and the TAG/ANCHOR
@@ -402,6 +528,24 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
     }
 
     STATS_INC(g_stat, rx_complete);
+
+    uint16_t code;
+    if (inst->frame_len < offsetof(struct _pan_frame_t, code) + sizeof(code)) {
+        return false;
+    }
+    memcpy(&code, inst->rxbuf + offsetof(struct _pan_frame_t, code), sizeof(code));
+    if (code == DWT_PAN_SLOTMAP) {
+        if (pan->config->role == PAN_ROLE_MASTER) {
+            return false;
+        }
+        slotmap_rx(pan, inst->rxbuf, inst->frame_len);
+        if (os_sem_get_count(&pan->sem) == 0) {
+            os_error_t err = os_sem_release(&pan->sem);
+            assert(err == OS_OK);
+        }
+        return true;
+    }
+
     pan_frame_t * frame = pan->frames[(pan->idx)%pan->nframes];
 
     /* Ignore frames that are too long */
@@ -409,6 +553,11 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
         return false;
     }
     memcpy(frame->array, inst->rxbuf, inst->frame_len);
+    if (inst->frame_len < sizeof(struct _pan_frame_t)) {
+        /* Nodes predating slot periods */
+        frame->slot_period = 1;
+        frame->slot_phase = 0;
+    }
 
     if (pan->config->role == PAN_ROLE_RELAY &&
         frame->rpt_count < frame->rpt_max &&
@@ -437,8 +586,11 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             inst->my_short_address = frame->short_address;
             inst->PANID = frame->pan_id;
             inst->slot_id = frame->slot_id;
+            pan->slot_period = (frame->slot_period) ? frame->slot_period : 1;
+            pan->slot_phase = frame->slot_phase;
             pan->status.valid = true;
             pan->status.lease_expired = false;
+            pan_slot_changed(pan);
             os_callout_stop(&pan->pan_lease_callout_expiry);
             if (frame->lease_time > 0) {
                 /* Calculate when our lease expires */
@@ -456,12 +608,20 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             return true;
         }
         break;
+    case DWT_PAN_SLOTACK:
+        if (pan->config->role == PAN_ROLE_MASTER) {
+            /* Keep listening for further acknowledgements and requests */
+            slotack_rx(pan, frame);
+            return true;
+        }
+        return false;
     case DWT_PAN_RESET:
         STATS_INC(g_stat, pan_reset);
         if (pan->config->role != PAN_ROLE_MASTER) {
             pan->status.valid = false;
             pan->status.lease_expired = true;
             inst->slot_id = 0xffff;
+            pan_slot_changed(pan);
             os_callout_stop(&pan->pan_lease_callout_expiry);
         } else {
             return false;
@@ -613,6 +773,8 @@ dw1000_pan_blink(dw1000_pan_instance_t *pan, uint16_t role,
     frame->rpt_max = MYNEWT_VAL(PAN_RPT_MAX);
     frame->role = role;
     frame->lease_time = pan->config->lease_time;
+    frame->slot_period = pan->config->slot_period;
+    frame->slot_phase = 0;
     imgr_my_version(&frame->fw_ver);
 
     dw1000_set_delay_start(inst, delay);
@@ -719,8 +881,231 @@ dw1000_pan_lease_remaining(dw1000_pan_instance_t * pan)
     return os_time_ticks_to_ms32(rt);
 }
 
+/**
+ * @fn dw1000_pan_slotmap_add(dw1000_pan_instance_t * pan, uint16_t short_address, uint16_t slot_id, uint8_t slot_period, uint8_t slot_phase)
+ * @brief Master side, queue a changed slot assignment for the next slot map broadcast.
+ * A pending entry for the same node is replaced.
+ *
+ * @param pan            Pointer to dw1000_pan_instance_t.
+ * @param short_address  Node.
+ * @param slot_id        New slot_id, 0xffff to revoke.
+ * @param slot_period    Slot period in superframes.
+ * @param slot_phase     Slot phase.
+ *
+ * @return OS_OK, OS_ENOMEM if the frame is full; the node then picks up the change on lease renewal
+ */
+int
+dw1000_pan_slotmap_add(dw1000_pan_instance_t * pan, uint16_t short_address, uint16_t slot_id,
+                       uint8_t slot_period, uint8_t slot_phase)
+{
+    pan_slotmap_frame_t * map = &pan->slotmap;
+    pan_slot_entry_t entry = {
+        .short_address = short_address,
+        .slot_id = slot_id,
+        .slot_period = slot_period,
+        .slot_phase = slot_phase
+    };
+    int rc = OS_OK;
+    uint16_t i;
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (i = 0; i < map->nentries; i++) {
+        if (map->entries[i].short_address == short_address)
+            break;
+    }
+    if (i < MYNEWT_VAL(PAN_SLOTMAP_MAX)) {
+        memcpy(&map->entries[i], &entry, sizeof(entry));
+        pan->slotmap_tries[i] = 0;
+        if (i == map->nentries)
+            map->nentries++;
+    } else {
+        rc = OS_ENOMEM;
+    }
+    OS_EXIT_CRITICAL(sr);
+    return rc;
+}
+
+/**
+ * @fn slotmap_remove(dw1000_pan_instance_t * pan, uint16_t i)
+ * @brief Master side, drop entry i of the pending slot map. Call in a critical section.
+ *
+ * @return void
+ */
+static void
+slotmap_remove(dw1000_pan_instance_t * pan, uint16_t i)
+{
+    pan_slotmap_frame_t * map = &pan->slotmap;
+    map->nentries--;
+    for (; i < map->nentries; i++) {
+        memcpy(&map->entries[i], &map->entries[i + 1], sizeof(pan_slot_entry_t));
+        pan->slotmap_tries[i] = pan->slotmap_tries[i + 1];
+    }
+}
+
+/**
+ * @fn slotack_rx(dw1000_pan_instance_t * pan, pan_frame_t * ack)
+ * @brief Master side, retire the slot map entry a node acknowledged. An acknowledgement of an
+ * entry that was replaced since does not match and the newer entry stays queued.
+ *
+ * @param pan   Pointer to dw1000_pan_instance_t.
+ * @param ack   Received DWT_PAN_SLOTACK frame.
+ *
+ * @return void
+ */
+static void
+slotack_rx(dw1000_pan_instance_t * pan, pan_frame_t * ack)
+{
+    pan_slotmap_frame_t * map = &pan->slotmap;
+
+    STATS_INC(g_stat, slotack_rx);
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (uint16_t i = 0; i < map->nentries; i++) {
+        if (map->entries[i].short_address == ack->short_address && map->entries[i].slot_id == ack->slot_id) {
+            slotmap_remove(pan, i);
+            break;
+        }
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn dw1000_pan_slotmap_send(dw1000_pan_instance_t * pan, dw1000_dev_modes_t mode, uint64_t delay)
+ * @brief Master side, broadcast the queued slot assignment changes and listen for acknowledgements
+ * and requests for the rx timeout set by the caller. Nodes holding a valid lease listen at the start
+ * of the pan slot, apply the entry addressed to them and acknowledge it in a subslot given by its
+ * position. Entries stay queued until acknowledged or broadcast PAN_SLOTMAP_RETRIES times.
+ *
+ * @param pan      Pointer to dw1000_pan_instance_t.
+ * @param mode     BLOCKING and NONBLOCKING modes of dw1000_dev_modes_t.
+ * @param delay    When to send the slot map
+ *
+ * @return dw1000_pan_status_t
+ */
+dw1000_pan_status_t
+dw1000_pan_slotmap_send(dw1000_pan_instance_t * pan, dw1000_dev_modes_t mode, uint64_t delay)
+{
+    dw1000_dev_instance_t * inst = pan->dev_inst;
+    pan_slotmap_frame_t * map = &pan->slotmap;
+    os_error_t err = os_sem_pend(&pan->sem,  OS_TIMEOUT_NEVER);
+    assert(err == OS_OK);
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    /* Entries broadcast often enough are left to the lease renewal */
+    for (uint16_t i = 0; i < map->nentries;) {
+        if (pan->slotmap_tries[i] >= MYNEWT_VAL(PAN_SLOTMAP_RETRIES)) {
+            STATS_INC(g_stat, slotmap_drop);
+            slotmap_remove(pan, i);
+        } else {
+            pan->slotmap_tries[i++]++;
+        }
+    }
+    uint16_t len = offsetof(struct _pan_slotmap_frame_t, entries) + map->nentries * sizeof(pan_slot_entry_t);
+    map->seq_num++;
+    map->long_address = inst->my_long_address;
+    map->rpt_count = 0;
+    map->rpt_max = 0;
+    /* Entries are added from the panmaster task, send a snapshot */
+    pan_slotmap_frame_t frame;
+    memcpy(frame.array, map->array, len);
+    OS_EXIT_CRITICAL(sr);
+
+    if (len == offsetof(struct _pan_slotmap_frame_t, entries)) {
+        os_sem_release(&pan->sem);
+        return pan->status;
+    }
+
+    dw1000_set_delay_start(inst, delay);
+    dw1000_write_tx_fctrl(inst, len, 0);
+    dw1000_write_tx(inst, frame.array, 0, len);
+    dw1000_set_wait4resp(inst, true);
+    pan->status.start_tx_error = dw1000_start_tx(inst).start_tx_error;
+
+    if (pan->status.start_tx_error){
+        STATS_INC(g_stat, tx_error);
+        DIAGMSG("{\"utime\": %lu,\"msg\": \"pan_slotmap_tx_err\"}\n", os_cputime_ticks_to_usecs(os_cputime_get32()));
+        os_sem_release(&pan->sem);
+    } else {
+        STATS_INC(g_stat, slotmap_tx);
+        if (mode == DWT_BLOCKING){
+            err = os_sem_pend(&pan->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions
+            os_sem_release(&pan->sem);
+            assert(err == OS_OK);
+        }
+    }
+    return pan->status;
+}
+
+/**
+ * @fn dw1000_pan_slotmap_ack(dw1000_pan_instance_t * pan, uint64_t delay)
+ * @brief Node side, acknowledge the last slot map entry applied, if not done yet.
+ *
+ * @param pan      Pointer to dw1000_pan_instance_t.
+ * @param delay    When to send the acknowledgement
+ *
+ * @return dw1000_pan_status_t
+ */
+dw1000_pan_status_t
+dw1000_pan_slotmap_ack(dw1000_pan_instance_t * pan, uint64_t delay)
+{
+    dw1000_dev_instance_t * inst = pan->dev_inst;
+    pan_frame_t * frame = pan->frames[(pan->idx)%pan->nframes];
+
+    frame->seq_num += pan->nframes;
+    frame->long_address = inst->my_long_address;
+    frame->code = DWT_PAN_SLOTACK;
+    frame->rpt_count = 0;
+    frame->rpt_max = 0;
+    frame->short_address = inst->my_short_address;
+    frame->slot_id = pan->slotack_slot_id;
+
+    dw1000_set_delay_start(inst, delay);
+    dw1000_write_tx_fctrl(inst, sizeof(struct _pan_frame_t), 0);
+    dw1000_write_tx(inst, frame->array, 0, sizeof(struct _pan_frame_t));
+    dw1000_set_wait4resp(inst, false);
+    pan->status.start_tx_error = dw1000_start_tx(inst).start_tx_error;
+
+    if (pan->status.start_tx_error){
+        /* Retried in the next pan slot */
+        STATS_INC(g_stat, tx_error);
+    } else {
+        STATS_INC(g_stat, slotack_tx);
+        pan->slotack_pos = 0;
+    }
+    return pan->status;
+}
 
 #if MYNEWT_VAL(TDMA_ENABLED)
+/**
+ * @fn dw1000_pan_slot_bind(dw1000_pan_instance_t * pan, struct _tdma_instance_t * tdma, uint16_t first, os_event_fn * cb, void * arg)
+ * @brief Node side, let the pan lease drive a tdma slot. The leased slot_id n is assigned as tdma slot first + n
+ * through tdma_assign_slot_periodic() with the leased period and phase, follows slot map changes and is released
+ * when the lease ends. Slot ids beyond the schedule are not placed.
+ *
+ * @param pan      Pointer to dw1000_pan_instance_t.
+ * @param tdma     Schedule to place the slot in.
+ * @param first    tdma slot of slot_id 0.
+ * @param cb       Slot handler.
+ * @param arg      Argument of the slot.
+ *
+ * @return void
+ */
+void
+dw1000_pan_slot_bind(dw1000_pan_instance_t * pan, struct _tdma_instance_t * tdma, uint16_t first,
+                     os_event_fn * cb, void * arg)
+{
+    pan->tdma = tdma;
+    pan->slot_first = first;
+    pan->slot_cb = cb;
+    pan->slot_arg = arg;
+    pan->slot_bound = 0xffff;
+    pan->slot_event.ev_cb = pan_slot_update;
+    pan->slot_event.ev_arg = (void *) pan;
+    pan_slot_changed(pan);
+}
+
 /**
  * @fn dw1000_pan_slot_timer_cb
  * @brief tdma slot handler for pan slots
@@ -748,9 +1133,13 @@ dw1000_pan_slot_timer_cb(struct os_event * ev)
         /* Broadcast an initial reset message to clear all leases */
         if (_pan_cycles < 8) {
             _pan_cycles++;
-            dw1000_pan_reset(pan, tdma_tx_slot_start(tdma, idx));
+            dw1000_pan_reset(pan, tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 0, 1)));
+        } else if (pan->slotmap.nentries) {
+            /* Announce changed assignments, then listen for acknowledgements and requests */
+            dw1000_set_rx_timeout(inst, 3*ccp->period/tdma->nslots/4);
+            dw1000_pan_slotmap_send(pan, DWT_BLOCKING, tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 0, 1)));
         } else {
-            uint64_t dx_time = tdma_rx_slot_start(tdma, idx);
+            uint64_t dx_time = tdma_rx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 0, 1));
             dw1000_set_rx_timeout(inst, 3*ccp->period/tdma->nslots/4);
             dw1000_set_delay_start(inst, dx_time);
             dw1000_set_on_error_continue(inst, true);
@@ -764,19 +1153,23 @@ dw1000_pan_slot_timer_cb(struct os_event * ev)
             if (pan->config->role == PAN_ROLE_RELAY) {
                 timeout = 3*ccp->period/tdma->nslots/4;
             } else {
-                /* Only listen long enough to get any resets from master */
-                timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(sizeof(struct _pan_frame_t)))
+                /* Only listen long enough to get any resets or slot map changes from master */
+                timeout = dw1000_phy_frame_duration(&inst->attrib, sizeof(struct _pan_slotmap_frame_t))
                     + MYNEWT_VAL(XTALT_GUARD);
             }
             dw1000_set_rx_timeout(inst, timeout);
-            dw1000_set_delay_start(inst, tdma_rx_slot_start(tdma, idx));
+            dw1000_set_delay_start(inst, tdma_rx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 0, 1)));
             dw1000_set_on_error_continue(inst, true);
             if (dw1000_pan_listen(pan, DWT_BLOCKING).start_rx_error) {
                 STATS_INC(g_stat, rx_error);
             }
+            /* Subslots 2 onwards acknowledge slot map entries by position */
+            if (pan->slotack_pos) {
+                dw1000_pan_slotmap_ack(pan, tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 1 + pan->slotack_pos, 16)));
+            }
         } else {
             /* Subslot 0 is for master reset, subslot 1 is for sending requests */
-            uint64_t dx_time = tdma_tx_slot_start(tdma, (float)idx+1.0f/16);
+            uint64_t dx_time = tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(idx, 1, 16));
             dw1000_pan_blink(pan, pan->config->network_role, DWT_BLOCKING, dx_time);
         }
     }
@@ -46,6 +46,8 @@ struct panmaster_node_idx {
     uint16_t slot_id;
     uint8_t role;
     uint16_t has_perm_slot:1; /*!< Has Permanent slot */
+    uint8_t slot_period;      /*!< Slot used every slot_period superframes */
+    uint8_t slot_phase;       /*!< when ccp seq_num % slot_period == slot_phase */
     uint32_t lease_ends;
 };
 
@@ -60,7 +62,8 @@ struct find_node_s {
         (N).addr=0xffff;(N).flags=0;(N).has_perm_slot=0;(N).index=0;(N).slot_id=0xffff;(N).role=0; \
         (N).fw_ver.iv_major=0;(N).fw_ver.iv_minor=0;                    \
         (N).fw_ver.iv_revision=0;(N).fw_ver.iv_build_num=0;}
-#define PANMASTER_NODE_IDX_DEFAULT(N)  {(N).addr=0xffff;(N).slot_id=0xffff;(N).role=0;}
+#define PANMASTER_NODE_IDX_DEFAULT(N)  {(N).addr=0xffff;(N).slot_id=0xffff;(N).role=0; \
+        (N).slot_period=1;(N).slot_phase=0;}
 
 typedef void (*panm_load_cb)(struct panmaster_node *node, void *cb_arg);
 
@@ -70,6 +73,7 @@ extern "C" {
 
 void panmaster_pkg_init(void);
 int panmaster_find_node(uint64_t euid, uint16_t role, struct panmaster_node **node);
+int panmaster_find_node_demand(uint64_t euid, uint16_t role, uint8_t slot_period, struct panmaster_node **node);
 int panmaster_find_node_general(struct find_node_s *fns);
     
 int panmaster_load(panm_load_cb cb, void *cb_arg);
@@ -83,6 +87,9 @@ void panmaster_add_version(uint64_t euid, struct image_version *ver);
 void panmaster_add_node(uint16_t short_addr, uint16_t role, uint8_t *euid_u8);
 void panmaster_delete_node(uint64_t euid);
 
+int panmaster_slot_revoke(uint16_t addr);
+int panmaster_slot_compact(uint16_t role);
+
 void panmaster_compress();
 void panmaster_sort();
 uint16_t panmaster_highest_node_addr();
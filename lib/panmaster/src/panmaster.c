@@ -18,6 +18,9 @@
 
 #endif
 static struct panmaster_node_idx node_idx[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+#if MYNEWT_VAL(PAN_ENABLED)
+static dw1000_pan_instance_t *g_pan = NULL;
+#endif
 
 static uint16_t pan_id = 0x0000;
 static volatile int nodes_loaded = 0;
@@ -155,7 +158,8 @@ panmaster_dw1000_cb(struct os_event * ev)
     struct panmaster_node *node;
     struct image_version fw_ver;
 
-    panmaster_find_node(frame->long_address, frame->role, &node);
+    node = NULL;
+    panmaster_find_node_demand(frame->long_address, frame->role, frame->slot_period, &node);
     if (!node) {
         return;
     }
@@ -166,6 +170,8 @@ panmaster_dw1000_cb(struct os_event * ev)
     frame->code = DWT_PAN_RESP;
     frame->short_address = node->addr;
     frame->slot_id = node_idx[node->index].slot_id;
+    frame->slot_period = node_idx[node->index].slot_period;
+    frame->slot_phase = node_idx[node->index].slot_phase;
     os_get_uptime(&tv);
     if (frame->lease_time == 0) {
         frame->lease_time = MYNEWT_VAL(PANMASTER_DEFAULT_LEASE_TIME);
@@ -230,6 +236,7 @@ panmaster_pkg_init(void)
     dw1000_pan_instance_t *pan = (dw1000_pan_instance_t*)dw1000_mac_find_cb_inst_ptr(inst, DW1000_PAN);
     assert(pan);
     dw1000_pan_set_postprocess(pan, panmaster_dw1000_cb);
+    g_pan = pan;
 #endif
 
 #endif
@@ -343,38 +350,189 @@ slot_lease_expired(int idx)
     return now_ms > le_ms;
 }
 
-static uint16_t
-first_free_slot_id(uint16_t node_addr, uint16_t role)
+/* Slot periods are powers of 2 so that the phase can be taken from the 8bit ccp seq_num */
+static uint8_t
+slot_period_sanitize(uint8_t period)
+{
+    uint8_t p = 1;
+    while (p < 128 && (p << 1) <= period) {
+        p <<= 1;
+    }
+    return p;
+}
+
+/* Two assignments of the same slot collide if their phases agree modulo the shorter period */
+static bool
+slot_conflicts(uint16_t node_addr, uint16_t role, uint16_t slot_id, uint8_t period, uint8_t phase)
 {
     int j;
-    uint16_t slot_id=0;
-    while (slot_id < 0xffff)
+    for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
     {
-        for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
+        if (node_idx[j].addr == 0xffff || role != node_idx[j].role ||
+            node_addr == node_idx[j].addr || slot_id != node_idx[j].slot_id) {
+            continue;
+        }
+        if (slot_lease_expired(j) && !node_idx[j].has_perm_slot) {
+            continue;
+        }
+        uint8_t p = (node_idx[j].has_perm_slot) ? 1 : node_idx[j].slot_period;
+        uint8_t m = (period < p) ? period : p;
+        if ((phase & (m-1)) == (node_idx[j].slot_phase & (m-1))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Lowest slot and phase not colliding with any active lease of the same role.
+ * The node keeps its current assignment if that is still free, so that lease
+ * renewals do not move it. idx < 0 for nodes without an entry yet.
+ */
+static uint16_t
+slot_alloc(int idx, uint16_t node_addr, uint16_t role, uint8_t period, uint8_t *phase)
+{
+    uint16_t slot_id;
+    uint8_t p;
+
+    period = slot_period_sanitize(period);
+    if (idx >= 0 && node_idx[idx].slot_id != 0xffff &&
+        node_idx[idx].slot_period == period &&
+        !slot_conflicts(node_addr, role, node_idx[idx].slot_id, period, node_idx[idx].slot_phase)) {
+        *phase = node_idx[idx].slot_phase;
+        return node_idx[idx].slot_id;
+    }
+    for (slot_id=0;slot_id<0xffff;slot_id++)
+    {
+        for (p=0;p<period;p++)
         {
-            if (node_idx[j].addr == 0xffff || role != node_idx[j].role) {
-                continue;
+            if (!slot_conflicts(node_addr, role, slot_id, period, p)) {
+                *phase = p;
+                return slot_id;
             }
+        }
+    }
+    return 0xffff;
+}
 
-            if (slot_id == node_idx[j].slot_id &&
-                node_addr != node_idx[j].addr &&
-                (slot_lease_expired(j) == false || node_idx[j].has_perm_slot)
-                )
-            {
-                goto next_slot;
-            }
+static void
+slot_assign(int idx, uint16_t role, uint8_t period)
+{
+    uint8_t phase = 0;
+    period = slot_period_sanitize(period);
+    node_idx[idx].slot_id = slot_alloc(idx, node_idx[idx].addr, role, period, &phase);
+    node_idx[idx].slot_period = period;
+    node_idx[idx].slot_phase = phase;
+}
+
+/* Queue a changed assignment for the slot map broadcast of the pan master */
+static void
+slot_announce(int idx)
+{
+#if MYNEWT_VAL(PAN_ENABLED)
+    if (g_pan) {
+        dw1000_pan_slotmap_add(g_pan, node_idx[idx].addr, node_idx[idx].slot_id,
+                               node_idx[idx].slot_period, node_idx[idx].slot_phase);
+    }
+#endif
+}
+
+/**
+ * Revoke the slot of a node. The node is told through the slot map broadcast
+ * and requests a new assignment with its next pan request.
+ *
+ * @param addr  Short address of the node
+ * @return 0 on success, OS_ENOENT if no leased slot is held by addr
+ */
+int
+panmaster_slot_revoke(uint16_t addr)
+{
+    int j;
+    for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
+    {
+        if (node_idx[j].addr != addr || node_idx[j].has_perm_slot ||
+            node_idx[j].slot_id == 0xffff) {
+            continue;
         }
+        node_idx[j].slot_id = 0xffff;
+        node_idx[j].lease_ends = 0;
+        slot_announce(j);
+        return 0;
+    }
+    return OS_ENOENT;
+}
 
-        return slot_id;
-    next_slot:
-        slot_id++;
+/**
+ * Reassign the leased slots of a role from slot 0 upwards, highest rate
+ * first, closing the gaps left by expired leases. Moved nodes are
+ * told through the slot map broadcast.
+ *
+ * @param role  Network role
+ * @return Number of nodes moved
+ */
+int
+panmaster_slot_compact(uint16_t role)
+{
+    int i, j, n = 0, moved = 0;
+    uint8_t order[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+    uint16_t old_slot[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+    uint8_t old_phase[MYNEWT_VAL(PANMASTER_MAXNUM_NODES)];
+
+    for (j=0;j<MYNEWT_VAL(PANMASTER_MAXNUM_NODES);j++)
+    {
+        if (node_idx[j].addr == 0xffff || node_idx[j].role != role ||
+            node_idx[j].has_perm_slot || node_idx[j].slot_id == 0xffff ||
+            slot_lease_expired(j)) {
+            continue;
+        }
+        /* Insertion sort on (period, slot_id) */
+        for (i=n;i>0;i--) {
+            struct panmaster_node_idx *prev = &node_idx[order[i-1]];
+            if (prev->slot_period < node_idx[j].slot_period ||
+                (prev->slot_period == node_idx[j].slot_period && prev->slot_id <= node_idx[j].slot_id)) {
+                break;
+            }
+            order[i] = order[i-1];
+        }
+        order[i] = j;
+        n++;
     }
 
-    return 0xffff;
+    for (i=0;i<n;i++) {
+        j = order[i];
+        old_slot[i] = node_idx[j].slot_id;
+        old_phase[i] = node_idx[j].slot_phase;
+        node_idx[j].slot_id = 0xffff;
+    }
+    for (i=0;i<n;i++) {
+        j = order[i];
+        slot_assign(j, role, node_idx[j].slot_period);
+        if (node_idx[j].slot_id != old_slot[i] || node_idx[j].slot_phase != old_phase[i]) {
+            slot_announce(j);
+            moved++;
+        }
+    }
+    PM_DEBUG("panm: compacted %d moved %d\n", n, moved);
+    return moved;
 }
 
 int
 panmaster_find_node(uint64_t euid, uint16_t role, struct panmaster_node **results)
+{
+    return panmaster_find_node_demand(euid, role, 1, results);
+}
+
+/**
+ * Find or add a node and lease it a slot for the requested rate.
+ *
+ * @param euid         Unique id
+ * @param role         Requested network role, 0 to keep the stored one
+ * @param slot_period  Demand, slot every slot_period superframes (power of 2)
+ * @param results      Node found or added
+ * @return 0
+ */
+int
+panmaster_find_node_demand(uint64_t euid, uint16_t role, uint8_t slot_period, struct panmaster_node **results)
 {
     int i;
     struct os_timeval tv;
@@ -390,9 +548,13 @@ panmaster_find_node(uint64_t euid, uint16_t role, struct panmaster_node **result
     {
         *results = &node;
         if (!node.has_perm_slot) {
-            node.slot_id = first_free_slot_id(node.addr, role);
+            slot_assign(node.index, role, slot_period);
+            node.slot_id = node_idx[node.index].slot_id;
+        } else {
+            node_idx[node.index].slot_id = node.slot_id;
+            node_idx[node.index].slot_period = 1;
+            node_idx[node.index].slot_phase = 0;
         }
-        node_idx[node.index].slot_id = node.slot_id;
 
         /* Only check role if given */
         if (node.role != role && role > 0) {
@@ -419,10 +581,8 @@ panmaster_find_node(uint64_t euid, uint16_t role, struct panmaster_node **result
         node_idx[i].addr = node.addr;
         node_idx[i].role = role;
         node.role = role;
-        if (!node.has_perm_slot) {
-            node.slot_id = first_free_slot_id(node.addr, role);
-        }
-        node_idx[i].slot_id = node.slot_id;
+        slot_assign(i, role, slot_period);
+        node.slot_id = node_idx[i].slot_id;
         node.first_seen_utc = utctime.tv_sec;
         node.index = i;
 
@@ -538,8 +698,8 @@ panmaster_add_node(uint16_t short_addr, uint16_t role, uint8_t *euid_u8)
         }
         node.addr = short_addr;
         node_idx[i].addr = node.addr;
-        node.slot_id = first_free_slot_id(node.addr, role);
-        node_idx[i].slot_id = node.slot_id;
+        slot_assign(i, role, 1);
+        node.slot_id = node_idx[i].slot_id;
         node.first_seen_utc = utctime.tv_sec;
         node.index = i;
 
@@ -574,9 +734,12 @@ panmaster_delete_node(uint64_t euid)
         return;
     }
 
+    if (node_idx[node.index].slot_id != 0xFFFF) {
+        node_idx[node.index].slot_id = 0xFFFF;
+        slot_announce(node.index);
+    }
     node.addr = 0xFFFF;
     node_idx[node.index].addr = 0xFFFF;
-    node_idx[node.index].slot_id = 0xFFFF;
     node_idx[node.index].has_perm_slot = 0;
 
     panmaster_save_node(&node);
@@ -45,6 +45,8 @@ const struct shell_param cmd_pm_param[] = {
     {"del", "<euid> delete node"},
     {"pslot", "<euid> <slot_id> set permanent slot (use slot_id=-1 to remove)"},
     {"role", "<euid> <role> set role)"},
+    {"revoke", "<addr> revoke leased slot"},
+    {"compact", "<role> reassign leased slots from 0"},
     {"dump", ""},
     {"clear", "erase list"},
     {"compr", ""},
@@ -123,7 +125,11 @@ list_nodes_blk()
                 slot_id = lne.nodes[j].slot_id;
             }
             console_printf("%4X, ", lne.nodes[j].role);
-            if (slot_id != 0xffff) {
+            if (slot_id != 0xffff && !lne.nodes[j].has_perm_slot &&
+                node_idx[lne.nodes[j].index].slot_period > 1) {
+                console_printf("%4d/%d:%d, ", slot_id, node_idx[lne.nodes[j].index].slot_period,
+                               node_idx[lne.nodes[j].index].slot_phase);
+            } else if (slot_id != 0xffff) {
                 console_printf("%4d, ", slot_id);
             } else {
                 console_printf("    , ");
@@ -268,6 +274,20 @@ panmaster_cli_cmd(int argc, char **argv)
         } else {
             console_printf("err\n");
         }
+    } else if (!strcmp(argv[1], "revoke")) {
+        if (argc < 3) {
+            console_printf("addr needed\n");
+            return 0;
+        }
+        addr = strtoll(argv[2], NULL, 16);
+        console_printf("%s\n", (panmaster_slot_revoke(addr)) ? "no leased slot" : "revoked");
+    } else if (!strcmp(argv[1], "compact")) {
+        if (argc < 3) {
+            console_printf("role needed\n");
+            return 0;
+        }
+        role = strtoll(argv[2], NULL, 0);
+        console_printf("moved %d\n", panmaster_slot_compact(role));
     } else if (!strcmp(argv[1], "clear")) {
         panmaster_clear_list();
     } else if (!strcmp(argv[1], "compr")) {
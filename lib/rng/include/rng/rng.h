@@ -107,6 +107,7 @@ typedef enum _dw1000_rng_modes_t{
     DWT_SS_TWR_NRNG_EXT_T1,
     DWT_SS_TWR_NRNG_EXT_FINAL,
     DWT_SS_TWR_NRNG_EXT_END,
+    DWT_SS_TWR_NRNG_INVALID,
     DWT_DS_TWR_NRNG = 0x50,
     DWT_DS_TWR_NRNG_T1,
     DWT_DS_TWR_NRNG_T2,
@@ -148,6 +149,9 @@ typedef struct _twr_data_t{
                 triad_t spherical_variance;         //!< Measurement variance triad
                 triad_t cartesian;                  //!< Position triad local coordinates
           //      triad_t cartesian_variance;       //!< Position estimated variance triad
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+                float los;                          //!< Line of sight probability of the last received frame (CIR classifier)
+#endif
 }twr_data_t;
 
 //! TWR frame format
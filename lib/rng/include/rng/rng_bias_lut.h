@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_bias_lut.h
+ * @brief Range bias tables by channel and PRF
+ *
+ * @details The tables are generated from measured bias against received level by tools/rng_bias_lut.py
+ * into src/rng_bias_lut.c. dw1000_rng_bias_correction() interpolates the table matching the channel and
+ * PRF in use, and falls back to the polynomial for combinations without one.
+ */
+
+#ifndef _RNG_BIAS_LUT_H_
+#define _RNG_BIAS_LUT_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Range bias against received level for a set of channels at one PRF
+typedef struct _rng_bias_lut_t{
+    uint8_t channels;           //!< Channels the table applies to, bit n for channel n
+    uint8_t prf;                //!< DWT_PRF_16M or DWT_PRF_64M
+    int8_t level0;              //!< Received level of the first entry in dBm
+    uint8_t step;               //!< Received level step between entries in dB
+    uint16_t n;                 //!< Number of entries
+    const int16_t * bias;       //!< Bias in mm, entry k at level0 + k * step
+}rng_bias_lut_t;
+
+extern const rng_bias_lut_t rng_bias_lut[];
+extern const uint16_t rng_bias_lut_size;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RNG_BIAS_LUT_H_ */
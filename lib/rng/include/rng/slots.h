@@ -45,9 +45,14 @@ typedef enum _slot_mode_t{
 typedef enum _slot_ptype_t{     
     PTYPE_CELL=0,         //!< Cell network
     PTYPE_BITFIELD,       //!< single cell network
-    PTYPE_RANGE           //!< specify slots as a range
+    PTYPE_RANGE,          //!< specify slots as a range
+    PTYPE_MAP             //!< cell network, slot bitmap of map_len bytes follows the payload
 }slot_ptype_t;
 
+//! Responder set of a single request, bit n addresses slot_id n
+typedef uint64_t slot_mask_t;
+#define SLOT_MASK_BITS (sizeof(slot_mask_t) * 8)
+
 typedef struct _slot_payload_t{
     uint32_t ptype:2;           //!< payload type
     union {
@@ -60,12 +65,20 @@ typedef struct _slot_payload_t{
             uint32_t start_slot_id:14;
             uint32_t end_slot_id:16;
         };
+        struct {
+            uint32_t :14;               //!< cell_id
+            uint32_t map_len:16;        //!< PTYPE_MAP bitmap length in bytes
+        };
     };
 }slot_payload_t;
 
 uint32_t NumberOfBits(uint32_t bitfield);
-uint32_t BitIndex(uint32_t mask, uint32_t slot, slot_mode_t mode);
 uint32_t BitPosition(uint32_t n);
+uint32_t NumberOfBits64(slot_mask_t bitfield);
+uint32_t SlotIndex(slot_mask_t mask, uint16_t slot_id, slot_mode_t mode);
+uint16_t SlotFirst(slot_mask_t mask);
+uint16_t SlotMapEncode(uint8_t map[], slot_mask_t mask);
+slot_mask_t SlotMapDecode(const uint8_t map[], uint16_t len);
 
 #ifdef __cplusplus
 }
@@ -48,6 +48,9 @@
 #include <dw1000/dw1000_stats.h>
 #include <dsp/polyval.h>
 
+#if MYNEWT_VAL(RNG_BIAS_LUT)
+#include <rng/rng_bias_lut.h>
+#endif
 #if MYNEWT_VAL(RNG_ENABLED)
 #include <rng/rng.h>
 #include <rng/rng_encode.h>
@@ -98,7 +101,7 @@ static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t
 static bool tx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
-#if MYNEWT_VAL(RNG_VERBOSE)
+#if MYNEWT_VAL(RNG_VERBOSE) || MYNEWT_VAL(CIR_NLOS_ENABLED)
 static bool complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 #endif
 
@@ -113,7 +116,7 @@ p=polyfit(rls,bias,3)
 mat2c(p,'rng_bias_poly_PRF16')
 */
 static float rng_bias_poly_PRF64[] ={
-        1.404476e-03, 3.208478e-01, 2.349322e+01, 5.470342e+02,
+        1.404476e-05, 3.208478e-03, 2.349322e-01, 5.470342e+00,
      	};
 static float rng_bias_poly_PRF16[] ={
         1.754924e-05, 4.106182e-03, 3.061584e-01, 7.189425e+00,
@@ -193,7 +196,7 @@ static dw1000_mac_interface_t g_cbs[] = {
             .rx_complete_cb = rx_complete_cb,
             .tx_complete_cb = tx_complete_cb,
             .rx_timeout_cb = rx_timeout_cb,
-#if MYNEWT_VAL(RNG_VERBOSE)
+#if MYNEWT_VAL(RNG_VERBOSE) || MYNEWT_VAL(CIR_NLOS_ENABLED)
             .complete_cb  = complete_cb,
 #endif
             .reset_cb = reset_cb
@@ -204,7 +207,7 @@ static dw1000_mac_interface_t g_cbs[] = {
             .rx_complete_cb = rx_complete_cb,
             .tx_complete_cb = tx_complete_cb,
             .rx_timeout_cb = rx_timeout_cb,
-#if MYNEWT_VAL(RNG_VERBOSE)
+#if MYNEWT_VAL(RNG_VERBOSE) || MYNEWT_VAL(CIR_NLOS_ENABLED)
             .complete_cb  = complete_cb,
 #endif
             .reset_cb = reset_cb
@@ -216,7 +219,7 @@ static dw1000_mac_interface_t g_cbs[] = {
             .rx_complete_cb = rx_complete_cb,
             .tx_complete_cb = tx_complete_cb,
             .rx_timeout_cb = rx_timeout_cb,
-#if MYNEWT_VAL(RNG_VERBOSE)
+#if MYNEWT_VAL(RNG_VERBOSE) || MYNEWT_VAL(CIR_NLOS_ENABLED)
             .complete_cb  = complete_cb,
 #endif
             .reset_cb = reset_cb
@@ -558,9 +561,43 @@ dw1000_rng_path_loss(float Pt, float G, float fc, float R){
     return Pr;
 }
 
+#if MYNEWT_VAL(RNG_BIAS_LUT)
+/**
+ * @fn rng_bias_lut_find(uint8_t channel, uint8_t prf)
+ * @brief Bias table for a channel and PRF.
+ *
+ * @return const rng_bias_lut_t * or NULL
+ */
+static const rng_bias_lut_t *
+rng_bias_lut_find(uint8_t channel, uint8_t prf){
+    for (uint16_t i = 0; i < rng_bias_lut_size; i++)
+        if ((rng_bias_lut[i].channels & (1U << channel)) && rng_bias_lut[i].prf == prf)
+            return &rng_bias_lut[i];
+    return NULL;
+}
+
+/**
+ * @fn rng_bias_lut_interp(const rng_bias_lut_t * lut, float Pr)
+ * @brief Linear interpolation of a bias table, held at the end values outside of it.
+ *
+ * @return Bias in meters
+ */
+static float
+rng_bias_lut_interp(const rng_bias_lut_t * lut, float Pr){
+    float x = (Pr - lut->level0) / lut->step;
+    if (!(x > 0))
+        return lut->bias[0] * 1e-3f;
+    if (x >= lut->n - 1)
+        return lut->bias[lut->n - 1] * 1e-3f;
+    uint16_t k = (uint16_t) x;
+    return (lut->bias[k] + (x - k) * (lut->bias[k + 1] - lut->bias[k])) * 1e-3f;
+}
+#endif
+
 /**
  * @fn dw1000_rng_bias_correction(dw1000_dev_instance_t * inst, float Pr)
- * @brief API for bias correction polynomial.
+ * @brief API for range bias correction. With RNG_BIAS_LUT the table for the channel and PRF in use is
+ * interpolated, the polynomial covers combinations without a table.
  *
  * @param inst   Pointer to dw1000_dev_instance_t.
  * @param pr     Variable that calculates range path loss.
@@ -570,6 +607,11 @@ dw1000_rng_path_loss(float Pt, float G, float fc, float R){
 float
 dw1000_rng_bias_correction(dw1000_dev_instance_t * inst, float Pr){
     float bias;
+#if MYNEWT_VAL(RNG_BIAS_LUT)
+    const rng_bias_lut_t * lut = rng_bias_lut_find(inst->config.channel, inst->config.prf);
+    if (lut)
+        return rng_bias_lut_interp(lut, Pr);
+#endif
     switch(inst->config.prf){
         case DWT_PRF_16M:
             bias = polyval(rng_bias_poly_PRF16, Pr, sizeof(rng_bias_poly_PRF16)/sizeof(float));
@@ -900,10 +942,13 @@ complete_ev_cb(struct os_event *ev) {
 }
 
 static struct os_event rng_event;
+#endif
 
+#if MYNEWT_VAL(RNG_VERBOSE) || MYNEWT_VAL(CIR_NLOS_ENABLED)
 /**
  * @fn complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
- * @brief API for rng complete callback and put complete_event_cb in queue.
+ * @brief API for rng complete callback, attaches the LOS probability of the last received frame
+ * to the range result and puts complete_event_cb in queue.
  *
  * @param inst   Pointer to dw1000_dev_instance_t.
  * @param cbs    Pointer to dw1000_mac_interface_t.
@@ -918,9 +963,15 @@ complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
         return false;
 
     rng->idx_current = (rng->idx)%rng->nframes;
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+    twr_frame_t * frame = rng->frames[rng->idx_current];
+    frame->los = (inst->cir && inst->cir->status.valid) ? inst->cir->los : 1.0f;
+#endif
+#if MYNEWT_VAL(RNG_VERBOSE)
     rng_event.ev_cb  = complete_ev_cb;
     rng_event.ev_arg = (void*) rng;
     os_eventq_put(os_eventq_dflt_get(), &rng_event);
+#endif
     return false;
 }
 #endif
@@ -0,0 +1,49 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file rng_bias_lut.c
+ * @brief Range bias tables, generated by tools/rng_bias_lut.py from tools/rng_bias_aps011.csv, do not edit.
+ */
+
+#include <os/os.h>
+
+#if MYNEWT_VAL(RNG_BIAS_LUT)
+#include <dw1000/dw1000_mac.h>
+#include <rng/rng_bias_lut.h>
+
+static const int16_t bias_ch1235_prf16[] = {
+    110, 106, 97, 84, 65, 36, 0, -31,
+    -59, -84, -109, -127, -143, -163, -179, -187,
+    -198,
+};
+static const int16_t bias_ch1235_prf64[] = {
+    81, 76, 71, 62, 49, 42, 35, 21,
+    0, -27, -51, -69, -82, -93, -100, -104,
+    -110,
+};
+
+const rng_bias_lut_t rng_bias_lut[] = {
+    {.channels = (1U << 1) | (1U << 2) | (1U << 3) | (1U << 5), .prf = DWT_PRF_16M, .level0 = -93, .step = 2, .n = sizeof(bias_ch1235_prf16)/sizeof(int16_t), .bias = bias_ch1235_prf16},
+    {.channels = (1U << 1) | (1U << 2) | (1U << 3) | (1U << 5), .prf = DWT_PRF_64M, .level0 = -93, .step = 2, .n = sizeof(bias_ch1235_prf64)/sizeof(int16_t), .bias = bias_ch1235_prf64},
+};
+
+const uint16_t rng_bias_lut_size = sizeof(rng_bias_lut)/sizeof(rng_bias_lut[0]);
+
+#endif /* MYNEWT_VAL(RNG_BIAS_LUT) */
@@ -31,6 +31,9 @@
 #if MYNEWT_VAL(WCS_ENABLED)
 #include <wcs/wcs.h>
 #endif
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+#include <diaglog/diaglog.h>
+#endif
 
 #if MYNEWT_VAL(RNG_VERBOSE)
 
@@ -39,17 +42,28 @@ static char _buf[JSON_BUF_SIZE];
 static uint16_t idx=0;
 
 static void
-json_fflush(){
+_json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    diaglog_write(NULL, DIAGLOG_TYPE_TEXT, _buf, idx);
+#else
     _buf[idx] = '\0';
-    printf("%s\n", _buf);
+    printf("%s", _buf);
+#endif
     idx=0;
 }
 
 static void
-_json_fflush(){
+json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    if (idx == JSON_BUF_SIZE)
+        _json_fflush();
+    _buf[idx++] = '\n';
+    _json_fflush();
+#else
     _buf[idx] = '\0';
-    printf("%s", _buf);
+    printf("%s\n", _buf);
     idx=0;
+#endif
 }
 
 static int
@@ -102,20 +116,20 @@ rng_encode(dw1000_rng_instance_t * rng) {
     switch(frame->code){
         case DWT_SS_TWR_FINAL:
         case DWT_DS_TWR_FINAL:
-         printf(", ");
+        json_write(NULL, ", ", 2);
         _twr_encode(frame);
         break;
         case DWT_SS_TWR_EXT_FINAL:
         case DWT_DS_TWR_EXT_FINAL:
-         printf(", ");
+        json_write(NULL, ", ", 2);
         _raz_encode(frame);
         break;
-        default: printf(",error: \"Unknown Frame Code\"");
+        default: json_write(NULL, ",error: \"Unknown Frame Code\"", 28);
     }
 #if MYNEWT_VAL(RNG_VERBOSE) > 1 
     dw1000_dev_instance_t * inst = rng->dev_inst; //!< Structure of DW1000_dev_instance
     if(inst->config.rxdiag_enable){
-        printf(", ");
+        json_write(NULL, ", ", 2);
         _diag_encode(inst);
     }
 #endif
@@ -157,6 +171,15 @@ _twr_encode(twr_frame_t * frame) {
     JSON_VALUE_UINT(&value, *(uint32_t *)&frame->spherical.range);
 #endif
     rc |= json_encode_object_entry(&encoder, "rng", &value);
+#if MYNEWT_VAL(CIR_NLOS_ENABLED)
+#if MYNEWT_VAL(FLOAT_USER)
+    sprintf(float_string,"%f",frame->los);
+    JSON_VALUE_STRING(&value, float_string);
+#else
+    JSON_VALUE_UINT(&value, *(uint32_t *)&frame->los);
+#endif
+    rc |= json_encode_object_entry(&encoder, "los", &value);
+#endif
    
     char uuid[16];
     sprintf(uuid,"%04x",frame->dst_address);
@@ -44,12 +44,7 @@
  */
 uint32_t
 NumberOfBits(uint32_t n) {
-    uint32_t count = 0;
-    while (n) {
-        n &= (n-1);
-        count++;
-    }
-    return count;
+    return __builtin_popcount(n);
 }
 
 /**
@@ -57,41 +52,98 @@ NumberOfBits(uint32_t n) {
  *
  * @param n bitfield to count bits within
  *
- * @return number of set bits
+ * @return position of the single set bit, counting from 1
  */
 uint32_t BitPosition(uint32_t n) {
-    uint32_t count = 0;
     assert(n && (! (n & (n-1)) )); // single bit set
+    return 32 - __builtin_clz(n);
+}
 
-    while (n){
-        n = n >> 1;
-        ++count; // position of bit within bitfield
-    }
-    return count;
+/**
+ * @fn NumberOfBits64(slot_mask_t n)
+ * @brief Help function to calculate the number of slots within a wide slot mask
+ *
+ * @param n     slot mask to count bits within
+ *
+ * @return number of set bits
+ */
+uint32_t
+NumberOfBits64(slot_mask_t n) {
+    return __builtin_popcountll(n);
 }
 
 /**
- * @fn BitIndex(uint32_t nslots_mask, uint32_t n, uint8_t mode)
- * @brief Help function to calculate the numerical ordering of a bit within a bitmask
+ * @fn SlotIndex(slot_mask_t mask, uint16_t slot_id, slot_mode_t mode)
+ * @brief Help function to calculate the numerical ordering of a slot within a wide slot mask (rank).
  *
- * @param nslots_mask     number of slots mask parameter
- * @param n               bitfield
- * @param mode            compare with SLOT_POSITION
+ * @param mask      slot mask of the request
+ * @param slot_id   slot to locate, must be set in mask
+ * @param mode      SLOT_POSITION or SLOT_REMAINING
  *
- * @return numerical ordering of a bit witin bitmask.
+ * @return numerical ordering of the slot within the mask
  */
 uint32_t
-BitIndex(uint32_t nslots_mask, uint32_t n, uint8_t mode) {
+SlotIndex(slot_mask_t mask, uint16_t slot_id, slot_mode_t mode) {
 
-    assert(n && (! (n & (n-1)) ));  // single bit set
-    assert(n & nslots_mask);        // bit set is within ROI
-    
-    uint32_t idx = BitPosition(n);
-    uint32_t slot_mask =  (((uint32_t)~0UL >> (sizeof(uint32_t) * 8 - idx)));
-    uint32_t remaining_mask = ((uint32_t)~0UL << idx);
+    assert(slot_id < SLOT_MASK_BITS);
+    assert(mask & ((slot_mask_t)1 << slot_id));     // slot is within ROI
+
+    slot_mask_t below = ((slot_mask_t)1 << slot_id) - 1;
 
     if (mode == SLOT_POSITION)
-        return NumberOfBits(nslots_mask & slot_mask) - 1; // slot position
+        return NumberOfBits64(mask & below);        // slot position
     else
-        return NumberOfBits(nslots_mask & remaining_mask) - 1; // no. of slots remaining
+        return NumberOfBits64(mask & ~below) - 1;   // no. of slots remaining
+}
+
+/**
+ * @fn SlotFirst(slot_mask_t mask)
+ * @brief Lowest slot_id set in the mask, for walking a mask in slot order with mask &= mask - 1.
+ *
+ * @param mask      non-zero slot mask
+ *
+ * @return slot_id
+ */
+uint16_t
+SlotFirst(slot_mask_t mask) {
+    assert(mask);
+    return __builtin_ctzll(mask);
+}
+
+/**
+ * @fn SlotMapEncode(uint8_t map[], slot_mask_t mask)
+ * @brief Write a slot mask as a little endian bitmap, trimmed after the highest set slot.
+ *
+ * @param map   output, at least sizeof(slot_mask_t) bytes
+ * @param mask  slot mask
+ *
+ * @return number of bytes written
+ */
+uint16_t
+SlotMapEncode(uint8_t map[], slot_mask_t mask) {
+    uint16_t len = 0;
+    while (mask) {
+        map[len++] = (uint8_t) mask;
+        mask >>= 8;
+    }
+    return len;
+}
+
+/**
+ * @fn SlotMapDecode(const uint8_t map[], uint16_t len)
+ * @brief Read a little endian bitmap written by SlotMapEncode().
+ *
+ * @param map   bitmap
+ * @param len   number of bytes, slots beyond SLOT_MASK_BITS are ignored
+ *
+ * @return slot mask
+ */
+slot_mask_t
+SlotMapDecode(const uint8_t map[], uint16_t len) {
+    slot_mask_t mask = 0;
+    if (len > sizeof(slot_mask_t))
+        len = sizeof(slot_mask_t);
+    for (uint16_t i = 0; i < len; i++)
+        mask |= (slot_mask_t) map[i] << (8 * i);
+    return mask;
 }
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Generate and validate the range bias tables of lib/rng/src/rng_bias_lut.c.
+
+Input rows are "channels, prf, level, bias": the channels a measurement
+applies to as digits (1235 for the 500 MHz channels), PRF in MHz, received
+level in dBm and range bias in cm. Each channels/prf group must cover a
+uniform level grid.
+
+    rng_bias_lut.py rng_bias_aps011.csv -o ../src/rng_bias_lut.c
+    rng_bias_lut.py rng_bias_aps011.csv --check ../src/rng_bias_lut.c
+"""
+
+import argparse
+import csv
+import sys
+
+LICENSE = """/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+"""
+
+PRF = {16: "DWT_PRF_16M", 64: "DWT_PRF_64M"}
+
+
+def load(path):
+    groups = {}
+    with open(path) as f:
+        rows = csv.reader(line for line in f if line.strip() and not line.startswith("#"))
+        for n, row in enumerate(rows):
+            try:
+                channels, prf, level, bias = row[0].strip(), int(row[1]), float(row[2]), float(row[3])
+            except (IndexError, ValueError):
+                sys.exit("%s: bad row %d: %s" % (path, n + 1, row))
+            if prf not in PRF or not channels.isdigit() or any(c not in "123457" for c in channels):
+                sys.exit("%s: bad channels or prf in row %d" % (path, n + 1))
+            groups.setdefault((channels, prf), []).append((level, bias))
+    return groups
+
+
+def table(channels, prf, points):
+    """Check the level grid and quantise the bias to mm."""
+    points.sort()
+    levels = [p[0] for p in points]
+    step = levels[1] - levels[0] if len(levels) > 1 else 0
+    if step <= 0 or any(abs(b - a - step) > 1e-6 for a, b in zip(levels, levels[1:])):
+        sys.exit("channels %s prf %d: levels are not a uniform grid" % (channels, prf))
+    if step != int(step) or levels[0] != int(levels[0]) or not -128 <= levels[0] <= 127:
+        sys.exit("channels %s prf %d: level grid must be whole dB" % (channels, prf))
+    bias = [int(round(p[1] * 10)) for p in points]
+    if any(not -32768 <= b <= 32767 for b in bias):
+        sys.exit("channels %s prf %d: bias out of int16 range" % (channels, prf))
+    err = max(abs(b - p[1] * 10) for b, p in zip(bias, points))
+    return {"channels": channels, "prf": prf, "level0": int(levels[0]),
+            "step": int(step), "bias": bias, "err": err}
+
+
+def emit(tables, source):
+    out = [LICENSE, "/**",
+           " * @file rng_bias_lut.c",
+           " * @brief Range bias tables, generated by tools/rng_bias_lut.py from tools/%s, do not edit." % source,
+           " */", "",
+           "#include <os/os.h>", "",
+           "#if MYNEWT_VAL(RNG_BIAS_LUT)",
+           "#include <dw1000/dw1000_mac.h>",
+           "#include <rng/rng_bias_lut.h>", ""]
+    for t in tables:
+        name = "bias_ch%s_prf%d" % (t["channels"], t["prf"])
+        out.append("static const int16_t %s[] = {" % name)
+        for k in range(0, len(t["bias"]), 8):
+            out.append("    " + " ".join("%d," % b for b in t["bias"][k:k + 8]))
+        out.append("};")
+    out += ["", "const rng_bias_lut_t rng_bias_lut[] = {"]
+    for t in tables:
+        mask = " | ".join("(1U << %s)" % c for c in t["channels"])
+        name = "bias_ch%s_prf%d" % (t["channels"], t["prf"])
+        out.append("    {.channels = %s, .prf = %s, .level0 = %d, .step = %d, .n = sizeof(%s)/sizeof(int16_t), .bias = %s}," %
+                   (mask, PRF[t["prf"]], t["level0"], t["step"], name, name))
+    out += ["};", "",
+            "const uint16_t rng_bias_lut_size = sizeof(rng_bias_lut)/sizeof(rng_bias_lut[0]);", "",
+            "#endif /* MYNEWT_VAL(RNG_BIAS_LUT) */", ""]
+    return "\n".join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("csv")
+    ap.add_argument("-o", "--output", help="write the C tables")
+    ap.add_argument("--check", metavar="FILE", help="fail unless FILE matches the tables generated from csv")
+    args = ap.parse_args()
+
+    groups = load(args.csv)
+    tables = [table(c, p, pts) for (c, p), pts in sorted(groups.items())]
+    seen = {}
+    for t in tables:
+        for c in t["channels"]:
+            if seen.setdefault((c, t["prf"]), t["channels"]) != t["channels"]:
+                sys.exit("channel %s prf %d is in more than one table" % (c, t["prf"]))
+    for t in tables:
+        print("channels %s prf %d: %d entries from %d dBm in %d dB steps, max quantisation error %.2f mm" %
+              (t["channels"], t["prf"], len(t["bias"]), t["level0"], t["step"], t["err"]))
+
+    text = emit(tables, args.csv.split("/")[-1])
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+    if args.check:
+        with open(args.check) as f:
+            if f.read() != text:
+                sys.exit("%s is out of date, regenerate with -o" % args.check)
+        print("%s is up to date" % args.check)
+
+
+if __name__ == "__main__":
+    main()
@@ -36,6 +36,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <dw1000/dw1000_dev.h>
 #include <dw1000/dw1000_ftypes.h>
 
@@ -45,28 +46,44 @@ extern "C" {
 #include <rng/slots.h>
 #include <stats/stats.h>
 
-typedef struct _survey_nrng_t{
-    uint16_t mask;              //!< slot bitmask, the bit position in the mask decodes as the node slot_id
-    float rng[];                //!< Ranging corresponding to above slot mask. When broadcasting the survey results we one transmit sucessful range requests.
-                                //!< Use NumberOfBits() BitIndex() to decode the bitmask
-}survey_nrng_t;
+#define SURVEY_RANGE_INVALID 0xffff     //!< Broadcast entry of a link that was lost
 
-typedef struct _survey_nrngs_t{
-    uint16_t mask;              //!< slot bitmask, the bit position in the mask decodes as the node slot_id
-    survey_nrng_t * nrng[];     //!< Ranging corresponding to above slot mask. When broadcasting the survey results we one transmit sucessful range requests.
-}survey_nrngs_t;
+//! Rolling survey matrix entry, ranges from the row node to the column node
+typedef struct _survey_cell_t{
+    float mean;                 //!< Averaged range in meters
+    uint16_t var;               //!< Range variance in mm^2, saturating
+    uint8_t num;                //!< Ranges averaged, saturates at SURVEY_NAVERAGE
+    uint8_t age;                //!< Survey rounds since the last update, saturating
+}survey_cell_t;
 
-//! N-Ranges request frame
+//! Broadcast entry, a matrix cell of the sender's row
+typedef struct _survey_entry_t{
+    uint16_t rng;               //!< Range in SURVEY_RANGE_RESOLUTION mm units, SURVEY_RANGE_INVALID for lost or out of range links
+}__attribute__((__packed__,aligned(1))) survey_entry_t;
+
+//! Statistics of a broadcast entry, only sent on refresh and for new links
+typedef struct _survey_entry_stat_t{
+    uint8_t num;                //!< Ranges averaged
+    uint8_t std;                //!< Range standard deviation in mm, saturating
+}__attribute__((__packed__,aligned(1))) survey_entry_stat_t;
+
+//! Survey broadcast, carries the entries of the sender's row that changed by more than SURVEY_DELTA_THRESHOLD
+//! since they were last sent, or are due a refresh. The entries are followed by the statistics of those in stat_mask.
 typedef union {
     struct _survey_broadcast_frame_t{
         struct _ieee_rng_request_frame_t;
         uint16_t slot_id;
         uint16_t cell_id;
-        struct _survey_nrng_t; 
+        uint16_t mask;          //!< Entries carried, the bit position decodes as the destination slot_id
+        uint16_t stat_mask;     //!< Entries whose survey_entry_stat_t follows the entries, a subset of mask
+        survey_entry_t entry[]; //!< Entries in mask order
     }__attribute__((__packed__,aligned(1)));
     uint8_t array[sizeof(struct _survey_broadcast_frame_t)]; 
 }survey_broadcast_frame_t;
 
+//! Largest broadcast frame of nnodes nodes
+#define SURVEY_FRAME_SIZE(nnodes) (sizeof(survey_broadcast_frame_t) + (nnodes) * (sizeof(survey_entry_t) + sizeof(survey_entry_stat_t)))
+
 STATS_SECT_START(survey_stat_section)
     STATS_SECT_ENTRY(request)
     STATS_SECT_ENTRY(listen)   
@@ -107,19 +124,44 @@ typedef struct _survey_instance_t{
     survey_status_t status;                     //!< Survey status parameters
     survey_config_t config;                     //!< Survey control parameters
     uint8_t seq_num;
-    uint16_t nnodes;                            //!< Number of buffers defined to store the data 
+    uint16_t nnodes;                            //!< Number of nodes within the survey
+    uint16_t round;                             //!< Completed survey rounds, paces the refresh of unchanged entries
     survey_broadcast_frame_t * frame;           //!< Frame to broadcast results back between nodes
-    uint16_t nframes;                           //!< nrngs[] is cicrular buffer of size nframes
-    uint16_t idx;                               //!< idx is cicrular buffer of size nframes
-    survey_nrngs_t * nrngs[];                   //!< Array containing survey results, indexed by slot_id
+    uint16_t * sent;                            //!< Own row entries as last broadcast, indexed by slot_id, updated once the TX started
+    uint16_t * addr;                            //!< Short address of the broadcasters, indexed by slot_id, 0 if not heard
+    survey_cell_t cells[];                      //!< Rolling nnodes x nnodes range matrix, row major by slot_id
 }survey_instance_t; 
 
+/**
+ * @fn survey_cell(survey_instance_t * survey, uint16_t i, uint16_t j)
+ * @brief Matrix entry of the ranges from slot i to slot j.
+ *
+ * @return survey_cell_t *
+ */
+static inline survey_cell_t *
+survey_cell(survey_instance_t * survey, uint16_t i, uint16_t j)
+{
+    return &survey->cells[i * survey->nnodes + j];
+}
+
+/**
+ * @fn survey_cell_valid(survey_cell_t * cell)
+ * @brief Entry holds a range updated within the last SURVEY_MAX_AGE rounds.
+ *
+ * @return bool
+ */
+static inline bool
+survey_cell_valid(survey_cell_t * cell)
+{
+    return cell->num && cell->age <= MYNEWT_VAL(SURVEY_MAX_AGE);
+}
 
-survey_instance_t * survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes, uint16_t nframes);
+survey_instance_t * survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes);
 void survey_free(survey_instance_t * inst);
 void survey_slot_range_cb(struct os_event *ev);
 void survey_slot_broadcast_cb(struct os_event *ev);
 survey_status_t survey_receiver(survey_instance_t * survey, uint64_t dx_time);
+int survey_cli_register(void);
 
 #ifdef __cplusplus
 }
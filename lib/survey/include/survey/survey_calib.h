@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_calib.h
+ * @brief Antenna delay calibration from survey results
+ * @details An antenna delay error of a node adds the same bias to every range it takes part in. The bias of
+ * each node is solved by least squares from the survey ranges against the distances of the localised layout,
+ * which with reference positions are the known distances. At least SURVEY_MDS_DIM + 1 connected references are
+ * required, without them the layout absorbs the biases. survey_calib_apply() turns the biases into antenna
+ * delay corrections, applies the own one and sends the others to their nodes over newtmgr.
+ */
+
+#ifndef _SURVEY_CALIB_H_
+#define _SURVEY_CALIB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <survey/survey.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Calibration result
+typedef struct _survey_calib_t{
+    uint16_t mask;                                  //!< Nodes with an estimate, by slot_id
+    uint16_t count;                                 //!< Calibrations applied, identifies the newtmgr requests
+    bool valid;                                     //!< rms below SURVEY_CALIB_MAX_RMS, required by survey_calib_apply()
+    float rms;                                      //!< Weighted rms range residual after correction in meters
+    float bias[MYNEWT_VAL(SURVEY_NNODES)];          //!< Range bias in meters, measured less true range share of the node
+    int16_t adjust[MYNEWT_VAL(SURVEY_NNODES)];      //!< Correction for both antenna delays in dw1000 time units
+}survey_calib_t;
+
+survey_calib_t * survey_calib_get(void);
+int survey_calib_solve(survey_instance_t * survey);
+int survey_calib_apply(survey_instance_t * survey, bool save);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SURVEY_CALIB_H_ */
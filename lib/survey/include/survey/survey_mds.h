@@ -0,0 +1,72 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_mds.h
+ * @brief Anchor localisation from survey results
+ * @details Both directions of each node pair in the rolling survey matrix are combined into one link. survey_mds_solve() places
+ * the nodes by classical multidimensional scaling, rotates the layout onto the reference points entered
+ * with survey_mds_set_reference() and refines it by weighted least squares with the reference nodes held
+ * fixed. The fitted minus measured distance of every link is kept as residual, a node whose links all
+ * show large residuals has likely been moved.
+ */
+
+#ifndef _SURVEY_MDS_H_
+#define _SURVEY_MDS_H_
+
+#include <stdint.h>
+#include <euclid/triad.h>
+#include <survey/survey.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Node pair as used by the last solution, both directions of the survey matrix combined
+typedef struct _survey_link_t{
+    float mean;                         //!< Range in meters
+    float weight;                       //!< Number of ranges over their variance
+    float residual;                     //!< Fitted less measured range in meters
+    uint16_t num;                       //!< Number of ranges, 0 for no link
+}survey_link_t;
+
+//! Localisation state
+typedef struct _survey_mds_t{
+    uint16_t mask;                      //!< Nodes placed by the last solution, by slot_id
+    uint16_t ref_mask;                  //!< Nodes with a reference position
+    uint16_t aligned:1;                 //!< Last solution is in the reference frame
+    triadf_t reference[MYNEWT_VAL(SURVEY_NNODES)];  //!< Reference positions in meters
+    triadf_t position[MYNEWT_VAL(SURVEY_NNODES)];   //!< Solved positions in meters
+    float rms[MYNEWT_VAL(SURVEY_NNODES)];           //!< Weighted rms residual of each node's links
+    float bias[MYNEWT_VAL(SURVEY_NNODES)];          //!< Range bias in meters taken off both ends of a node's links
+    survey_link_t link[MYNEWT_VAL(SURVEY_NNODES)][MYNEWT_VAL(SURVEY_NNODES)]; //!< Upper triangle, i < j
+}survey_mds_t;
+
+survey_mds_t * survey_mds_get(void);
+void survey_mds_reset(void);
+int survey_mds_solve(survey_instance_t * survey);
+int survey_mds_set_reference(uint16_t slot_id, float x, float y, float z);
+void survey_mds_clear_reference(void);
+survey_link_t * survey_mds_link(uint16_t i, uint16_t j);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SURVEY_MDS_H_ */
@@ -61,10 +61,19 @@
 #include <nrng/nrng.h>
 #include <rng/slots.h>
 #endif
-#if MYNEWT_VAL(SURVEY_VERBOSE)
+#if MYNEWT_VAL(SURVEY_VERBOSE) || MYNEWT_VAL(SURVEY_MDS)
 static void survey_complete_cb(struct os_event *ev);
+#endif
+#if MYNEWT_VAL(SURVEY_VERBOSE)
 #include <survey/survey_encode.h>
 #endif
+#if MYNEWT_VAL(SURVEY_MDS)
+#include <survey/survey_mds.h>
+#endif
+
+#if MYNEWT_VAL(SURVEY_RANGE_RESOLUTION) * (SURVEY_RANGE_INVALID - 1) < MYNEWT_VAL(SURVEY_MDS_MAX_RANGE) * 1000
+#error "SURVEY_RANGE_RESOLUTION does not span SURVEY_MDS_MAX_RANGE in 16 bits"
+#endif
 
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
@@ -98,30 +107,27 @@ survey_status_t survey_receiver(survey_instance_t * survey, uint64_t dx_time);
  * @return survey_instance_t * 
  */
 survey_instance_t * 
-survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes, uint16_t nframes){
+survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes){
     assert(inst);
+    assert(nnodes <= 16);   // uint16_t masks
     
     survey_instance_t *survey = (survey_instance_t*)dw1000_mac_find_cb_inst_ptr(inst, DW1000_SURVEY);
     if (survey == NULL) {
-        survey = (survey_instance_t *) malloc(sizeof(survey_instance_t) + nframes * sizeof(survey_nrngs_t * )); 
+        survey = (survey_instance_t *) malloc(sizeof(survey_instance_t) + nnodes * nnodes * sizeof(survey_cell_t)); 
         assert(survey);
-        memset(survey, 0, sizeof(survey_instance_t) + nframes * sizeof(survey_nrngs_t * ));
-    
-        for (uint16_t j = 0; j < nframes; j++){
-            survey->nrngs[j] = (survey_nrngs_t *) malloc(sizeof(survey_nrngs_t) + nnodes * sizeof(survey_nrng_t * )); // Variable array alloc
-            assert(survey->nrngs[j]);
-            memset(survey->nrngs[j], 0, sizeof(survey_nrngs_t) + nnodes * sizeof(survey_nrng_t * ));
-
-            for (uint16_t i = 0; i < nnodes; i++){
-                survey->nrngs[j]->nrng[i] = (survey_nrng_t * ) malloc(sizeof(survey_nrng_t) + nnodes * sizeof(float)); 
-                assert(survey->nrngs[j]->nrng[i]);
-                memset(survey->nrngs[j]->nrng[i], 0, sizeof(survey_nrng_t) + nnodes * sizeof(float));
-            }
-        }
+        memset(survey, 0, sizeof(survey_instance_t) + nnodes * nnodes * sizeof(survey_cell_t));
 
-        survey->frame = (survey_broadcast_frame_t *) malloc(sizeof(survey_broadcast_frame_t) + nnodes * sizeof(float)); 
+        survey->sent = (uint16_t *) malloc(nnodes * sizeof(uint16_t));
+        assert(survey->sent);
+        memset(survey->sent, 0xff, nnodes * sizeof(uint16_t));  // SURVEY_RANGE_INVALID
+
+        survey->addr = (uint16_t *) malloc(nnodes * sizeof(uint16_t));
+        assert(survey->addr);
+        memset(survey->addr, 0, nnodes * sizeof(uint16_t));
+
+        survey->frame = (survey_broadcast_frame_t *) malloc(SURVEY_FRAME_SIZE(nnodes)); 
         assert(survey->frame);
-        memset(survey->frame, 0, sizeof(survey_broadcast_frame_t) + nnodes * sizeof(float));
+        memset(survey->frame, 0, SURVEY_FRAME_SIZE(nnodes));
         survey_broadcast_frame_t frame = {
             .PANID = 0xDECA,
             .fctrl = FCNTL_IEEE_RANGE_16,
@@ -133,7 +139,6 @@ survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes, uint16_t nfra
         memcpy(survey->frame, &frame, sizeof(survey_broadcast_frame_t));
         survey->status.selfmalloc = 1;
         survey->nnodes = nnodes; 
-        survey->nframes = nframes; 
 
         /* Lookup the other instances we will need */
         survey->dev_inst = inst;
@@ -159,7 +164,7 @@ survey_init(struct _dw1000_dev_instance_t * inst, uint16_t nnodes, uint16_t nfra
         .reset_cb = reset_cb
     };
 
-#if MYNEWT_VAL(SURVEY_VERBOSE)
+#if MYNEWT_VAL(SURVEY_VERBOSE) || MYNEWT_VAL(SURVEY_MDS)
     survey->survey_complete_cb = survey_complete_cb;
 #endif
     dw1000_mac_append_interface(inst, &survey->cbs);
@@ -189,11 +194,8 @@ survey_free(survey_instance_t * survey)
     assert(survey);
     
     if (survey->status.selfmalloc){
-        for (uint16_t j = 0; j < survey->nframes; j++){
-            for (uint16_t i = 0; i < survey->nnodes; i++)
-                free(survey->nrngs[j]->nrng[i]);
-            free(survey->nrngs[j]);
-        }
+        free(survey->sent);
+        free(survey->addr);
         free(survey->frame);
         free(survey);
     }else{
@@ -212,13 +214,17 @@ survey_pkg_init(void)
     printf("{\"utime\": %lu,\"msg\": \"survey_pkg_init\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
 #if MYNEWT_VAL(DW1000_DEVICE_0)
-    survey_init(hal_dw1000_inst(0), MYNEWT_VAL(SURVEY_NNODES), MYNEWT_VAL(SURVEY_NFRAMES));
+    survey_init(hal_dw1000_inst(0), MYNEWT_VAL(SURVEY_NNODES));
+#endif
+#if MYNEWT_VAL(SURVEY_CLI)
+    int rc = survey_cli_register();
+    assert(rc == 0);
 #endif
 }
 
-#if MYNEWT_VAL(SURVEY_VERBOSE)
+#if MYNEWT_VAL(SURVEY_VERBOSE) || MYNEWT_VAL(SURVEY_MDS)
 /**
- * API for verbose logging of survey results.
+ * API for post processing of survey results, verbose logging and localisation.
  * 
  * @param struct os_event
  * @return none
@@ -228,10 +234,58 @@ static void survey_complete_cb(struct os_event *ev) {
     assert(ev->ev_arg != NULL);
 
     survey_instance_t * survey = (survey_instance_t *) ev->ev_arg;
-    survey_encode(survey, survey->seq_num, survey->idx);    
+#if MYNEWT_VAL(SURVEY_VERBOSE)
+    survey_encode(survey, survey->seq_num);    
+#endif
+#if MYNEWT_VAL(SURVEY_MDS)
+    survey_mds_solve(survey);
+#endif
 }
 #endif
 
+/**
+ * Fold a range into a matrix entry, Welford's mean and variance turning into an exponential average once
+ * SURVEY_NAVERAGE ranges are in, so that moved nodes show up.
+ *
+ * @param cell  Matrix entry.
+ * @param range Range in meters.
+ * @return none
+ */
+static void
+survey_cell_add(survey_cell_t * cell, float range)
+{
+    if (!survey_cell_valid(cell)) {
+        cell->num = 0;
+        cell->mean = 0;
+        cell->var = 0;
+    }
+    if (cell->num < MYNEWT_VAL(SURVEY_NAVERAGE))
+        cell->num++;
+    float d = range - cell->mean;
+    cell->mean += d / cell->num;
+    float var = cell->var + (d * (range - cell->mean) * 1e6f - cell->var) / cell->num;
+    cell->var = (var > UINT16_MAX) ? UINT16_MAX : (var < 0) ? 0 : (uint16_t) var;
+    cell->age = 0;
+}
+
+/**
+ * Close a survey round, age all entries.
+ *
+ * @param survey survey_instance_t pointer
+ * @return none
+ */
+static void
+survey_round(survey_instance_t * survey)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (uint16_t i = 0; i < survey->nnodes * survey->nnodes; i++)
+        if (survey->cells[i].age < UINT8_MAX)
+            survey->cells[i].age++;
+    survey->round++;
+    OS_EXIT_CRITICAL(sr);
+}
+
 /**
  * Callback to schedule nrng request survey
  * 
@@ -254,11 +308,11 @@ survey_slot_range_cb(struct os_event *ev)
     survey->seq_num = (ccp->seq_num & ((uint32_t)~0UL << MYNEWT_VAL(SURVEY_MASK))) >> MYNEWT_VAL(SURVEY_MASK);
     
     if(ccp->seq_num % survey->nnodes == inst->slot_id){
-        uint64_t dx_time = tdma_tx_slot_start(tdma, slot->idx) & 0xFFFFFFFE00UL;
+        uint64_t dx_time = tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(slot->idx, 0, 1)) & 0xFFFFFFFE00UL;
         survey_request(survey, dx_time);
     }
     else{
-        uint64_t dx_time = tdma_rx_slot_start(tdma, slot->idx) & 0xFFFFFFFE00UL;
+        uint64_t dx_time = tdma_rx_slot_start_q16(tdma, TDMA_SLOT_Q16(slot->idx, 0, 1)) & 0xFFFFFFFE00UL;
         survey_listen(survey, dx_time); 
     }
 }
@@ -287,12 +341,14 @@ survey_slot_broadcast_cb(struct os_event *ev){
     survey->seq_num = (ccp->seq_num & ((uint32_t)~0UL << MYNEWT_VAL(SURVEY_MASK))) >> MYNEWT_VAL(SURVEY_MASK);
 
     if(ccp->seq_num % survey->nnodes == inst->slot_id){
-        uint64_t dx_time = tdma_tx_slot_start(tdma, slot->idx) & 0xFFFFFFFE00UL;
+        uint64_t dx_time = tdma_tx_slot_start_q16(tdma, TDMA_SLOT_Q16(slot->idx, 0, 1)) & 0xFFFFFFFE00UL;
         survey_broadcaster(survey, dx_time);
     }else{
-        uint64_t dx_time = tdma_rx_slot_start(tdma, slot->idx) & 0xFFFFFFFE00UL;
+        uint64_t dx_time = tdma_rx_slot_start_q16(tdma, TDMA_SLOT_Q16(slot->idx, 0, 1)) & 0xFFFFFFFE00UL;
         survey_receiver(survey, dx_time);  
     }
+    if(ccp->seq_num % survey->nnodes == survey->nnodes - 1)
+        survey_round(survey);
     if(ccp->seq_num % survey->nnodes == survey->nnodes - 1 && survey->survey_complete_cb){
         survey_complete_event.ev_cb  = survey->survey_complete_cb;
         survey_complete_event.ev_arg = (void*) survey;
@@ -319,12 +375,13 @@ survey_request(survey_instance_t * survey, uint64_t dx_time)
     uint32_t slot_mask = ~(~0UL << (survey->nnodes));
     dw1000_nrng_request_delay_start(survey->nrng, 0xffff, dx_time, DWT_SS_TWR_NRNG, slot_mask, 0);
     
-    survey_nrngs_t * nrngs = survey->nrngs[(survey->idx)%survey->nframes];
-    nrngs->nrng[inst->slot_id]->mask = dw1000_nrng_get_ranges(survey->nrng, 
-                                nrngs->nrng[inst->slot_id]->rng, 
-                                survey->nnodes, 
-                                survey->nrng->idx
-                            );
+    float rng[16];
+    slot_mask_t mask = dw1000_nrng_get_ranges(survey->nrng, rng, survey->nnodes, survey->nrng->idx);
+    uint16_t n = 0;
+    for (slot_mask_t pending = mask; pending; pending &= pending - 1) {
+        uint16_t j = SlotFirst(pending);
+        survey_cell_add(survey_cell(survey, inst->slot_id, j), rng[n++]);
+    }
     return survey->status;
 }
 
@@ -363,13 +420,46 @@ survey_broadcaster(survey_instance_t * survey, uint64_t dx_time){
     STATS_INC(survey->stat, broadcaster);
 
     dw1000_dev_instance_t * inst = survey->dev_inst;
-    survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
 
-    survey->frame->mask = nrngs->nrng[inst->slot_id]->mask;
     survey->frame->seq_num = survey->seq_num;
     survey->frame->slot_id = inst->slot_id;
-
-    uint16_t nnodes = NumberOfBits(survey->frame->mask);
+    survey->frame->cell_id = inst->cell_id;
+    survey->addr[inst->slot_id] = inst->my_short_address;
+
+    // Entries that moved beyond the threshold, and a rotating share of the rest to keep them alive at the receivers.
+    // Count and variance only go with the refreshed entries and with links that were lost at the last broadcast.
+    survey_entry_stat_t stats[16];
+    uint16_t mask = 0, stat_mask = 0, nnodes = 0, nstats = 0;
+    for (uint16_t j = 0; j < survey->nnodes; j++) {
+        if (j == inst->slot_id)
+            continue;
+        survey_cell_t * cell = survey_cell(survey, inst->slot_id, j);
+        uint16_t rng = SURVEY_RANGE_INVALID;
+        if (survey_cell_valid(cell)) {
+            // Ranges beyond the 16 bit span go out as lost rather than clamped to a wrong value
+            float units = cell->mean * 1000.0f / MYNEWT_VAL(SURVEY_RANGE_RESOLUTION) + 0.5f;
+            if (units >= 0 && units < SURVEY_RANGE_INVALID)
+                rng = (uint16_t) units;
+        }
+        uint16_t sent = survey->sent[j];
+        if (rng == SURVEY_RANGE_INVALID && sent == SURVEY_RANGE_INVALID)
+            continue;
+        bool refresh = (survey->round + j) % MYNEWT_VAL(SURVEY_REFRESH) == 0;
+        if (refresh || rng == SURVEY_RANGE_INVALID || sent == SURVEY_RANGE_INVALID
+            || abs((int32_t) rng - sent) * MYNEWT_VAL(SURVEY_RANGE_RESOLUTION) > MYNEWT_VAL(SURVEY_DELTA_THRESHOLD)) {
+            survey->frame->entry[nnodes++].rng = rng;
+            mask |= 1U << j;
+            if (rng != SURVEY_RANGE_INVALID && (refresh || sent == SURVEY_RANGE_INVALID)) {
+                float std = sqrtf(cell->var) + 0.5f;
+                stats[nstats].num = cell->num;
+                stats[nstats++].std = (std < UINT8_MAX) ? (uint8_t) std : UINT8_MAX;
+                stat_mask |= 1U << j;
+            }
+        }
+    }
+    memcpy(&survey->frame->entry[nnodes], stats, nstats * sizeof(survey_entry_stat_t));
+    survey->frame->mask = mask;
+    survey->frame->stat_mask = stat_mask;
     survey->status.empty = nnodes == 0;
     if (survey->status.empty){
         err = os_sem_release(&survey->sem);
@@ -378,9 +468,7 @@ survey_broadcaster(survey_instance_t * survey, uint64_t dx_time){
     }
 
     assert(nnodes < survey->nnodes);
-    memcpy(survey->frame->rng, nrngs->nrng[inst->slot_id]->rng, nnodes * sizeof(float));
-    
-    uint16_t n = sizeof(struct _survey_broadcast_frame_t) + nnodes * sizeof(float);
+    uint16_t n = sizeof(struct _survey_broadcast_frame_t) + nnodes * sizeof(survey_entry_t) + nstats * sizeof(survey_entry_stat_t);
     dw1000_write_tx(inst, survey->frame->array, 0, n);
     dw1000_write_tx_fctrl(inst, n, 0);
     dw1000_set_delay_start(inst, dx_time); 
@@ -391,6 +479,11 @@ survey_broadcaster(survey_instance_t * survey, uint64_t dx_time){
         if (os_sem_get_count(&survey->sem) == 0) 
             os_sem_release(&survey->sem);
     }else{
+        // Only entries on air count as sent, after a failed start they go out again with the next broadcast
+        for (uint16_t j = 0, k = 0; j < survey->nnodes; j++)
+            if (mask & (1U << j))
+                survey->sent[j] = survey->frame->entry[k++].rng;
+
         err = os_sem_pend(&survey->sem, OS_TIMEOUT_NEVER); // Wait for completion of transactions 
         assert(err == OS_OK);
         err = os_sem_release(&survey->sem);
@@ -416,7 +509,7 @@ survey_receiver(survey_instance_t * survey, uint64_t dx_time){
     assert(err == OS_OK);
     STATS_INC(survey->stat, receiver);
 
-    uint16_t n = sizeof(struct _survey_broadcast_frame_t) + survey->nnodes * sizeof(float);
+    uint16_t n = SURVEY_FRAME_SIZE(survey->nnodes);
     uint16_t timeout = dw1000_phy_frame_duration(&inst->attrib, n) 
                         + survey->config.rx_timeout_delay;
     dw1000_set_rx_timeout(inst, timeout); 
@@ -462,8 +555,6 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
 
     if(frame->dst_address != 0xffff)
         return false;
-    if(survey->ccp->seq_num % survey->nnodes == 0)
-        survey->idx++;  // advance the nrngs idx at begining of sequence.
 
     switch(frame->code) {
         case DWT_SURVEY_BROADCAST:
@@ -472,22 +563,41 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
                     return false;
                 if (frame->seq_num != survey->seq_num) 
                     break;
-                uint16_t n = sizeof(survey_broadcast_frame_t) + survey->nnodes * sizeof(float);
-                if (inst->frame_len > n || frame->slot_id > survey->nnodes - 1) {
+                uint16_t nnodes = NumberOfBits(frame->mask);
+                uint16_t n = sizeof(survey_broadcast_frame_t) + nnodes * sizeof(survey_entry_t)
+                            + NumberOfBits(frame->stat_mask) * sizeof(survey_entry_stat_t);
+                if (inst->frame_len < n || frame->slot_id > survey->nnodes - 1 || (frame->mask >> survey->nnodes)
+                    || (frame->stat_mask & ~frame->mask)) {
                     return false;
                 }
-                survey_nrngs_t * nrngs = survey->nrngs[survey->idx%survey->nframes];
-                uint16_t nnodes = NumberOfBits(frame->mask);
+                survey_entry_stat_t * stat = (survey_entry_stat_t *) &frame->entry[nnodes];
                 survey->status.empty = nnodes == 0;
-                if(!survey->status.empty){
-                    nrngs->mask |= 1U << frame->slot_id;
-                    nrngs->nrng[frame->slot_id]->mask = frame->mask;
-                    memcpy(nrngs->nrng[frame->slot_id]->rng, frame->rng, nnodes * sizeof(float));
-                    break;
-                }else{      
-                    nrngs->nrng[frame->slot_id]->mask = 0;              
-                    break;
+                survey->addr[frame->slot_id] = frame->src_address;
+                uint16_t k = 0;
+                for (uint16_t j = 0; j < survey->nnodes; j++) {
+                    if (!(frame->mask & (1U << j)))
+                        continue;
+                    survey_cell_t * cell = survey_cell(survey, frame->slot_id, j);
+                    survey_entry_t * entry = &frame->entry[k++];
+                    if (entry->rng == SURVEY_RANGE_INVALID) {
+                        cell->num = 0;
+                        if (frame->stat_mask & (1U << j))
+                            stat++;
+                        continue;
+                    }
+                    // Already averaged by the sender, take its count and variance so both directions weigh alike.
+                    // Without statistics the last ones received stay, a link first heard without them counts once.
+                    cell->mean = entry->rng * MYNEWT_VAL(SURVEY_RANGE_RESOLUTION) / 1000.0f;
+                    if (frame->stat_mask & (1U << j)) {
+                        cell->num = stat->num;
+                        cell->var = (uint16_t) stat->std * stat->std;
+                        stat++;
+                    } else if (cell->num == 0) {
+                        cell->num = 1;
+                    }
+                    cell->age = 0;
                 }
+                break;
             }
             break;
         default: 
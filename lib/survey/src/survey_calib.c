@@ -0,0 +1,307 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_calib.c
+ * @brief Antenna delay calibration from survey results
+ * @details With both antenna delays of node i off by e_i, the range between nodes i and j reads
+ * c * (e_i + e_j) long. The biases b_i minimise sum w_ij (r_ij - d_ij - b_i - b_j)^2, with r_ij the survey
+ * range and d_ij the distance of the layout solved by survey_mds_solve(). Layout and biases are solved in
+ * turn, the layout from the bias corrected ranges, until the biases settle. Referenced nodes are held at
+ * their known positions, at least SURVEY_MDS_DIM + 1 of them as a free layout stretches to absorb a common
+ * bias. A free node on the hull of the layout is poorly determined, its neighbours all lie to one side and
+ * moving it outward reads much like a bias, so the references are best placed on the hull. A prior of
+ * SURVEY_CALIB_PRIOR keeps poorly determined nodes close to their current delays.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <os/os.h>
+#include <os/endian.h>
+
+#if MYNEWT_VAL(SURVEY_CALIB)
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <mgmt/mgmt.h>
+#include <tinycbor/cbor.h>
+#include <tinycbor/cbor_mbuf_writer.h>
+#include <nmgr_uwb/nmgr_uwb.h>
+#include <uwbcfg/uwbcfg.h>
+#include <survey/survey.h>
+#include <survey/survey_mds.h>
+#include <survey/survey_calib.h>
+
+#define NNODES MYNEWT_VAL(SURVEY_NNODES)
+#define DWT_TO_METERS ((299792458.0f/1.000293f) * (float)DWT_TIME_UNITS)
+
+static survey_calib_t g_calib;
+
+/**
+ * @fn survey_calib_get(void)
+ * @brief Last calibration result.
+ *
+ * @return survey_calib_t *
+ */
+survey_calib_t *
+survey_calib_get(void)
+{
+    return &g_calib;
+}
+
+/**
+ * @fn survey_calib_cholesky(float * a, float * b, uint16_t n)
+ * @brief Solve a x = b in place for a symmetric positive definite n x n matrix, x is returned in b.
+ *
+ * @return OS_OK or OS_EINVAL if a is not positive definite
+ */
+static int
+survey_calib_cholesky(float * a, float * b, uint16_t n)
+{
+    for (uint16_t j = 0; j < n; j++) {
+        float s = a[j * n + j];
+        for (uint16_t k = 0; k < j; k++)
+            s -= a[j * n + k] * a[j * n + k];
+        if (s <= 0)
+            return OS_EINVAL;
+        a[j * n + j] = sqrtf(s);
+        for (uint16_t i = j + 1; i < n; i++) {
+            s = a[i * n + j];
+            for (uint16_t k = 0; k < j; k++)
+                s -= a[i * n + k] * a[j * n + k];
+            a[i * n + j] = s / a[j * n + j];
+        }
+    }
+    for (uint16_t i = 0; i < n; i++) {
+        for (uint16_t k = 0; k < i; k++)
+            b[i] -= a[i * n + k] * b[k];
+        b[i] /= a[i * n + i];
+    }
+    for (int16_t i = n - 1; i >= 0; i--) {
+        for (uint16_t k = i + 1; k < n; k++)
+            b[i] -= a[k * n + i] * b[k];
+        b[i] /= a[i * n + i];
+    }
+    return OS_OK;
+}
+
+/**
+ * @fn survey_calib_distance(survey_mds_t * mds, uint16_t i, uint16_t j)
+ * @brief Distance between two solved positions.
+ *
+ * @return float
+ */
+static float
+survey_calib_distance(survey_mds_t * mds, uint16_t i, uint16_t j)
+{
+    float dx = mds->position[i].x - mds->position[j].x;
+    float dy = mds->position[i].y - mds->position[j].y;
+    float dz = mds->position[i].z - mds->position[j].z;
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+/**
+ * @fn survey_calib_solve(survey_instance_t * survey)
+ * @brief Estimate the range bias of every node, see file description. The biases stay applied to the
+ * localisation until survey_calib_apply(), a refused solve clears them.
+ *
+ * @param survey  survey instance holding the range matrix.
+ *
+ * @return OS_OK, OS_EINVAL with fewer than SURVEY_MDS_DIM + 1 connected references or the error of survey_mds_solve()
+ */
+int
+survey_calib_solve(survey_instance_t * survey)
+{
+    survey_mds_t * mds = survey_mds_get();
+    float prior = 1.0f / powf(MYNEWT_VAL(SURVEY_CALIB_PRIOR) / 100.0f, 2);
+    float a[NNODES][NNODES], b[NNODES];
+    int rc = OS_OK;
+
+    g_calib.mask = 0;
+    g_calib.valid = false;
+    memset(mds->bias, 0, sizeof(mds->bias));
+    if (NumberOfBits(mds->ref_mask) < MYNEWT_VAL(SURVEY_MDS_DIM) + 1)
+        return OS_EINVAL;
+
+    for (uint16_t it = 0; it < MYNEWT_VAL(SURVEY_CALIB_ITERATIONS); it++) {
+        if ((rc = survey_mds_solve(survey)) != OS_OK)
+            break;
+
+        memset(a, 0, sizeof(a));
+        memset(b, 0, sizeof(b));
+        for (uint16_t i = 0; i < NNODES; i++)
+            a[i][i] = prior;
+        for (uint16_t i = 0; i < NNODES; i++) {
+            for (uint16_t j = i + 1; j < NNODES; j++) {
+                survey_link_t * link = &mds->link[i][j];
+                if (link->num == 0 || !(mds->mask & (1U << i)) || !(mds->mask & (1U << j)))
+                    continue;
+                // link->mean has the current biases taken off
+                float e = link->mean + mds->bias[i] + mds->bias[j] - survey_calib_distance(mds, i, j);
+                a[i][i] += link->weight;
+                a[j][j] += link->weight;
+                a[i][j] += link->weight;
+                a[j][i] += link->weight;
+                b[i] += link->weight * e;
+                b[j] += link->weight * e;
+            }
+        }
+        if ((rc = survey_calib_cholesky(&a[0][0], b, NNODES)) != OS_OK)
+            break;
+
+        float step = 0;
+        for (uint16_t i = 0; i < NNODES; i++) {
+            step = fmaxf(step, fabsf(b[i] - mds->bias[i]));
+            mds->bias[i] = b[i];
+        }
+        if (step < 1e-3f)
+            break;
+    }
+    if (rc == OS_OK)
+        rc = survey_mds_solve(survey);
+    if (rc == OS_OK && NumberOfBits(mds->ref_mask & mds->mask) < MYNEWT_VAL(SURVEY_MDS_DIM) + 1)
+        rc = OS_EINVAL;
+    if (rc != OS_OK) {
+        memset(mds->bias, 0, sizeof(mds->bias));
+        return rc;
+    }
+
+    float sum = 0, sum_w = 0;
+    for (uint16_t i = 0; i < NNODES; i++) {
+        for (uint16_t j = i + 1; j < NNODES; j++) {
+            survey_link_t * link = &mds->link[i][j];
+            if (link->num == 0 || !(mds->mask & (1U << i)) || !(mds->mask & (1U << j)))
+                continue;
+            sum += link->weight * link->residual * link->residual;
+            sum_w += link->weight;
+        }
+    }
+    g_calib.rms = (sum_w > 0) ? sqrtf(sum / sum_w) : INFINITY;
+    g_calib.valid = g_calib.rms < MYNEWT_VAL(SURVEY_CALIB_MAX_RMS) / 100.0f;
+    g_calib.mask = mds->mask;
+    for (uint16_t i = 0; i < NNODES; i++) {
+        g_calib.bias[i] = (mds->mask & (1U << i)) ? mds->bias[i] : 0;
+        // A positive bias reads long, longer delays take it off
+        g_calib.adjust[i] = (int16_t) lroundf(g_calib.bias[i] / DWT_TO_METERS);
+    }
+    return OS_OK;
+}
+
+/**
+ * @fn survey_calib_push(survey_instance_t * survey, uint16_t addr, int16_t adjust, bool save)
+ * @brief Queue a uwbcfg antenna delay request for a remote node, sent with the next newtmgr slot.
+ *
+ * @return OS_OK, OS_ENOENT without a UWB newtmgr transport or OS_ENOMEM
+ */
+static int
+survey_calib_push(survey_instance_t * survey, uint16_t addr, int16_t adjust, bool save)
+{
+    nmgr_uwb_instance_t * nmgruwb = (nmgr_uwb_instance_t *)dw1000_mac_find_cb_inst_ptr(survey->dev_inst, DW1000_NMGR_UWB);
+    if (nmgruwb == NULL)
+        return OS_ENOENT;
+
+    struct os_mbuf * om = os_msys_get_pkthdr(NMGR_UWB_MTU_STD, 0);
+    if (om == NULL)
+        return OS_ENOMEM;
+
+    struct nmgr_hdr * hdr = (struct nmgr_hdr *) os_mbuf_extend(om, sizeof(struct nmgr_hdr));
+    if (hdr == NULL) {
+        os_mbuf_free_chain(om);
+        return OS_ENOMEM;
+    }
+    memset(hdr, 0, sizeof(struct nmgr_hdr));
+    hdr->nh_op = NMGR_OP_WRITE;
+    hdr->nh_group = htons(MGMT_GROUP_ID_UWBCFG);
+    hdr->nh_seq = (uint8_t) g_calib.count;
+    hdr->nh_id = UWBCFG_NMGR_ID_ANTDLY;
+
+    struct cbor_mbuf_writer writer;
+    CborEncoder encoder, map;
+    cbor_mbuf_writer_init(&writer, om);
+    cbor_encoder_init(&encoder, &writer.enc, 0);
+
+    CborError err = cbor_encoder_create_map(&encoder, &map, CborIndefiniteLength);
+    err |= cbor_encode_text_stringz(&map, "rx");
+    err |= cbor_encode_int(&map, adjust);
+    err |= cbor_encode_text_stringz(&map, "tx");
+    err |= cbor_encode_int(&map, adjust);
+    err |= cbor_encode_text_stringz(&map, "id");
+    err |= cbor_encode_uint(&map, ((uint32_t) survey->dev_inst->my_short_address << 16) | g_calib.count);
+    err |= cbor_encode_text_stringz(&map, "save");
+    err |= cbor_encode_boolean(&map, save);
+    err |= cbor_encoder_close_container(&encoder, &map);
+    if (err) {
+        os_mbuf_free_chain(om);
+        return OS_ENOMEM;
+    }
+    hdr->nh_len = htons(OS_MBUF_PKTLEN(om) - sizeof(struct nmgr_hdr));
+
+    return uwb_nmgr_queue_tx(nmgruwb, addr, NMGR_CMD_STATE_SEND, om);
+}
+
+/**
+ * @fn survey_calib_apply(survey_instance_t * survey, bool save)
+ * @brief Apply the corrections of the last survey_calib_solve(), the own one through uwbcfg and the others
+ * as newtmgr requests to the short address each node broadcast its survey results from. The ranges taken
+ * with the old delays are discarded.
+ *
+ * @param survey  survey instance holding the range matrix.
+ * @param save    Have the nodes persist their new delays, otherwise they hold until reset.
+ *
+ * @return OS_OK, OS_EINVAL without a valid solution, or the last error of a node that could not be reached
+ */
+int
+survey_calib_apply(survey_instance_t * survey, bool save)
+{
+    dw1000_dev_instance_t * inst = survey->dev_inst;
+    survey_mds_t * mds = survey_mds_get();
+    int rc = OS_OK;
+
+    if (g_calib.mask == 0 || !g_calib.valid)
+        return OS_EINVAL;
+
+    g_calib.count++;
+    for (uint16_t i = 0; i < survey->nnodes && i < NNODES; i++) {
+        int err = OS_OK;
+        if (!(g_calib.mask & (1U << i)) || g_calib.adjust[i] == 0)
+            continue;
+        if (i == inst->slot_id)
+            err = uwbcfg_antdly_adjust(g_calib.adjust[i], g_calib.adjust[i], save);
+        else if (survey->addr[i] == 0)
+            err = OS_ENOENT;
+        else
+            err = survey_calib_push(survey, survey->addr[i], g_calib.adjust[i], save);
+        if (err != OS_OK)
+            rc = err;
+    }
+
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    for (uint16_t k = 0; k < survey->nnodes * survey->nnodes; k++)
+        survey->cells[k].num = 0;
+    OS_EXIT_CRITICAL(sr);
+
+    memset(mds->bias, 0, sizeof(mds->bias));
+    survey_mds_reset();
+    g_calib.mask = 0;
+    g_calib.valid = false;
+    return rc;
+}
+
+#endif /* MYNEWT_VAL(SURVEY_CALIB) */
@@ -0,0 +1,183 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/mynewt.h>
+#include <syscfg/syscfg.h>
+
+#if MYNEWT_VAL(SURVEY_CLI)
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <shell/shell.h>
+#include <console/console.h>
+
+#include <dw1000/dw1000_hal.h>
+#include "survey/survey.h"
+#include "survey/survey_mds.h"
+#if MYNEWT_VAL(SURVEY_CALIB)
+#include "survey/survey_calib.h"
+#endif
+
+static int survey_cli_cmd(int argc, char **argv);
+
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+const struct shell_param cmd_survey_param[] = {
+    {"show", "node positions and rms residual"},
+    {"links", "range and residual of every link"},
+    {"solve", "recompute positions"},
+    {"ref <slot> <x> <y> <z>", "reference position in meters"},
+    {"ref clear", "remove references"},
+#if MYNEWT_VAL(SURVEY_CALIB)
+    {"calib", "estimate antenna delay corrections"},
+    {"calib apply [save]", "send the corrections, save persists them"},
+#endif
+    {NULL,NULL},
+};
+
+const struct shell_cmd_help cmd_survey_help = {
+	"survey", "<cmd>", cmd_survey_param
+};
+#endif
+
+static struct shell_cmd shell_survey_cmd = {
+    .sc_cmd = "survey",
+    .sc_cmd_func = survey_cli_cmd,
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+    .help = &cmd_survey_help
+#endif
+};
+
+/* console_printf has no float support */
+static void
+print_fixed(float v)
+{
+    console_printf("%s%d.%03d", (v < 0) ? "-" : "", (int)fabsf(v), (int)((fabsf(v) - (int)fabsf(v)) * 1000));
+}
+
+static void
+show(survey_mds_t * mds)
+{
+    console_printf("frame: %s\n", (mds->aligned) ? "reference" : "local");
+    console_printf("#slot, x(m), y(m), z(m), rms(m)\n");
+    for (uint16_t i = 0; i < MYNEWT_VAL(SURVEY_NNODES); i++) {
+        if (!(mds->mask & (1U << i)))
+            continue;
+        console_printf("%5d%s, ", i, (mds->ref_mask & (1U << i)) ? "*" : "");
+        for (uint16_t j = 0; j < 3; j++) {
+            print_fixed(mds->position[i].array[j]);
+            console_printf(", ");
+        }
+        print_fixed(mds->rms[i]);
+        console_printf("\n");
+    }
+}
+
+static void
+links(survey_mds_t * mds)
+{
+    console_printf("#i, j, n, range(m), residual(m)\n");
+    for (uint16_t i = 0; i < MYNEWT_VAL(SURVEY_NNODES); i++) {
+        for (uint16_t j = i + 1; j < MYNEWT_VAL(SURVEY_NNODES); j++) {
+            survey_link_t * link = survey_mds_link(i, j);
+            if (link->num == 0)
+                continue;
+            console_printf("%2d, %2d, %3d, ", i, j, link->num);
+            print_fixed(link->mean);
+            console_printf(", ");
+            print_fixed(link->residual);
+            console_printf("\n");
+        }
+    }
+}
+
+#if MYNEWT_VAL(SURVEY_CALIB)
+static void
+calib(survey_instance_t * survey)
+{
+    survey_calib_t * cal = survey_calib_get();
+
+    console_printf("#slot, addr, bias(m), adjust\n");
+    for (uint16_t i = 0; i < MYNEWT_VAL(SURVEY_NNODES); i++) {
+        if (!(cal->mask & (1U << i)))
+            continue;
+        console_printf("%5d, 0x%04X, ", i, survey->addr[i]);
+        print_fixed(cal->bias[i]);
+        console_printf(", %d\n", cal->adjust[i]);
+    }
+    console_printf("rms(m): ");
+    print_fixed(cal->rms);
+    console_printf(cal->valid ? "\n" : ", above SURVEY_CALIB_MAX_RMS\n");
+}
+#endif
+
+static int
+survey_cli_cmd(int argc, char **argv)
+{
+    survey_mds_t * mds = survey_mds_get();
+
+    if (argc < 2) {
+        return 0;
+    }
+    if (!strcmp(argv[1], "show")) {
+        show(mds);
+    } else if (!strcmp(argv[1], "links")) {
+        links(mds);
+    } else if (!strcmp(argv[1], "solve")) {
+        survey_instance_t * survey = (survey_instance_t *)dw1000_mac_find_cb_inst_ptr(hal_dw1000_inst(0), DW1000_SURVEY);
+        if (survey == NULL || survey_mds_solve(survey) != 0)
+            console_printf("Not enough connected nodes\n");
+        else
+            show(mds);
+#if MYNEWT_VAL(SURVEY_CALIB)
+    } else if (!strcmp(argv[1], "calib")) {
+        survey_instance_t * survey = (survey_instance_t *)dw1000_mac_find_cb_inst_ptr(hal_dw1000_inst(0), DW1000_SURVEY);
+        if (survey == NULL) {
+            console_printf("No survey\n");
+        } else if (argc > 2 && !strcmp(argv[2], "apply")) {
+            bool save = argc > 3 && !strcmp(argv[3], "save");
+            if (!survey_calib_get()->valid)
+                console_printf("Run calib first, with a residual below SURVEY_CALIB_MAX_RMS\n");
+            else if (survey_calib_apply(survey, save) != 0)
+                console_printf("Some nodes could not be reached\n");
+        } else if (survey_calib_solve(survey) != 0) {
+            console_printf("Needs %d connected references\n", MYNEWT_VAL(SURVEY_MDS_DIM) + 1);
+        } else {
+            calib(survey);
+        }
+#endif
+    } else if (!strcmp(argv[1], "ref") && argc == 3 && !strcmp(argv[2], "clear")) {
+        survey_mds_clear_reference();
+    } else if (!strcmp(argv[1], "ref") && argc > 5) {
+        uint16_t slot = strtol(argv[2], NULL, 0);
+        if (survey_mds_set_reference(slot, strtof(argv[3], NULL), strtof(argv[4], NULL), strtof(argv[5], NULL)))
+            console_printf("Invalid slot\n");
+    } else {
+        console_printf("Unknown cmd\n");
+    }
+    return 0;
+}
+
+int
+survey_cli_register(void)
+{
+    return shell_cmd_register(&shell_survey_cmd);
+}
+#endif /* MYNEWT_VAL(SURVEY_CLI) */
@@ -27,6 +27,9 @@
 #include <dw1000/dw1000_mac.h>
 #include <nrng/nrng_encode.h>
 #include <survey/survey_encode.h>
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+#include <diaglog/diaglog.h>
+#endif
 
 #if MYNEWT_VAL(SURVEY_VERBOSE)
 
@@ -35,17 +38,28 @@ static char _buf[JSON_BUF_SIZE];
 static uint16_t idx=0;
 
 static void
-json_fflush(){
+_json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    diaglog_write(NULL, DIAGLOG_TYPE_TEXT, _buf, idx);
+#else
     _buf[idx] = '\0';
-    printf("%s\n", _buf);
+    printf("%s", _buf);
+#endif
     idx=0;
 }
 
 static void
-_json_fflush(){
+json_fflush(){
+#if MYNEWT_VAL(DIAGLOG_ENABLED)
+    if (idx == JSON_BUF_SIZE)
+        _json_fflush();
+    _buf[idx++] = '\n';
+    _json_fflush();
+#else
     _buf[idx] = '\0';
-    printf("%s", _buf);
+    printf("%s\n", _buf);
     idx=0;
+#endif
 }
 
 static int
@@ -69,18 +83,23 @@ json_write(void *buf, char* data, int len) {
  * @return none.
  */
 void 
-survey_encode(survey_instance_t * survey, uint16_t seq, uint16_t idx){
+survey_encode(survey_instance_t * survey, uint16_t seq){
  
     struct json_encoder encoder;
     struct json_value value;
     int rc;
     uint32_t utime = os_cputime_ticks_to_usecs(os_cputime_get32());
-    survey_nrngs_t * nrngs = survey->nrngs[idx%survey->nframes];
+    uint16_t masks[16] = {0};
 
     uint32_t mask = 0;
-    // Workout which node responded to the request
+    // Workout which rows hold valid entries
     for (uint16_t i=0; i < survey->nnodes; i++){
-        if (nrngs->nrng[i]->mask){
+        for (uint16_t j=0; j < survey->nnodes; j++){
+            if (survey_cell_valid(survey_cell(survey, i, j))){
+                masks[i] |= 1U << j;
+            }
+        }
+        if (masks[i]){
                 mask |= 1UL << i;
         }
     }
@@ -109,19 +128,22 @@ survey_encode(survey_instance_t * survey, uint16_t seq, uint16_t idx){
     rc |= json_encode_array_start(&encoder);
    
     for (uint16_t i=0; i < survey->nnodes; i++){
-        if (nrngs->nrng[i]->mask){
-            JSON_VALUE_UINT(&value, nrngs->nrng[i]->mask);
+        if (masks[i]){
+            JSON_VALUE_UINT(&value, masks[i]);
              rc |= json_encode_object_start(&encoder); 
             rc |= json_encode_object_entry(&encoder, "mask", &value);
             rc |= json_encode_array_name(&encoder, "nrng");
             rc |= json_encode_array_start(&encoder);
-            for (uint16_t j=0; j < NumberOfBits(nrngs->nrng[i]->mask); j++){
+            for (uint16_t j=0; j < survey->nnodes; j++){
+                if (!(masks[i] & (1U << j)))
+                    continue;
+                float rng = survey_cell(survey, i, j)->mean;
 #if MYNEWT_VAL(FLOAT_USER)
                 char float_string[16];
-                sprintf(float_string,"%f",nrngs->nrng[i]->rng[j]);
+                sprintf(float_string,"%f",rng);
                 JSON_VALUE_STRING(&value, float_string);
 #else
-                JSON_VALUE_UINT(&value, *(uint32_t *)&nrngs->nrng[i]->rng[j]);
+                JSON_VALUE_UINT(&value, *(uint32_t *)&rng);
 #endif
                 rc |= json_encode_array_value(&encoder, &value); 
             }
@@ -0,0 +1,492 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_mds.c
+ * @brief Anchor localisation from survey results
+ * @details Both directions of a node pair in the survey matrix are combined into one link, weighted by their
+ * number of ranges over their variance. Classical MDS needs a complete distance matrix, links that were never ranged are filled with the
+ * shortest path through the measured ones. The eigenvectors of the double centred squared distances give
+ * the initial layout, which is only defined up to rotation and mirroring. With at least SURVEY_MDS_DIM
+ * reference points the layout, or its mirror image whichever fits better, is rotated onto the references
+ * by Horn's quaternion method. The layout is then refined node by node with Gauss-Newton steps on the
+ * weighted range residuals.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <os/os.h>
+
+#if MYNEWT_VAL(SURVEY_MDS)
+#include <survey/survey.h>
+#include <survey/survey_mds.h>
+
+#if MYNEWT_VAL(SURVEY_NNODES) > 16
+#error "SURVEY_MDS supports at most 16 nodes"
+#endif
+#if MYNEWT_VAL(SURVEY_MDS_DIM) != 2 && MYNEWT_VAL(SURVEY_MDS_DIM) != 3
+#error "SURVEY_MDS_DIM must be 2 or 3"
+#endif
+
+#define NNODES MYNEWT_VAL(SURVEY_NNODES)
+#define DIM MYNEWT_VAL(SURVEY_MDS_DIM)
+
+static survey_mds_t g_mds;
+
+/**
+ * @fn survey_mds_get(void)
+ * @brief Localisation state.
+ *
+ * @return survey_mds_t *
+ */
+survey_mds_t *
+survey_mds_get(void)
+{
+    return &g_mds;
+}
+
+/**
+ * @fn survey_mds_reset(void)
+ * @brief Discard the solution, keep the references.
+ *
+ * @return void
+ */
+void
+survey_mds_reset(void)
+{
+    memset(g_mds.link, 0, sizeof(g_mds.link));
+    memset(g_mds.position, 0, sizeof(g_mds.position));
+    memset(g_mds.rms, 0, sizeof(g_mds.rms));
+    g_mds.mask = 0;
+    g_mds.aligned = 0;
+}
+
+/**
+ * @fn survey_mds_link(uint16_t i, uint16_t j)
+ * @brief Link statistics between slot i and slot j.
+ *
+ * @return survey_link_t * or NULL
+ */
+survey_link_t *
+survey_mds_link(uint16_t i, uint16_t j)
+{
+    if (i == j || i >= NNODES || j >= NNODES)
+        return NULL;
+    return (i < j) ? &g_mds.link[i][j] : &g_mds.link[j][i];
+}
+
+/**
+ * @fn survey_mds_set_reference(uint16_t slot_id, float x, float y, float z)
+ * @brief Enter the known position of a node.
+ *
+ * @return OS_OK or OS_EINVAL
+ */
+int
+survey_mds_set_reference(uint16_t slot_id, float x, float y, float z)
+{
+    if (slot_id >= NNODES)
+        return OS_EINVAL;
+    g_mds.reference[slot_id] = (triadf_t){.x = x, .y = y, .z = z};
+    g_mds.ref_mask |= 1U << slot_id;
+    return OS_OK;
+}
+
+/**
+ * @fn survey_mds_clear_reference(void)
+ * @brief Remove all reference positions.
+ *
+ * @return void
+ */
+void
+survey_mds_clear_reference(void)
+{
+    g_mds.ref_mask = 0;
+}
+
+/**
+ * @fn survey_mds_jacobi(float * a, float * v, uint16_t n)
+ * @brief Eigen decomposition of a symmetric matrix by cyclic Jacobi rotations.
+ *
+ * @param a  n x n matrix, row major, overwritten with the eigenvalues on the diagonal.
+ * @param v  n x n output, eigenvectors in the columns.
+ * @param n  Dimension.
+ *
+ * @return void
+ */
+static void
+survey_mds_jacobi(float * a, float * v, uint16_t n)
+{
+    float scale = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        for (uint16_t j = 0; j < n; j++) {
+            v[i*n + j] = (i == j) ? 1.0f : 0;
+            scale += a[i*n + j] * a[i*n + j];
+        }
+    }
+
+    for (uint16_t sweep = 0; sweep < 32; sweep++) {
+        float off = 0;
+        for (uint16_t p = 0; p < n; p++)
+            for (uint16_t q = p + 1; q < n; q++)
+                off += a[p*n + q] * a[p*n + q];
+        if (off <= 1e-12f * scale)
+            break;
+
+        for (uint16_t p = 0; p < n; p++) {
+            for (uint16_t q = p + 1; q < n; q++) {
+                float apq = a[p*n + q];
+                if (apq == 0)
+                    continue;
+                float theta = (a[q*n + q] - a[p*n + p]) / (2.0f * apq);
+                float t = ((theta < 0) ? -1.0f : 1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+                float c = 1.0f / sqrtf(t * t + 1.0f);
+                float s = t * c;
+                for (uint16_t k = 0; k < n; k++) {
+                    float akp = a[k*n + p], akq = a[k*n + q];
+                    a[k*n + p] = c * akp - s * akq;
+                    a[k*n + q] = s * akp + c * akq;
+                }
+                for (uint16_t k = 0; k < n; k++) {
+                    float apk = a[p*n + k], aqk = a[q*n + k];
+                    a[p*n + k] = c * apk - s * aqk;
+                    a[q*n + k] = s * apk + c * aqk;
+                }
+                for (uint16_t k = 0; k < n; k++) {
+                    float vkp = v[k*n + p], vkq = v[k*n + q];
+                    v[k*n + p] = c * vkp - s * vkq;
+                    v[k*n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @fn survey_mds_horn(float p[][3], float q[][3], uint16_t m, float r[3][3])
+ * @brief Rotation best mapping the centred points p onto the centred points q (Horn 1987).
+ *
+ * @param p  Points, centred.
+ * @param q  Target points, centred.
+ * @param m  Number of points.
+ * @param r  Output rotation.
+ *
+ * @return sum of squared distances after rotation
+ */
+static float
+survey_mds_horn(float p[][3], float q[][3], uint16_t m, float r[3][3])
+{
+    float s[3][3] = {{0}};
+    for (uint16_t k = 0; k < m; k++)
+        for (uint16_t i = 0; i < 3; i++)
+            for (uint16_t j = 0; j < 3; j++)
+                s[i][j] += p[k][i] * q[k][j];
+
+    float n[16] = {
+        s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0],
+        s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2],
+        s[2][0] - s[0][2], s[0][1] + s[1][0], -s[0][0] + s[1][1] - s[2][2], s[1][2] + s[2][1],
+        s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], -s[0][0] - s[1][1] + s[2][2]
+    };
+    float v[16];
+    survey_mds_jacobi(n, v, 4);
+
+    uint16_t best = 0;
+    for (uint16_t i = 1; i < 4; i++)
+        if (n[i*4 + i] > n[best*4 + best])
+            best = i;
+    float w = v[0*4 + best], x = v[1*4 + best], y = v[2*4 + best], z = v[3*4 + best];
+
+    r[0][0] = w*w + x*x - y*y - z*z; r[0][1] = 2*(x*y - w*z);         r[0][2] = 2*(x*z + w*y);
+    r[1][0] = 2*(x*y + w*z);         r[1][1] = w*w - x*x + y*y - z*z; r[1][2] = 2*(y*z - w*x);
+    r[2][0] = 2*(x*z - w*y);         r[2][1] = 2*(y*z + w*x);         r[2][2] = w*w - x*x - y*y + z*z;
+
+    float err = 0;
+    for (uint16_t k = 0; k < m; k++) {
+        for (uint16_t i = 0; i < 3; i++) {
+            float e = r[i][0] * p[k][0] + r[i][1] * p[k][1] + r[i][2] * p[k][2] - q[k][i];
+            err += e * e;
+        }
+    }
+    return err;
+}
+
+/**
+ * @fn survey_mds_align(float x[][3], const uint16_t slot[], uint16_t n)
+ * @brief Move the MDS layout into the reference frame, mirroring it when that fits better.
+ *
+ * @param x     Layout, n nodes.
+ * @param slot  slot_id of each node.
+ * @param n     Number of nodes.
+ *
+ * @return void
+ */
+static void
+survey_mds_align(float x[][3], const uint16_t slot[], uint16_t n)
+{
+    float p[NNODES][3], q[NNODES][3];
+    float pc[3] = {0}, qc[3] = {0};
+    uint16_t m = 0;
+
+    for (uint16_t k = 0; k < n; k++) {
+        if (!(g_mds.ref_mask & (1U << slot[k])))
+            continue;
+        for (uint16_t i = 0; i < 3; i++) {
+            p[m][i] = (i < DIM) ? x[k][i] : 0;
+            q[m][i] = (i < DIM) ? g_mds.reference[slot[k]].array[i] : 0;
+            pc[i] += p[m][i];
+            qc[i] += q[m][i];
+        }
+        m++;
+    }
+    for (uint16_t i = 0; i < 3; i++) {
+        pc[i] /= m;
+        qc[i] /= m;
+    }
+    for (uint16_t k = 0; k < m; k++) {
+        for (uint16_t i = 0; i < 3; i++) {
+            p[k][i] -= pc[i];
+            q[k][i] -= qc[i];
+        }
+    }
+
+    float r[3][3], rm[3][3];
+    float err = survey_mds_horn(p, q, m, r);
+    for (uint16_t k = 0; k < m; k++)
+        p[k][0] = -p[k][0];
+    float sign = 1.0f;
+    if (survey_mds_horn(p, q, m, rm) < err) {
+        sign = -1.0f;
+        memcpy(r, rm, sizeof(r));
+    }
+
+    for (uint16_t k = 0; k < n; k++) {
+        float d[3] = {sign * (x[k][0] - pc[0]), x[k][1] - pc[1], (DIM == 3) ? x[k][2] - pc[2] : 0};
+        for (uint16_t i = 0; i < DIM; i++)
+            x[k][i] = r[i][0] * d[0] + r[i][1] * d[1] + r[i][2] * d[2] + qc[i];
+    }
+}
+
+/**
+ * @fn survey_mds_links(survey_instance_t * survey)
+ * @brief Combine both directions of every node pair of the survey matrix, weighting each by its number of
+ * ranges over their variance. The range bias of both nodes is taken off.
+ *
+ * @return uint16_t mask of the nodes with at least one link
+ */
+static uint16_t
+survey_mds_links(survey_instance_t * survey)
+{
+    float sigma = MYNEWT_VAL(SURVEY_MDS_SIGMA) / 100.0f;
+    uint16_t nnodes = (survey->nnodes < NNODES) ? survey->nnodes : NNODES;
+    uint16_t active = 0;
+
+    memset(g_mds.link, 0, sizeof(g_mds.link));
+    for (uint16_t i = 0; i < nnodes; i++) {
+        for (uint16_t j = i + 1; j < nnodes; j++) {
+            survey_link_t * link = &g_mds.link[i][j];
+            survey_cell_t * cells[] = {survey_cell(survey, i, j), survey_cell(survey, j, i)};
+            float sum = 0;
+            for (uint16_t c = 0; c < 2; c++) {
+                if (!survey_cell_valid(cells[c]) || cells[c]->mean <= 0 || cells[c]->mean > MYNEWT_VAL(SURVEY_MDS_MAX_RANGE))
+                    continue;
+                float w = cells[c]->num / (cells[c]->var * 1e-6f + sigma * sigma);
+                link->weight += w;
+                link->num += cells[c]->num;
+                sum += w * (cells[c]->mean - g_mds.bias[i] - g_mds.bias[j]);
+            }
+            if (link->num) {
+                link->mean = sum / link->weight;
+                active |= (1U << i) | (1U << j);
+            }
+        }
+    }
+    return active;
+}
+
+/**
+ * @fn survey_mds_solve(survey_instance_t * survey)
+ * @brief Place the surveyed nodes, see file description.
+ *
+ * @param survey  survey instance holding the range matrix.
+ *
+ * @return OS_OK, OS_EINVAL with fewer than SURVEY_MDS_DIM + 1 nodes or a disconnected network
+ */
+int
+survey_mds_solve(survey_instance_t * survey)
+{
+    static float a[NNODES * NNODES], v[NNODES * NNODES];
+    float d[NNODES][NNODES], x[NNODES][3];
+    uint16_t slot[NNODES], n = 0, fixed = 0;
+    uint16_t active = survey_mds_links(survey);
+    for (uint16_t i = 0; i < NNODES; i++)
+        if (active & (1U << i))
+            slot[n++] = i;
+    if (n < DIM + 1)
+        return OS_EINVAL;
+
+    // Distances, unmeasured links by the shortest path through measured ones
+    for (uint16_t k = 0; k < n; k++)
+        for (uint16_t l = 0; l < n; l++) {
+            survey_link_t * link = survey_mds_link(slot[k], slot[l]);
+            d[k][l] = (k == l) ? 0 : (link->num) ? link->mean : INFINITY;
+        }
+    for (uint16_t m = 0; m < n; m++)
+        for (uint16_t k = 0; k < n; k++)
+            for (uint16_t l = 0; l < n; l++)
+                if (d[k][m] + d[m][l] < d[k][l])
+                    d[k][l] = d[k][m] + d[m][l];
+
+    // Double centring of the squared distances
+    float row[NNODES], total = 0;
+    for (uint16_t k = 0; k < n; k++) {
+        row[k] = 0;
+        for (uint16_t l = 0; l < n; l++) {
+            if (isinf(d[k][l]))
+                return OS_EINVAL;
+            row[k] += d[k][l] * d[k][l];
+        }
+        row[k] /= n;
+        total += row[k];
+    }
+    total /= n;
+    for (uint16_t k = 0; k < n; k++)
+        for (uint16_t l = 0; l < n; l++)
+            a[k*n + l] = -0.5f * (d[k][l] * d[k][l] - row[k] - row[l] + total);
+
+    survey_mds_jacobi(a, v, n);
+    uint16_t used = 0;
+    for (uint16_t i = 0; i < 3; i++) {
+        if (i >= DIM) {
+            for (uint16_t k = 0; k < n; k++)
+                x[k][i] = 0;
+            continue;
+        }
+        int16_t best = -1;
+        for (uint16_t e = 0; e < n; e++)
+            if (!(used & (1U << e)) && (best < 0 || a[e*n + e] > a[best*n + best]))
+                best = e;
+        used |= 1U << best;
+        float lambda = (a[best*n + best] > 0) ? sqrtf(a[best*n + best]) : 0;
+        for (uint16_t k = 0; k < n; k++)
+            x[k][i] = v[k*n + best] * lambda;
+    }
+
+    // Reference frame, the reference nodes are held at their positions
+    uint16_t nref = 0;
+    float height = 0;
+    for (uint16_t k = 0; k < n; k++)
+        if (g_mds.ref_mask & (1U << slot[k])) {
+            nref++;
+            height += g_mds.reference[slot[k]].z;
+        }
+    g_mds.aligned = nref >= DIM;
+    if (g_mds.aligned) {
+        survey_mds_align(x, slot, n);
+        for (uint16_t k = 0; k < n; k++) {
+            if (g_mds.ref_mask & (1U << slot[k])) {
+                fixed |= 1U << k;
+                for (uint16_t i = 0; i < 3; i++)
+                    x[k][i] = g_mds.reference[slot[k]].array[i];
+            } else if (DIM == 2) {
+                x[k][2] = height / nref;    // Nodes assumed at the mean reference height
+            }
+        }
+    }
+
+    // Weighted least squares, one Gauss-Newton step per node and sweep
+    for (uint16_t it = 0; it < MYNEWT_VAL(SURVEY_MDS_ITERATIONS); it++) {
+        for (uint16_t k = 0; k < n; k++) {
+            if (fixed & (1U << k))
+                continue;
+            float h[3][3] = {{0}}, b[3] = {0};
+            for (uint16_t l = 0; l < n; l++) {
+                survey_link_t * link = survey_mds_link(slot[k], slot[l]);
+                if (link == NULL || link->num == 0)
+                    continue;
+                float u[3] = {0}, r = 0;
+                for (uint16_t i = 0; i < DIM; i++) {
+                    u[i] = x[k][i] - x[l][i];
+                    r += u[i] * u[i];
+                }
+                r = sqrtf(r);
+                if (r < 1e-3f)
+                    continue;
+                float w = link->weight;
+                float e = link->mean - r;
+                for (uint16_t i = 0; i < 3; i++) {
+                    u[i] /= r;
+                    b[i] += w * u[i] * e;
+                }
+                for (uint16_t i = 0; i < 3; i++)
+                    for (uint16_t j = 0; j < 3; j++)
+                        h[i][j] += w * u[i] * u[j];
+            }
+            if (DIM == 2)
+                h[2][2] = 1.0f;
+            float det = h[0][0] * (h[1][1] * h[2][2] - h[1][2] * h[2][1])
+                      - h[0][1] * (h[1][0] * h[2][2] - h[1][2] * h[2][0])
+                      + h[0][2] * (h[1][0] * h[2][1] - h[1][1] * h[2][0]);
+            if (fabsf(det) < 1e-9f)
+                continue;
+            // Cramer's rule
+            float dx = (b[0] * (h[1][1] * h[2][2] - h[1][2] * h[2][1])
+                      - h[0][1] * (b[1] * h[2][2] - h[1][2] * b[2])
+                      + h[0][2] * (b[1] * h[2][1] - h[1][1] * b[2])) / det;
+            float dy = (h[0][0] * (b[1] * h[2][2] - h[1][2] * b[2])
+                      - b[0] * (h[1][0] * h[2][2] - h[1][2] * h[2][0])
+                      + h[0][2] * (h[1][0] * b[2] - b[1] * h[2][0])) / det;
+            float dz = (h[0][0] * (h[1][1] * b[2] - b[1] * h[2][1])
+                      - h[0][1] * (h[1][0] * b[2] - b[1] * h[2][0])
+                      + b[0] * (h[1][0] * h[2][1] - h[1][1] * h[2][0])) / det;
+            x[k][0] += dx;
+            x[k][1] += dy;
+            if (DIM == 3)
+                x[k][2] += dz;
+        }
+    }
+
+    // Residuals
+    float sum_w[NNODES] = {0}, sum_r[NNODES] = {0};
+    for (uint16_t k = 0; k < n; k++) {
+        for (uint16_t l = k + 1; l < n; l++) {
+            survey_link_t * link = survey_mds_link(slot[k], slot[l]);
+            if (link->num == 0)
+                continue;
+            float r = 0;
+            for (uint16_t i = 0; i < DIM; i++)
+                r += (x[k][i] - x[l][i]) * (x[k][i] - x[l][i]);
+            link->residual = sqrtf(r) - link->mean;
+            float w = link->weight;
+            sum_w[k] += w; sum_w[l] += w;
+            sum_r[k] += w * link->residual * link->residual;
+            sum_r[l] += w * link->residual * link->residual;
+        }
+    }
+
+    g_mds.mask = active;
+    for (uint16_t k = 0; k < n; k++) {
+        for (uint16_t i = 0; i < 3; i++)
+            g_mds.position[slot[k]].array[i] = x[k][i];
+        g_mds.rms[slot[k]] = (sum_w[k] > 0) ? sqrtf(sum_r[k] / sum_w[k]) : 0;
+    }
+    return OS_OK;
+}
+
+#endif // MYNEWT_VAL(SURVEY_MDS)
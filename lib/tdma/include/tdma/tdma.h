@@ -50,12 +50,42 @@ extern "C" {
 #if MYNEWT_VAL(TDMA_STATS)
 STATS_SECT_START(tdma_stat_section)
     STATS_SECT_ENTRY(slot_timer_cnt)
+    STATS_SECT_ENTRY(slot_timer_late)
     STATS_SECT_ENTRY(superframe_cnt)
     STATS_SECT_ENTRY(rx_complete)
     STATS_SECT_ENTRY(tx_complete)
+    STATS_SECT_ENTRY(holdover)
 STATS_SECT_END
 #endif
 
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+//! Histograms over all slots. margin_X counts handlers starting less than X before their slot, handler_X runs shorter than X
+STATS_SECT_START(tdma_slot_stat_section)
+    STATS_SECT_ENTRY(margin_late)
+    STATS_SECT_ENTRY(margin_50us)
+    STATS_SECT_ENTRY(margin_100us)
+    STATS_SECT_ENTRY(margin_200us)
+    STATS_SECT_ENTRY(margin_400us)
+    STATS_SECT_ENTRY(margin_800us)
+    STATS_SECT_ENTRY(margin_long)
+    STATS_SECT_ENTRY(handler_50us)
+    STATS_SECT_ENTRY(handler_100us)
+    STATS_SECT_ENTRY(handler_200us)
+    STATS_SECT_ENTRY(handler_400us)
+    STATS_SECT_ENTRY(handler_800us)
+    STATS_SECT_ENTRY(handler_long)
+    STATS_SECT_ENTRY(deadline_miss)
+STATS_SECT_END
+
+//! Timing quality of one slot
+typedef struct _tdma_slot_metrics_t{
+    uint32_t cnt;                      //!< Handler runs
+    uint32_t miss;                     //!< Runs that missed the DW1000 deadline (start_tx_error or start_rx_error)
+    int32_t margin_min;                //!< Smallest time from handler start to slot start in usec, negative when late
+    uint32_t handler_max;              //!< Longest handler run in usec
+}tdma_slot_metrics_t;
+#endif
+
 //! Structure of TDMA
 typedef struct _tdma_status_t{
     uint16_t selfmalloc:1;            //!< Internal flag for memory garbage collection
@@ -63,13 +93,30 @@ typedef struct _tdma_status_t{
     uint16_t awaiting_superframe:1;   //!< Superframe of tdma
 }tdma_status_t;
 
+//! Slot timing, recomputed on every superframe from the latest ccp update
+typedef struct _tdma_timing_t{
+    uint64_t epoch;                    //!< Superframe epoch in local DTU (ccp->local_epoch)
+    uint64_t slot_dtu_q16;             //!< Skew corrected slot duration in DTU, Q16
+    uint64_t shr_dtu;                  //!< Preamble and SFD duration in DTU, rx slots open this much earlier
+    uint32_t os_epoch;                 //!< Superframe epoch in cputime ticks
+    uint64_t os_slot_usecs_q16;        //!< Slot duration in usecs, Q16
+    uint32_t os_lead;                  //!< Ticks by which the slot timer precedes the slot (SHR and OS_LATENCY)
+    uint8_t seq_num;                   //!< Clock master sequence number of the superframe, selects the hyperframe phase
+}tdma_timing_t;
+
 //! Structure of tdma_slot
 typedef struct _tdma_slot_t{
     struct _tdma_instance_t * parent;  //!< Pointer to _tdma_instance_ti
-    struct hal_timer timer;            //!< Timer
     struct os_event event;             //!< Sturcture of event
+    os_event_fn * cb;                  //!< Slot handler
     uint16_t idx;                      //!< Slot number
+    uint8_t period;                    //!< Slot fires every period superframes, power of 2
+    uint8_t phase;                     //!< in the superframes where ccp seq_num % period == phase
     void * arg;                        //!< Optional argument
+    TAILQ_ENTRY(_tdma_slot_t) next;    //!< Next assigned slot in the schedule
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+    tdma_slot_metrics_t metrics;       //!< Timing quality
+#endif
 }tdma_slot_t; 
 
 //! Structure of tdma instance
@@ -80,13 +127,20 @@ typedef struct _tdma_instance_t{
 #endif
 #if MYNEWT_VAL(TDMA_STATS)
     STATS_SECT_DECL(tdma_stat_section) stat;  //!< Stats instance
+#endif
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+    STATS_SECT_DECL(tdma_slot_stat_section) slot_stat; //!< Slot timing histograms
 #endif
     tdma_status_t status;                    //!< Status of tdma 
     dw1000_mac_interface_t cbs;              //!< MAC Layer Callbacks
     struct os_mutex mutex;                   //!< Structure of os_mutex
-    uint16_t idx;                            //!< Slot number
+    uint16_t idx;                            //!< Slot number of the last slot fired
     uint16_t nslots;                         //!< Number of slots 
     uint32_t os_epoch;                       //!< Epoch timestamp
+    tdma_timing_t timing;                    //!< Slot timing of the current superframe
+    struct hal_timer slot_timer;             //!< Single timer, armed for the next due slot
+    TAILQ_HEAD(, _tdma_slot_t) schedule;     //!< Assigned slots sorted by slot number
+    struct _tdma_slot_t * next_slot;         //!< Next slot due in the current superframe, NULL when none
     struct os_event superframe_event;        //!< Structure of superframe_event
 #ifdef TDMA_TASKS_ENABLE
     struct os_eventq eventq;                 //!< Structure of os events
@@ -104,12 +158,34 @@ typedef struct _tdma_instance_t{
 struct _tdma_instance_t * tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots);
 void tdma_free(struct _tdma_instance_t * inst);
 void tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx, void * arg);
+void tdma_assign_slot_periodic(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx,
+        uint8_t period, uint8_t phase, void * arg);
 void tdma_release_slot(struct _tdma_instance_t * inst, uint16_t idx);
 void tdma_stop(struct _tdma_instance_t * tdma);
 
+void tdma_timing_update(struct _tdma_instance_t * tdma);
+void tdma_metrics_clear(struct _tdma_instance_t * tdma);
+int tdma_cli_register(void);
+
+uint64_t tdma_tx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16);
+uint64_t tdma_rx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16);
 uint64_t tdma_tx_slot_start(struct _tdma_instance_t * tdma, float idx);
 uint64_t tdma_rx_slot_start(struct _tdma_instance_t * tdma, float idx);
 
+//! Event queue the slot handlers run on
+static inline struct os_eventq *
+tdma_eventq(struct _tdma_instance_t * tdma)
+{
+#ifdef TDMA_TASKS_ENABLE
+    return &tdma->eventq;
+#else
+    return &tdma->dev_inst->eventq;
+#endif
+}
+
+//! Slot position in Q16 for the *_slot_start_q16 functions, sub-slot num/den into slot idx
+#define TDMA_SLOT_Q16(idx, num, den) (((uint32_t)(idx) << 16) + (((uint32_t)(num) << 16) / (den)))
+
 #ifdef __cplusplus
 }
 #endif
@@ -58,9 +58,11 @@
 #if MYNEWT_VAL(TDMA_STATS)
 STATS_NAME_START(tdma_stat_section)
     STATS_NAME(tdma_stat_section, slot_timer_cnt)
+    STATS_NAME(tdma_stat_section, slot_timer_late)
     STATS_NAME(tdma_stat_section, superframe_cnt)
     STATS_NAME(tdma_stat_section, rx_complete)
     STATS_NAME(tdma_stat_section, tx_complete)
+    STATS_NAME(tdma_stat_section, holdover)
 STATS_NAME_END(tdma_stat_section)
 
 #define TDMA_STATS_INC(__X) STATS_INC(tdma->stat, __X)
@@ -68,6 +70,31 @@ STATS_NAME_END(tdma_stat_section)
 #define TDMA_STATS_INC(__X) {}
 #endif
 
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+STATS_NAME_START(tdma_slot_stat_section)
+    STATS_NAME(tdma_slot_stat_section, margin_late)
+    STATS_NAME(tdma_slot_stat_section, margin_50us)
+    STATS_NAME(tdma_slot_stat_section, margin_100us)
+    STATS_NAME(tdma_slot_stat_section, margin_200us)
+    STATS_NAME(tdma_slot_stat_section, margin_400us)
+    STATS_NAME(tdma_slot_stat_section, margin_800us)
+    STATS_NAME(tdma_slot_stat_section, margin_long)
+    STATS_NAME(tdma_slot_stat_section, handler_50us)
+    STATS_NAME(tdma_slot_stat_section, handler_100us)
+    STATS_NAME(tdma_slot_stat_section, handler_200us)
+    STATS_NAME(tdma_slot_stat_section, handler_400us)
+    STATS_NAME(tdma_slot_stat_section, handler_800us)
+    STATS_NAME(tdma_slot_stat_section, handler_long)
+    STATS_NAME(tdma_slot_stat_section, deadline_miss)
+STATS_NAME_END(tdma_slot_stat_section)
+
+static void tdma_slot_dispatch(struct os_event * ev);
+#endif
+
+#if MYNEWT_VAL(DIAGLOG_DIAGMSG)
+#include <diaglog/diaglog.h>
+#define DIAGMSG(s,u) diaglog_msg(s,u)
+#endif
 //#define DIAGMSG(s,u) printf(s,u)
 #ifndef DIAGMSG
 #define DIAGMSG(s,u)
@@ -75,8 +102,10 @@ STATS_NAME_END(tdma_stat_section)
 
 static void tdma_superframe_event_cb(struct os_event * ev);
 static void slot_timer_cb(void * arg);
+static void slot_timer_arm(struct _tdma_instance_t * tdma);
 static bool rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
+static bool holdover_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 
 #ifdef TDMA_TASKS_ENABLE
 static void tdma_tasks_init(struct _tdma_instance_t * inst);
@@ -108,6 +137,8 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots)
         assert(err == OS_OK);
         tdma->nslots = nslots; 
         tdma->dev_inst = inst;
+        TAILQ_INIT(&tdma->schedule);
+        os_cputime_timer_init(&tdma->slot_timer, slot_timer_cb, (void *) tdma);
 #ifdef TDMA_TASKS_ENABLE
         tdma->task_prio = inst->task_prio + 0x6;
 #endif
@@ -117,7 +148,9 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots)
         .id = DW1000_TDMA,
         .inst_ptr = (void*)tdma,
         .tx_complete_cb = tx_complete_cb,
-        .rx_complete_cb = rx_complete_cb
+        .rx_complete_cb = rx_complete_cb,
+        .rx_timeout_cb = holdover_cb,
+        .rx_error_cb = holdover_cb
     };
     dw1000_mac_append_interface(inst, &tdma->cbs);
 
@@ -143,11 +176,31 @@ tdma_init(struct _dw1000_dev_instance_t * inst, uint16_t nslots)
     assert(rc == 0);
 #endif
 
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+    rc = stats_init(
+                STATS_HDR(tdma->slot_stat),
+                STATS_SIZE_INIT_PARMS(tdma->slot_stat, STATS_SIZE_32),
+                STATS_NAME_INIT_PARMS(tdma_slot_stat_section)
+            );
+    assert(rc == 0);
+
+#if  MYNEWT_VAL(DW1000_DEVICE_0) && !MYNEWT_VAL(DW1000_DEVICE_1)
+    rc = stats_register("tdma_slot", STATS_HDR(tdma->slot_stat));
+#elif  MYNEWT_VAL(DW1000_DEVICE_0) && MYNEWT_VAL(DW1000_DEVICE_1)
+    if (inst->idx == 0)
+        rc |= stats_register("tdma_slot0", STATS_HDR(tdma->slot_stat));
+    else
+        rc |= stats_register("tdma_slot1", STATS_HDR(tdma->slot_stat));
+#endif
+    assert(rc == 0);
+#endif
+
     tdma->superframe_event.ev_cb  = tdma_superframe_event_cb;
     tdma->superframe_event.ev_arg = (void *) tdma;
 
     tdma->status.initialized = true;
     tdma->os_epoch = os_cputime_get32();
+    tdma_timing_update(tdma);
 
 #ifdef TDMA_TASKS_ENABLE
     tdma_tasks_init(tdma);
@@ -193,6 +246,10 @@ void tdma_pkg_init(void){
 #if MYNEWT_VAL(DW1000_DEVICE_2)
         tdma_init(hal_dw1000_inst(2), MYNEWT_VAL(TDMA_NSLOTS));
 #endif
+#if MYNEWT_VAL(TDMA_CLI)
+    int rc = tdma_cli_register();
+    assert(rc == 0);
+#endif
 
 }
 
@@ -299,6 +356,36 @@ rx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     return false;
 }
 
+/**
+ * @fn holdover_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+ * @brief Interrupt context rx_timeout/rx_error callback. When ccp has just bridged a missed beacon (see
+ * dw1000_ccp_holdover) the superframe is started from the predicted epoch. ccp is ahead of tdma in the
+ * interface list, so its prediction is already in place here.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param cbs   Pointer to dw1000_mac_interface_t.
+ *
+ * @return bool false, tdma is an observer
+ */
+static bool
+holdover_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
+{
+    tdma_instance_t * tdma = (tdma_instance_t*)cbs->inst_ptr;
+    dw1000_ccp_instance_t *ccp = tdma->ccp;
+
+    /* An acting backup master starts the superframe from its tx_complete */
+    if (ccp->missed && !ccp->status.acting_master && ccp->os_epoch != tdma->os_epoch && tdma->status.initialized){
+        TDMA_STATS_INC(holdover);
+        tdma->os_epoch = ccp->os_epoch;
+#ifdef TDMA_TASKS_ENABLE
+        os_eventq_put(&tdma->eventq, &tdma->superframe_event);
+#else
+        os_eventq_put(&inst->eventq, &tdma->superframe_event);
+#endif
+    }
+    return false;
+}
+
 /**
  * @fn tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
  * @brief Interrupt context tdma_tx_complete callback. Used to define eopch for tdma actavities
@@ -314,7 +401,7 @@ tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     tdma_instance_t * tdma = (tdma_instance_t*)cbs->inst_ptr;
     dw1000_ccp_instance_t *ccp = tdma->ccp;
 
-    if (inst->fctrl_array[0] == FCNTL_IEEE_BLINK_CCP_64 && ccp->config.role == CCP_ROLE_MASTER){
+    if (inst->fctrl_array[0] == FCNTL_IEEE_BLINK_CCP_64 && (ccp->config.role == CCP_ROLE_MASTER || ccp->status.acting_master)){
         TDMA_STATS_INC(tx_complete);
         DIAGMSG("{\"utime\": %lu,\"msg\": \"tdma:tx_complete_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
         if (tdma != NULL && tdma->status.initialized){
@@ -330,9 +417,84 @@ tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
     return false;
 }
 
+/**
+ * @fn tdma_slot_active_from(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+ * @brief First slot of the schedule, starting at slot, that fires in the current superframe.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param slot  Starting point in the schedule, may be NULL.
+ *
+ * @return tdma_slot_t * or NULL
+ */
+static inline tdma_slot_t *
+tdma_slot_active_from(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+{
+    while (slot && (tdma->timing.seq_num & (slot->period - 1)) != slot->phase)
+        slot = TAILQ_NEXT(slot, next);
+    return slot;
+}
+
+/**
+ * @fn tdma_schedule_insert(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+ * @brief Insert a slot into the schedule, keeping it sorted by slot number. A slot inserted
+ * ahead of the pending slot of the current superframe, and not yet passed, takes its place.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param slot  Slot to insert.
+ *
+ * @return void
+ */
+static void
+tdma_schedule_insert(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+{
+    tdma_slot_t * cur;
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    TAILQ_FOREACH(cur, &tdma->schedule, next) {
+        if (cur->idx > slot->idx)
+            break;
+    }
+    if (cur)
+        TAILQ_INSERT_BEFORE(cur, slot, next);
+    else
+        TAILQ_INSERT_TAIL(&tdma->schedule, slot, next);
+    if (tdma->next_slot == cur && cur != NULL && slot->idx > tdma->idx
+        && tdma_slot_active_from(tdma, slot) == slot) {
+        os_cputime_timer_stop(&tdma->slot_timer);
+        tdma->next_slot = slot;
+        slot_timer_arm(tdma);
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+/**
+ * @fn tdma_schedule_remove(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+ * @brief Remove a slot from the schedule. If it is the pending slot the timer moves on to its successor.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param slot  Slot to remove.
+ *
+ * @return void
+ */
+static void
+tdma_schedule_remove(struct _tdma_instance_t * tdma, tdma_slot_t * slot)
+{
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    if (tdma->next_slot == slot) {
+        os_cputime_timer_stop(&tdma->slot_timer);
+        tdma->next_slot = tdma_slot_active_from(tdma, TAILQ_NEXT(slot, next));
+        if (tdma->next_slot)
+            slot_timer_arm(tdma);
+    }
+    TAILQ_REMOVE(&tdma->schedule, slot, next);
+    OS_EXIT_CRITICAL(sr);
+}
+
 /**
  * @fn tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx, void * arg)
- * @brief API to intialise slot instance for the slot.Also initialise a timer and assigns callback for each slot.
+ * @brief API to intialise slot instance for the slot, firing every superframe. The slot is added to the schedule
+ * served by the tdma slot timer.
  *
  * @param inst       Pointer to _tdma_instance_t.
  * @param call_back  Callback for the particular slot.
@@ -343,8 +505,31 @@ tx_complete_cb(struct _dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cb
  */
 void
 tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx, void * arg)
+{
+    tdma_assign_slot_periodic(inst, call_back, idx, 1, 0, arg);
+}
+
+/**
+ * @fn tdma_assign_slot_periodic(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx, uint8_t period, uint8_t phase, void * arg)
+ * @brief API to intialise a hyperframe slot, firing in every period-th superframe. The superframe is selected by the
+ * clock master sequence number so that all nodes agree on it, nodes with different phases can share the same slot number.
+ *
+ * @param inst       Pointer to _tdma_instance_t.
+ * @param call_back  Callback for the particular slot.
+ * @param idx        Slot number.
+ * @param period     Superframes between firings, power of 2 up to 128.
+ * @param phase      Fires when ccp seq_num % period == phase.
+ * @param arg        Argument to the callback.
+ *
+ * @return void
+ */
+void
+tdma_assign_slot_periodic(struct _tdma_instance_t * inst, void (* call_back )(struct os_event *), uint16_t idx,
+        uint8_t period, uint8_t phase, void * arg)
 {
     assert(idx < inst->nslots);
+    assert(period && (period & (period - 1)) == 0 && period <= 128);
+    assert(phase < period);
 
     if (inst->status.initialized == false)
        return;
@@ -352,17 +537,26 @@ tdma_assign_slot(struct _tdma_instance_t * inst, void (* call_back )(struct os_e
     if (inst->slot[idx] == NULL){
         inst->slot[idx] = (tdma_slot_t  *) malloc(sizeof(struct _tdma_slot_t));
         assert(inst->slot[idx]);
-        memset(inst->slot[idx], 0, sizeof(struct _tdma_slot_t));
     }else{
-        memset(inst->slot[idx], 0, sizeof(struct _tdma_slot_t));
+        tdma_schedule_remove(inst, inst->slot[idx]);
+        os_eventq_remove(tdma_eventq(inst), &inst->slot[idx]->event);
     }
+    memset(inst->slot[idx], 0, sizeof(struct _tdma_slot_t));
     inst->slot[idx]->idx = idx;
+    inst->slot[idx]->period = period;
+    inst->slot[idx]->phase = phase;
     inst->slot[idx]->parent = inst;
     inst->slot[idx]->arg = arg;
+    inst->slot[idx]->cb = call_back;
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+    inst->slot[idx]->metrics.margin_min = INT32_MAX;
+    inst->slot[idx]->event.ev_cb  = tdma_slot_dispatch;
+#else
     inst->slot[idx]->event.ev_cb  = call_back;
+#endif
     inst->slot[idx]->event.ev_arg = (void *) inst->slot[idx];
 
-    os_cputime_timer_init(&inst->slot[idx]->timer, slot_timer_cb, (void *) inst->slot[idx]);
+    tdma_schedule_insert(inst, inst->slot[idx]);
 }
 
 /**
@@ -379,16 +573,84 @@ tdma_release_slot(struct _tdma_instance_t * inst, uint16_t idx)
 {
     assert(idx < inst->nslots);
     if (inst->slot[idx]) {
-        os_cputime_timer_stop(&inst->slot[idx]->timer);
+        tdma_schedule_remove(inst, inst->slot[idx]);
+        os_eventq_remove(tdma_eventq(inst), &inst->slot[idx]->event);
         free(inst->slot[idx]);
         inst->slot[idx] =  NULL;
     }
 }
 
+/**
+ * @fn tdma_timing_update(struct _tdma_instance_t * tdma)
+ * @brief Recompute the slot timing from the latest ccp update. All floating point work of the slot
+ * timing, including the wcs skew correction, is done here once per superframe, the slot timer and
+ * the *_slot_start functions then only use integer arithmetic.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ *
+ * @return void
+ */
+void
+tdma_timing_update(struct _tdma_instance_t * tdma)
+{
+    dw1000_ccp_instance_t * ccp = tdma->ccp;
+    tdma_timing_t * timing = &tdma->timing;
+    float shr = dw1000_phy_SHR_duration(&tdma->dev_inst->attrib);
+
+    uint64_t slot_dtu_q16 = ((uint64_t)ccp->period << 32) / tdma->nslots;
+#if MYNEWT_VAL(WCS_ENABLED)
+    wcs_instance_t * wcs = ccp->wcs;
+    if (wcs->status.valid)
+        slot_dtu_q16 = (uint64_t) roundl(slot_dtu_q16 * wcs_dtu_time_correction(wcs));
+#endif
+    timing->epoch = ccp->local_epoch;
+    timing->seq_num = ccp->seq_num;
+    timing->slot_dtu_q16 = slot_dtu_q16;
+    timing->shr_dtu = (uint64_t)ceilf(dw1000_usecs_to_dwt_usecs(shr)) << 16;
+    timing->os_epoch = tdma->os_epoch;
+    timing->os_slot_usecs_q16 = (uint64_t)(dw1000_dwt_usecs_to_usecs(ccp->period/tdma->nslots) * 65536.0f);
+    timing->os_lead = os_cputime_usecs_to_ticks((uint32_t)ceilf(shr) + MYNEWT_VAL(OS_LATENCY));
+}
+
+/**
+ * @fn tdma_slot_os_time(struct _tdma_instance_t * tdma, uint16_t idx)
+ * @brief Cputime at which the slot event is posted, early by the preamble duration and OS_LATENCY.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ * @param idx   Slot number.
+ *
+ * @return uint32_t cputime ticks
+ */
+static uint32_t
+tdma_slot_os_time(struct _tdma_instance_t * tdma, uint16_t idx)
+{
+    tdma_timing_t * timing = &tdma->timing;
+    return timing->os_epoch
+        + os_cputime_usecs_to_ticks((uint32_t)((idx * timing->os_slot_usecs_q16) >> 16))
+        - timing->os_lead;
+}
+
+/**
+ * @fn slot_timer_arm(struct _tdma_instance_t * tdma)
+ * @brief Arm the slot timer for tdma->next_slot. A slot already overdue fires immediately.
+ *
+ * @param tdma  Pointer to _tdma_instance_t.
+ *
+ * @return void
+ */
+static void
+slot_timer_arm(struct _tdma_instance_t * tdma)
+{
+    uint32_t ticks = tdma_slot_os_time(tdma, tdma->next_slot->idx);
+    if ((int32_t)(ticks - os_cputime_get32()) < 0)
+        TDMA_STATS_INC(slot_timer_late);
+    hal_timer_start_at(&tdma->slot_timer, ticks);
+}
+
 /**
  * @fn tdma_superframe_event_cb(struct os_event * ev)
  * @brief This event is generated by ccp/clkcal complete event. This event defines the start of an superframe epoch.
- * The event also schedules a tdma_superframe_timer_cb which turns on the receiver in advance of the next superframe epoch.
+ * Only the first assigned slot is armed here, each slot timer expiry arms the next one in the schedule.
  *
  * @param ev   Pointer to os_event.
  *
@@ -401,34 +663,27 @@ tdma_superframe_event_cb(struct os_event * ev){
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"tdma_superframe_event_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
     tdma_instance_t * tdma = (void *)ev->ev_arg;
-    struct _dw1000_dev_instance_t * inst = tdma->dev_inst;
-    dw1000_ccp_instance_t * ccp = tdma->ccp;
-    
+    os_sr_t sr;
+
     TDMA_STATS_INC(superframe_cnt);
 
-    for (uint16_t i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            os_cputime_timer_stop(&tdma->slot[i]->timer);
-        }
-    }
-    for (uint16_t i = 0; i < tdma->nslots; i++) {
-        if (tdma->slot[i]){
-            hal_timer_start_at(&tdma->slot[i]->timer, tdma->os_epoch
-                + os_cputime_usecs_to_ticks(
-                    (uint32_t) (i * dw1000_dwt_usecs_to_usecs(ccp->period/tdma->nslots))
-                    - (uint32_t)ceilf(dw1000_phy_SHR_duration(&inst->attrib)) 
-                    - MYNEWT_VAL(OS_LATENCY))
-            );
-        }
-    }
+    tdma_timing_update(tdma);
+
+    OS_ENTER_CRITICAL(sr);
+    os_cputime_timer_stop(&tdma->slot_timer);
+    tdma->idx = 0;
+    tdma->next_slot = tdma_slot_active_from(tdma, TAILQ_FIRST(&tdma->schedule));
+    if (tdma->next_slot)
+        slot_timer_arm(tdma);
+    OS_EXIT_CRITICAL(sr);
 }
 
 /**
  * @fn slot_timer_cb(void * arg)
- * @brief API for each slot. This function then puts
- * the callback provided by the user in the tdma event queue.
+ * @brief Slot timer expiry. Puts the callback of the due slot provided by the user
+ * in the tdma event queue and re-arms the timer for the next slot in the schedule.
  *
- * @param arg    A void type argument.
+ * @param arg    Pointer to _tdma_instance_t.
  *
  * @return void
  */
@@ -437,21 +692,105 @@ slot_timer_cb(void * arg)
 {
     assert(arg);
 
-    tdma_slot_t * slot = (tdma_slot_t *) arg;
-    /* No point in continuing if this slot is NULL */
+    tdma_instance_t * tdma = (tdma_instance_t *) arg;
+    tdma_slot_t * slot = tdma->next_slot;
+    /* No point in continuing if the slot was released */
     if (slot == NULL) {
         return;
     }
-    tdma_instance_t * tdma = slot->parent;
+    tdma->idx = slot->idx;
+    tdma->next_slot = tdma_slot_active_from(tdma, TAILQ_NEXT(slot, next));
+    if (tdma->next_slot)
+        slot_timer_arm(tdma);
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"slot_timer_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
     TDMA_STATS_INC(slot_timer_cnt);
 
-#ifdef TDMA_TASKS_ENABLE
-    os_eventq_put(&tdma->eventq, &slot->event);
-#else
-    os_eventq_put(&tdma->dev_inst->eventq, &slot->event);
+    os_eventq_put(tdma_eventq(tdma), &slot->event);
+}
+
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+/**
+ * @fn tdma_slot_dispatch(struct os_event * ev)
+ * @brief Runs the slot handler provided by the user and records how far ahead of the slot start it began,
+ * how long it took and whether the delayed tx/rx it scheduled missed the DW1000 deadline.
+ *
+ * @param ev   Pointer to os_event, ev_arg is the slot.
+ *
+ * @return void
+ */
+static void
+tdma_slot_dispatch(struct os_event * ev)
+{
+    tdma_slot_t * slot = (tdma_slot_t *) ev->ev_arg;
+    tdma_instance_t * tdma = slot->parent;
+    dw1000_dev_instance_t * inst = tdma->dev_inst;
+    tdma_slot_metrics_t * metrics = &slot->metrics;
+
+    uint16_t idx = slot->idx;
+    uint32_t start = os_cputime_get32();
+    int32_t margin = (int32_t)(tdma_slot_os_time(tdma, idx) + tdma->timing.os_lead - start);
+    margin = (margin < 0) ? -(int32_t)os_cputime_ticks_to_usecs(-margin) : (int32_t)os_cputime_ticks_to_usecs(margin);
+
+    // status shares its word with bits the interrupt handler sets, clear ours without racing it
+    os_sr_t sr;
+    OS_ENTER_CRITICAL(sr);
+    inst->status.start_tx_error = 0;
+    inst->status.start_rx_error = 0;
+    OS_EXIT_CRITICAL(sr);
+    slot->cb(ev);
+    uint32_t handler = os_cputime_ticks_to_usecs(os_cputime_get32() - start);
+    bool miss = inst->status.start_tx_error || inst->status.start_rx_error;
+
+    if (margin < 0) STATS_INC(tdma->slot_stat, margin_late);
+    else if (margin < 50) STATS_INC(tdma->slot_stat, margin_50us);
+    else if (margin < 100) STATS_INC(tdma->slot_stat, margin_100us);
+    else if (margin < 200) STATS_INC(tdma->slot_stat, margin_200us);
+    else if (margin < 400) STATS_INC(tdma->slot_stat, margin_400us);
+    else if (margin < 800) STATS_INC(tdma->slot_stat, margin_800us);
+    else STATS_INC(tdma->slot_stat, margin_long);
+
+    if (handler < 50) STATS_INC(tdma->slot_stat, handler_50us);
+    else if (handler < 100) STATS_INC(tdma->slot_stat, handler_100us);
+    else if (handler < 200) STATS_INC(tdma->slot_stat, handler_200us);
+    else if (handler < 400) STATS_INC(tdma->slot_stat, handler_400us);
+    else if (handler < 800) STATS_INC(tdma->slot_stat, handler_800us);
+    else STATS_INC(tdma->slot_stat, handler_long);
+
+    if (miss) STATS_INC(tdma->slot_stat, deadline_miss);
+
+    /* The handler may have released its own slot */
+    if (tdma->slot[idx] != slot)
+        return;
+    metrics->cnt++;
+    metrics->miss += miss;
+    if (margin < metrics->margin_min)
+        metrics->margin_min = margin;
+    if (handler > metrics->handler_max)
+        metrics->handler_max = handler;
+}
+#endif
+
+/**
+ * @fn tdma_metrics_clear(struct _tdma_instance_t * tdma)
+ * @brief API to restart the slot timing metrics, per slot and histograms.
+ *
+ * @param tdma      Pointer to _tdma_instance_t.
+ *
+ * @return void
+ */
+void
+tdma_metrics_clear(struct _tdma_instance_t * tdma)
+{
+#if MYNEWT_VAL(TDMA_SLOT_METRICS)
+    for (uint16_t i = 0; i < tdma->nslots; i++) {
+        if (tdma->slot[i]) {
+            memset(&tdma->slot[i]->metrics, 0, sizeof(tdma_slot_metrics_t));
+            tdma->slot[i]->metrics.margin_min = INT32_MAX;
+        }
+    }
+    stats_reset(STATS_HDR(tdma->slot_stat));
 #endif
 }
 
@@ -466,15 +805,49 @@ slot_timer_cb(void * arg)
 void
 tdma_stop(struct _tdma_instance_t * tdma)
 {
+    os_cputime_timer_stop(&tdma->slot_timer);
     for (uint16_t i = 0; i < tdma->nslots; i++) {
         if (tdma->slot[i]){
-            os_cputime_timer_stop(&tdma->slot[i]->timer);
             tdma_release_slot(tdma, i);
         }
     }
 }
 
 
+/**
+ * @fn tdma_tx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16)
+ * @brief Start of a slot or sub-slot position for a tx operation, integer only.
+ *
+ * @param tdma      Pointer to _tdma_instance_t.
+ * @param idx_q16   Slot position in Q16, see TDMA_SLOT_Q16().
+ *
+ * @return dx_time   The time for a tx operation to start
+ */
+uint64_t
+tdma_tx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16)
+{
+    tdma_timing_t * timing = &tdma->timing;
+    uint64_t offset = (((idx_q16 >> 16) * timing->slot_dtu_q16) >> 16)
+                    + (((idx_q16 & 0xffff) * (timing->slot_dtu_q16 >> 16)) >> 16);
+    return timing->epoch + offset;
+}
+
+/**
+ * @fn tdma_rx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16)
+ * @brief Start of a slot or sub-slot position for a rx operation, integer only. The receiver
+ * is turned on ahead of the RMARKER by the preamble duration.
+ *
+ * @param tdma      Pointer to _tdma_instance_t.
+ * @param idx_q16   Slot position in Q16, see TDMA_SLOT_Q16().
+ *
+ * @return dx_time   The time for a rx operation to start
+ */
+uint64_t
+tdma_rx_slot_start_q16(struct _tdma_instance_t * tdma, uint32_t idx_q16)
+{
+    return tdma_tx_slot_start_q16(tdma, idx_q16) - tdma->timing.shr_dtu;
+}
+
 /**
  * Function for calculating the start of the slot for a tx operation
  *
@@ -486,16 +859,7 @@ tdma_stop(struct _tdma_instance_t * tdma)
 uint64_t
 tdma_tx_slot_start(struct _tdma_instance_t * tdma, float idx)
 {
-    dw1000_ccp_instance_t * ccp = tdma->ccp;
-
-#if MYNEWT_VAL(WCS_ENABLED)
-    wcs_instance_t * wcs = ccp->wcs;
-    uint64_t dx_time = (ccp->local_epoch + (uint64_t) wcs_dtu_time_adjust(wcs, ((idx * ((uint64_t)ccp->period << 16))/tdma->nslots)));
-    // uint64_t dx_time = (ccp->local_epoch + (uint64_t) roundf((1.0l + wcs->skew) * (double)((idx * (uint64_t)ccp->period * 65536)/tdma->nslots)));
-#else
-    uint64_t dx_time = (ccp->local_epoch + (uint64_t) ((idx * ((uint64_t)ccp->period << 16)/tdma->nslots)));
-#endif
-    return dx_time;
+    return tdma_tx_slot_start_q16(tdma, (uint32_t)(idx * 65536.0f));
 }
 
 /**
@@ -511,7 +875,5 @@ tdma_tx_slot_start(struct _tdma_instance_t * tdma, float idx)
 uint64_t
 tdma_rx_slot_start(struct _tdma_instance_t * tdma, float idx)
 {
-    uint64_t dx_time = tdma_tx_slot_start(tdma, idx);
-    dx_time = (dx_time - ((uint64_t)ceilf(dw1000_usecs_to_dwt_usecs(dw1000_phy_SHR_duration(&tdma->dev_inst->attrib))) << 16));
-    return dx_time;
+    return tdma_rx_slot_start_q16(tdma, (uint32_t)(idx * 65536.0f));
 }
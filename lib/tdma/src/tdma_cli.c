@@ -0,0 +1,109 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <os/mynewt.h>
+#include <syscfg/syscfg.h>
+
+#if MYNEWT_VAL(TDMA_CLI)
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <shell/shell.h>
+#include <console/console.h>
+
+#include <dw1000/dw1000_hal.h>
+#include <tdma/tdma.h>
+
+// Instances hal_dw1000_inst() hands out
+#if MYNEWT_VAL(DW1000_DEVICE_1)
+#define TDMA_CLI_NDEVICES 2
+#else
+#define TDMA_CLI_NDEVICES 1
+#endif
+
+static int tdma_cli_cmd(int argc, char **argv);
+
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+const struct shell_param cmd_tdma_param[] = {
+    {"slots [inst]", "per slot timing, margin to slot start and handler time in usec"},
+    {"clear [inst]", "restart slot metrics"},
+    {NULL,NULL},
+};
+
+const struct shell_cmd_help cmd_tdma_help = {
+	"tdma", "<cmd>", cmd_tdma_param
+};
+#endif
+
+static struct shell_cmd shell_tdma_cmd = {
+    .sc_cmd = "tdma",
+    .sc_cmd_func = tdma_cli_cmd,
+#if MYNEWT_VAL(SHELL_CMD_HELP)
+    .help = &cmd_tdma_help
+#endif
+};
+
+static void
+slots(tdma_instance_t * tdma)
+{
+    console_printf("#idx, period:phase, cnt, miss, margin_min, handler_max\n");
+    for (uint16_t i = 0; i < tdma->nslots; i++) {
+        tdma_slot_t * slot = tdma->slot[i];
+        if (slot == NULL)
+            continue;
+        tdma_slot_metrics_t * m = &slot->metrics;
+        console_printf("%4d, %d:%d, %lu, %lu, %ld, %lu\n", i, slot->period, slot->phase,
+                (unsigned long)m->cnt, (unsigned long)m->miss,
+                (long)((m->cnt) ? m->margin_min : 0), (unsigned long)m->handler_max);
+    }
+}
+
+static int
+tdma_cli_cmd(int argc, char **argv)
+{
+    if (argc < 2) {
+        return 0;
+    }
+    uint16_t idx = (argc > 2) ? strtol(argv[2], NULL, 0) : 0;
+    if (idx >= TDMA_CLI_NDEVICES) {
+        console_printf("Invalid device\n");
+        return 0;
+    }
+    tdma_instance_t * tdma = (tdma_instance_t *)dw1000_mac_find_cb_inst_ptr(hal_dw1000_inst(idx), DW1000_TDMA);
+    if (tdma == NULL) {
+        console_printf("No tdma instance\n");
+        return 0;
+    }
+    if (!strcmp(argv[1], "slots")) {
+        slots(tdma);
+    } else if (!strcmp(argv[1], "clear")) {
+        tdma_metrics_clear(tdma);
+    } else {
+        console_printf("Unknown cmd\n");
+    }
+    return 0;
+}
+
+int
+tdma_cli_register(void)
+{
+    return shell_cmd_register(&shell_tdma_cmd);
+}
+#endif /* MYNEWT_VAL(TDMA_CLI) */
@@ -21,15 +21,15 @@
 #define _TOFDB_H_
 
 #include <inttypes.h>
+#include <syscfg/syscfg.h>
 #include <bootutil/image.h>
 struct image_version;
 
 struct tofdb_node {
     uint16_t addr;           /*!< Local id, 16bit */
-    uint32_t last_updated;
-    float tof;
-    float sum;
-    float sum_sq;
+    uint32_t last_updated;   /*!< cputime of the last measurement */
+    float tof;               /*!< Running mean */
+    float m2;                /*!< Sum of squared deviations from the mean */
     uint32_t num;
 };
 
@@ -39,6 +39,13 @@ extern "C" {
 
 int tofdb_get_tof(uint16_t addr, uint32_t *tof);
 int tofdb_set_tof(uint16_t addr, uint32_t tof);
+int tofdb_remove(uint16_t addr);
+void tofdb_expire(void);
+float tofdb_node_variance(struct tofdb_node *node);
+struct tofdb_node* tofdb_get_nodes();
+#if MYNEWT_VAL(TOFDB_FCB)
+int tofdb_save(void);
+#endif
     
 #ifdef __cplusplus
 }
@@ -0,0 +1,65 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tofdb_anchor.h
+ * @brief Tag side anchor selection
+ *
+ * @details Anchors are kept by nrng slot_id with their position and link statistics from recent
+ * exchanges. tofdb_anchor_select() returns the slot_mask of the K anchors giving the lowest link
+ * weighted GDOP around the current position, to be passed to dw1000_nrng_request().
+ */
+
+#ifndef _TOFDB_ANCHOR_H_
+#define _TOFDB_ANCHOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <euclid/triad.h>
+#include <rng/slots.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _dw1000_nrng_instance_t;
+
+//! Anchor entry, indexed by slot_id
+struct tofdb_anchor {
+    uint16_t addr;           /*!< Short address, 0 for unused entries */
+    uint16_t has_position:1; /*!< Position is known */
+    uint16_t age:15;         /*!< Requests since the anchor was last included */
+    triad16_t position;      /*!< Position in cm */
+    float success;           /*!< Averaged response rate, 0.0 - 1.0 */
+    float fppl;              /*!< Averaged first path power level in dBm */
+    float los;               /*!< Averaged line of sight estimate, 0.0 - 1.0 */
+};
+
+int tofdb_anchor_set(uint16_t slot_id, uint16_t addr, float x, float y, float z);
+int tofdb_anchor_clear(uint16_t slot_id);
+struct tofdb_anchor * tofdb_anchor_get(uint16_t slot_id);
+slot_mask_t tofdb_anchor_update(struct _dw1000_nrng_instance_t * nrng, uint16_t base);
+slot_mask_t tofdb_anchor_select(slot_mask_t candidates, uint16_t k, const triadf_t * position, float * gdop);
+void tofdb_anchor_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TOFDB_ANCHOR_H_ */
@@ -6,11 +6,40 @@
 #include <ccp/ccp.h>
 #endif
 #include <tofdb/tofdb.h>
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+#include <tofdb/tofdb_anchor.h>
+#endif
 #include <dw1000/dw1000_hal.h>
+#if MYNEWT_VAL(TOFDB_FCB)
+#include <fcb/fcb.h>
+#include <flash_map/flash_map.h>
+#endif
+
+#if MYNEWT_VAL(TOFDB_HASH_SIZE) & (MYNEWT_VAL(TOFDB_HASH_SIZE) - 1)
+#error "TOFDB_HASH_SIZE must be a power of two"
+#endif
+#if MYNEWT_VAL(TOFDB_HASH_SIZE) <= MYNEWT_VAL(TOFDB_MAXNUM_NODES)
+#error "TOFDB_HASH_SIZE must exceed TOFDB_MAXNUM_NODES"
+#endif
+
+#define TOFDB_EMPTY 0xffff
+#define TOFDB_HASH_MASK (MYNEWT_VAL(TOFDB_HASH_SIZE) - 1)
 
 int tofdb_cli_register();
 
-static struct tofdb_node nodes[MYNEWT_VAL(TOFDB_MAXNUM_NODES)]; /* ca 18b/node */
+static struct tofdb_node nodes[MYNEWT_VAL(TOFDB_MAXNUM_NODES)]; /* ca 20b/node */
+/* Open addressing, linear probing, index into nodes[] keyed by addr */
+static uint16_t hash_idx[MYNEWT_VAL(TOFDB_HASH_SIZE)];
+/* Nodes in use from least to most recently updated, free nodes chained
+ * through lru_next from free_head, so allocation never scans nodes[] */
+static uint16_t lru_prev[MYNEWT_VAL(TOFDB_MAXNUM_NODES)];
+static uint16_t lru_next[MYNEWT_VAL(TOFDB_MAXNUM_NODES)];
+static uint16_t lru_head, lru_tail, free_head;
+
+#if MYNEWT_VAL(TOFDB_TIMEOUT)
+static uint32_t timeout_ticks;
+static struct os_callout expire_callout;
+#endif
 
 struct tofdb_node*
 tofdb_get_nodes()
@@ -18,70 +47,349 @@ tofdb_get_nodes()
     return nodes;
 }
 
+static inline uint16_t
+tofdb_hash(uint16_t addr)
+{
+    /* Fibonacci hashing, spreads consecutive addresses */
+    return ((addr * 2654435761UL) >> 16) & TOFDB_HASH_MASK;
+}
+
+/* Returns the hash position of addr or -1 */
+static int
+tofdb_lookup(uint16_t addr)
+{
+    uint16_t h = tofdb_hash(addr);
+    for (int n=0;n<MYNEWT_VAL(TOFDB_HASH_SIZE);n++) {
+        if (hash_idx[h] == TOFDB_EMPTY) {
+            break;
+        }
+        if (nodes[hash_idx[h]].addr == addr) {
+            return h;
+        }
+        h = (h+1) & TOFDB_HASH_MASK;
+    }
+    return -1;
+}
+
+static void
+tofdb_lru_remove(uint16_t i)
+{
+    if (lru_prev[i] == TOFDB_EMPTY) {
+        lru_head = lru_next[i];
+    } else {
+        lru_next[lru_prev[i]] = lru_next[i];
+    }
+    if (lru_next[i] == TOFDB_EMPTY) {
+        lru_tail = lru_prev[i];
+    } else {
+        lru_prev[lru_next[i]] = lru_prev[i];
+    }
+}
+
+/* Append node i as the most recently updated */
+static void
+tofdb_lru_append(uint16_t i)
+{
+    lru_prev[i] = lru_tail;
+    lru_next[i] = TOFDB_EMPTY;
+    if (lru_tail == TOFDB_EMPTY) {
+        lru_head = i;
+    } else {
+        lru_next[lru_tail] = i;
+    }
+    lru_tail = i;
+}
+
+static void
+tofdb_link(uint16_t i)
+{
+    uint16_t h = tofdb_hash(nodes[i].addr);
+    tofdb_lru_append(i);
+    while (hash_idx[h] != TOFDB_EMPTY) {
+        h = (h+1) & TOFDB_HASH_MASK;
+    }
+    hash_idx[h] = i;
+}
+
+/* Remove the node at hash position h, shifting back later entries of
+ * the probe sequence instead of leaving a tombstone */
+static void
+tofdb_unlink(uint16_t h)
+{
+    uint16_t j = h;
+    uint16_t i = hash_idx[h];
+
+    memset(&nodes[i], 0, sizeof(struct tofdb_node));
+    tofdb_lru_remove(i);
+    lru_next[i] = free_head;
+    free_head = i;
+    while (1) {
+        j = (j+1) & TOFDB_HASH_MASK;
+        if (hash_idx[j] == TOFDB_EMPTY) {
+            break;
+        }
+        uint16_t k = tofdb_hash(nodes[hash_idx[j]].addr);
+        /* Entry stays if its home position lies cyclically in (h, j] */
+        if ((h < j) ? (h < k && k <= j) : (h < k || k <= j)) {
+            continue;
+        }
+        hash_idx[h] = hash_idx[j];
+        h = j;
+    }
+    hash_idx[h] = TOFDB_EMPTY;
+}
+
+static bool
+tofdb_expired(struct tofdb_node *node, uint32_t now)
+{
+#if MYNEWT_VAL(TOFDB_TIMEOUT)
+    return (uint32_t)(now - node->last_updated) > timeout_ticks;
+#else
+    return false;
+#endif
+}
+
+/* Free node entry, evicting the least recently updated when full */
+static uint16_t
+tofdb_alloc(void)
+{
+    uint16_t i;
+
+    if (free_head == TOFDB_EMPTY) {
+        tofdb_unlink(tofdb_lookup(nodes[lru_head].addr));
+    }
+    i = free_head;
+    free_head = lru_next[i];
+    return i;
+}
+
 int tofdb_get_tof(uint16_t addr, uint32_t *tof)
 {
+    os_sr_t sr;
+    int h, rc = OS_ENOENT;
+
     if (!tof) {
         return OS_EINVAL;
     }
-    for (int i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
-        if (addr && addr == nodes[i].addr) {
-            *tof = (uint32_t)nodes[i].tof;
+    if (!addr) {
+        return OS_ENOENT;
+    }
+    OS_ENTER_CRITICAL(sr);
+    h = tofdb_lookup(addr);
+    if (h >= 0 && !tofdb_expired(&nodes[hash_idx[h]], os_cputime_get32())) {
+        *tof = (uint32_t)nodes[hash_idx[h]].tof;
+        rc = OS_OK;
+    }
+    OS_EXIT_CRITICAL(sr);
+    return rc;
+}
+
+int tofdb_set_tof(uint16_t addr, uint32_t tof)
+{
+    os_sr_t sr;
+    struct tofdb_node *node;
+    uint32_t now = os_cputime_get32();
+    int h;
+
+    if (!addr) {
+        return OS_EINVAL;
+    }
+    OS_ENTER_CRITICAL(sr);
+    h = tofdb_lookup(addr);
+    if (h >= 0 && tofdb_expired(&nodes[hash_idx[h]], now)) {
+        /* Stale statistics, start over */
+        tofdb_unlink(h);
+        h = -1;
+    }
+
+    if (h >= 0) {
+        node = &nodes[hash_idx[h]];
+        node->last_updated = now;
+        tofdb_lru_remove(hash_idx[h]);
+        tofdb_lru_append(hash_idx[h]);
+        float d = tof - node->tof;
+        if (fabsf(d) > (2.0f/0.047f)) {
+            /* Filter out measurements more than 2m from previous average */
             goto ret;
         }
+#if MYNEWT_VAL(TOFDB_MAXNUM_UPDATES) > 1
+        if (node->num > (MYNEWT_VAL(TOFDB_MAXNUM_UPDATES)-1)) {
+            goto ret;
+        }
+#endif
+        /* Welford's online mean and variance */
+        node->num++;
+        node->tof += d/node->num;
+        node->m2 += d*(tof - node->tof);
+        goto ret;
     }
-    return OS_ENOENT;
+
+    uint16_t i = tofdb_alloc();
+    node = &nodes[i];
+    node->addr = addr;
+    node->last_updated = now;
+    node->tof = tof;
+    node->m2 = 0;
+    node->num = 1;
+    tofdb_link(i);
 ret:
+    OS_EXIT_CRITICAL(sr);
     return OS_OK;
 }
 
-int tofdb_set_tof(uint16_t addr, uint32_t tof)
+int
+tofdb_remove(uint16_t addr)
 {
-    int i;
+    os_sr_t sr;
+    int h;
 
-    /* See if this entry exist in our database already */
-    for (i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
-        if (addr && addr == nodes[i].addr) {
-            float d = tof - nodes[i].tof;
-            if (fabsf(d) > (2.0f/0.047f)) {
-                /* Filter out measurements more than 2m from previous average */
-                goto ret;
-            }
-#if MYNEWT_VAL(TOFDB_MAXNUM_UPDATES) > 1
-            if (nodes[i].num > (MYNEWT_VAL(TOFDB_MAXNUM_UPDATES)-1)) {
-                goto ret;
-            }
-#endif
-            nodes[i].num++;
-            nodes[i].sum += tof;
-            nodes[i].sum_sq += (float)tof*(float)tof;
-            nodes[i].tof = nodes[i].sum/nodes[i].num;
+    OS_ENTER_CRITICAL(sr);
+    h = (addr) ? tofdb_lookup(addr) : -1;
+    if (h >= 0) {
+        tofdb_unlink(h);
+    }
+    OS_EXIT_CRITICAL(sr);
+    return (h >= 0) ? OS_OK : OS_ENOENT;
+}
 
-            nodes[i].last_updated = os_cputime_get32();
-            goto ret;
+/* Population variance of the tof estimates, in dwt units squared */
+float
+tofdb_node_variance(struct tofdb_node *node)
+{
+    return (node->num) ? node->m2/node->num : 0;
+}
+
+void
+tofdb_expire(void)
+{
+    os_sr_t sr;
+    uint32_t now = os_cputime_get32();
+
+    for (int i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
+        OS_ENTER_CRITICAL(sr);
+        if (nodes[i].addr && tofdb_expired(&nodes[i], now)) {
+            tofdb_unlink(tofdb_lookup(nodes[i].addr));
         }
+        OS_EXIT_CRITICAL(sr);
     }
+}
 
-    /* No match, look for a free spot */
-    for (i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
-        if (nodes[i].addr) {
-            continue;
+#if MYNEWT_VAL(TOFDB_TIMEOUT)
+static void
+expire_cb(struct os_event *ev)
+{
+    tofdb_expire();
+    /* Sweep well within the cputime wrap so no age is misread */
+    os_callout_reset(&expire_callout, (OS_TICKS_PER_SEC*MYNEWT_VAL(TOFDB_TIMEOUT))/4);
+}
+#endif
+
+#if MYNEWT_VAL(TOFDB_FCB)
+#define TOFDB_FCB_VERS 1
+
+/* Flash snapshot entry, last_updated is meaningless across a restart */
+struct tofdb_record {
+    uint16_t addr;
+    float tof;
+    float m2;
+    uint32_t num;
+} __attribute__((packed));
+
+static struct flash_area tofdb_fcb_area[MYNEWT_VAL(TOFDB_FCB_NUM_AREAS) + 1];
+static struct fcb tofdb_fcb = {
+    .f_magic = MYNEWT_VAL(TOFDB_FCB_MAGIC),
+    .f_version = TOFDB_FCB_VERS,
+    .f_sectors = tofdb_fcb_area,
+};
+
+static void
+tofdb_init_fcb(void)
+{
+    int cnt;
+    int rc;
+
+    rc = flash_area_to_sectors(MYNEWT_VAL(TOFDB_FCB_FLASH_AREA), &cnt, NULL);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+    SYSINIT_PANIC_ASSERT(
+        cnt <= sizeof(tofdb_fcb_area) / sizeof(tofdb_fcb_area[0]));
+    flash_area_to_sectors(
+        MYNEWT_VAL(TOFDB_FCB_FLASH_AREA), &cnt, tofdb_fcb_area);
+
+    tofdb_fcb.f_sector_cnt = cnt;
+    tofdb_fcb.f_scratch_cnt = 0;
+
+    rc = fcb_init(&tofdb_fcb);
+    if (rc) {
+        for (cnt = 0; cnt < tofdb_fcb.f_sector_cnt; cnt++) {
+            flash_area_erase(&tofdb_fcb_area[cnt], 0,
+                             tofdb_fcb_area[cnt].fa_size);
         }
-        
-        nodes[i].addr = addr;
-        nodes[i].last_updated = os_cputime_get32();
-        nodes[i].tof = tof;
-        nodes[i].sum = tof;
-        nodes[i].sum_sq = (float)tof*(float)tof;
-        nodes[i].num = 1;
-        goto ret;
+        rc = fcb_init(&tofdb_fcb);
     }
+    SYSINIT_PANIC_ASSERT(rc == 0);
+}
+
+static int
+fcb_load_cb(struct fcb_entry *loc, void *arg)
+{
+    struct tofdb_record rec;
+    uint32_t now = os_cputime_get32();
 
-    if (i==MYNEWT_VAL(TOFDB_MAXNUM_NODES)) {
-        return OS_ENOMEM;
+    if (loc->fe_data_len != sizeof(rec)) {
+        return 0;
+    }
+    if (flash_area_read(loc->fe_area, loc->fe_data_off, &rec, sizeof(rec))) {
+        return 0;
+    }
+    if (!rec.addr || tofdb_lookup(rec.addr) >= 0) {
+        return 0;
+    }
+    uint16_t i = tofdb_alloc();
+    nodes[i].addr = rec.addr;
+    nodes[i].last_updated = now;
+    nodes[i].tof = rec.tof;
+    nodes[i].m2 = rec.m2;
+    nodes[i].num = rec.num;
+    tofdb_link(i);
+    return 0;
+}
+
+/* Replace the flash snapshot with the current contents */
+int
+tofdb_save(void)
+{
+    os_sr_t sr;
+    struct tofdb_record rec;
+    struct fcb_entry loc;
+    int rc;
+
+    rc = fcb_clear(&tofdb_fcb);
+    if (rc) {
+        return OS_EINVAL;
+    }
+    for (int i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
+        OS_ENTER_CRITICAL(sr);
+        rec.addr = nodes[i].addr;
+        rec.tof = nodes[i].tof;
+        rec.m2 = nodes[i].m2;
+        rec.num = nodes[i].num;
+        OS_EXIT_CRITICAL(sr);
+        if (!rec.addr) {
+            continue;
+        }
+        rc = fcb_append(&tofdb_fcb, sizeof(rec), &loc);
+        if (rc) {
+            return (rc == FCB_ERR_NOSPACE) ? OS_ENOMEM : OS_EINVAL;
+        }
+        rc = flash_area_write(loc.fe_area, loc.fe_data_off, &rec, sizeof(rec));
+        if (rc) {
+            return OS_EINVAL;
+        }
+        fcb_append_finish(&tofdb_fcb, &loc);
     }
-ret:
     return OS_OK;
 }
+#endif
 
 uint32_t
 ccp_cb(uint16_t short_addr)
@@ -101,6 +409,24 @@ tofdb_pkg_init(void)
 #endif
 
     memset(nodes, 0, sizeof(nodes));
+    memset(hash_idx, 0xff, sizeof(hash_idx));
+    lru_head = lru_tail = TOFDB_EMPTY;
+    for (int i=0;i<MYNEWT_VAL(TOFDB_MAXNUM_NODES);i++) {
+        lru_next[i] = (i+1 < MYNEWT_VAL(TOFDB_MAXNUM_NODES)) ? i+1 : TOFDB_EMPTY;
+    }
+    free_head = 0;
+#if MYNEWT_VAL(TOFDB_TIMEOUT)
+    timeout_ticks = MYNEWT_VAL(TOFDB_TIMEOUT) * os_cputime_usecs_to_ticks(1000000);
+    os_callout_init(&expire_callout, os_eventq_dflt_get(), expire_cb, NULL);
+    os_callout_reset(&expire_callout, (OS_TICKS_PER_SEC*MYNEWT_VAL(TOFDB_TIMEOUT))/4);
+#endif
+#if MYNEWT_VAL(TOFDB_FCB)
+    tofdb_init_fcb();
+    fcb_walk(&tofdb_fcb, 0, fcb_load_cb, NULL);
+#endif
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+    tofdb_anchor_init();
+#endif
     /*  */
 #if MYNEWT_VAL(CCP_ENABLED)
     
@@ -0,0 +1,329 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tofdb_anchor.c
+ * @brief Tag side anchor selection
+ *
+ * @details After every nrng exchange tofdb_anchor_update() folds the outcome of each requested slot
+ * into running averages of the response rate, first path power and LOS estimate. tofdb_anchor_select()
+ * then grows the set of anchors greedily, each time adding the anchor that most reduces the trace of
+ * (H'WH)^-1, H being the unit vectors from the current position to the anchors and W the link weights.
+ * Anchors whose response rate fell below TOFDB_ANCHOR_MIN_SUCCESS are left out until they have not been
+ * requested for TOFDB_ANCHOR_RETRY exchanges, after which they are offered again as a probe.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <os/mynewt.h>
+#include <syscfg/syscfg.h>
+
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <nrng/nrng.h>
+#include <tofdb/tofdb_anchor.h>
+
+#if MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM) > 64
+#error "TOFDB_ANCHOR_MAXNUM exceeds the slot_mask_t width"
+#endif
+
+#define TOFDB_ANCHOR_ALPHA (1.0f / (1 << MYNEWT_VAL(TOFDB_ANCHOR_EWMA_SHIFT)))
+#define TOFDB_ANCHOR_EPS (1e-3f)        //!< Regularisation, keeps (H'WH) invertible below three anchors
+#define TOFDB_ANCHOR_RANGE_MAX (327.67f) //!< Largest coordinate in meters the int16 cm position holds
+
+static struct tofdb_anchor anchors[MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)];
+
+/**
+ * @fn tofdb_anchor_reset(struct tofdb_anchor * anchor)
+ * @brief Start the link statistics of an entry optimistic, an unknown anchor is worth a try.
+ *
+ * @return void
+ */
+static void
+tofdb_anchor_reset(struct tofdb_anchor * anchor)
+{
+    memset(anchor, 0, sizeof(*anchor));
+    anchor->success = 1.0f;
+    anchor->fppl = NAN;
+    anchor->los = 1.0f;
+}
+
+/**
+ * @fn tofdb_anchor_set(uint16_t slot_id, uint16_t addr, float x, float y, float z)
+ * @brief Enter the position of the anchor responding in slot_id.
+ *
+ * @param slot_id  nrng slot of the anchor.
+ * @param addr     Short address, 0 to keep the learned address.
+ * @param x,y,z    Position in meters, within +-TOFDB_ANCHOR_RANGE_MAX.
+ *
+ * @return OS_OK or OS_EINVAL for an unknown slot or a position the cm entry cannot hold
+ */
+int
+tofdb_anchor_set(uint16_t slot_id, uint16_t addr, float x, float y, float z)
+{
+    if (slot_id >= MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)) {
+        return OS_EINVAL;
+    }
+    if (!(fabsf(x) <= TOFDB_ANCHOR_RANGE_MAX && fabsf(y) <= TOFDB_ANCHOR_RANGE_MAX && fabsf(z) <= TOFDB_ANCHOR_RANGE_MAX)) {
+        return OS_EINVAL;
+    }
+    struct tofdb_anchor * anchor = &anchors[slot_id];
+    if (addr) {
+        anchor->addr = addr;
+    }
+    anchor->position.x = (int16_t) lroundf(x * 100.0f);
+    anchor->position.y = (int16_t) lroundf(y * 100.0f);
+    anchor->position.z = (int16_t) lroundf(z * 100.0f);
+    anchor->has_position = 1;
+    return OS_OK;
+}
+
+/**
+ * @fn tofdb_anchor_clear(uint16_t slot_id)
+ * @brief Forget position and link statistics of an anchor.
+ *
+ * @return OS_OK or OS_EINVAL
+ */
+int
+tofdb_anchor_clear(uint16_t slot_id)
+{
+    if (slot_id >= MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)) {
+        return OS_EINVAL;
+    }
+    tofdb_anchor_reset(&anchors[slot_id]);
+    return OS_OK;
+}
+
+/**
+ * @fn tofdb_anchor_get(uint16_t slot_id)
+ * @brief Anchor entry of slot_id.
+ *
+ * @return struct tofdb_anchor * or NULL
+ */
+struct tofdb_anchor *
+tofdb_anchor_get(uint16_t slot_id)
+{
+    return (slot_id < MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)) ? &anchors[slot_id] : NULL;
+}
+
+/**
+ * @fn tofdb_anchor_update(struct _dw1000_nrng_instance_t * nrng, uint16_t base)
+ * @brief Fold the outcome of the last request into the link statistics, call from the nrng
+ * complete callback with the same base as dw1000_nrng_get_ranges().
+ *
+ * @param nrng  nrng instance of the completed request.
+ * @param base  Index of the first frame of the request.
+ *
+ * @return slot_mask_t of the anchors that responded
+ */
+slot_mask_t
+tofdb_anchor_update(struct _dw1000_nrng_instance_t * nrng, uint16_t base)
+{
+    dw1000_dev_instance_t * inst = nrng->dev_inst;
+    slot_mask_t mask = 0;
+    uint16_t idx = 0;
+
+    for (slot_mask_t pending = nrng->slot_mask; pending; pending &= pending - 1, idx++) {
+        uint16_t slot_id = SlotFirst(pending);
+        if (slot_id >= MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)) {
+            break;
+        }
+        struct tofdb_anchor * anchor = &anchors[slot_id];
+        nrng_frame_t * frame = nrng->frames[(base + idx)%nrng->nframes];
+        anchor->age = 0;
+        if (frame->code != DWT_SS_TWR_NRNG_FINAL || frame->seq_num != nrng->seq_num) {
+            anchor->success -= TOFDB_ANCHOR_ALPHA * anchor->success;
+            continue;
+        }
+        mask |= (slot_mask_t)1 << slot_id;
+        anchor->success += TOFDB_ANCHOR_ALPHA * (1.0f - anchor->success);
+        if (anchor->addr == 0) {
+            anchor->addr = frame->dst_address;      // Swapped on reception, see nrng_encode()
+        }
+        if (inst->config.rxdiag_enable) {
+            float rssi = dw1000_calc_rssi(inst, &frame->diag);
+            float fppl = dw1000_calc_fppl(inst, &frame->diag);
+            if (isfinite(rssi) && isfinite(fppl)) {
+                anchor->fppl = isnan(anchor->fppl) ? fppl : anchor->fppl + TOFDB_ANCHOR_ALPHA * (fppl - anchor->fppl);
+                anchor->los += TOFDB_ANCHOR_ALPHA * (dw1000_estimate_los(rssi, fppl) - anchor->los);
+            }
+        }
+    }
+
+    for (uint16_t i = 0; i < MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM); i++) {
+        if (!(nrng->slot_mask & ((slot_mask_t)1 << i)) && anchors[i].age < 0x7fff) {
+            anchors[i].age++;
+        }
+    }
+    return mask;
+}
+
+/**
+ * @fn tofdb_anchor_weight(const struct tofdb_anchor * anchor)
+ * @brief Link weight, 0 excludes the anchor from selection.
+ *
+ * @return float
+ */
+static float
+tofdb_anchor_weight(const struct tofdb_anchor * anchor)
+{
+    float success = anchor->success;
+    if (success < MYNEWT_VAL(TOFDB_ANCHOR_MIN_SUCCESS) / 100.0f) {
+        if (anchor->age < MYNEWT_VAL(TOFDB_ANCHOR_RETRY)) {
+            return 0;
+        }
+        success = MYNEWT_VAL(TOFDB_ANCHOR_MIN_SUCCESS) / 100.0f;
+    }
+    // NLOS ranges are biased but still constrain the position, halve rather than drop them
+    float w = success * (0.5f + 0.5f * anchor->los);
+    if (!isnan(anchor->fppl)) {
+        // Range variance grows as the first path nears the noise floor, full weight 20dB above it
+        float margin = (anchor->fppl - MYNEWT_VAL(TOFDB_ANCHOR_FPPL_FLOOR)) / 20.0f;
+        w *= (margin > 1.0f) ? 1.0f : (margin < 0.1f) ? 0.1f : margin;
+    }
+    return w;
+}
+
+/**
+ * @fn tofdb_anchor_trace_inv(const float a[])
+ * @brief Trace of the inverse of a symmetric 3x3 matrix stored as a00, a01, a02, a11, a12, a22.
+ *
+ * @return float
+ */
+static float
+tofdb_anchor_trace_inv(const float a[])
+{
+    float c00 = a[3] * a[5] - a[4] * a[4];
+    float c11 = a[0] * a[5] - a[2] * a[2];
+    float c22 = a[0] * a[3] - a[1] * a[1];
+    float det = a[0] * c00 - a[1] * (a[1] * a[5] - a[4] * a[2]) + a[2] * (a[1] * a[4] - a[3] * a[2]);
+    return (c00 + c11 + c22) / det;
+}
+
+/**
+ * @fn tofdb_anchor_select(slot_mask_t candidates, uint16_t k, const triadf_t * position, float * gdop)
+ * @brief Pick the anchors for the next dw1000_nrng_request().
+ *
+ * @param candidates  Slots to choose from, e.g. those allocated in the cell.
+ * @param k           Number of anchors, 0 for TOFDB_ANCHOR_K.
+ * @param position    Current position estimate in meters, NULL for the centroid of the candidates.
+ * @param gdop        Output, weighted GDOP of the selection, may be NULL.
+ *
+ * Anchors without a position are appended by link weight when fewer than k have one.
+ *
+ * @return slot_mask_t of the selected anchors
+ */
+slot_mask_t
+tofdb_anchor_select(slot_mask_t candidates, uint16_t k, const triadf_t * position, float * gdop)
+{
+    float u[MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)][3];
+    float w[MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM)];
+    slot_mask_t eligible = 0, located = 0, selected = 0;
+    float p[3] = {0}, sum = 0;
+
+    if (k == 0) {
+        k = MYNEWT_VAL(TOFDB_ANCHOR_K);
+    }
+    for (uint16_t i = 0; i < MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM); i++) {
+        w[i] = (candidates & ((slot_mask_t)1 << i)) ? tofdb_anchor_weight(&anchors[i]) : 0;
+        if (w[i] == 0) {
+            continue;
+        }
+        eligible |= (slot_mask_t)1 << i;
+        if (anchors[i].has_position) {
+            located |= (slot_mask_t)1 << i;
+            for (uint16_t j = 0; j < 3; j++) {
+                u[i][j] = anchors[i].position.array[j] / 100.0f;
+                p[j] += w[i] * u[i][j];
+            }
+            sum += w[i];
+        }
+    }
+
+    if (position) {
+        p[0] = position->x; p[1] = position->y; p[2] = position->z;
+    } else if (sum > 0) {
+        p[0] /= sum; p[1] /= sum; p[2] /= sum;
+    }
+
+    for (slot_mask_t pending = located; pending; pending &= pending - 1) {
+        uint16_t i = SlotFirst(pending);
+        float d[3] = {u[i][0] - p[0], u[i][1] - p[1], u[i][2] - p[2]};
+        float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        for (uint16_t j = 0; j < 3; j++) {
+            u[i][j] = (r > 0.1f) ? d[j] / r : 0;    // No direction when on top of the anchor
+        }
+    }
+
+    float a[6] = {TOFDB_ANCHOR_EPS, 0, 0, TOFDB_ANCHOR_EPS, 0, TOFDB_ANCHOR_EPS};
+    float trace = tofdb_anchor_trace_inv(a);
+    for (uint16_t n = 0; n < k && (located & ~selected); n++) {
+        int16_t best = -1;
+        float best_a[6];
+        for (slot_mask_t pending = located & ~selected; pending; pending &= pending - 1) {
+            uint16_t i = SlotFirst(pending);
+            float t[6] = {
+                a[0] + w[i] * u[i][0] * u[i][0], a[1] + w[i] * u[i][0] * u[i][1], a[2] + w[i] * u[i][0] * u[i][2],
+                a[3] + w[i] * u[i][1] * u[i][1], a[4] + w[i] * u[i][1] * u[i][2], a[5] + w[i] * u[i][2] * u[i][2]
+            };
+            float tr = tofdb_anchor_trace_inv(t);
+            if (best < 0 || tr < trace) {
+                best = i;
+                trace = tr;
+                memcpy(best_a, t, sizeof(best_a));
+            }
+        }
+        selected |= (slot_mask_t)1 << best;
+        memcpy(a, best_a, sizeof(a));
+    }
+
+    for (uint16_t n = NumberOfBits64(selected); n < k && (eligible & ~selected); n++) {
+        int16_t best = -1;
+        for (slot_mask_t pending = eligible & ~selected; pending; pending &= pending - 1) {
+            uint16_t i = SlotFirst(pending);
+            if (best < 0 || w[i] > w[best]) {
+                best = i;
+            }
+        }
+        selected |= (slot_mask_t)1 << best;
+    }
+
+    if (gdop) {
+        *gdop = sqrtf(trace);
+    }
+    return selected;
+}
+
+/**
+ * @fn tofdb_anchor_init(void)
+ * @brief Clear the anchor table.
+ *
+ * @return void
+ */
+void
+tofdb_anchor_init(void)
+{
+    for (uint16_t i = 0; i < MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM); i++) {
+        tofdb_anchor_reset(&anchors[i]);
+    }
+}
+
+#endif /* MYNEWT_VAL(TOFDB_ANCHOR_SELECT) */
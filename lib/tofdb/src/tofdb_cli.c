@@ -24,6 +24,7 @@
 #if MYNEWT_VAL(TOFDB_CLI)
 
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 
 #include <defs/error.h>
@@ -33,14 +34,23 @@
 
 #include "rng/rng.h"
 #include "tofdb/tofdb.h"
-
-struct tofdb_node* tofdb_get_nodes();
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+#include "tofdb/tofdb_anchor.h"
+#endif
 
 static int tofdb_cli_cmd(int argc, char **argv);
 
 #if MYNEWT_VAL(SHELL_CMD_HELP)
 const struct shell_param cmd_tofdb_param[] = {
     {"list", ""},
+#if MYNEWT_VAL(TOFDB_FCB)
+    {"save", "store snapshot in flash"},
+#endif
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+    {"anchors", "list anchor positions and link statistics"},
+    {"anchor <slot> <x> <y> <z> [addr]", "set anchor position in meters"},
+    {"anchor <slot> clear", "forget anchor"},
+#endif
     {NULL,NULL},
 };
 
@@ -75,9 +85,8 @@ list_nodes()
         console_printf("%4d, ", i);
         console_printf("%4x, ", nodes[i].addr);
         console_printf("%6ld, ", (uint32_t)nodes[i].tof);
-        float ave = nodes[i].tof;
-        float stddev = dw1000_rng_tof_to_meters((uint32_t)sqrtf(nodes[i].sum_sq/nodes[i].num - ave*ave));
-        ave = dw1000_rng_tof_to_meters((uint32_t)(nodes[i].sum/nodes[i].num));
+        float stddev = dw1000_rng_tof_to_meters((uint32_t)sqrtf(tofdb_node_variance(&nodes[i])));
+        float ave = dw1000_rng_tof_to_meters((uint32_t)nodes[i].tof);
         console_printf("%3d.%03d, ", (int)ave, (int)(fabsf(ave-(int)ave)*1000));
         console_printf("%4ld, ", nodes[i].num);
         if (nodes[i].num>1) {
@@ -97,6 +106,64 @@ list_nodes()
     }
 }
 
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+static void
+print_fixed(float v)
+{
+    console_printf("%s%d.%02d", (v < 0) ? "-" : "", (int)fabsf(v), (int)((fabsf(v) - (int)fabsf(v))*100));
+}
+
+static void
+list_anchors()
+{
+    console_printf("#slot, addr, x(m), y(m), z(m), success, fppl(dBm), los, age\n");
+    for (uint16_t i=0;i<MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM);i++) {
+        struct tofdb_anchor *anchor = tofdb_anchor_get(i);
+        if (!anchor->addr && !anchor->has_position) {
+            continue;
+        }
+        console_printf("%5d, %4x, ", i, anchor->addr);
+        for (int j=0;j<3;j++) {
+            if (anchor->has_position) {
+                print_fixed(anchor->position.array[j]/100.0f);
+                console_printf(", ");
+            } else {
+                console_printf("-, ");
+            }
+        }
+        print_fixed(anchor->success);
+        console_printf(", ");
+        if (isnan(anchor->fppl)) {
+            console_printf("-");
+        } else {
+            print_fixed(anchor->fppl);
+        }
+        console_printf(", ");
+        print_fixed(anchor->los);
+        console_printf(", %d\n", anchor->age);
+    }
+}
+
+static void
+set_anchor(int argc, char **argv)
+{
+    uint16_t slot = strtol(argv[2], NULL, 0);
+    int rc;
+
+    if (argc == 4 && !strcmp(argv[3], "clear")) {
+        rc = tofdb_anchor_clear(slot);
+    } else if (argc > 5) {
+        uint16_t addr = (argc > 6) ? strtol(argv[6], NULL, 16) : 0;
+        rc = tofdb_anchor_set(slot, addr, strtof(argv[3], NULL), strtof(argv[4], NULL), strtof(argv[5], NULL));
+    } else {
+        console_printf("Missing arguments\n");
+        return;
+    }
+    if (rc) {
+        console_printf("Invalid slot\n");
+    }
+}
+#endif
 
 static int
 tofdb_cli_cmd(int argc, char **argv)
@@ -106,6 +173,16 @@ tofdb_cli_cmd(int argc, char **argv)
     }
     if (!strcmp(argv[1], "list")) {
         list_nodes();
+#if MYNEWT_VAL(TOFDB_FCB)
+    } else if (!strcmp(argv[1], "save")) {
+        console_printf("%s\n", (tofdb_save() == 0) ? "Saved" : "Save failed");
+#endif
+#if MYNEWT_VAL(TOFDB_ANCHOR_SELECT)
+    } else if (!strcmp(argv[1], "anchors")) {
+        list_anchors();
+    } else if (!strcmp(argv[1], "anchor") && argc > 3) {
+        set_anchor(argc, argv);
+#endif
     } else {
         console_printf("Unknown cmd\n");
     }
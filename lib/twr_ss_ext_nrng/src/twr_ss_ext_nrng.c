@@ -184,26 +184,12 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             {
                 // This code executes on the device that is responding to a request
                 DIAGMSG("{\"utime\": %lu,\"msg\": \"DWT_SS_TWR_NRNG_EXT\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
-                if (inst->frame_len != sizeof(nrng_request_frame_t))
-                    break;
-
                 nrng_request_frame_t * _frame = (nrng_request_frame_t * )inst->rxbuf;
 
-#if MYNEWT_VAL(CELL_ENABLED)
-                if (_frame->ptype != PTYPE_CELL)
-                    break;
-                if (_frame->cell_id != inst->cell_id)
-                    break;
-                if (_frame->slot_mask & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->slot_mask, 1UL << inst->slot_id, SLOT_POSITION);
-                else
+                int16_t idx = dw1000_nrng_slot_idx(_frame, inst->frame_len, inst->cell_id, inst->slot_id, NULL);
+                if (idx < 0)
                     break;
-#else
-                if (_frame->bitfield & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->bitfield, 1UL << inst->slot_id, SLOT_POSITION);
-                else
-                    break;
-#endif
+                slot_idx = idx;
                 nrng_frame_t * frame = (nrng_frame_t *) nrng->frames[(++nrng->idx)%(nrng->nframes/FRAMES_PER_RANGE)][FIRST_FRAME_IDX];
                 memcpy(frame->array, inst->rxbuf, sizeof(nrng_frame_t));
 
@@ -50,6 +50,10 @@
 #endif
 #include <dsp/polyval.h>
 #include <rng/slots.h>
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+#include <cir/cir.h>
+#include <cir/cir_fp.h>
+#endif
 
 #define WCS_DTU MYNEWT_VAL(WCS_DTU)
 
@@ -62,6 +66,22 @@ static bool rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t
 static bool rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
 static bool rx_error_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t *);
 static bool reset_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs);
+#if MYNEWT_VAL(TWR_SS_NRNG_FINAL)
+static void send_final(dw1000_dev_instance_t * inst, dw1000_nrng_instance_t * nrng);
+#endif
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+static uint64_t concurrent_offset(wcs_instance_t * wcs, dw1000_rng_config_t * config, uint16_t slot_idx);
+static bool concurrent_fits(dw1000_dev_instance_t * inst, uint16_t slot_idx);
+static void concurrent_extract(dw1000_dev_instance_t * inst, dw1000_nrng_instance_t * nrng, 
+                    dw1000_rng_config_t * config, uint16_t decoded_idx);
+
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_SHIFT) % 8
+#error "TWR_SS_NRNG_CONCURRENT_SHIFT must be a multiple of 8 taps, the delayed transmit resolution"
+#endif
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_WINDOW) > MYNEWT_VAL(CIR_MAX_SIZE)
+#error "TWR_SS_NRNG_CONCURRENT_WINDOW must not exceed CIR_MAX_SIZE"
+#endif
+#endif
 
 static dw1000_mac_interface_t g_cbs = {
     .id = DW1000_NRNG_SS,
@@ -160,6 +180,12 @@ rx_timeout_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 
     if(os_sem_get_count(&nrng->sem) == 0){
         NRNG_STATS_INC(rx_timeout);
+#if MYNEWT_VAL(TWR_SS_NRNG_FINAL)
+        if (nrng->final_flag){
+            nrng->final_flag = 0;
+            send_final(inst, nrng);
+        }
+#endif
         // In the case of a NRNG timeout is used to mark the end of the request 
         // and is used to call the completion callback  
         if(!(SLIST_EMPTY(&inst->interface_cbs))){
@@ -229,32 +255,25 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
             {
                 // This code executes on the device that is responding to a request
                 DIAGMSG("{\"utime\": %lu,\"msg\": \"DWT_SS_TWR_NRNG\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
-                if (inst->frame_len < sizeof(nrng_request_frame_t)) 
-                    break;
-                uint16_t slot_idx;    
-#if MYNEWT_VAL(CELL_ENABLED)
-                if (_frame->ptype != PTYPE_CELL) 
+                uint16_t nslots;
+                int16_t slot_idx = dw1000_nrng_slot_idx(_frame, inst->frame_len, inst->cell_id, inst->slot_id, &nslots);
+                if (slot_idx < 0)
                     break;
-                if (_frame->cell_id != inst->cell_id)
-                    break; 
-                if (_frame->slot_mask & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->slot_mask, 1UL << inst->slot_id, SLOT_POSITION);
-                else
-                    break;
-#else
-                if (_frame->bitfield & (1UL << inst->slot_id))
-                    slot_idx = BitIndex(_frame->bitfield, 1UL << inst->slot_id, SLOT_POSITION);
-                else
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+                // A shift past the preamble symbol would alias onto the first responders
+                if (!concurrent_fits(inst, slot_idx))
                     break;
-#endif         
+#endif
                 nrng_final_frame_t * frame = (nrng_final_frame_t *) nrng->frames[(++nrng->idx)%nrng->nframes];
                 memcpy(frame->array, inst->rxbuf, sizeof(nrng_request_frame_t));
 
                 uint64_t request_timestamp = inst->rxtimestamp;
-                uint64_t response_tx_delay = request_timestamp 
-                            + (((uint64_t)config->tx_holdoff_delay
-                            + (uint64_t)(slot_idx * ((uint64_t)config->tx_guard_delay
-                            + (uint64_t)(dw1000_usecs_to_dwt_usecs(dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t)))))))<< 16);
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+                dw1000_ccp_instance_t * _ccp = (dw1000_ccp_instance_t*)dw1000_mac_find_cb_inst_ptr(inst, DW1000_CCP);
+                uint64_t response_tx_delay = request_timestamp + concurrent_offset(_ccp->wcs, config, slot_idx);
+#else
+                uint64_t response_tx_delay = request_timestamp + dw1000_nrng_slot_offset(inst, config, slot_idx);
+#endif
                 uint64_t response_timestamp = (response_tx_delay & 0xFFFFFFFE00UL) + inst->tx_antenna_delay;
 
 #if MYNEWT_VAL(WCS_ENABLED)
@@ -279,7 +298,20 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
 #endif
                 dw1000_write_tx(inst, frame->array, 0, sizeof(nrng_response_frame_t));
                 dw1000_write_tx_fctrl(inst, sizeof(nrng_response_frame_t), 0);
+#if MYNEWT_VAL(TWR_SS_NRNG_FINAL)
+                // Stay in receive for the aggregated final, sent once the remaining slots have elapsed
+                dw1000_set_wait4resp(inst, true);
+                uint16_t timeout = usecs_to_response(inst,
+                            nslots - slot_idx,                  // no. of remaining frames
+                            config,
+                            dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_response_frame_t))
+                        ) + config->tx_holdoff_delay            // Initiator turn arround time.
+                        + dw1000_phy_frame_duration(&inst->attrib, sizeof(nrng_final_agg_frame_t))
+                        + config->rx_timeout_delay;
+                dw1000_set_rx_timeout(inst, timeout);
+#else
                 dw1000_set_wait4resp(inst, false);
+#endif
                 dw1000_set_delay_start(inst, response_tx_delay);
 
                 if (dw1000_start_tx(inst).start_tx_error){
@@ -288,7 +320,9 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                         cbs->start_tx_error_cb(inst, cbs);
                     }
                 }else{
+#if !MYNEWT_VAL(TWR_SS_NRNG_FINAL)
                     os_sem_release(&nrng->sem);
+#endif
                 }
             break;
             }
@@ -333,6 +367,20 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                 if(inst->config.rxdiag_enable) {
                     memcpy(&frame->diag, &inst->rxdiag, sizeof(struct _dw1000_dev_rxdiag_t));
                 }
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+                // All responses overlapped in this reception, hold the accumulator and read the others from it
+                dw1000_write_reg(inst, SYS_CTRL_ID, SYS_CTRL_OFFSET, (uint8_t) SYS_CTRL_TRXOFF, sizeof(uint8_t));
+                concurrent_extract(inst, nrng, config, idx);
+                NRNG_STATS_INC(complete);
+                if(!(SLIST_EMPTY(&inst->interface_cbs))){
+                    SLIST_FOREACH(cbs, &inst->interface_cbs, next){
+                    if (cbs!=NULL && cbs->complete_cb)
+                        if(cbs->complete_cb(inst, cbs)) continue;
+                    }
+                }
+                os_error_t err = os_sem_release(&nrng->sem);
+                assert(err == OS_OK);
+#else
                 if(idx == nrng->nnodes-1){
                      dw1000_set_rx_timeout(inst, 1); // Triger timeout event
                 }else{
@@ -344,8 +392,40 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
                             ) + config->rx_timeout_delay;          // TOF allowance.
                     dw1000_set_rx_timeout(inst, timeout);
                 }
+#endif
             break;
             }
+#if MYNEWT_VAL(TWR_SS_NRNG_FINAL)
+        case DWT_SS_TWR_NRNG_FINAL:
+            {
+                // This code executes on a responder, the aggregated final closes the request for all responders at once
+                DIAGMSG("{\"utime\": %lu,\"msg\": \"DWT_SS_TWR_NRNG_FINAL\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
+                nrng_final_agg_frame_t * _frame = (nrng_final_agg_frame_t *)inst->rxbuf;
+                nrng_frame_t * frame = nrng->frames[nrng->idx%nrng->nframes];
+
+                if (nrng->final_flag || frame->code != DWT_SS_TWR_NRNG_T1 
+                        || frame->seq_num != _frame->seq_num || frame->dst_address != _frame->src_address)
+                    break;
+
+                int32_t residual;
+                if (dw1000_nrng_final_unpack(_frame, inst->frame_len, frame->slot_id, &residual)){
+                    frame->request_timestamp = _frame->request_timestamp;
+                    frame->response_timestamp = _frame->request_timestamp 
+                            + (uint32_t)dw1000_nrng_slot_offset(inst, config, frame->slot_id) + (uint32_t)residual;
+                    frame->code = DWT_SS_TWR_NRNG_FINAL;
+                }
+                NRNG_STATS_INC(complete);
+                if(!(SLIST_EMPTY(&inst->interface_cbs))){
+                    SLIST_FOREACH(cbs, &inst->interface_cbs, next){
+                    if (cbs!=NULL && cbs->complete_cb)
+                        if(cbs->complete_cb(inst, cbs)) continue;
+                    }
+                }
+                os_error_t err = os_sem_release(&nrng->sem);
+                assert(err == OS_OK);
+            break;
+            }
+#endif
         default:
                 return false;
             break;
@@ -353,3 +433,167 @@ rx_complete_cb(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs)
     return true;
 }
 
+#if MYNEWT_VAL(TWR_SS_NRNG_FINAL)
+/**
+ * API to broadcast the aggregated final of the request that just completed, one frame
+ * in place of a final per responder.
+ *
+ * @param inst  Pointer to dw1000_dev_instance_t.
+ * @param nrng  Pointer to dw1000_nrng_instance_t.
+ *
+ * @return void
+ */
+static void
+send_final(dw1000_dev_instance_t * inst, dw1000_nrng_instance_t * nrng)
+{
+    nrng_final_agg_frame_t final;
+    uint16_t len = dw1000_nrng_final_pack(nrng, &final);
+    if (len == 0)
+        return;
+
+    dw1000_write_tx(inst, final.array, 0, len);
+    dw1000_write_tx_fctrl(inst, len, 0);
+    dw1000_set_wait4resp(inst, false);
+    if (dw1000_start_tx(inst).start_tx_error)
+        NRNG_STATS_INC(start_tx_error);
+}
+#endif
+
+#if MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
+
+#define CONCURRENT_TAP_DTU 64               //!< Accumulator sample period, 1.0016ns
+#define CONCURRENT_TX_TRUNC 256             //!< Mean loss of the 512 dtu delayed transmit resolution
+
+//! Accumulator window and dummy octet, as read by dw1000_read_accdata
+static struct {
+    uint8_t dummy;
+    struct _cir_complex_t array[MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_WINDOW)];
+} __attribute__((packed, aligned(1))) g_window;
+
+/**
+ * API for the response delay of request position slot_idx in concurrent mode. All responders
+ * answer after the same holdoff, shifted by a whole number of delayed transmit steps so that
+ * their first paths land in separate parts of the initiator's accumulator.
+ *
+ * @param wcs       Local clock relative to the master, NULL for the nominal delay in master time.
+ * @param config    Pointer to dw1000_rng_config_t.
+ * @param slot_idx  Position within the request.
+ *
+ * @return delay in dwt units of the local clock
+ */
+static uint64_t
+concurrent_offset(wcs_instance_t * wcs, dw1000_rng_config_t * config, uint16_t slot_idx)
+{
+    uint64_t offset = ((uint64_t)config->tx_holdoff_delay << 16)
+                    + (uint64_t)slot_idx * MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_SHIFT) * CONCURRENT_TAP_DTU;
+    if (wcs)
+        offset = (uint64_t)(offset / wcs_dtu_time_correction(wcs));
+    return offset;
+}
+
+/**
+ * API to check that the response of request position slot_idx, and the ones before it, fit in one preamble
+ * symbol of the accumulator; the accumulator wraps there and later shifts alias onto earlier responders.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param slot_idx  Position within the request.
+ *
+ * @return true if (slot_idx + 1) * TWR_SS_NRNG_CONCURRENT_SHIFT taps fit the accumulator
+ */
+static bool
+concurrent_fits(dw1000_dev_instance_t * inst, uint16_t slot_idx)
+{
+    uint16_t acc_len = (inst->config.prf == DWT_PRF_64M) ? 1016 : 992;
+    return (uint32_t)(slot_idx + 1) * MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_SHIFT) <= acc_len;
+}
+
+/**
+ * API to read one accumulator window, following the wrap at the end of the preamble symbol.
+ *
+ * @param inst      Pointer to dw1000_dev_instance_t.
+ * @param start     First tap, may lie outside [0, acc_len).
+ * @param acc_len   Accumulator length in taps.
+ *
+ * @return void
+ */
+static void
+concurrent_read(dw1000_dev_instance_t * inst, int32_t start, uint16_t acc_len)
+{
+    uint16_t n = MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_WINDOW);
+    uint16_t first = ((start % acc_len) + acc_len) % acc_len;
+    uint16_t head = (first + n > acc_len) ? acc_len - first : n;
+
+    dw1000_read_accdata(inst, (uint8_t *)&g_window, first * sizeof(cir_complex_t), 1 + head * sizeof(cir_complex_t));
+    if (head < n){
+        // Every read starts with a dummy octet, read it into the last tap of the first part and restore that
+        struct _cir_complex_t last = g_window.array[head - 1];
+        dw1000_read_accdata(inst, (uint8_t *)&g_window.array[head] - 1, 0, 1 + (n - head) * sizeof(cir_complex_t));
+        g_window.array[head - 1] = last;
+    }
+}
+
+/**
+ * API to recover the responses that overlapped the decoded one. Each responder's first path is searched
+ * in a window around the arrival expected at zero range; its position relative to the first path of the
+ * decoded frame gives the response reception time. The responder's own timestamps are not received, the
+ * nominal turnaround of its position stands in for them, so the accuracy is bounded by the 8ns delayed
+ * transmit resolution.
+ *
+ * @param inst          Pointer to dw1000_dev_instance_t.
+ * @param nrng          Pointer to dw1000_nrng_instance_t.
+ * @param config        Pointer to dw1000_rng_config_t.
+ * @param decoded_idx   Request position of the decoded response.
+ *
+ * @return void
+ */
+static void
+concurrent_extract(dw1000_dev_instance_t * inst, dw1000_nrng_instance_t * nrng, dw1000_rng_config_t * config, uint16_t decoded_idx)
+{
+    dw1000_ccp_instance_t * ccp = (dw1000_ccp_instance_t*)dw1000_mac_find_cb_inst_ptr(inst, DW1000_CCP);
+    wcs_instance_t * wcs = ccp->wcs;
+    uint16_t acc_len = (inst->config.prf == DWT_PRF_64M) ? 1016 : 992;
+    uint16_t noise_std = (inst->config.rxdiag_enable) ? inst->rxdiag.rx_std
+                    : dw1000_read_reg(inst, RX_FQUAL_ID, 0, sizeof(uint16_t)) & STD_NOISE_MASK;
+    float fp_idx = (float)dw1000_read_reg(inst, RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET, sizeof(uint16_t)) / 64.0f;
+    uint64_t request_timestamp = dw1000_read_txtime(inst);
+    uint64_t rx_timestamp = inst->rxtimestamp;
+
+    // The MAC re-enabled the receiver with RXPRD cleared (CIR_DEFERRED_READ) before the caller turned it off,
+    // a preamble detected in between has overwritten the accumulator
+    bool held = (dw1000_read_reg(inst, SYS_STATUS_ID, 0, sizeof(uint16_t)) & SYS_STATUS_RXPRD) == 0;
+    if (!held)
+        NRNG_STATS_INC(rx_error);
+
+    for (uint16_t i = 0; i < nrng->nnodes; i++){
+        if (i == decoded_idx)
+            continue;
+        nrng_frame_t * frame = nrng->frames[(nrng->idx + i)%nrng->nframes];
+        frame->code = DWT_SS_TWR_NRNG_INVALID;
+        if (!held || !concurrent_fits(inst, i))
+            continue;
+
+        // Arrival at zero range in local time, relative to the decoded first path
+        uint64_t turnaround = concurrent_offset(NULL, config, i) - CONCURRENT_TX_TRUNC + inst->tx_antenna_delay;
+        uint64_t expected = request_timestamp + (uint64_t)(turnaround / wcs_dtu_time_correction(wcs));
+        int64_t delta = (int64_t)((expected - rx_timestamp) << 24) >> 24;      // 40 bit wrap
+        int32_t start = (int32_t)floorf(fp_idx + (float)delta / CONCURRENT_TAP_DTU) - MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_LEAD);
+
+        concurrent_read(inst, start, acc_len);
+        cir_fp_t fp;
+        if (!cir_fp_refine(g_window.array, MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT_WINDOW), noise_std, &fp))
+            continue;
+
+        uint64_t response_timestamp = rx_timestamp + (int64_t)((start + fp.fp_idx - fp_idx) * CONCURRENT_TAP_DTU);
+        frame->request_timestamp = wcs_local_to_master(wcs, request_timestamp) & 0xFFFFFFFFULL;
+        frame->response_timestamp = wcs_local_to_master(wcs, response_timestamp) & 0xFFFFFFFFULL;
+        frame->reception_timestamp = 0;
+        frame->transmission_timestamp = (uint32_t)turnaround;
+        frame->carrier_integrator = 0;
+        frame->seq_num = nrng->seq_num;
+        frame->src_address = inst->my_short_address;
+        frame->dst_address = BROADCAST_ADDRESS;     // Responder not decoded
+        frame->slot_id = i;
+        frame->code = DWT_SS_TWR_NRNG_FINAL;
+    }
+}
+#endif // MYNEWT_VAL(TWR_SS_NRNG_CONCURRENT)
@@ -27,7 +27,11 @@
 #include <os/os.h>
 #include <dw1000/dw1000_dev.h>
 #include <ccp/ccp.h>
+#if MYNEWT_VAL(WCS_KF)
+#include <wcs/wcs_kf.h>
+#else
 #include <timescale/timescale.h>        
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -56,9 +60,17 @@ typedef struct _wcs_instance_t{
     ccp_timestamp_t master_epoch;
     ccp_timestamp_t local_epoch;
     double skew;
+    int64_t skew_q32;               //!< Linearised mapping, master/local rate - 1 in Q32
+    int32_t drift_q80;              //!< Linearised mapping, drift / (2 * WCS_DTU) per dtu^2 in Q80
+    uint64_t master_offset;         //!< Linearised mapping, master time at linear_epoch
+    uint64_t linear_epoch;          //!< Linearised mapping, local_epoch.lo it was taken at
     struct os_event postprocess_ev;
     struct _dw1000_ccp_instance_t * ccp;
+#if MYNEWT_VAL(WCS_KF)
+    wcs_kf_t kf;
+#else
     struct _timescale_instance_t * timescale;
+#endif
 }wcs_instance_t; 
 
 wcs_instance_t * wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp);
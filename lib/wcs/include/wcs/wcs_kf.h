@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_kf.h
+ * @brief Clock tracker
+ *
+ * @details Three state (offset, skew, drift) Kalman filter tracking the master clock from ccp beacons, an
+ * alternative to the timescale package for targets without a double precision FPU. Master time is kept as a
+ * 40bit integer, the filter runs in float32 on the error state so no double arithmetic is needed.
+ */
+
+#ifndef _WCS_KF_H_
+#define _WCS_KF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _wcs_kf_t{
+    uint64_t time;                  //!< Master time at the last ccp local epoch, 40bit dtu
+    float skew;                     //!< Master/local rate - 1
+    float drift;                    //!< Rate of change of skew in 1/s
+    float P[3][3];                  //!< Error covariance of time (dtu), skew and drift
+    uint16_t rejected;              //!< Consecutive beacons outside the innovation gate
+    uint16_t initialized:1;
+}wcs_kf_t;
+
+void wcs_kf_init(wcs_kf_t * kf, uint64_t time, float skew);
+bool wcs_kf_update(wcs_kf_t * kf, uint64_t interval, uint64_t time, float skew);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WCS_KF_H_ */
@@ -52,10 +52,16 @@
 #include <dw1000/dw1000_ftypes.h>
 #include <ccp/ccp.h>
 #include <wcs/wcs.h>
+#if !MYNEWT_VAL(WCS_KF)
 #include <timescale/timescale.h>
+#endif
 
 #if MYNEWT_VAL(WCS_ENABLED)
 
+#if MYNEWT_VAL(DIAGLOG_DIAGMSG)
+#include <diaglog/diaglog.h>
+#define DIAGMSG(s,u) diaglog_msg(s,u)
+#endif
 //#define DIAGMSG(s,u) printf(s,u)
 #define WCS_DTU MYNEWT_VAL(WCS_DTU)
 
@@ -66,10 +72,15 @@
 #undef TICTOC
 
 static void wcs_postprocess(struct os_event * ev);
+static void wcs_linearise(wcs_instance_t * wcs);
 
+#define WCS_USE_LINEAR (MYNEWT_VAL(WCS_LINEAR) || MYNEWT_VAL(WCS_KF))
+
+#if !MYNEWT_VAL(WCS_KF)
 static const double g_x0[TIMESCALE_N] = {0};
 static const double g_q[] = { MYNEWT_VAL(TIMESCALE_QVAR) * 1.0l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.1l, MYNEWT_VAL(TIMESCALE_QVAR) * 0.01l};
 static const double g_T = 1e-6l * MYNEWT_VAL(CCP_PERIOD);  // peroid in sec
+#endif
 
 /*! 
  * @fn wcs_init(wcs_instance_t * inst,  dw1000_ccp_instance_t * ccp)
@@ -97,8 +108,12 @@ wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp){
     }
     inst->ccp = ccp;    
 
+#if MYNEWT_VAL(WCS_KF)
+    inst->kf.initialized = 0;
+#else
     inst->timescale = timescale_init(NULL, g_x0, g_q, g_T);
     inst->timescale->status.initialized = 0; //Ignore X0 values, until we get first event
+#endif
     inst->status.initialized = 0;
 
     wcs_set_postprocess(inst, &wcs_postprocess);      // Using default process
@@ -121,7 +136,9 @@ wcs_init(wcs_instance_t * inst, dw1000_ccp_instance_t * ccp){
 void 
 wcs_free(wcs_instance_t * inst){
     assert(inst);  
+#if !MYNEWT_VAL(WCS_KF)
     timescale_free(inst->timescale);
+#endif
     if (inst->status.selfmalloc)
         free(inst);
     else
@@ -147,8 +164,10 @@ void wcs_update_cb(struct os_event * ev){
     assert(ev->ev_arg != NULL);
     dw1000_ccp_instance_t * ccp = (dw1000_ccp_instance_t *)ev->ev_arg;
     wcs_instance_t * wcs = ccp->wcs;
+#if !MYNEWT_VAL(WCS_KF)
     timescale_instance_t * timescale = wcs->timescale;
     timescale_states_t * states = (timescale_states_t *) (timescale->eke->x);
+#endif
 
     DIAGMSG("{\"utime\": %lu,\"msg\": \"wcs_update_cb\"}\n",os_cputime_ticks_to_usecs(os_cputime_get32()));
 
@@ -159,6 +178,22 @@ void wcs_update_cb(struct os_event * ev){
         wcs->master_epoch.timestamp = ccp->master_epoch.timestamp; 
         wcs->local_epoch.timestamp += wcs->observed_interval;
 
+#if MYNEWT_VAL(WCS_KF)
+        /* Relayed and backup beacons carry no skew measurement */
+        float skew = (frame->carrier_integrator) ? dw1000_calc_clock_offset_ratio(ccp->dev_inst, frame->carrier_integrator) : NAN;
+        if (wcs->status.initialized == 0){
+            wcs_kf_init(&wcs->kf, wcs->master_epoch.lo, isnan(skew) ? 0 : skew);
+            wcs->status.valid = wcs->status.initialized = 1;
+        }else{
+            wcs_kf_update(&wcs->kf, wcs->observed_interval, wcs->master_epoch.lo, skew);
+            wcs->status.valid = wcs->kf.initialized;
+        }
+
+        if (wcs->status.valid)
+            wcs->skew = -wcs->kf.skew;
+        else
+            wcs->skew = 0.0l;
+#else
         if (wcs->status.initialized == 0){
             timescale = timescale_init(timescale, g_x0, g_q, g_T);
             /* Update pointer in case realloc happens in timescale_init */
@@ -181,6 +216,8 @@ void wcs_update_cb(struct os_event * ev){
             wcs->skew = 1.0l - states->skew / WCS_DTU;
         else
             wcs->skew = 0.0l;
+#endif
+        wcs_linearise(wcs);
 
         if(wcs->config.postprocess == true)
             os_eventq_put(os_eventq_dflt_get(), &wcs->postprocess_ev);
@@ -188,6 +225,53 @@ void wcs_update_cb(struct os_event * ev){
 }
 
 
+/*!
+ * @fn wcs_linearise(wcs_instance_t * wcs)
+ *
+ * @brief Snapshot the tracker states as integer offset, skew and drift coefficients, the mapping local to master
+ * time about local_epoch is then master = master_offset + delta + delta * skew + delta^2 * drift / (2 * WCS_DTU).
+ * A skew of 100ppm is below 2^19 in Q32, the product stays within 64bit for any 40bit delta. The drift
+ * coefficient is held in Q80 and applied to delta in units of 2^16 dtu, see wcs_drift_term().
+ *
+ * Rounding the skew to Q32 adds at most 1 + delta * 2^-33 dtu, the drift term well below 1 dtu over the
+ * holdover span, see tools/host/wcs_linear_test.c.
+ *
+ * input parameters
+ * @param wcs - wcs_instance_t *
+ *
+ * returns none
+ */
+static void
+wcs_linearise(wcs_instance_t * wcs){
+    int64_t skew_q32 = 0;
+    double drift = 0;
+    uint64_t master_offset = wcs->master_epoch.lo;
+    os_sr_t sr;
+
+    if (wcs->status.valid) {
+#if MYNEWT_VAL(WCS_KF)
+        skew_q32 = (int64_t) llroundf(wcs->kf.skew * 4294967296.0f);
+        drift = wcs->kf.drift;
+        master_offset = wcs->kf.time;
+#else
+        timescale_states_t * states = (timescale_states_t *) (wcs->timescale->eke->x);
+        skew_q32 = (int64_t) llround((states->skew / WCS_DTU - 1.0l) * 4294967296.0l);
+        drift = states->drift / WCS_DTU;
+        master_offset = (uint64_t) llround(states->time);
+#endif
+    }
+    /* drift / (2 * WCS_DTU) in Q80, clamped to 32bit so that the product in wcs_drift_term() fits, |drift| < 2e-4/s */
+    double drift_q80 = drift * 1208925819614629174706176.0 / (2 * WCS_DTU);
+    drift_q80 = (drift_q80 > INT32_MAX) ? INT32_MAX : (drift_q80 < -INT32_MAX) ? -INT32_MAX : drift_q80;
+
+    OS_ENTER_CRITICAL(sr);
+    wcs->skew_q32 = skew_q32;
+    wcs->drift_q80 = (int32_t) llround(drift_q80);
+    wcs->master_offset = master_offset;
+    wcs->linear_epoch = wcs->local_epoch.lo;
+    OS_EXIT_CRITICAL(sr);
+}
+
 /*! 
  * @fn wcs_postprocess(struct os_event * ev)
  *
@@ -207,15 +291,20 @@ wcs_postprocess(struct os_event * ev){
 
 #if MYNEWT_VAL(WCS_VERBOSE)
     wcs_instance_t * wcs = (wcs_instance_t *) ev->ev_arg;
+#if MYNEWT_VAL(WCS_KF)
+    uint64_t state_time = wcs->kf.time;
+#else
     timescale_instance_t * timescale = wcs->timescale; 
     timescale_states_t * x = (timescale_states_t *) (timescale->eke->x); 
+    uint64_t state_time = (uint64_t) x->time;
+#endif
 
         printf("{\"utime\": %llu, \"wcs\": [%llu,%llu,%llu,%llu], \"skew\": %llu}\n",
         wcs_read_systime_master64(wcs->ccp->dev_inst),
         (uint64_t) wcs->master_epoch.timestamp,
         (uint64_t) wcs_local_to_master(wcs, wcs->local_epoch.lo),
         (uint64_t) wcs->local_epoch.timestamp,
-        (uint64_t) x->time,
+        state_time,
        *(uint64_t *)&(wcs->skew)
     );
 #endif
@@ -248,10 +337,33 @@ wcs_set_postprocess(wcs_instance_t * inst, os_event_fn * postprocess){
  * @return time
  * 
  */
+/**
+ * Drift part of the linearised mapping, delta^2 * drift / (2 * WCS_DTU) in dtu. delta is taken in units of 2^16 dtu,
+ * below 2^24 for a 40bit delta, so that its square shifted by 16 fits 32bit and the product with the 32bit Q80
+ * coefficient fits 64bit.
+ *
+ * @param wcs    Pointer to wcs_instance_t.
+ * @param delta  Local dtu since linear_epoch.
+ * @return dtu
+ */
+static inline int64_t
+wcs_drift_term(wcs_instance_t * wcs, int64_t delta)
+{
+    uint64_t d = ((uint64_t) delta + (1ULL << 15)) >> 16;
+    return ((int64_t)((d * d) >> 16) * wcs->drift_q80 + (1LL << 31)) >> 32;
+}
+
 inline uint64_t wcs_dtu_time_adjust(struct _wcs_instance_t * wcs, uint64_t dtu_time){
     
+#if WCS_USE_LINEAR
+    if (wcs->status.valid) {
+        dtu_time &= 0x00FFFFFFFFFFUL;
+        dtu_time += (((int64_t) dtu_time * wcs->skew_q32) + (1LL << 31)) >> 32;
+    }
+#else
     if (wcs->status.valid)
        dtu_time = (uint64_t) roundl(dtu_time * wcs_dtu_time_correction(wcs));
+#endif
 
     return dtu_time & 0x00FFFFFFFFFFUL;
 }
@@ -260,11 +372,15 @@ inline uint64_t wcs_dtu_time_adjust(struct _wcs_instance_t * wcs, uint64_t dtu_t
 inline double wcs_dtu_time_correction(struct _wcs_instance_t * wcs){
     assert(wcs);
 
-    timescale_states_t * x = (timescale_states_t *) (wcs->timescale->eke->x);
-
     double correction = 1.0l;
+#if MYNEWT_VAL(WCS_KF)
+    if (wcs->status.valid)
+       correction = 1.0f + wcs->kf.skew;
+#else
+    timescale_states_t * x = (timescale_states_t *) (wcs->timescale->eke->x);
     if (wcs->status.valid)
        correction = (double) x->skew / WCS_DTU;
+#endif
 
     return correction;
 }
@@ -279,6 +395,18 @@ inline double wcs_dtu_time_correction(struct _wcs_instance_t * wcs){
  * 
  */
 uint64_t wcs_local_to_master64(wcs_instance_t * wcs, uint64_t dtu_time){
+#if WCS_USE_LINEAR
+    uint64_t master_lo40;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    int64_t delta = ((dtu_time & 0x0FFFFFFFFFFUL) - wcs->linear_epoch) & 0x0FFFFFFFFFFUL;
+    if (wcs->status.valid)
+        master_lo40 = wcs->master_offset + delta + (((delta * wcs->skew_q32) + (1LL << 31)) >> 32) + wcs_drift_term(wcs, delta);
+    else
+        master_lo40 = wcs->master_offset + delta;
+    OS_EXIT_CRITICAL(sr);
+#else
     timescale_instance_t * timescale = wcs->timescale; 
 
     double delta = ((dtu_time & 0x0FFFFFFFFFFUL) - wcs->local_epoch.lo) & 0x0FFFFFFFFFFUL;
@@ -290,6 +418,7 @@ uint64_t wcs_local_to_master64(wcs_instance_t * wcs, uint64_t dtu_time){
     } else {
         master_lo40 = wcs->master_epoch.lo + delta;
     }
+#endif
 
     return (wcs->master_epoch.timestamp & 0xFFFFFF0000000000UL) + master_lo40;
 }
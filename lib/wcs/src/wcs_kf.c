@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ * 
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_kf.c
+ * @brief Clock tracker
+ *
+ * @details Error state Kalman filter on [time, skew, drift]. Between beacons the master time is predicted
+ * in integer dtu from the interval observed on the local clock; the float32 filter only carries the
+ * corrections to that prediction, which stay small enough for single precision. Measurements are the
+ * master epoch carried by the beacon and the skew derived from the carrier integrator.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <wcs/wcs.h>
+#include <wcs/wcs_kf.h>
+
+#if MYNEWT_VAL(WCS_KF)
+
+#define WCS_KF_MASK40 0x0FFFFFFFFFFUL
+
+/**
+ * @fn wcs_kf_init(wcs_kf_t * kf, uint64_t time, float skew)
+ * @brief (Re)start the filter from a single beacon.
+ *
+ * @param kf     Pointer to wcs_kf_t.
+ * @param time   Master epoch of the beacon, 40bit dtu.
+ * @param skew   Measured master/local rate - 1.
+ *
+ * @return void
+ */
+void
+wcs_kf_init(wcs_kf_t * kf, uint64_t time, float skew)
+{
+    memset(kf, 0, sizeof(wcs_kf_t));
+    kf->time = time & WCS_KF_MASK40;
+    kf->skew = skew;
+    kf->P[0][0] = MYNEWT_VAL(WCS_KF_RVAR_TIME);
+    kf->P[1][1] = MYNEWT_VAL(WCS_KF_RVAR_SKEW);
+    kf->P[2][2] = MYNEWT_VAL(WCS_KF_QVAR_DRIFT);
+    kf->initialized = 1;
+}
+
+/**
+ * @fn wcs_kf_update(wcs_kf_t * kf, uint64_t interval, uint64_t time, float skew)
+ * @brief Predict over the local interval since the previous beacon and correct with the new one.
+ * A beacon whose time innovation lies outside WCS_KF_GATE standard deviations is ignored, after
+ * WCS_KF_REJECT_MAX such beacons in a row the filter restarts from the measurement.
+ *
+ * @param kf        Pointer to wcs_kf_t.
+ * @param interval  Local dtu since the previous beacon.
+ * @param time      Master epoch of the beacon, 40bit dtu.
+ * @param skew      Measured master/local rate - 1, NAN if not available.
+ *
+ * @return true if the beacon was used
+ */
+bool
+wcs_kf_update(wcs_kf_t * kf, uint64_t interval, uint64_t time, float skew)
+{
+    float I = (float) interval;
+    float T = I / (float) MYNEWT_VAL(WCS_DTU);
+    float (*P)[3] = kf->P;
+
+    /* Predict, x = F x with F = [1 I I*T/2; 0 1 T; 0 0 1] */
+    kf->time = (kf->time + interval + (int64_t) lroundf(I * (kf->skew + 0.5f * kf->drift * T))) & WCS_KF_MASK40;
+    kf->skew += kf->drift * T;
+
+    float f01 = I, f02 = 0.5f * I * T, f12 = T;
+    float FP[3][3];
+    for (uint16_t j = 0; j < 3; j++) {
+        FP[0][j] = P[0][j] + f01 * P[1][j] + f02 * P[2][j];
+        FP[1][j] = P[1][j] + f12 * P[2][j];
+        FP[2][j] = P[2][j];
+    }
+    for (uint16_t i = 0; i < 3; i++) {
+        P[i][0] = FP[i][0] + FP[i][1] * f01 + FP[i][2] * f02;
+        P[i][1] = FP[i][1] + FP[i][2] * f12;
+        P[i][2] = FP[i][2];
+    }
+    P[0][0] += MYNEWT_VAL(WCS_KF_QVAR_TIME) * T;
+    P[1][1] += MYNEWT_VAL(WCS_KF_QVAR_SKEW) * T;
+    P[2][2] += MYNEWT_VAL(WCS_KF_QVAR_DRIFT) * T;
+
+    /* Without a skew measurement (NAN) only the time is observed */
+    float rvar_skew = MYNEWT_VAL(WCS_KF_RVAR_SKEW);
+    if (isnan(skew)) {
+        skew = kf->skew;
+        rvar_skew = 1e30f;
+    }
+
+    /* Innovation, time difference sign extended from 40bit */
+    int64_t dt = (int64_t)(((time - kf->time) & WCS_KF_MASK40) << 24) >> 24;
+    float y[2] = {(float) dt, skew - kf->skew};
+    float S[2][2] = {
+        {P[0][0] + MYNEWT_VAL(WCS_KF_RVAR_TIME), P[0][1]},
+        {P[1][0], P[1][1] + rvar_skew}
+    };
+    float det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+
+    if (det <= 0 || y[0] * y[0] > MYNEWT_VAL(WCS_KF_GATE) * MYNEWT_VAL(WCS_KF_GATE) * S[0][0]) {
+        if (++kf->rejected >= MYNEWT_VAL(WCS_KF_REJECT_MAX))
+            wcs_kf_init(kf, time, skew);
+        return false;
+    }
+    kf->rejected = 0;
+
+    /* K = P H' S^-1, H selects time and skew */
+    float Si[2][2] = {{S[1][1] / det, -S[0][1] / det}, {-S[1][0] / det, S[0][0] / det}};
+    float K[3][2];
+    for (uint16_t i = 0; i < 3; i++) {
+        K[i][0] = P[i][0] * Si[0][0] + P[i][1] * Si[1][0];
+        K[i][1] = P[i][0] * Si[0][1] + P[i][1] * Si[1][1];
+    }
+
+    kf->time = (kf->time + (int64_t) lroundf(K[0][0] * y[0] + K[0][1] * y[1])) & WCS_KF_MASK40;
+    kf->skew += K[1][0] * y[0] + K[1][1] * y[1];
+    kf->drift += K[2][0] * y[0] + K[2][1] * y[1];
+
+    /* P = (I - K H) P, kept symmetric */
+    float HP[2][3];
+    memcpy(HP, P, sizeof(HP));
+    for (uint16_t i = 0; i < 3; i++)
+        for (uint16_t j = 0; j < 3; j++)
+            P[i][j] -= K[i][0] * HP[0][j] + K[i][1] * HP[1][j];
+    for (uint16_t i = 0; i < 3; i++)
+        for (uint16_t j = i + 1; j < 3; j++)
+            P[i][j] = P[j][i] = 0.5f * (P[i][j] + P[j][i]);
+    for (uint16_t i = 0; i < 3; i++)
+        if (P[i][i] < 0)
+            P[i][i] = 0;
+
+    return true;
+}
+
+#endif // MYNEWT_VAL(WCS_KF)
@@ -33,11 +33,17 @@
 #ifndef __SYS_UWBCFG_H_
 #define __SYS_UWBCFG_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <os/queue.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define MGMT_GROUP_ID_UWBCFG   (0x103)
+#define UWBCFG_NMGR_ID_WRITE   (0)  /*!< Set config strings, {"cfgs": [], "flds": mask, "save": bool} */
+#define UWBCFG_NMGR_ID_ANTDLY  (1)  /*!< Shift antenna delays, {"rx": int, "tx": int, "id": uint, "save": bool} */
 
 typedef int (*uwbcfg_update_handler_t)(void);    
     
@@ -50,6 +56,7 @@ SLIST_HEAD(uwbcfg_cbs_head, uwbcfg_cbs);
     
 int uwbcfg_register(struct uwbcfg_cbs *handler);
 int uwbcfg_apply(void);
+int uwbcfg_antdly_adjust(int16_t rx_adj, int16_t tx_adj, bool save);
     
 #ifdef __cplusplus
 }
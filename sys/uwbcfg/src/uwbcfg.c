@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <os/mynewt.h>
 #include <config/config.h>
@@ -311,6 +312,45 @@ uwbcfg_export(void (*export_func)(char *name, char *val),
     return 0;
 }
 
+/**
+ * Shift the antenna delays by a number of dw1000 time units and apply them.
+ * For calibration by a node that measured the range bias but does not know
+ * the delays in use.
+ *
+ * @param rx_adj  Added to the rx antenna delay
+ * @param tx_adj  Added to the tx antenna delay
+ * @param save    Persist the new delays
+ *
+ * @return 0 on success, OS_EINVAL if a delay would leave the valid range
+ */
+int
+uwbcfg_antdly_adjust(int16_t rx_adj, int16_t tx_adj, bool save)
+{
+    const int idx[] = {CFGSTR_RX_ANTDLY, CFGSTR_TX_ANTDLY};
+    int32_t dly[] = {rx_adj, tx_adj};
+    char b[32];
+
+    for (int i=0;i<2;i++) {
+        dly[i] += strtol(uwb_config[idx[i]], NULL, 0);
+        /* Parsed as CONF_INT16 on commit */
+        if (dly[i] < 0 || dly[i] > INT16_MAX) {
+            return OS_EINVAL;
+        }
+    }
+    for (int i=0;i<2;i++) {
+        snprintf(uwb_config[idx[i]], CFGSTR_STRLEN, "0x%04x", (unsigned int)dly[i]);
+    }
+    uwbcfg_commit();
+
+    if (save) {
+        for (int i=0;i<2;i++) {
+            snprintf(b, sizeof(b), "%s/%s", uwbcfg_handler.ch_name, _uwbcfg_str[idx[i]]);
+            conf_save_one(b, uwb_config[idx[i]]);
+        }
+    }
+    return 0;
+}
+
 int
 uwbcfg_register(struct uwbcfg_cbs *handler)
 {
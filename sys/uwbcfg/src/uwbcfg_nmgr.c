@@ -34,11 +34,15 @@
 #if MYNEWT_VAL(UWBCFG_NMGR)
 
 static int uwbcfg_write(struct mgmt_cbuf *);
+static int uwbcfg_antdly_write(struct mgmt_cbuf *);
 //static int uwbcfg_read(struct mgmt_cbuf *);
 
 static const struct mgmt_handler uwbcfg_nmgr_handlers[] = {
-    [0] = {
+    [UWBCFG_NMGR_ID_WRITE] = {
         .mh_write = uwbcfg_write
+    },
+    [UWBCFG_NMGR_ID_ANTDLY] = {
+        .mh_write = uwbcfg_antdly_write
     }
 };
 
@@ -121,6 +125,76 @@ out:
     return 0;
 }
 
+/* Relative adjustments are not idempotent, a request repeated with
+ * the same nonzero id is acknowledged but not applied again. */
+static int
+uwbcfg_antdly_write(struct mgmt_cbuf *cb)
+{
+    static long long unsigned int last_id = 0;
+    long long int rx_adj = 0;
+    long long int tx_adj = 0;
+    long long unsigned int id = 0;
+    bool do_save = false;
+    int rc;
+
+    const struct cbor_attr_t off_attr[] = {
+        [0] = {
+            .attribute = "rx",
+            .type = CborAttrIntegerType,
+            .addr.integer = &rx_adj,
+            .nodefault = true
+        },
+        [1] = {
+            .attribute = "tx",
+            .type = CborAttrIntegerType,
+            .addr.integer = &tx_adj,
+            .nodefault = true
+        },
+        [2] = {
+            .attribute = "id",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &id,
+            .nodefault = true
+        },
+        [3] = {
+            .attribute = "save",
+            .type = CborAttrBooleanType,
+            .addr.boolean = &do_save,
+            .nodefault = true
+        },
+        [4] = { 0 },
+    };
+
+    rc = cbor_read_object(&cb->it, off_attr);
+    if (rc || rx_adj < INT16_MIN || rx_adj > INT16_MAX ||
+        tx_adj < INT16_MIN || tx_adj > INT16_MAX) {
+        UC_ERR("antdly read_failed rc %d\n", rc);
+        return MGMT_ERR_EINVAL;
+    }
+
+    UC_DEBUG("uwbcfg: antdly rx:%d tx:%d id:%lu s:%d\n",
+             (int)rx_adj, (int)tx_adj, (uint32_t)id, do_save);
+
+    if (id == 0 || id != last_id) {
+        if (uwbcfg_antdly_adjust(rx_adj, tx_adj, do_save)) {
+            return MGMT_ERR_EINVAL;
+        }
+        last_id = id;
+    }
+
+    CborError g_err = CborNoError;
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "rc");
+    g_err |= cbor_encode_int(&cb->encoder, MGMT_ERR_EOK);
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "rx_antdly");
+    g_err |= cbor_encode_text_stringz(&cb->encoder, uwbcfg_internal_get(CFGSTR_RX_ANTDLY));
+    g_err |= cbor_encode_text_stringz(&cb->encoder, "tx_antdly");
+    g_err |= cbor_encode_text_stringz(&cb->encoder, uwbcfg_internal_get(CFGSTR_TX_ANTDLY));
+
+    if (g_err) {
+        return MGMT_ERR_ENOMEM;
+    }
+    return 0;
+}
 
 void
 uwbcfg_nmgr_module_init(void)
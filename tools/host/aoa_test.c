@@ -0,0 +1,268 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file aoa_test.c
+ * @brief Host check of the angle of arrival averaging, calibration table and config strings
+ *
+ * @details Runs lib/aoa/src/aoa.c with a linear calibration table. PDoA samples spread across the wrap at
+ * +/-pi must average to the circular mean with the circular variance, also through a phase offset that
+ * wraps them, and a phase offset calibration must recover an offset near pi. Table points must stay
+ * sorted by PDoA whatever the insertion order, a point at the same angle must be replaced and a full
+ * table refused. The table and offset must survive a round trip through the "aoa" config strings.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <config/config.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <cir/cir.h>
+#include <aoa/aoa.h>
+
+#define NAVG MYNEWT_VAL(AOA_AVERAGE_N)
+#define NLUT MYNEWT_VAL(AOA_LUT_SIZE)
+#define MRAD 1e-3f
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+void aoa_pkg_init(void);
+
+static dw1000_dev_instance_t g_inst[2];
+static struct conf_handler * g_handler;
+
+struct _dw1000_dev_instance_t * hal_dw1000_inst(uint8_t idx) { return &g_inst[idx]; }
+void dw1000_mac_append_interface(dw1000_dev_instance_t * inst, dw1000_mac_interface_t * cbs) {}
+float cir_get_pdoa(cir_instance_t * master, cir_instance_t * slave) { return 0; }
+float cir_calc_aoa(float pdoa, float wavelength, float antenna_separation) { return asinf(pdoa / (2.0f * M_PI) * wavelength / antenna_separation); }
+uint32_t os_cputime_get32(void) { return 0; }
+uint32_t os_cputime_ticks_to_usecs(uint32_t ticks) { return ticks; }
+int conf_register(struct conf_handler * cf) { g_handler = cf; return 0; }
+int conf_save_one(const char * name, char * var) { return 0; }
+
+int
+conf_value_from_str(char * val_str, enum conf_type type, void * vp, int maxlen)
+{
+    if (type != CONF_STRING || val_str == NULL || (int) strlen(val_str) >= maxlen)
+        return OS_EINVAL;
+    strcpy((char *) vp, val_str);
+    return 0;
+}
+
+static float
+wrap(float phase)
+{
+    return phase - 2.0f * M_PI * floorf((phase + M_PI) / (2.0f * M_PI));
+}
+
+/* Table mapping pdoa linearly to half its value, wide enough to cover +/-pi */
+static void
+lut_linear(aoa_instance_t * aoa)
+{
+    aoa_cal_clear(aoa);
+    CHECK(aoa_lut_insert(aoa, -3.2f, -1.6f) == OS_OK);
+    CHECK(aoa_lut_insert(aoa, 3.2f, 1.6f) == OS_OK);
+    CHECK(aoa_lut_insert(aoa, 0, 0) == OS_OK);
+}
+
+static void
+test_wrapped_average(aoa_instance_t * aoa)
+{
+    const float spread = 0.05f;
+    const float offsets[] = {0, 0.5f, -2.0f};
+
+    for (uint16_t k = 0; k < sizeof(offsets) / sizeof(offsets[0]); k++) {
+        lut_linear(aoa);
+        aoa->phase_offset = offsets[k];
+
+        /* Alternating either side of pi - 0.02, half of them wrapped to -pi */
+        float mean = M_PI - 0.02f;
+        for (uint16_t i = 0; i < 2 * NAVG + 3; i++)
+            aoa_update(aoa, wrap(mean + ((i & 1) ? spread : -spread) + offsets[k]));
+        float var = -2.0f * logf(cosf(spread)) / NAVG;
+
+        CHECK(aoa->status.valid);
+        CHECK(aoa->nsamples == NAVG);
+        CHECK(fabsf(wrap(aoa->pdoa_mean - mean)) < MRAD);
+        CHECK(fabsf(aoa->resultant - cosf(spread)) < 1e-4f);
+        CHECK(fabsf(aoa->angle - mean / 2) < MRAD);
+        CHECK(fabsf(aoa->angle_variance - var / 4) < 0.01f * var / 4);
+
+        /* The history moves to the new samples */
+        for (uint16_t i = 0; i < NAVG; i++)
+            aoa_update(aoa, wrap(0.3f + offsets[k]));
+        CHECK(fabsf(aoa->pdoa_mean - 0.3f) < MRAD);
+        CHECK(fabsf(aoa->resultant - 1.0f) < 1e-4f);
+        CHECK(aoa->angle_variance < 1e-6f);
+    }
+    printf("aoa_update: mean and variance across the +/-pi wrap ok\n");
+}
+
+static void
+test_offset_calibration(aoa_instance_t * aoa)
+{
+    aoa_cal_clear(aoa);
+    aoa_cal_start(aoa, true, 0, 40);
+    for (uint16_t i = 0; i < 40; i++)
+        aoa_update(aoa, wrap(M_PI + ((i & 1) ? 0.1f : -0.1f)));
+    CHECK(!aoa->status.calibrating);
+    CHECK(fabsf(wrap(aoa->phase_offset - M_PI)) < MRAD);
+    CHECK(!aoa->status.valid);
+
+    /* A table step at 0.5 rad stores the offset corrected mean */
+    aoa_cal_start(aoa, false, 0.5f, 10);
+    for (uint16_t i = 0; i < 10; i++)
+        aoa_update(aoa, wrap(M_PI + 0.4f));
+    CHECK(aoa->lut.n == 1);
+    CHECK(fabsf(aoa->lut.pdoa[0] - 0.4f) < MRAD && aoa->lut.angle[0] == 0.5f);
+}
+
+static bool
+lut_sorted(aoa_lut_t * lut)
+{
+    for (uint16_t i = 1; i < lut->n; i++)
+        if (lut->pdoa[i - 1] > lut->pdoa[i])
+            return false;
+    return true;
+}
+
+static void
+test_lut_insert(aoa_instance_t * aoa)
+{
+    aoa_lut_t lut;
+    float phase_offset;
+
+    /* Angles in a scrambled order, pdoa decreasing with angle */
+    aoa_cal_clear(aoa);
+    for (uint16_t i = 0; i < NLUT; i++) {
+        uint16_t k = (i * 5) % NLUT;
+        float angle = (k - NLUT / 2) * 0.2f;
+        CHECK(aoa_lut_insert(aoa, -2.0f * angle, angle) == OS_OK);
+        aoa_lut_get(aoa, &lut, NULL);
+        CHECK(lut.n == i + 1);
+        CHECK(lut_sorted(&lut));
+    }
+    CHECK(aoa_lut_insert(aoa, 0.05f, 1.234f) == OS_ENOMEM);
+
+    /* Same angle within 0.1 degree replaces the point, also in a full table, and moves it */
+    float angle = (0 - NLUT / 2) * 0.2f;
+    CHECK(aoa_lut_insert(aoa, 0.01f, angle + 0.001f) == OS_OK);
+    aoa->phase_offset = 0.25f;
+    aoa_lut_get(aoa, &lut, &phase_offset);
+    CHECK(lut.n == NLUT);
+    CHECK(lut_sorted(&lut));
+    CHECK(phase_offset == 0.25f);
+    uint16_t found = 0;
+    for (uint16_t i = 0; i < lut.n; i++) {
+        if (fabsf(lut.angle[i] - angle) < 0.01f) {
+            found++;
+            CHECK(lut.pdoa[i] == 0.01f);
+        }
+    }
+    CHECK(found == 1);
+    printf("aoa_lut_insert: %d points sorted, replace and full table ok\n", NLUT);
+}
+
+static char g_exported[2][MYNEWT_VAL(AOA_LUT_SIZE) * 14 + 1];
+
+static void
+export_func(char * name, char * val)
+{
+    uint16_t k = (!strcmp(name, "aoa/offset")) ? 0 : (!strcmp(name, "aoa/lut")) ? 1 : 2;
+    CHECK(k < 2);
+    if (k < 2)
+        snprintf(g_exported[k], sizeof(g_exported[k]), "%s", val);
+}
+
+static void
+test_config(aoa_instance_t * aoa)
+{
+    aoa_lut_t lut, restored;
+    float phase_offset, restored_offset;
+    char * offset_arg[] = {"offset"};
+    char * lut_arg[] = {"lut"};
+
+    /* A full table at the extremes of the encoding */
+    aoa_cal_clear(aoa);
+    for (uint16_t i = 0; i < NLUT; i++) {
+        float a = -M_PI / 2 + i * M_PI / (NLUT - 1);
+        CHECK(aoa_lut_insert(aoa, -M_PI + i * 2 * M_PI / (NLUT - 1), a) == OS_OK);
+    }
+    aoa->phase_offset = -3.14159f;
+    aoa_lut_get(aoa, &lut, &phase_offset);
+
+    CHECK(g_handler != NULL && !strcmp(g_handler->ch_name, "aoa"));
+    CHECK(g_handler->ch_export(export_func, CONF_EXPORT_PERSIST) == 0);
+    CHECK(!strcmp(g_handler->ch_get(1, offset_arg, NULL, 0), g_exported[0]));
+    CHECK(!strcmp(g_handler->ch_get(1, lut_arg, NULL, 0), g_exported[1]));
+    CHECK(!strcmp(g_exported[0], "-3142"));
+    CHECK(aoa_config_save(aoa) == 0);
+
+    aoa_cal_clear(aoa);
+    CHECK(aoa->lut.n == 0 && aoa->phase_offset == 0);
+    CHECK(g_handler->ch_set(1, offset_arg, g_exported[0]) == 0);
+    CHECK(g_handler->ch_set(1, lut_arg, g_exported[1]) == 0);
+    CHECK(g_handler->ch_commit() == 0);
+
+    aoa_lut_get(aoa, &restored, &restored_offset);
+    CHECK(fabsf(restored_offset - phase_offset) <= MRAD / 2);
+    CHECK(restored.n == lut.n);
+    for (uint16_t i = 0; i < lut.n && i < restored.n; i++) {
+        CHECK(fabsf(restored.pdoa[i] - lut.pdoa[i]) <= MRAD / 2);
+        CHECK(fabsf(restored.angle[i] - lut.angle[i]) <= MRAD / 2);
+    }
+
+    /* An empty table stays empty, a truncated string keeps its whole points */
+    char empty[] = "";
+    char truncated[] = "-100,-50;200,100;300";
+    CHECK(g_handler->ch_set(1, lut_arg, empty) == 0);
+    CHECK(g_handler->ch_commit() == 0);
+    CHECK(aoa->lut.n == 0);
+    CHECK(g_handler->ch_set(1, lut_arg, truncated) == 0);
+    CHECK(g_handler->ch_commit() == 0);
+    CHECK(aoa->lut.n == 2 && aoa->lut.pdoa[1] == 0.2f && aoa->lut.angle[1] == 0.1f);
+    printf("aoa config: offset %s, lut \"%.24s...\" round trip ok\n", g_exported[0], g_exported[1]);
+}
+
+int
+main(void)
+{
+    g_inst[0].config.channel = 5;
+    g_inst[1].config.channel = 5;
+    aoa_pkg_init();
+    aoa_instance_t * aoa = aoa_get_instance();
+    CHECK(aoa != NULL && aoa->status.initialized);
+
+    test_wrapped_average(aoa);
+    test_offset_calibration(aoa);
+    test_lut_insert(aoa);
+    test_config(aoa);
+    aoa_free(aoa);
+    printf("aoa: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
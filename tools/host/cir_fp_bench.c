@@ -0,0 +1,197 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file cir_fp_bench.c
+ * @brief Host micro-benchmark of the first path refinement kernel
+ *
+ * @details Times lib/cir/src/cir_fp.c on synthetic windows, a pulse at a random sub-sample position
+ * and phase followed by a weaker reflection, with receiver noise. The same detection run in float gives
+ * the reference for the fixed point interpolator, the largest difference in fp_idx is reported. The
+ * host build takes the portable path, CIR_FP_SIMD only applies on cores with the DSP extension.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <os/os.h>
+#include <cir/cir.h>
+#include <cir/cir_fp.h>
+
+#define NWIN 512
+#define ROUNDS 200
+#define UPSAMPLE MYNEWT_VAL(CIR_FP_UPSAMPLE)
+
+static struct _cir_complex_t g_win[NWIN][MYNEWT_VAL(CIR_MAX_SIZE)];
+static volatile uint32_t g_sink;
+static uint64_t g_state = 0x2545F4914F6CDD1DULL;
+
+static double
+uniform(void)
+{
+    g_state ^= g_state << 13;
+    g_state ^= g_state >> 7;
+    g_state ^= g_state << 17;
+    return (g_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double
+gauss(void)
+{
+    return sqrt(-2.0 * log(uniform() + 1e-300)) * cos(2.0 * M_PI * uniform());
+}
+
+static int16_t
+clamp16(double v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : (int16_t) lround(v);
+}
+
+/* Direct path at pos, reflection 2.5 samples later at half the amplitude, gaussian pulse of the 64MHz PRF */
+static void
+synth(struct _cir_complex_t * cir, uint16_t n, double pos, double noise)
+{
+    double amp = 4000.0, phase = 2.0 * M_PI * uniform(), phase2 = 2.0 * M_PI * uniform();
+    for (uint16_t i = 0; i < n; i++) {
+        double d1 = i - pos, d2 = i - pos - 2.5;
+        double a1 = amp * exp(-d1 * d1 / 0.72), a2 = 0.5 * amp * exp(-d2 * d2 / 0.72);
+        cir[i].real = clamp16(a1 * cos(phase) + a2 * cos(phase2) + noise * gauss());
+        cir[i].imag = clamp16(a1 * sin(phase) + a2 * sin(phase2) + noise * gauss());
+    }
+}
+
+/* cir_fp_refine() in float */
+static bool
+refine_float(const struct _cir_complex_t * cir, uint16_t n, uint16_t noise_std, float * fp_idx)
+{
+    float mag2[MYNEWT_VAL(CIR_MAX_SIZE)], peak = 0;
+    for (uint16_t i = 0; i < n; i++) {
+        mag2[i] = (float) cir[i].real * cir[i].real + (float) cir[i].imag * cir[i].imag;
+        peak = (mag2[i] > peak) ? mag2[i] : peak;
+    }
+    float thresh = peak * MYNEWT_VAL(CIR_FP_THRESHOLD) * MYNEWT_VAL(CIR_FP_THRESHOLD) / 10000.0f;
+    float floor2 = (float) noise_std * noise_std * MYNEWT_VAL(CIR_FP_NOISE_MULT) * MYNEWT_VAL(CIR_FP_NOISE_MULT);
+    thresh = (floor2 > thresh) ? floor2 : thresh;
+    if (peak == 0 || thresh > peak)
+        return false;
+
+    uint16_t i = 0;
+    while (mag2[i] < thresh)
+        i++;
+    if (i == 0)
+        return false;
+
+    float prev = mag2[i - 1];
+    for (uint16_t k = 1; k <= UPSAMPLE; k++) {
+        float t = (float) k / UPSAMPLE, t2 = t * t, t3 = t2 * t;
+        float w[4] = {0.5f * (-t3 + 2 * t2 - t), 0.5f * (3 * t3 - 5 * t2 + 2), 0.5f * (-3 * t3 + 4 * t2 + t), 0.5f * (t3 - t2)};
+        float re = 0, im = 0;
+        for (int16_t j = 0; j < 4; j++) {
+            int16_t idx = (int16_t) i - 2 + j;
+            idx = (idx < 0) ? 0 : (idx >= n) ? n - 1 : idx;
+            re += w[j] * cir[idx].real;
+            im += w[j] * cir[idx].imag;
+        }
+        float cur = (k == UPSAMPLE) ? mag2[i] : re * re + im * im;
+        if (cur >= thresh) {
+            float frac = (cur > prev && prev < thresh) ? (thresh - prev) / (cur - prev) : 0.0f;
+            *fp_idx = (float)(i - 1) + ((float)(k - 1) + frac) / UPSAMPLE;
+            return true;
+        }
+        prev = cur;
+    }
+    *fp_idx = (float) i;
+    return true;
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void
+bench(uint16_t n, uint16_t noise_std)
+{
+    uint32_t mag2[MYNEWT_VAL(CIR_MAX_SIZE)], up[UPSAMPLE];
+    float worst = 0;
+    uint32_t found = 0, mismatch = 0;
+    cir_fp_t fp;
+
+    for (uint32_t w = 0; w < NWIN; w++)
+        synth(g_win[w], n, MYNEWT_VAL(CIR_OFFSET) + 1.0 + uniform(), noise_std);
+
+    for (uint32_t w = 0; w < NWIN; w++) {
+        float ref;
+        bool ok = cir_fp_refine(g_win[w], n, noise_std, &fp);
+        if (ok != refine_float(g_win[w], n, noise_std, &ref)) {
+            mismatch++;
+            continue;
+        }
+        if (ok) {
+            found++;
+            worst = (fabsf(fp.fp_idx - ref) > worst) ? fabsf(fp.fp_idx - ref) : worst;
+        }
+    }
+    printf("cir_fp, %u taps, noise %u: found %u/%u, fixed vs float max %.3f samples, %u disagree\n",
+        n, noise_std, found, NWIN, worst, mismatch);
+
+    double t0 = now_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint32_t w = 0; w < NWIN; w++) {
+            cir_fp_mag2(g_win[w], mag2, n);
+            g_sink += mag2[n - 1];
+        }
+    printf("  %-20s %8.1f ns\n", "cir_fp_mag2", (now_ns() - t0) / ((double) ROUNDS * NWIN));
+
+    t0 = now_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint32_t w = 0; w < NWIN; w++) {
+            cir_fp_interp_mag2(g_win[w], n, 2, up);
+            g_sink += up[UPSAMPLE - 1];
+        }
+    printf("  %-20s %8.1f ns\n", "cir_fp_interp_mag2", (now_ns() - t0) / ((double) ROUNDS * NWIN));
+
+    t0 = now_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint32_t w = 0; w < NWIN; w++)
+            g_sink += cir_fp_refine(g_win[w], n, noise_std, &fp);
+    printf("  %-20s %8.1f ns\n", "cir_fp_refine", (now_ns() - t0) / ((double) ROUNDS * NWIN));
+
+    t0 = now_ns();
+    for (uint32_t r = 0; r < ROUNDS; r++)
+        for (uint32_t w = 0; w < NWIN; w++) {
+            float ref;
+            g_sink += refine_float(g_win[w], n, noise_std, &ref);
+        }
+    printf("  %-20s %8.1f ns\n", "float reference", (now_ns() - t0) / ((double) ROUNDS * NWIN));
+}
+
+int
+main(void)
+{
+    cir_fp_init();
+    bench(MYNEWT_VAL(CIR_SIZE), 0);
+    bench(MYNEWT_VAL(CIR_SIZE), 40);
+    bench(MYNEWT_VAL(CIR_MAX_SIZE), 40);
+    return 0;
+}
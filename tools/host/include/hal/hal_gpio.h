@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_HAL_HAL_GPIO_H
+#define _HOST_HAL_HAL_GPIO_H
+
+#include <os/os.h>
+
+#define HAL_GPIO_TRIG_RISING 1
+#define HAL_GPIO_PULL_NONE 0
+#define HAL_GPIO_PULL_DOWN 2
+
+int hal_gpio_init_in(int pin, int pull);
+int hal_gpio_init_out(int pin, int val);
+int hal_gpio_write(int pin, int val);
+int hal_gpio_read(int pin);
+int hal_gpio_toggle(int pin);
+int hal_gpio_irq_init(int pin, void *handler, void *arg, int trig, int pull);
+void hal_gpio_irq_enable(int pin);
+void hal_gpio_irq_disable(int pin);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_HAL_HAL_SPI_H
+#define _HOST_HAL_HAL_SPI_H
+
+#include <os/os.h>
+
+struct hal_spi_settings {
+    uint8_t data_mode;
+    uint8_t data_order;
+    uint8_t word_size;
+    uint32_t baudrate;
+};
+
+int hal_spi_enable(int spi_num);
+int hal_spi_disable(int spi_num);
+
+#endif
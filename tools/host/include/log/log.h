@@ -0,0 +1,39 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_LOG_LOG_H
+#define _HOST_LOG_LOG_H
+
+#include <stdint.h>
+
+struct log { int unused; };
+struct log_handler;
+extern const struct log_handler log_console_handler;
+
+#define LOG_SYSLEVEL 0
+#define LOG_DEBUG(log, mod, ...) ((void)(log))
+#define LOG_INFO(log, mod, ...) ((void)(log))
+#define LOG_WARN(log, mod, ...) ((void)(log))
+#define LOG_ERROR(log, mod, ...) ((void)(log))
+
+int log_register(char *name, struct log *log, const struct log_handler *h, void *arg, uint8_t level);
+
+#endif
@@ -0,0 +1,42 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_MGMT_MGMT_H
+#define _HOST_MGMT_MGMT_H
+
+#include <stdint.h>
+
+#define NMGR_OP_READ        (0)
+#define NMGR_OP_READ_RSP    (1)
+#define NMGR_OP_WRITE       (2)
+#define NMGR_OP_WRITE_RSP   (3)
+
+struct nmgr_hdr {
+    uint8_t  nh_op:3;
+    uint8_t  _res1:5;
+    uint8_t  nh_flags;
+    uint16_t nh_len;
+    uint16_t nh_group;
+    uint8_t  nh_seq;
+    uint8_t  nh_id;
+};
+
+#endif
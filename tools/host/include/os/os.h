@@ -0,0 +1,153 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file os.h
+ * @brief Host shim of the mynewt kernel API
+ *
+ * @details Just enough of kernel/os for the library sources under test to compile natively. The
+ * declarations follow apache-mynewt-core, nothing here is implemented beyond what the host checkers
+ * provide themselves. Critical sections are no-ops, the checkers are single threaded.
+ */
+
+#ifndef _HOST_OS_H_
+#define _HOST_OS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/queue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int os_error_t;
+typedef uint32_t os_time_t;
+typedef uint32_t os_stack_t;
+typedef uint32_t os_sr_t;
+
+#define OS_OK               0
+#define OS_ENOMEM           1
+#define OS_EINVAL           2
+#define OS_ENOENT           3
+#define OS_TIMEOUT          4
+#define OS_EBUSY            5
+#define OS_TIMEOUT_NEVER    (UINT32_MAX)
+#define OS_WAIT_FOREVER     (-1)
+#define OS_STACK_ALIGNMENT  8
+#define OS_TICKS_PER_SEC    1000
+
+#define OS_ENTER_CRITICAL(sr) ((sr) = 0)
+#define OS_EXIT_CRITICAL(sr) ((void)(sr))
+#define SYSINIT_ASSERT_ACTIVE()
+#define SYSINIT_PANIC_ASSERT(x)
+
+#define OS_TIME_TICK_GT(t1, t2) ((int32_t)((t1) - (t2)) > 0)
+#define OS_TIME_TICK_LT(t1, t2) ((int32_t)((t1) - (t2)) < 0)
+#define OS_TIME_TICK_GEQ(t1, t2) ((int32_t)((t1) - (t2)) >= 0)
+
+struct os_event;
+typedef void os_event_fn(struct os_event *ev);
+
+struct os_event {
+    uint8_t ev_queued;
+    os_event_fn *ev_cb;
+    void *ev_arg;
+    STAILQ_ENTRY(os_event) ev_next;
+};
+
+struct os_eventq { int unused; };
+struct os_callout { struct os_event c_ev; };
+struct os_sem { uint16_t sem_tokens; };
+struct os_mutex { int unused; };
+struct os_task { int unused; };
+struct os_mqueue { int unused; };
+struct os_mempool { int unused; };
+struct os_timeval { int64_t tv_sec; int32_t tv_usec; };
+struct os_mbuf { int om_len; uint8_t *om_data; };
+struct hal_timer { void *arg; };
+
+typedef void (*hal_timer_cb)(void *arg);
+typedef void (*os_task_func_t)(void *arg);
+
+void os_eventq_init(struct os_eventq *evq);
+int os_eventq_inited(const struct os_eventq *evq);
+void os_eventq_put(struct os_eventq *evq, struct os_event *ev);
+void os_eventq_remove(struct os_eventq *evq, struct os_event *ev);
+void os_eventq_run(struct os_eventq *evq);
+struct os_eventq *os_eventq_dflt_get(void);
+
+int os_task_init(struct os_task *t, const char *name, os_task_func_t func, void *arg, uint8_t prio,
+        os_time_t sanity_itvl, os_stack_t *stack_bottom, uint16_t stack_size);
+int os_sanity_task_checkin(struct os_task *t);
+
+os_error_t os_sem_init(struct os_sem *sem, uint16_t tokens);
+os_error_t os_sem_pend(struct os_sem *sem, os_time_t timeout);
+os_error_t os_sem_release(struct os_sem *sem);
+static inline uint16_t os_sem_get_count(struct os_sem *sem) { return sem->sem_tokens; }
+
+os_error_t os_mutex_init(struct os_mutex *mu);
+os_error_t os_mutex_pend(struct os_mutex *mu, os_time_t timeout);
+os_error_t os_mutex_release(struct os_mutex *mu);
+
+void os_callout_init(struct os_callout *c, struct os_eventq *evq, os_event_fn *ev_cb, void *ev_arg);
+int os_callout_reset(struct os_callout *c, os_time_t ticks);
+void os_callout_stop(struct os_callout *c);
+
+uint32_t os_cputime_get32(void);
+uint32_t os_cputime_usecs_to_ticks(uint32_t usecs);
+uint32_t os_cputime_ticks_to_usecs(uint32_t ticks);
+void os_cputime_delay_usecs(uint32_t usecs);
+void os_cputime_timer_init(struct hal_timer *timer, hal_timer_cb fp, void *arg);
+int os_cputime_timer_start(struct hal_timer *timer, uint32_t cputime);
+int os_cputime_timer_relative(struct hal_timer *timer, uint32_t usecs);
+void os_cputime_timer_stop(struct hal_timer *timer);
+int hal_timer_start_at(struct hal_timer *timer, uint32_t tick);
+
+os_time_t os_time_get(void);
+int os_time_ms_to_ticks(uint32_t ms, os_time_t *out_ticks);
+static inline os_time_t os_time_ms_to_ticks32(uint32_t ms) { return ms; }
+int os_get_uptime(struct os_timeval *tv);
+
+#define OS_MBUF_PKTLEN(om) ((om)->om_len)
+#define OS_MBUF_USRHDR(om) ((void *)(om))
+#define OS_MBUF_USRHDR_LEN(om) 0
+
+struct os_mbuf *os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len);
+int os_mbuf_free_chain(struct os_mbuf *om);
+int os_mbuf_copyinto(struct os_mbuf *om, int off, const void *src, int len);
+int os_mbuf_copydata(const struct os_mbuf *m, int off, int len, void *dst);
+void *os_mbuf_extend(struct os_mbuf *om, uint16_t len);
+void os_mbuf_adj(struct os_mbuf *om, int req_len);
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len);
+
+int os_mqueue_init(struct os_mqueue *mq, os_event_fn *ev_cb, void *arg);
+struct os_mbuf *os_mqueue_get(struct os_mqueue *mq);
+int os_mqueue_put(struct os_mqueue *mq, struct os_eventq *evq, struct os_mbuf *om);
+
+void *os_malloc(size_t size);
+void os_free(void *mem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HOST_OS_H_ */
@@ -0,0 +1,49 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_STATS_STATS_H
+#define _HOST_STATS_STATS_H
+
+#include <os/os.h>
+
+struct stats_hdr { int unused; };
+
+#define STATS_SECT_START(name) struct stats_##name { struct stats_hdr s_hdr;
+#define STATS_SECT_ENTRY(var) uint32_t var;
+#define STATS_SECT_END };
+#define STATS_SECT_DECL(name) struct stats_##name
+#define STATS_NAME_START(name) static const char * name##_names[] = {
+#define STATS_NAME(name, var) #var,
+#define STATS_NAME_END(name) };
+#define STATS_INC(sect, var) ((sect).var++)
+#define STATS_INCN(sect, var, n) ((sect).var += (n))
+#define STATS_SET(sect, var, n) ((sect).var = (n))
+#define STATS_CLEAR(sect, var) ((sect).var = 0)
+#define STATS_HDR(sect) (&(sect).s_hdr)
+#define STATS_SIZE_32 4
+#define STATS_SIZE_INIT_PARMS(sect, size) size, sizeof(sect)
+#define STATS_NAME_INIT_PARMS(name) name##_names, 1
+
+int stats_init(struct stats_hdr *shdr, int size, int cnt, const char **names, int name_cnt);
+int stats_register(const char *name, struct stats_hdr *shdr);
+void stats_reset(struct stats_hdr *shdr);
+
+#endif
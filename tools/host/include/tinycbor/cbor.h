@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_TINYCBOR_CBOR_H
+#define _HOST_TINYCBOR_CBOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef int CborError;
+
+#define CborNoError             0
+#define CborIndefiniteLength    SIZE_MAX
+
+struct cbor_encoder_writer;
+
+typedef struct CborEncoder {
+    struct cbor_encoder_writer *writer;
+    size_t added;
+    int flags;
+} CborEncoder;
+
+void cbor_encoder_init(CborEncoder *encoder, struct cbor_encoder_writer *pwriter, int flags);
+CborError cbor_encode_uint(CborEncoder *encoder, uint64_t value);
+CborError cbor_encode_int(CborEncoder *encoder, int64_t value);
+CborError cbor_encode_simple_value(CborEncoder *encoder, uint8_t value);
+CborError cbor_encode_text_string(CborEncoder *encoder, const char *string, size_t length);
+CborError cbor_encoder_create_map(CborEncoder *encoder, CborEncoder *mapEncoder, size_t length);
+CborError cbor_encoder_close_container(CborEncoder *encoder, const CborEncoder *containerEncoder);
+
+static inline CborError cbor_encode_text_stringz(CborEncoder *encoder, const char *string)
+{ return cbor_encode_text_string(encoder, string, strlen(string)); }
+static inline CborError cbor_encode_boolean(CborEncoder *encoder, bool value)
+{ return cbor_encode_simple_value(encoder, (int)value - 1 + 21); }
+
+#endif
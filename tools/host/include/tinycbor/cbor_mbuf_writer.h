@@ -0,0 +1,39 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/* Host shim, see os/os.h */
+
+#ifndef _HOST_TINYCBOR_CBOR_MBUF_WRITER_H
+#define _HOST_TINYCBOR_CBOR_MBUF_WRITER_H
+
+#include <os/os.h>
+#include <tinycbor/cbor.h>
+
+struct cbor_encoder_writer {
+    int bytes_written;
+};
+
+struct cbor_mbuf_writer {
+    struct cbor_encoder_writer enc;
+    struct os_mbuf *m;
+};
+
+void cbor_mbuf_writer_init(struct cbor_mbuf_writer *cb, struct os_mbuf *m);
+
+#endif
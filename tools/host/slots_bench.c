@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file slots_bench.c
+ * @brief Host micro-benchmark of the slot bitmap helpers
+ *
+ * @details Times lib/rng/src/slots.c against the bit at a time loops it replaced, over random 64 slot
+ * masks of varying density. Results of both are compared first, the run fails on a mismatch. Host
+ * numbers only rank the two, the Cortex-M cost of a popcount depends on the core.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <os/os.h>
+#include <rng/slots.h>
+
+#define NMASKS 1024
+#define ROUNDS 2000
+
+static slot_mask_t g_masks[NMASKS];
+static uint16_t g_slots[NMASKS];
+static volatile uint32_t g_sink;
+
+static uint32_t
+loop_bits(slot_mask_t n)
+{
+    uint32_t count = 0;
+    while (n) {
+        n &= (n - 1);
+        count++;
+    }
+    return count;
+}
+
+static uint32_t
+loop_index(slot_mask_t mask, uint16_t slot_id, slot_mode_t mode)
+{
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < SLOT_MASK_BITS; i++) {
+        if (!(mask & ((slot_mask_t)1 << i)))
+            continue;
+        if ((mode == SLOT_POSITION) ? (i < slot_id) : (i > slot_id))
+            count++;
+    }
+    return count;
+}
+
+static uint16_t
+loop_first(slot_mask_t mask)
+{
+    uint16_t slot_id = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        slot_id++;
+    }
+    return slot_id;
+}
+
+static double
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t
+rand64(uint64_t * state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+#define BENCH(name, expr) do { \
+    double t0 = now_ns(); \
+    uint32_t sum = 0; \
+    for (uint32_t r = 0; r < ROUNDS; r++) \
+        for (uint32_t i = 0; i < NMASKS; i++) \
+            sum += (expr); \
+    g_sink = sum; \
+    printf("  %-28s %6.2f ns\n", name, (now_ns() - t0) / ((double)ROUNDS * NMASKS)); \
+} while (0)
+
+int
+main(void)
+{
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    int failures = 0;
+
+    /* Densities from a single responder to a full mask, slot_id always set in its mask */
+    for (uint32_t i = 0; i < NMASKS; i++) {
+        slot_mask_t mask = rand64(&state);
+        for (uint32_t k = 0; k < i % 4; k++)
+            mask &= rand64(&state);
+        mask |= (slot_mask_t)1 << (rand64(&state) % SLOT_MASK_BITS);
+        g_masks[i] = mask;
+        do {
+            g_slots[i] = rand64(&state) % SLOT_MASK_BITS;
+        } while (!(mask & ((slot_mask_t)1 << g_slots[i])));
+    }
+
+    for (uint32_t i = 0; i < NMASKS; i++) {
+        slot_mask_t m = g_masks[i];
+        uint8_t map[sizeof(slot_mask_t)];
+        failures += NumberOfBits64(m) != loop_bits(m);
+        failures += SlotIndex(m, g_slots[i], SLOT_POSITION) != loop_index(m, g_slots[i], SLOT_POSITION);
+        failures += SlotIndex(m, g_slots[i], SLOT_REMAINING) != loop_index(m, g_slots[i], SLOT_REMAINING);
+        failures += SlotFirst(m) != loop_first(m);
+        failures += SlotMapDecode(map, SlotMapEncode(map, m)) != m;
+    }
+    if (failures) {
+        printf("slots: %d mismatches\n", failures);
+        return 1;
+    }
+
+    printf("slots, per call over %d masks:\n", NMASKS);
+    BENCH("NumberOfBits64", NumberOfBits64(g_masks[i]));
+    BENCH("  bit loop", loop_bits(g_masks[i]));
+    BENCH("SlotIndex SLOT_POSITION", SlotIndex(g_masks[i], g_slots[i], SLOT_POSITION));
+    BENCH("  bit loop", loop_index(g_masks[i], g_slots[i], SLOT_POSITION));
+    BENCH("SlotIndex SLOT_REMAINING", SlotIndex(g_masks[i], g_slots[i], SLOT_REMAINING));
+    BENCH("  bit loop", loop_index(g_masks[i], g_slots[i], SLOT_REMAINING));
+    BENCH("SlotFirst", SlotFirst(g_masks[i]));
+    BENCH("  shift loop", loop_first(g_masks[i]));
+    BENCH("SlotMapEncode", ({ uint8_t map[sizeof(slot_mask_t)]; SlotMapEncode(map, g_masks[i]); }));
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_calib_test.c
+ * @brief Host check of the antenna delay calibration
+ *
+ * @details Fills the survey matrix of a synthetic 8 node layout with ranges that read long by known per
+ * node biases, one link never ranged, and runs lib/survey/src/survey_calib.c on top of survey_mds.c. With
+ * the four corners as references the recovered biases and delay corrections must match the injected ones.
+ * Fewer than SURVEY_MDS_DIM + 1 references must be refused without a valid result or biases left applied.
+ * Applying the result must adjust the own delays, report the nodes it could not reach and discard the
+ * ranges taken with the old delays.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <tinycbor/cbor_mbuf_writer.h>
+#include <nmgr_uwb/nmgr_uwb.h>
+#include <survey/survey.h>
+#include <survey/survey_mds.h>
+#include <survey/survey_calib.h>
+
+#define NNODES 8
+#define SIGMA 0.01          // Noise of the range means in m
+#define TOLERANCE 0.02      // Bias error in m
+#define DWT_TO_METERS ((299792458.0f/1.000293f) * (float)DWT_TIME_UNITS)
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const float g_pos[NNODES][3] = {
+    {0, 0, 2}, {20, 0, 2}, {20, 15, 2}, {0, 15, 2}, {10, 7, 2}, {5, 12, 2}, {15, 3, 2}, {8, 1, 2}
+};
+static const float g_bias[NNODES] = {0.12f, -0.08f, 0.05f, 0, 0.15f, -0.10f, 0.03f, 0.07f};
+static uint64_t g_state = 0x2545F4914F6CDD1DULL;
+static int16_t g_antdly;
+
+/* Newtmgr transport, not registered so remote corrections fail with OS_ENOENT */
+void * dw1000_mac_find_cb_inst_ptr(dw1000_dev_instance_t * inst, uint16_t id) { return NULL; }
+int uwb_nmgr_queue_tx(struct _nmgr_uwb_instance_t * nmgruwb, uint16_t dst_addr, uint16_t code, struct os_mbuf * om) { return OS_OK; }
+int uwbcfg_antdly_adjust(int16_t rx_adj, int16_t tx_adj, bool save) { g_antdly = rx_adj; return OS_OK; }
+struct os_mbuf * os_msys_get_pkthdr(uint16_t dsize, uint16_t user_hdr_len) { return NULL; }
+void * os_mbuf_extend(struct os_mbuf * om, uint16_t len) { return NULL; }
+int os_mbuf_free_chain(struct os_mbuf * om) { return 0; }
+void cbor_mbuf_writer_init(struct cbor_mbuf_writer * cb, struct os_mbuf * m) {}
+void cbor_encoder_init(CborEncoder * encoder, struct cbor_encoder_writer * pwriter, int flags) {}
+CborError cbor_encode_uint(CborEncoder * encoder, uint64_t value) { return CborNoError; }
+CborError cbor_encode_int(CborEncoder * encoder, int64_t value) { return CborNoError; }
+CborError cbor_encode_simple_value(CborEncoder * encoder, uint8_t value) { return CborNoError; }
+CborError cbor_encode_text_string(CborEncoder * encoder, const char * string, size_t length) { return CborNoError; }
+CborError cbor_encoder_create_map(CborEncoder * encoder, CborEncoder * map, size_t length) { return CborNoError; }
+CborError cbor_encoder_close_container(CborEncoder * encoder, const CborEncoder * map) { return CborNoError; }
+
+static double
+uniform(void)
+{
+    g_state ^= g_state << 13;
+    g_state ^= g_state >> 7;
+    g_state ^= g_state << 17;
+    return (g_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double
+gauss(void)
+{
+    return sqrt(-2.0 * log(uniform() + 1e-300)) * cos(2.0 * M_PI * uniform());
+}
+
+static float
+distance(const float * a, const float * b)
+{
+    return sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+}
+
+static survey_instance_t *
+survey_alloc(void)
+{
+    survey_instance_t * survey = calloc(1, sizeof(survey_instance_t) + NNODES * NNODES * sizeof(survey_cell_t));
+    survey->nnodes = NNODES;
+    survey->addr = calloc(NNODES, sizeof(uint16_t));
+    survey->dev_inst = calloc(1, sizeof(dw1000_dev_instance_t));
+    return survey;
+}
+
+static void
+survey_release(survey_instance_t * survey)
+{
+    free(survey->dev_inst);
+    free(survey->addr);
+    free(survey);
+}
+
+/* Both directions of every pair, biased by both nodes, except the pair 4-7 */
+static void
+survey_fill(survey_instance_t * survey)
+{
+    memset(survey->cells, 0, NNODES * NNODES * sizeof(survey_cell_t));
+    for (uint16_t i = 0; i < NNODES; i++) {
+        for (uint16_t j = 0; j < NNODES; j++) {
+            if (i == j || (i == 4 && j == 7) || (i == 7 && j == 4))
+                continue;
+            survey_cell_t * cell = survey_cell(survey, i, j);
+            cell->mean = distance(g_pos[i], g_pos[j]) + g_bias[i] + g_bias[j] + SIGMA * gauss();
+            cell->var = (uint16_t)(4 * SIGMA * 4 * SIGMA * 1e6);
+            cell->num = 16;
+            cell->age = 0;
+        }
+    }
+}
+
+static void
+survey_reference(const uint16_t * refs, uint16_t n)
+{
+    survey_mds_reset();
+    survey_mds_clear_reference();
+    for (uint16_t k = 0; k < n; k++)
+        survey_mds_set_reference(refs[k], g_pos[refs[k]][0], g_pos[refs[k]][1], g_pos[refs[k]][2]);
+}
+
+static void
+test_biases(survey_instance_t * survey)
+{
+    const uint16_t refs[] = {0, 1, 2, 3};
+    survey_fill(survey);
+    survey_reference(refs, sizeof(refs) / sizeof(refs[0]));
+
+    CHECK(survey_calib_solve(survey) == OS_OK);
+    survey_calib_t * calib = survey_calib_get();
+    CHECK(calib->valid);
+    CHECK(calib->mask == 0xff);
+
+    float worst = 0;
+    int16_t slack = (int16_t) lroundf(TOLERANCE / DWT_TO_METERS);
+    for (uint16_t i = 0; i < NNODES; i++) {
+        float err = fabsf(calib->bias[i] - g_bias[i]);
+        int16_t adjust = (int16_t) lroundf(g_bias[i] / DWT_TO_METERS);
+        CHECK(err < TOLERANCE);
+        CHECK(abs(calib->adjust[i] - adjust) <= slack);
+        worst = (err > worst) ? err : worst;
+    }
+
+    /* The biases stay applied to the localisation */
+    survey_mds_t * mds = survey_mds_get();
+    float position = 0;
+    for (uint16_t i = 0; i < NNODES; i++)
+        position = fmaxf(position, distance(mds->position[i].array, g_pos[i]));
+    CHECK(position < TOLERANCE);
+    printf("survey_calib, 4 references: worst bias error %.3f m, rms %.3f m, worst position error %.3f m\n",
+            worst, calib->rms, position);
+}
+
+static void
+test_refused(survey_instance_t * survey)
+{
+    const uint16_t refs[] = {0, 1, 2, 3};
+    survey_fill(survey);
+    survey_calib_t * calib = survey_calib_get();
+    survey_mds_t * mds = survey_mds_get();
+
+    /* A free layout stretches to absorb a common bias, SURVEY_MDS_DIM + 1 references are required */
+    for (uint16_t n = 0; n < MYNEWT_VAL(SURVEY_MDS_DIM) + 1; n++) {
+        survey_reference(refs, n);
+        calib->valid = true;
+        CHECK(survey_calib_solve(survey) == OS_EINVAL);
+        CHECK(!calib->valid);
+        CHECK(calib->mask == 0);
+        for (uint16_t i = 0; i < NNODES; i++)
+            CHECK(mds->bias[i] == 0);
+    }
+    CHECK(survey_calib_apply(survey, false) == OS_EINVAL);
+}
+
+static void
+test_apply(survey_instance_t * survey)
+{
+    const uint16_t refs[] = {0, 1, 2, 3};
+    survey_fill(survey);
+    survey_reference(refs, sizeof(refs) / sizeof(refs[0]));
+    survey->dev_inst->slot_id = 4;
+    for (uint16_t i = 0; i < NNODES; i++)
+        survey->addr[i] = (i == 2) ? 0 : 0x1000 + i;
+
+    CHECK(survey_calib_solve(survey) == OS_OK);
+    survey_calib_t * calib = survey_calib_get();
+    int16_t own = calib->adjust[4];
+    uint16_t count = calib->count;
+
+    g_antdly = 0;
+    CHECK(survey_calib_apply(survey, false) == OS_ENOENT);
+    CHECK(g_antdly == own);
+    CHECK(calib->count == count + 1);
+    CHECK(!calib->valid);
+    CHECK(calib->mask == 0);
+    for (uint16_t k = 0; k < NNODES * NNODES; k++)
+        CHECK(survey->cells[k].num == 0);
+    for (uint16_t i = 0; i < NNODES; i++)
+        CHECK(survey_mds_get()->bias[i] == 0);
+}
+
+int
+main(void)
+{
+    survey_instance_t * survey = survey_alloc();
+
+    test_biases(survey);
+    test_refused(survey);
+    test_apply(survey);
+    survey_release(survey);
+    printf("survey_calib: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file survey_mds_test.c
+ * @brief Host check of the survey localisation
+ *
+ * @details Fills the survey matrix of a synthetic 8 node layout with noisy ranges in both directions, one
+ * link never ranged, and runs lib/survey/src/survey_mds.c. With three references the solution must land
+ * on the true positions, without references the solved distances must match the true ones. Networks with
+ * too few nodes or two disconnected parts must be refused.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <survey/survey.h>
+#include <survey/survey_mds.h>
+
+#define NNODES 8
+#define SIGMA 0.05          // Range noise in m
+#define TOLERANCE 0.15      // Position error in m
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static const float g_pos[NNODES][3] = {
+    {0, 0, 2}, {20, 0, 2}, {20, 15, 2}, {0, 15, 2}, {10, 7, 2}, {5, 12, 2}, {15, 3, 2}, {8, 1, 2}
+};
+static uint64_t g_state = 0x2545F4914F6CDD1DULL;
+
+static double
+uniform(void)
+{
+    g_state ^= g_state << 13;
+    g_state ^= g_state >> 7;
+    g_state ^= g_state << 17;
+    return (g_state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double
+gauss(void)
+{
+    return sqrt(-2.0 * log(uniform() + 1e-300)) * cos(2.0 * M_PI * uniform());
+}
+
+static float
+distance(const float * a, const float * b)
+{
+    return sqrtf((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]));
+}
+
+static survey_instance_t *
+survey_alloc(void)
+{
+    survey_instance_t * survey = calloc(1, sizeof(survey_instance_t) + NNODES * NNODES * sizeof(survey_cell_t));
+    survey->nnodes = NNODES;
+    return survey;
+}
+
+/* Both directions of every pair in mask, except the pair missing */
+static void
+survey_fill(survey_instance_t * survey, uint16_t mask, uint16_t missing_i, uint16_t missing_j)
+{
+    memset(survey->cells, 0, NNODES * NNODES * sizeof(survey_cell_t));
+    for (uint16_t i = 0; i < NNODES; i++) {
+        for (uint16_t j = 0; j < NNODES; j++) {
+            if (i == j || !(mask & (1U << i)) || !(mask & (1U << j)))
+                continue;
+            if ((i == missing_i && j == missing_j) || (i == missing_j && j == missing_i))
+                continue;
+            survey_cell_t * cell = survey_cell(survey, i, j);
+            cell->mean = distance(g_pos[i], g_pos[j]) + SIGMA * gauss();
+            cell->var = (uint16_t)(SIGMA * SIGMA * 1e6);
+            cell->num = 16;
+            cell->age = 0;
+        }
+    }
+}
+
+static void
+test_references(survey_instance_t * survey)
+{
+    survey_mds_reset();
+    survey_mds_clear_reference();
+    survey_fill(survey, 0xff, 0, 2);
+    const uint16_t refs[] = {0, 1, 3};
+    for (uint16_t k = 0; k < sizeof(refs) / sizeof(refs[0]); k++)
+        survey_mds_set_reference(refs[k], g_pos[refs[k]][0], g_pos[refs[k]][1], g_pos[refs[k]][2]);
+
+    CHECK(survey_mds_solve(survey) == OS_OK);
+    survey_mds_t * mds = survey_mds_get();
+    CHECK(mds->aligned);
+    CHECK(mds->mask == 0xff);
+    CHECK(survey_mds_link(0, 2)->num == 0);
+
+    float worst = 0;
+    for (uint16_t i = 0; i < NNODES; i++) {
+        float err = distance(mds->position[i].array, g_pos[i]);
+        CHECK(err < TOLERANCE);
+        worst = (err > worst) ? err : worst;
+    }
+    printf("survey_mds, 3 references: worst position error %.3f m\n", worst);
+}
+
+static void
+test_free_layout(survey_instance_t * survey)
+{
+    survey_mds_reset();
+    survey_mds_clear_reference();
+    survey_fill(survey, 0xff, 0, 2);
+
+    CHECK(survey_mds_solve(survey) == OS_OK);
+    survey_mds_t * mds = survey_mds_get();
+    CHECK(!mds->aligned);
+
+    float worst = 0;
+    for (uint16_t i = 0; i < NNODES; i++) {
+        for (uint16_t j = i + 1; j < NNODES; j++) {
+            float err = fabsf(distance(mds->position[i].array, mds->position[j].array) - distance(g_pos[i], g_pos[j]));
+            CHECK(err < TOLERANCE);
+            worst = (err > worst) ? err : worst;
+        }
+    }
+    printf("survey_mds, no references: worst distance error %.3f m, missing link 0-2\n", worst);
+}
+
+static void
+test_refused(survey_instance_t * survey)
+{
+    survey_mds_reset();
+    survey_mds_clear_reference();
+
+    /* Two nodes cannot be placed in SURVEY_MDS_DIM dimensions */
+    survey_fill(survey, 0x03, NNODES, NNODES);
+    CHECK(survey_mds_solve(survey) == OS_EINVAL);
+
+    /* Nodes 0-3 and 4-7 never ranged each other */
+    survey_fill(survey, 0xff, NNODES, NNODES);
+    for (uint16_t i = 0; i < 4; i++) {
+        for (uint16_t j = 4; j < NNODES; j++) {
+            survey_cell(survey, i, j)->num = 0;
+            survey_cell(survey, j, i)->num = 0;
+        }
+    }
+    CHECK(survey_mds_solve(survey) == OS_EINVAL);
+}
+
+int
+main(void)
+{
+    survey_instance_t * survey = survey_alloc();
+
+    test_references(survey);
+    test_free_layout(survey);
+    test_refused(survey);
+    free(survey);
+    printf("survey_mds: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
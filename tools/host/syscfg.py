@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Write a syscfg header holding the default of every setting in the repository.
+
+Stands in for the syscfg.h newt generates, so that host builds see the same
+defaults as a target build. Every value is guarded by #ifndef and can be
+overridden with -DMYNEWT_VAL_<NAME>=<value>.
+
+    syscfg.py ../.. -o build/syscfg.h
+"""
+
+import argparse
+import glob
+import os
+import sys
+
+import yaml
+
+# Settings the BSP or apache-mynewt-core would provide
+HOST_DEFAULTS = {
+    "DW1000_DEVICE_0": 1,
+    "DW1000_DEVICE_1": 0,
+    "DW1000_DEVICE_2": 0,
+    "DW1000_DEVICE_0_RX_ANT_DLY": 0x4050,
+    "DW1000_DEVICE_0_TX_ANT_DLY": 0x4050,
+    "SHELL_CMD_HELP": 1,
+    "FLOAT_USER": 0,
+}
+
+# Packages that are not built on the host
+SKIP = ("net/ip",)
+
+
+def defaults(root):
+    seen = {}
+    for path in sorted(glob.glob(os.path.join(root, "**", "syscfg.yml"), recursive=True)):
+        rel = os.path.relpath(path, root)
+        if rel.startswith("tools") or any(rel.startswith(s) for s in SKIP):
+            continue
+        with open(path) as f:
+            doc = yaml.safe_load(f) or {}
+        for section, defs in doc.items():
+            if not section.startswith("syscfg.defs") or not defs:
+                continue
+            for name, d in defs.items():
+                value = d.get("value", 0) if isinstance(d, dict) else 0
+                if value is None or value == "":
+                    value = 0
+                seen.setdefault(name, value)
+    for name, value in HOST_DEFAULTS.items():
+        seen.setdefault(name, value)
+    return seen
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("root", help="repository root")
+    ap.add_argument("-o", "--output", required=True)
+    args = ap.parse_args()
+
+    out = ["/* Generated by tools/host/syscfg.py, do not edit. */", "",
+           "#ifndef H_MYNEWT_SYSCFG_", "#define H_MYNEWT_SYSCFG_", "",
+           "#define MYNEWT_VAL(x) MYNEWT_VAL_ ## x", ""]
+    for name, value in sorted(defaults(args.root).items()):
+        if isinstance(value, bool):
+            value = int(value)
+        out += ["#ifndef MYNEWT_VAL_%s" % name, "#define MYNEWT_VAL_%s (%s)" % (name, value), "#endif"]
+    out += ["", "#endif", ""]
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,185 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tofdb_anchor_test.c
+ * @brief Host check of the tofdb anchor selection
+ *
+ * @details Runs lib/tofdb/src/tofdb_anchor.c against hand made layouts: spread beats collinear
+ * anchors, poorly responding anchors sit out until they are due a retry, unlocated anchors fill
+ * up by link weight, and the address of a responder is learned from its final frame.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <nrng/nrng.h>
+#include <tofdb/tofdb_anchor.h>
+
+#define BIT(n) ((slot_mask_t)1 << (n))
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+/* Only called with rxdiag_enable set, which the checks leave off */
+float dw1000_calc_rssi(dw1000_dev_instance_t * inst, dw1000_dev_rxdiag_t * diag) { return NAN; }
+float dw1000_calc_fppl(dw1000_dev_instance_t * inst, dw1000_dev_rxdiag_t * diag) { return NAN; }
+float dw1000_estimate_los(float rssi, float fppl) { return NAN; }
+
+static void
+test_set(void)
+{
+    tofdb_anchor_init();
+    CHECK(tofdb_anchor_set(0, 0x1000, 327.67f, -327.67f, 0) == OS_OK);
+    CHECK(tofdb_anchor_get(0)->position.x == 32767 && tofdb_anchor_get(0)->position.y == -32767);
+    CHECK(tofdb_anchor_set(1, 0x1001, 327.7f, 0, 0) == OS_EINVAL);
+    CHECK(tofdb_anchor_set(1, 0x1001, 0, 0, -1000.0f) == OS_EINVAL);
+    CHECK(tofdb_anchor_set(1, 0x1001, NAN, 0, 0) == OS_EINVAL);
+    CHECK(tofdb_anchor_get(1)->has_position == 0 && tofdb_anchor_get(1)->addr == 0);
+    CHECK(tofdb_anchor_set(MYNEWT_VAL(TOFDB_ANCHOR_MAXNUM), 0x1001, 0, 0, 0) == OS_EINVAL);
+}
+
+static void
+test_geometry(void)
+{
+    triadf_t origin = {.x = 0, .y = 0, .z = 0};
+    float gdop_spread, gdop_collinear;
+
+    tofdb_anchor_init();
+    tofdb_anchor_set(0, 0x1000, 10, 0, 0);
+    tofdb_anchor_set(1, 0x1001, 10, 0.2f, 0);      // Almost behind slot 0 seen from the origin
+    tofdb_anchor_set(2, 0x1002, 0, 10, 0);
+    tofdb_anchor_set(3, 0x1003, 0, 0, 10);
+
+    slot_mask_t mask = tofdb_anchor_select(BIT(0) | BIT(1) | BIT(2) | BIT(3), 3, &origin, &gdop_spread);
+    CHECK(NumberOfBits64(mask) == 3);
+    CHECK((mask & BIT(2)) && (mask & BIT(3)));
+    CHECK((mask & (BIT(0) | BIT(1))) != (BIT(0) | BIT(1)));
+
+    // Without slot 3 the best of three has no vertical component, GDOP goes up
+    mask = tofdb_anchor_select(BIT(0) | BIT(1) | BIT(2), 3, &origin, &gdop_collinear);
+    CHECK(mask == (BIT(0) | BIT(1) | BIT(2)));
+    CHECK(gdop_collinear > gdop_spread);
+
+    // Candidates limit the choice, k = 0 takes the default
+    mask = tofdb_anchor_select(BIT(2) | BIT(3), 0, &origin, NULL);
+    CHECK(mask == (BIT(2) | BIT(3)));
+}
+
+static void
+test_success(void)
+{
+    triadf_t origin = {.x = 0, .y = 0, .z = 0};
+
+    tofdb_anchor_init();
+    tofdb_anchor_set(0, 0x1000, 10, 0, 0);
+    tofdb_anchor_set(1, 0x1001, 0, 10, 0);
+    tofdb_anchor_set(2, 0x1002, 0, 0, 10);
+    tofdb_anchor_set(3, 0x1003, -10, 0, 0);
+
+    struct tofdb_anchor * bad = tofdb_anchor_get(2);
+    bad->success = (MYNEWT_VAL(TOFDB_ANCHOR_MIN_SUCCESS) - 1) / 100.0f;
+    bad->age = 0;
+    slot_mask_t mask = tofdb_anchor_select(BIT(0) | BIT(1) | BIT(2) | BIT(3), 3, &origin, NULL);
+    CHECK(!(mask & BIT(2)));
+    CHECK(mask == (BIT(0) | BIT(1) | BIT(3)));
+
+    bad->age = MYNEWT_VAL(TOFDB_ANCHOR_RETRY);
+    mask = tofdb_anchor_select(BIT(0) | BIT(1) | BIT(2) | BIT(3), 3, &origin, NULL);
+    CHECK(mask & BIT(2));
+
+    // Among equals the better link wins
+    tofdb_anchor_get(3)->success = 0.5f;
+    bad->success = 1.0f;
+    mask = tofdb_anchor_select(BIT(0) | BIT(3), 1, &origin, NULL);
+    CHECK(mask == BIT(0));
+}
+
+static void
+test_unlocated(void)
+{
+    tofdb_anchor_init();
+    tofdb_anchor_set(0, 0x1000, 10, 0, 0);
+    tofdb_anchor_set(1, 0x1001, 0, 10, 0);
+    tofdb_anchor_get(4)->success = 0.9f;
+    tofdb_anchor_get(5)->success = 0.6f;
+    tofdb_anchor_get(6)->success = 0.3f;
+
+    slot_mask_t mask = tofdb_anchor_select(BIT(0) | BIT(1) | BIT(4) | BIT(5) | BIT(6), 4, NULL, NULL);
+    CHECK(mask == (BIT(0) | BIT(1) | BIT(4) | BIT(5)));
+
+    // Nothing located, pick by weight alone
+    mask = tofdb_anchor_select(BIT(4) | BIT(5) | BIT(6), 1, NULL, NULL);
+    CHECK(mask == BIT(4));
+}
+
+static void
+test_update(void)
+{
+    const uint16_t nframes = 4;
+    dw1000_dev_instance_t * inst = calloc(1, sizeof(dw1000_dev_instance_t));
+    dw1000_nrng_instance_t * nrng = calloc(1, sizeof(dw1000_nrng_instance_t) + nframes * sizeof(nrng_frame_t *));
+    nrng_frame_t * frames = calloc(nframes, sizeof(nrng_frame_t));
+
+    nrng->dev_inst = inst;
+    nrng->nframes = nframes;
+    for (uint16_t i = 0; i < nframes; i++) {
+        nrng->frames[i] = &frames[i];
+    }
+
+    tofdb_anchor_init();
+    nrng->seq_num = 7;
+    nrng->slot_mask = BIT(1) | BIT(3);
+    // Received frames have their addresses swapped, dst_address holds the responder
+    frames[0] = (nrng_frame_t){.code = DWT_SS_TWR_NRNG_FINAL, .seq_num = 7, .src_address = 0x4321, .dst_address = 0x1001};
+    frames[1] = (nrng_frame_t){.code = DWT_SS_TWR_NRNG_FINAL, .seq_num = 6, .src_address = 0x4321, .dst_address = 0x1003};
+
+    slot_mask_t mask = tofdb_anchor_update(nrng, 0);
+    CHECK(mask == BIT(1));
+    CHECK(tofdb_anchor_get(1)->addr == 0x1001);
+    CHECK(tofdb_anchor_get(3)->addr == 0);
+    CHECK(tofdb_anchor_get(1)->success == 1.0f);
+    CHECK(tofdb_anchor_get(3)->success < 1.0f);
+    CHECK(tofdb_anchor_get(0)->age == 1 && tofdb_anchor_get(1)->age == 0);
+
+    free(frames);
+    free(nrng);
+    free(inst);
+}
+
+int
+main(void)
+{
+    test_set();
+    test_geometry();
+    test_success();
+    test_unlocated();
+    test_update();
+    printf("tofdb_anchor: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file tofdb_test.c
+ * @brief Host check of the tofdb node table
+ *
+ * @details Runs lib/tofdb/src/tofdb.c with 8 nodes in a 16 entry hash table. Addresses are picked to
+ * collide at the end of the table so probe sequences wrap to its start. A hand made sequence deletes the
+ * head of a wrapped chain, then a random sequence of updates, removals, lazy and swept expiry and
+ * evictions across the cputime wrap is run against a plain model. After every step each node of the
+ * model must be found with its tof, and no other address.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <os/os.h>
+#include <tofdb/tofdb.h>
+
+#define NNODES MYNEWT_VAL(TOFDB_MAXNUM_NODES)
+#define HASH_MASK (MYNEWT_VAL(TOFDB_HASH_SIZE) - 1)
+#define TIMEOUT_TICKS (MYNEWT_VAL(TOFDB_TIMEOUT) * 1000000UL)
+#define NPOOL 16
+#define STEPS 20000
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+void tofdb_pkg_init(void);
+
+/* cputime in usecs, started short of the wrap */
+static uint32_t g_now = 0xffffffffUL - 100000000UL;
+static uint64_t g_state = 0x2545F4914F6CDD1DULL;
+
+uint32_t os_cputime_get32(void) { return g_now; }
+uint32_t os_cputime_usecs_to_ticks(uint32_t usecs) { return usecs; }
+struct os_eventq * os_eventq_dflt_get(void) { return NULL; }
+void os_callout_init(struct os_callout * c, struct os_eventq * evq, os_event_fn * ev_cb, void * ev_arg) {}
+int os_callout_reset(struct os_callout * c, os_time_t ticks) { return 0; }
+
+/* Model of the table, most recently updated last */
+static struct {
+    uint16_t addr;
+    uint32_t last_updated;
+} g_model[NNODES];
+static int g_count;
+static uint16_t g_pool[NPOOL];
+
+static uint32_t
+xorshift(void)
+{
+    g_state ^= g_state << 13;
+    g_state ^= g_state >> 7;
+    g_state ^= g_state << 17;
+    return (uint32_t)(g_state >> 32);
+}
+
+/* Same hash as tofdb.c */
+static uint16_t
+hash(uint16_t addr)
+{
+    return ((addr * 2654435761UL) >> 16) & HASH_MASK;
+}
+
+static uint32_t
+tof_of(uint16_t addr)
+{
+    return 1000 + addr;
+}
+
+/* Addresses hashing to the last two, the first and a middle position */
+static void
+pool_fill(void)
+{
+    static const uint16_t homes[NPOOL] = {15, 15, 15, 15, 15, 14, 14, 14, 14, 0, 0, 0, 7, 7, 7, 7};
+    uint16_t addr = 1;
+
+    for (int k = 0; k < NPOOL; k++) {
+        while (hash(addr) != homes[k])
+            addr++;
+        g_pool[k] = addr++;
+    }
+}
+
+static bool
+model_expired(int k)
+{
+    return (uint32_t)(g_now - g_model[k].last_updated) > TIMEOUT_TICKS;
+}
+
+static int
+model_find(uint16_t addr)
+{
+    for (int k = 0; k < g_count; k++)
+        if (g_model[k].addr == addr)
+            return k;
+    return -1;
+}
+
+static void
+model_remove(int k)
+{
+    memmove(&g_model[k], &g_model[k + 1], (g_count - k - 1) * sizeof(g_model[0]));
+    g_count--;
+}
+
+static void
+model_set(uint16_t addr)
+{
+    int k = model_find(addr);
+
+    if (k >= 0)
+        model_remove(k);
+    else if (g_count == NNODES)
+        model_remove(0);
+    g_model[g_count].addr = addr;
+    g_model[g_count].last_updated = g_now;
+    g_count++;
+}
+
+static void
+model_expire(void)
+{
+    for (int k = g_count - 1; k >= 0; k--)
+        if (model_expired(k))
+            model_remove(k);
+}
+
+static void
+check_model(int step)
+{
+    struct tofdb_node * nodes = tofdb_get_nodes();
+    int used = 0;
+    int before = failures;
+
+    for (int i = 0; i < NNODES; i++)
+        used += (nodes[i].addr != 0);
+    CHECK(used == g_count);
+    for (int k = 0; k < NPOOL; k++) {
+        uint32_t tof = 0;
+        int m = model_find(g_pool[k]);
+        int rc = tofdb_get_tof(g_pool[k], &tof);
+        if (m >= 0 && !model_expired(m)) {
+            CHECK(rc == OS_OK);
+            CHECK(tof == tof_of(g_pool[k]));
+        } else {
+            CHECK(rc == OS_ENOENT);
+        }
+    }
+    if (failures != before)
+        printf("tofdb: model mismatch at step %d\n", step);
+}
+
+static void
+test_wrapped_chain(void)
+{
+    tofdb_pkg_init();
+    g_count = 0;
+
+    /* Homes 15, 15, 14, 0, 7 end up at 15, 0, 14, 1, 7 */
+    uint16_t chain[] = {g_pool[0], g_pool[1], g_pool[5], g_pool[9], g_pool[12]};
+    for (int k = 0; k < 5; k++) {
+        CHECK(tofdb_set_tof(chain[k], tof_of(chain[k])) == OS_OK);
+        model_set(chain[k]);
+    }
+    check_model(-1);
+
+    /* Removing the head at 15 must shift 0 back over the wrap and 1 to its home, 14 and 7 stay */
+    CHECK(tofdb_remove(chain[0]) == OS_OK);
+    model_remove(model_find(chain[0]));
+    check_model(-2);
+    CHECK(tofdb_remove(chain[0]) == OS_ENOENT);
+    CHECK(tofdb_remove(0) == OS_ENOENT);
+}
+
+static void
+test_random(void)
+{
+    int evicted = 0, expired = 0;
+
+    tofdb_pkg_init();
+    g_count = 0;
+    for (int step = 0; step < STEPS; step++) {
+        uint16_t addr = g_pool[xorshift() % NPOOL];
+        uint32_t op = xorshift() % 100;
+
+        g_now += 1 + xorshift() % 1000;
+        if (op < 2) {
+            /* Let some nodes age out */
+            g_now += TIMEOUT_TICKS / 2 + xorshift() % TIMEOUT_TICKS;
+        }
+        if (op < 60) {
+            int k = model_find(addr);
+            if (k >= 0 && model_expired(k)) {
+                model_remove(k);
+                expired++;
+            }
+            evicted += (k < 0 && g_count == NNODES);
+            CHECK(tofdb_set_tof(addr, tof_of(addr)) == OS_OK);
+            model_set(addr);
+        } else if (op < 85) {
+            int k = model_find(addr);
+            CHECK(tofdb_remove(addr) == ((k >= 0) ? OS_OK : OS_ENOENT));
+            if (k >= 0)
+                model_remove(k);
+        } else {
+            int count = g_count;
+            tofdb_expire();
+            model_expire();
+            expired += count - g_count;
+        }
+        check_model(step);
+    }
+    printf("tofdb: %d steps, %d evictions, %d expiries\n", STEPS, evicted, expired);
+    CHECK(evicted > 0 && expired > 0);
+}
+
+int
+main(void)
+{
+    pool_fill();
+    test_wrapped_chain();
+    test_random();
+    printf("tofdb: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_kf_replay.c
+ * @brief Replay a ccp beacon trace through the wcs clock trackers
+ *
+ * @details Feeds each beacon of a trace (see wcs_kf_trace.py) to lib/wcs/src/wcs_kf.c the way
+ * wcs_update_cb() does, and to a double precision filter of the [time, skew, drift] model the timescale
+ * package runs, with the same noise settings. The timescale package lives out of tree, the reference
+ * keeps its precision and model so the difference shows what the float32 error state costs. Both are
+ * scored against the true master time of the trace.
+ *
+ *   wcs_kf_replay [-v] [trace.csv]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <wcs/wcs_kf.h>
+
+#define MASK40 0x0FFFFFFFFFFULL
+#define SETTLE 10           // Beacons left out of the scores
+
+typedef struct {
+    double time;            // Master time, unwrapped dtu
+    double skew;
+    double drift;
+    double P[3][3];
+    uint16_t rejected;
+} ref_kf_t;
+
+typedef struct {
+    double sum2;
+    double max;
+    uint32_t n;
+} score_t;
+
+static void
+ref_init(ref_kf_t * kf, double time, double skew)
+{
+    memset(kf, 0, sizeof(ref_kf_t));
+    kf->time = time;
+    kf->skew = skew;
+    kf->P[0][0] = MYNEWT_VAL(WCS_KF_RVAR_TIME);
+    kf->P[1][1] = MYNEWT_VAL(WCS_KF_RVAR_SKEW);
+    kf->P[2][2] = MYNEWT_VAL(WCS_KF_QVAR_DRIFT);
+}
+
+static void
+ref_update(ref_kf_t * kf, double I, double time, double skew)
+{
+    double T = I / MYNEWT_VAL(WCS_DTU);
+    double (*P)[3] = kf->P;
+    double F[3][3] = {{1, I, 0.5 * I * T}, {0, 1, T}, {0, 0, 1}};
+    double FP[3][3], FPF[3][3];
+
+    kf->time += I * (1.0 + kf->skew + 0.5 * kf->drift * T);
+    kf->skew += kf->drift * T;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            FP[i][j] = F[i][0] * P[0][j] + F[i][1] * P[1][j] + F[i][2] * P[2][j];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            FPF[i][j] = FP[i][0] * F[j][0] + FP[i][1] * F[j][1] + FP[i][2] * F[j][2];
+    memcpy(P, FPF, sizeof(FPF));
+    P[0][0] += MYNEWT_VAL(WCS_KF_QVAR_TIME) * T;
+    P[1][1] += MYNEWT_VAL(WCS_KF_QVAR_SKEW) * T;
+    P[2][2] += MYNEWT_VAL(WCS_KF_QVAR_DRIFT) * T;
+
+    double rvar_skew = MYNEWT_VAL(WCS_KF_RVAR_SKEW);
+    if (isnan(skew)) {
+        skew = kf->skew;
+        rvar_skew = 1e30;
+    }
+    double y[2] = {time - kf->time, skew - kf->skew};
+    double S[2][2] = {{P[0][0] + MYNEWT_VAL(WCS_KF_RVAR_TIME), P[0][1]}, {P[1][0], P[1][1] + rvar_skew}};
+    double det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+
+    if (det <= 0 || y[0] * y[0] > MYNEWT_VAL(WCS_KF_GATE) * MYNEWT_VAL(WCS_KF_GATE) * S[0][0]) {
+        if (++kf->rejected >= MYNEWT_VAL(WCS_KF_REJECT_MAX))
+            ref_init(kf, time, skew);
+        return;
+    }
+    kf->rejected = 0;
+
+    double Si[2][2] = {{S[1][1] / det, -S[0][1] / det}, {-S[1][0] / det, S[0][0] / det}};
+    double K[3][2], HP[2][3];
+    for (int i = 0; i < 3; i++) {
+        K[i][0] = P[i][0] * Si[0][0] + P[i][1] * Si[1][0];
+        K[i][1] = P[i][0] * Si[0][1] + P[i][1] * Si[1][1];
+    }
+    kf->time += K[0][0] * y[0] + K[0][1] * y[1];
+    kf->skew += K[1][0] * y[0] + K[1][1] * y[1];
+    kf->drift += K[2][0] * y[0] + K[2][1] * y[1];
+    memcpy(HP, P, sizeof(HP));
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            P[i][j] -= K[i][0] * HP[0][j] + K[i][1] * HP[1][j];
+}
+
+static void
+score(score_t * s, double err)
+{
+    s->sum2 += err * err;
+    s->max = (fabs(err) > s->max) ? fabs(err) : s->max;
+    s->n++;
+}
+
+/* Sign extended 40bit difference */
+static int64_t
+diff40(uint64_t a, uint64_t b)
+{
+    return (int64_t)(((a - b) & MASK40) << 24) >> 24;
+}
+
+int
+main(int argc, char ** argv)
+{
+    const char * path = "wcs_kf_trace.csv";
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else
+            path = argv[i];
+    }
+    FILE * f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    wcs_kf_t kf;
+    ref_kf_t ref;
+    score_t s_kf = {0}, s_ref = {0}, s_skew = {0};
+    uint64_t prev_local = 0, prev_master = 0, prev_truth = 0;
+    double master_unwrapped = 0, truth_unwrapped = 0;     // Reference runs on unwrapped time from the first beacon
+    uint32_t n = 0, used = 0;
+    char line[128];
+
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long local, master, truth;
+        char skew_str[32];
+        if (line[0] == '#' || sscanf(line, "%llu,%llu,%31[^,],%llu", &local, &master, skew_str, &truth) != 4)
+            continue;
+        float skew = strtof(skew_str, NULL);
+
+        if (n == 0) {
+            wcs_kf_init(&kf, master, isnan(skew) ? 0 : skew);
+            ref_init(&ref, 0, isnan(skew) ? 0 : skew);
+            truth_unwrapped = (double) diff40(truth, master);
+        } else {
+            uint64_t interval = (local - prev_local) & MASK40;
+            master_unwrapped += (double) diff40(master, prev_master);
+            truth_unwrapped += (double) diff40(truth, prev_truth);
+            used += wcs_kf_update(&kf, interval, master, skew);
+            ref_update(&ref, (double) interval, master_unwrapped, skew);
+        }
+        prev_local = local;
+        prev_master = master;
+        prev_truth = truth;
+
+        double e_kf = (double) diff40(kf.time, truth);
+        double e_ref = ref.time - truth_unwrapped;
+        if (n >= SETTLE) {
+            score(&s_kf, e_kf);
+            score(&s_ref, e_ref);
+            score(&s_skew, (double) kf.skew - ref.skew);
+        }
+        if (verbose)
+            printf("%4u: kf %8.1f dtu, ref %8.1f dtu, skew kf-ref %.3e\n", n, e_kf, e_ref, (double) kf.skew - ref.skew);
+        n++;
+    }
+    fclose(f);
+
+    if (s_kf.n == 0) {
+        printf("%s: fewer than %d beacons\n", path, SETTLE + 1);
+        return 1;
+    }
+    printf("%s: %u beacons, wcs_kf used %u of %u updates\n", path, n, used, n - 1);
+    printf("time error vs truth (dtu)  wcs_kf rms %.1f max %.1f, reference rms %.1f max %.1f\n",
+        sqrt(s_kf.sum2 / s_kf.n), s_kf.max, sqrt(s_ref.sum2 / s_ref.n), s_ref.max);
+    printf("skew wcs_kf - reference    rms %.3e max %.3e\n", sqrt(s_skew.sum2 / s_skew.n), s_skew.max);
+    return 0;
+}
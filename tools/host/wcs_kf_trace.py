@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Write a synthetic ccp beacon trace for wcs_kf_replay.
+
+Rows are "local, master, skew, truth": the local reception epoch and the
+master epoch of a beacon as wcs_update_cb() sees them (40bit dtu), the
+carrier integrator skew (master/local rate - 1, nan for relayed beacons)
+and the true master time at the local epoch. The local clock starts at
+skew0, drifts linearly and takes a step halfway, as after a temperature
+change. Epochs and skews carry gaussian noise, a few beacons are relayed
+and one epoch is an outlier for the innovation gate.
+
+    wcs_kf_trace.py -o wcs_kf_trace.csv
+"""
+
+import argparse
+import math
+import random
+
+DTU = 128e6 * 512           # dtu per second, WCS_DTU
+MASK40 = (1 << 40) - 1
+
+
+def trace(n, period, skew0, drift, step, sigma_time, sigma_skew, seed):
+    rng = random.Random(seed)
+    master = 0x0F00000000
+    local = 0xFF00000000
+    skew = skew0
+    rows = []
+    for k in range(n):
+        if k:
+            t = period / DTU
+            skew += drift * t + (step if k == n // 2 else 0)
+            master += period
+            local += int(round(period / (1.0 + skew)))
+        meas = master + rng.gauss(0, sigma_time)
+        if k == n // 3:
+            meas += 100 * sigma_time
+        relayed = k % 17 == 5
+        meas_skew = float("nan") if relayed else skew + rng.gauss(0, sigma_skew)
+        rows.append((local & MASK40, int(round(meas)) & MASK40, meas_skew, master & MASK40))
+    return rows
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("-o", "--output", required=True)
+    ap.add_argument("-n", type=int, default=300, help="beacons")
+    ap.add_argument("--period", type=int, default=0x100000 << 16, help="beacon period in dtu, CCP_PERIOD << 16")
+    ap.add_argument("--skew", type=float, default=12e-6, help="initial master/local rate - 1")
+    ap.add_argument("--drift", type=float, default=2e-9, help="skew change per second")
+    ap.add_argument("--step", type=float, default=0.2e-6, help="skew step halfway")
+    ap.add_argument("--sigma-time", type=float, default=10.0, help="epoch noise in dtu")
+    ap.add_argument("--sigma-skew", type=float, default=1e-7, help="skew measurement noise")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    rows = trace(args.n, args.period, args.skew, args.drift, args.step, args.sigma_time, args.sigma_skew, args.seed)
+    with open(args.output, "w") as f:
+        f.write("# generated by wcs_kf_trace.py, local, master, skew, truth\n")
+        for local, master, skew, truth in rows:
+            f.write("%d,%d,%s,%d\n" % (local, master, "nan" if math.isnan(skew) else "%.6e" % skew, truth))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,203 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * @file wcs_linear_test.c
+ * @brief Host check of the WCS_LINEAR fixed point conversion
+ *
+ * @details Runs lib/wcs/src/wcs.c with the WCS_KF tracker and compares wcs_local_to_master64() and
+ * wcs_dtu_time_adjust() against the same offset, skew and drift evaluated in long double. The Q32 skew is
+ * off by at most 2^-33, so over delta dtu the fixed point result may differ by 1 + delta * 2^-33 dtu, plus
+ * 1 dtu for the rounding of the drift term. Deltas cover a beacon period and the holdover span, across the
+ * 40bit wrap, for skews up to 100ppm and drifts up to 1e-8/s.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <os/os.h>
+#include <dw1000/dw1000_dev.h>
+#include <dw1000/dw1000_mac.h>
+#include <ccp/ccp.h>
+#include <wcs/wcs.h>
+
+#define MASK40 0x0FFFFFFFFFFULL
+#define PERIOD_DTU ((uint64_t)MYNEWT_VAL(CCP_PERIOD) << 16)
+
+static int failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+static dw1000_ccp_instance_t * g_ccp;
+static float g_skew;
+
+void * dw1000_mac_find_cb_inst_ptr(dw1000_dev_instance_t * inst, uint16_t id) { return g_ccp; }
+float dw1000_calc_clock_offset_ratio(dw1000_dev_instance_t * inst, int32_t integrator) { return g_skew; }
+uint64_t dw1000_read_systime(dw1000_dev_instance_t * inst) { return 0; }
+uint32_t dw1000_read_systime_lo(dw1000_dev_instance_t * inst) { return 0; }
+uint64_t dw1000_read_rxtime(dw1000_dev_instance_t * inst) { return 0; }
+uint32_t dw1000_read_rxtime_lo(dw1000_dev_instance_t * inst) { return 0; }
+uint64_t dw1000_read_txtime(dw1000_dev_instance_t * inst) { return 0; }
+uint32_t dw1000_read_txtime_lo(dw1000_dev_instance_t * inst) { return 0; }
+struct os_eventq * os_eventq_dflt_get(void) { return NULL; }
+void os_eventq_put(struct os_eventq * evq, struct os_event * ev) {}
+
+/* First beacon of the tracker, takes the measured skew as is */
+static wcs_instance_t *
+beacon(uint64_t local_epoch, uint64_t master_epoch, float skew)
+{
+    static ccp_frame_t frame;
+    static wcs_instance_t wcs;
+    struct os_event ev = {.ev_arg = g_ccp};
+
+    memset(&wcs, 0, sizeof(wcs));
+    g_ccp->wcs = &wcs;
+    g_ccp->status.valid = 1;
+    g_ccp->frames[0] = &frame;
+    g_ccp->local_epoch = local_epoch & MASK40;
+    g_ccp->master_epoch.timestamp = master_epoch;
+    frame.carrier_integrator = 1;
+    g_skew = skew;
+
+    wcs.local_epoch.lo = local_epoch & MASK40;
+    wcs_update_cb(&ev);
+    return &wcs;
+}
+
+/* Next beacon one period later, on the track of the current states */
+static void
+beacon_next(wcs_instance_t * wcs, float skew)
+{
+    struct os_event ev = {.ev_arg = g_ccp};
+    double T = PERIOD_DTU / MYNEWT_VAL(WCS_DTU);
+
+    g_ccp->local_epoch = (g_ccp->local_epoch + PERIOD_DTU) & MASK40;
+    g_ccp->master_epoch.timestamp = wcs->kf.time + PERIOD_DTU
+        + (uint64_t) llround(PERIOD_DTU * (wcs->kf.skew + 0.5 * wcs->kf.drift * T));
+    g_skew = skew;
+    wcs_update_cb(&ev);
+}
+
+static double
+check_map(wcs_instance_t * wcs, uint64_t local_epoch, uint64_t delta)
+{
+    uint64_t local = (local_epoch + delta) & MASK40;
+    long double ref = (long double)wcs->kf.time + (long double)delta * (1.0L + (long double)wcs->kf.skew)
+        + (long double)wcs->kf.drift * (long double)delta * (long double)delta / (2.0L * MYNEWT_VAL(WCS_DTU));
+    long double out = (long double)(wcs_local_to_master64(wcs, local) & MASK40);
+    long double err = out - fmodl(roundl(ref), (long double)(MASK40 + 1));
+    long double bound = ((wcs->kf.drift != 0) ? 2.0L : 1.0L) + (long double)delta / 8589934592.0L;
+
+    if (err > (long double)(MASK40 / 2))
+        err -= (long double)(MASK40 + 1);
+    else if (err < -(long double)(MASK40 / 2))
+        err += (long double)(MASK40 + 1);
+    CHECK(fabsl(err) <= bound);
+    return (double)fabsl(err);
+}
+
+static void
+test_local_to_master(void)
+{
+    const float skews[] = {0, 1e-6f, -1e-6f, 20e-6f, -20e-6f, 100e-6f, -100e-6f};
+    const uint64_t epochs[] = {0x1000, 0x8000000000ULL, MASK40 - PERIOD_DTU / 2};
+    const uint64_t span = PERIOD_DTU * (MYNEWT_VAL(CCP_HOLDOVER_MAX) + 1);
+    double worst = 0;
+
+    for (uint16_t i = 0; i < sizeof(skews) / sizeof(skews[0]); i++) {
+        for (uint16_t j = 0; j < sizeof(epochs) / sizeof(epochs[0]); j++) {
+            wcs_instance_t * wcs = beacon(epochs[j], 0x123456789AULL + j * PERIOD_DTU, skews[i]);
+            CHECK(wcs->status.valid);
+            for (uint64_t delta = 0; delta <= span; delta += span / 997 + 1) {
+                double err = check_map(wcs, epochs[j], delta);
+                worst = (err > worst) ? err : worst;
+            }
+            check_map(wcs, epochs[j], span);
+        }
+    }
+    printf("wcs_local_to_master64: worst error %.1f dtu over %llu dtu\n", worst, (unsigned long long)span);
+}
+
+static void
+test_time_adjust(void)
+{
+    const float skews[] = {1e-6f, -20e-6f, 100e-6f, -100e-6f};
+    double worst = 0;
+
+    for (uint16_t i = 0; i < sizeof(skews) / sizeof(skews[0]); i++) {
+        wcs_instance_t * wcs = beacon(0x1000, 0x2000, skews[i]);
+        for (uint64_t t = 0; t < (1ULL << 40); t += (1ULL << 40) / 1009) {
+            long double ref = roundl((long double)t * (1.0L + (long double)wcs->kf.skew));
+            long double err = fabsl((long double)wcs_dtu_time_adjust(wcs, t) - fmodl(ref, (long double)(MASK40 + 1)));
+            if (err > (long double)(MASK40 / 2))
+                err = (long double)(MASK40 + 1) - err;
+            CHECK(err <= 1.0L + (long double)t / 8589934592.0L);
+            worst = ((double)err > worst) ? (double)err : worst;
+        }
+    }
+    printf("wcs_dtu_time_adjust: worst error %.1f dtu over 2^40 dtu\n", worst);
+}
+
+/* The tracker only takes up a drift on its second beacon, it is set ahead of the update */
+static void
+test_drift(void)
+{
+    const float skews[] = {20e-6f, -100e-6f};
+    const float drifts[] = {1e-9f, 1e-8f, -1e-8f};
+    const uint64_t epoch = MASK40 - PERIOD_DTU * 3;
+    const uint64_t span = PERIOD_DTU * (MYNEWT_VAL(CCP_HOLDOVER_MAX) + 1);
+    double worst = 0, term = 0;
+
+    for (uint16_t i = 0; i < sizeof(skews) / sizeof(skews[0]); i++) {
+        for (uint16_t j = 0; j < sizeof(drifts) / sizeof(drifts[0]); j++) {
+            wcs_instance_t * wcs = beacon(epoch, 0x123456789AULL, skews[i]);
+            wcs->kf.drift = drifts[j];
+            beacon_next(wcs, skews[i] + drifts[j] * (float)(PERIOD_DTU / MYNEWT_VAL(WCS_DTU)));
+            CHECK(wcs->status.valid);
+            CHECK(wcs->kf.drift != 0);
+            for (uint64_t delta = 0; delta <= span; delta += span / 997 + 1) {
+                double err = check_map(wcs, epoch + PERIOD_DTU, delta);
+                worst = (err > worst) ? err : worst;
+            }
+            check_map(wcs, epoch + PERIOD_DTU, span);
+            double t = fabs(wcs->kf.drift) * (double)span * span / (2 * MYNEWT_VAL(WCS_DTU));
+            term = (t > term) ? t : term;
+        }
+    }
+    printf("wcs_local_to_master64 with drift: worst error %.1f dtu, drift term up to %.0f dtu\n", worst, term);
+}
+
+int
+main(void)
+{
+    g_ccp = calloc(1, sizeof(dw1000_ccp_instance_t) + sizeof(ccp_frame_t *));
+    g_ccp->nframes = 1;
+
+    test_local_to_master();
+    test_time_adjust();
+    test_drift();
+    free(g_ccp);
+    printf("wcs_linear: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}